@@ -59,6 +59,7 @@ __attribute__((naked)) int __init kernelsu_init_early(void)
 #include "runtime/ksud.h"
 #include "manager/manager_observer.h"
 #include "selinux/selinux.h"
+#include "selftest/selftest.h"
 #include "supercall/supercall.h"
 #ifdef CONFIG_KSU_SUPERKEY
 #include "manager/superkey.h"
@@ -233,6 +234,8 @@ int __init kernelsu_init(void)
 		ksu_file_wrapper_init();
 	}
 
+	ksu_selftest_run();
+
 #ifndef CONFIG_KSU_DEBUG
 	kobject_del(&THIS_MODULE->mkobj.kobj);
 #endif // #ifndef CONFIG_KSU_DEBUG
@@ -1,10 +1,13 @@
 #include <linux/build_bug.h>
 #include <linux/cred.h>
 #include <linux/errno.h>
+#include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/nsproxy.h>
+#include <linux/path.h>
+#include <linux/proc_ns.h>
 #include <linux/rwsem.h>
 #include <linux/sched/signal.h>
 #include <linux/string.h>
@@ -14,6 +17,7 @@
 
 #include "policy/allowlist.h"
 #include "extension/uts_view.h"
+#include "infra/su_mount_ns.h"
 #include "infra/symbol_resolver.h"
 #include "klog.h" // IWYU pragma: keep
 #include "ksu.h"
@@ -51,6 +55,12 @@ static u32 uts_view_status_flags;
 static u32 detached_task_count;
 static bool runtime_audit_done;
 static bool deny_scoped_active;
+/*
+ * nsfs file of the UTS namespace every deny-scoped process joins, built by the
+ * first such spawn after a config change. Holding it pins the namespace.
+ */
+static struct file *deny_ns_file;
+static u64 deny_ns_generation;
 static bool uts_view_stopping;
 static atomic_t uts_view_active_callbacks = ATOMIC_INIT(0);
 static DECLARE_WAIT_QUEUE_HEAD(uts_view_callback_waitq);
@@ -255,6 +265,15 @@ static void update_deny_active_locked(void)
 		       (uts_view_mode & KSU_UTS_VIEW_MODE_DENY_SCOPED));
 }
 
+static void invalidate_deny_ns_locked(void)
+{
+	if (deny_ns_file) {
+		fput(deny_ns_file);
+		deny_ns_file = NULL;
+	}
+	deny_ns_generation++;
+}
+
 static bool uts_view_callback_enter(void)
 {
 	bool entered = false;
@@ -505,6 +524,7 @@ void ksu_uts_view_exit(void)
 	}
 	memset(&global_cfg, 0, sizeof(global_cfg));
 	memset(&deny_cfg, 0, sizeof(deny_cfg));
+	invalidate_deny_ns_locked();
 	memset(&boot_original_uts, 0, sizeof(boot_original_uts));
 	boot_original_valid = false;
 	uts_view_mode = 0;
@@ -617,6 +637,8 @@ int ksu_uts_view_set_config(const struct ksu_uts_view_config *config)
 	ret = apply_mode ? set_mode_locked(target_mode) : 0;
 	if (!apply_mode)
 		update_deny_active_locked();
+	/* Global fields are baked into the shared namespace as well. */
+	invalidate_deny_ns_locked();
 out:
 	mutex_unlock(&uts_view_lock);
 	return ret;
@@ -647,11 +669,40 @@ int ksu_uts_view_get_status(struct ksu_uts_view_status *status)
 	return 0;
 }
 
-void ksu_uts_view_on_setresuid(uid_t old_uid, uid_t new_uid)
+/* Called with uts_view_lock held, current just unshared and merged. */
+static void publish_deny_ns_locked(u64 generation)
+{
+	struct path ns_path;
+	struct file *ns_file;
+	int ret;
+
+	if (deny_ns_file || generation != deny_ns_generation)
+		return;
+
+	ret = ns_get_path(&ns_path, current, &utsns_operations);
+	if (ret) {
+		pr_warn("uts_view: get path for deny namespace failed: %d\n",
+			ret);
+		return;
+	}
+	ns_file = dentry_open(&ns_path, O_RDONLY, ksu_cred);
+	path_put(&ns_path);
+	if (IS_ERR(ns_file)) {
+		pr_warn("uts_view: open deny namespace failed: %ld\n",
+			PTR_ERR(ns_file));
+		return;
+	}
+	deny_ns_file = ns_file;
+}
+
+void ksu_uts_view_on_setresuid(uid_t old_uid, uid_t new_uid,
+			       bool should_umount)
 {
 	struct ksu_uts_template scoped;
 	struct uts_namespace *current_uts;
 	const struct cred *old_cred;
+	struct file *shared = NULL;
+	u64 generation;
 	long ret;
 
 	(void)old_uid;
@@ -661,7 +712,7 @@ void ksu_uts_view_on_setresuid(uid_t old_uid, uid_t new_uid)
 		return;
 	if (!uts_view_callback_enter())
 		return;
-	if (!is_isolated_process(new_uid) && !ksu_uid_should_umount(new_uid))
+	if (!is_isolated_process(new_uid) && !should_umount)
 		goto out;
 	if (!is_zygote(get_current_cred()))
 		goto out;
@@ -682,10 +733,24 @@ void ksu_uts_view_on_setresuid(uid_t old_uid, uid_t new_uid)
 		mutex_unlock(&uts_view_lock);
 		goto out;
 	}
+	if (deny_ns_file)
+		shared = get_file(deny_ns_file);
+	generation = deny_ns_generation;
 	memcpy(&scoped, &deny_cfg, sizeof(scoped));
 	mutex_unlock(&uts_view_lock);
 
 	old_cred = override_creds(ksu_cred);
+	if (shared) {
+		ret = ksu_setns_file(shared, CLONE_NEWUTS);
+		fput(shared);
+		if (!ret) {
+			revert_creds(old_cred);
+			goto out;
+		}
+		pr_warn("uts_view: joining deny namespace failed for pid %d: "
+			"%ld\n",
+			current->pid, ret);
+	}
 	ret = ksys_unshare(CLONE_NEWUTS);
 	revert_creds(old_cred);
 	if (ret) {
@@ -701,6 +766,8 @@ void ksu_uts_view_on_setresuid(uid_t old_uid, uid_t new_uid)
 		down_write(uts_sem_ptr);
 		merge_template_locked(&current->nsproxy->uts_ns->name, &scoped);
 		up_write(uts_sem_ptr);
+		if (!shared)
+			publish_deny_ns_locked(generation);
 	}
 	mutex_unlock(&uts_view_lock);
 
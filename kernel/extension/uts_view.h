@@ -13,6 +13,7 @@ int ksu_uts_view_get_config(struct ksu_uts_view_config *config);
 int ksu_uts_view_set_config(const struct ksu_uts_view_config *config);
 int ksu_uts_view_get_status(struct ksu_uts_view_status *status);
 
-void ksu_uts_view_on_setresuid(uid_t old_uid, uid_t new_uid);
+void ksu_uts_view_on_setresuid(uid_t old_uid, uid_t new_uid,
+			       bool should_umount);
 
 #endif // #ifndef __KSU_EXT_UTS_VIEW_H
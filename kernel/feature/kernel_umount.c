@@ -486,7 +486,7 @@ out:
 	return f;
 }
 
-int ksu_handle_umount(uid_t old_uid, uid_t new_uid)
+int ksu_handle_umount(uid_t old_uid, uid_t new_uid, bool should_umount)
 {
 	struct file *mountinfo;
 	struct umount_tw *tw;
@@ -517,7 +517,7 @@ int ksu_handle_umount(uid_t old_uid, uid_t new_uid)
 		return 0;
 	}
 
-	if (!ksu_uid_should_umount(new_uid) && !is_isolated_process(new_uid)) {
+	if (!should_umount && !is_isolated_process(new_uid)) {
 		return 0;
 	}
 
@@ -11,7 +11,7 @@ void ksu_kernel_umount_exit(void);
 void try_umount(const char *mnt, int flags);
 
 // Handler function to be called from setresuid hook
-int ksu_handle_umount(uid_t old_uid, uid_t new_uid);
+int ksu_handle_umount(uid_t old_uid, uid_t new_uid, bool should_umount);
 
 // for the umount list
 struct mount_entry {
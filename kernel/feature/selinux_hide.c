@@ -9,13 +9,16 @@
 #include <linux/cred.h>
 #include <linux/cpu.h>
 #include <linux/fs.h>
+#include <linux/ctype.h>
 #include <linux/init.h>
+#include <linux/jhash.h>
 #include <linux/jump_label.h>
 #include <linux/memory.h>
 #include <linux/mm.h>
 #include <linux/moduleparam.h>
 #include <linux/mutex.h>
 #include <linux/printk.h>
+#include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/uaccess.h>
 #include <asm-generic/errno-base.h>
@@ -86,6 +89,137 @@ static struct selinux_state fake_state;
 static write_op_fn *context_write, *access_write;
 static write_op_fn orig_context_write, orig_access_write;
 
+/*
+ * Fake decisions only ever come from backup_sepolicy, which does not change
+ * once captured, so they are memoized until it is dropped. Apps tend to probe
+ * the same handful of contexts on every start.
+ */
+#define HIDE_SID_CACHE_SLOTS 64
+#define HIDE_SID_CACHE_CTX_LEN 96
+#define HIDE_AVD_CACHE_SLOTS 256
+
+struct hide_sid_entry {
+	u32 len; // 0: empty
+	u32 sid;
+	char ctx[HIDE_SID_CACHE_CTX_LEN];
+};
+
+struct hide_avd_entry {
+	bool valid;
+	u16 tclass;
+	u32 ssid;
+	u32 tsid;
+	struct av_decision avd;
+};
+
+static DEFINE_SPINLOCK(hide_cache_lock);
+static struct hide_sid_entry hide_sid_cache[HIDE_SID_CACHE_SLOTS];
+static struct hide_avd_entry hide_avd_cache[HIDE_AVD_CACHE_SLOTS];
+
+static void hide_cache_flush(void)
+{
+	spin_lock(&hide_cache_lock);
+	memset(hide_sid_cache, 0, sizeof(hide_sid_cache));
+	memset(hide_avd_cache, 0, sizeof(hide_avd_cache));
+	spin_unlock(&hide_cache_lock);
+}
+
+static int hide_context_to_sid(const char *ctx, u32 len, u32 *sid)
+{
+	struct hide_sid_entry *e = NULL;
+	int ret;
+
+	if (len && len <= HIDE_SID_CACHE_CTX_LEN) {
+		e = &hide_sid_cache[jhash(ctx, len, 0) %
+				    HIDE_SID_CACHE_SLOTS];
+		spin_lock(&hide_cache_lock);
+		if (e->len == len && !memcmp(e->ctx, ctx, len)) {
+			*sid = e->sid;
+			spin_unlock(&hide_cache_lock);
+			return 0;
+		}
+		spin_unlock(&hide_cache_lock);
+	}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+	ret = security_context_to_sid_with_policy(backup_sepolicy, ctx, len,
+						  sid, SECSID_NULL, GFP_KERNEL);
+#else
+	ret = security_context_to_sid(&fake_state, ctx, len, sid, GFP_KERNEL);
+#endif // #if LINUX_VERSION_CODE >= KERNEL_VERSIO...
+	if (ret || !e)
+		return ret;
+
+	spin_lock(&hide_cache_lock);
+	memcpy(e->ctx, ctx, len);
+	e->len = len;
+	e->sid = *sid;
+	spin_unlock(&hide_cache_lock);
+	return 0;
+}
+
+static void hide_compute_av(u32 ssid, u32 tsid, u16 tclass,
+			    struct av_decision *avd)
+{
+	struct hide_avd_entry *e =
+	    &hide_avd_cache[jhash_3words(ssid, tsid, tclass, 0) %
+			    HIDE_AVD_CACHE_SLOTS];
+
+	spin_lock(&hide_cache_lock);
+	if (e->valid && e->ssid == ssid && e->tsid == tsid &&
+	    e->tclass == tclass) {
+		*avd = e->avd;
+		spin_unlock(&hide_cache_lock);
+		return;
+	}
+	spin_unlock(&hide_cache_lock);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+	security_compute_av_user_with_policy(backup_sepolicy, ssid, tsid,
+					     tclass, avd);
+#else
+	security_compute_av_user(&fake_state, ssid, tsid, tclass, avd);
+#endif // #if LINUX_VERSION_CODE >= KERNEL_VERSIO...
+
+	spin_lock(&hide_cache_lock);
+	e->ssid = ssid;
+	e->tsid = tsid;
+	e->tclass = tclass;
+	e->avd = *avd;
+	e->valid = true;
+	spin_unlock(&hide_cache_lock);
+}
+
+// Split off the next whitespace separated word of *cursor, in place
+static char *hide_next_word(char **cursor)
+{
+	char *word = skip_spaces(*cursor);
+	char *end = word;
+
+	while (*end && !isspace(*end))
+		end++;
+	if (*end)
+		*end++ = '\0';
+	*cursor = end;
+	return *word ? word : NULL;
+}
+
+/*
+ * A class number as sscanf("%hu") reads it: it must start with a digit,
+ * parsing stops at the first non-digit, and the value wraps to 16 bits.
+ */
+static bool hide_parse_tclass(const char *word, u16 *tclass)
+{
+	u16 val = 0;
+
+	if (!isdigit(*word))
+		return false;
+	for (; isdigit(*word); word++)
+		val = val * 10 + (*word - '0');
+	*tclass = val;
+	return true;
+}
+
 static ssize_t my_write_context(struct file *file, char *buf, size_t size)
 {
 	// apply to all app uids
@@ -101,8 +235,7 @@ static ssize_t my_write_context(struct file *file, char *buf, size_t size)
 			      SECCLASS_SECURITY, SECURITY__CHECK_CONTEXT, NULL);
 	if (length)
 		goto out;
-	length = security_context_to_sid_with_policy(
-	    backup_sepolicy, buf, size, &sid, SECSID_NULL, GFP_KERNEL);
+	length = hide_context_to_sid(buf, size, &sid);
 	if (length)
 		goto out;
 
@@ -125,8 +258,7 @@ static ssize_t my_write_context(struct file *file, char *buf, size_t size)
 	if (length)
 		goto out;
 
-	length =
-	    security_context_to_sid(&fake_state, buf, size, &sid, GFP_KERNEL);
+	length = hide_context_to_sid(buf, size, &sid);
 	if (length)
 		goto out;
 
@@ -148,7 +280,7 @@ static ssize_t my_write_access(struct file *file, char *buf, size_t size)
 	if (likely(current_uid().val < 10000)) {
 		return orig_access_write(file, buf, size);
 	}
-	char *scon = NULL, *tcon = NULL;
+	char *cursor = buf, *scon, *tcon, *word;
 	u32 ssid, tsid;
 	u16 tclass;
 	struct av_decision avd;
@@ -165,55 +297,27 @@ static ssize_t my_write_access(struct file *file, char *buf, size_t size)
 	if (length)
 		goto out;
 
-	length = -ENOMEM;
-	scon = kzalloc(size + 1, GFP_KERNEL);
-	if (!scon)
-		goto out;
-
-	length = -ENOMEM;
-	tcon = kzalloc(size + 1, GFP_KERNEL);
-	if (!tcon)
-		goto out;
-
 	length = -EINVAL;
-	if (sscanf(buf, "%s %s %hu", scon, tcon, &tclass) != 3)
-		goto out;
-
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
-	length = security_context_to_sid_with_policy(backup_sepolicy, scon,
-						     strlen(scon), &ssid,
-						     SECSID_NULL, GFP_KERNEL);
-	if (length)
-		goto out;
-
-	length = security_context_to_sid_with_policy(backup_sepolicy, tcon,
-						     strlen(tcon), &tsid,
-						     SECSID_NULL, GFP_KERNEL);
-	if (length)
+	scon = hide_next_word(&cursor);
+	tcon = hide_next_word(&cursor);
+	word = hide_next_word(&cursor);
+	if (!scon || !tcon || !word || !hide_parse_tclass(word, &tclass))
 		goto out;
 
-	security_compute_av_user_with_policy(backup_sepolicy, ssid, tsid,
-					     tclass, &avd);
-#else
-	length =
-	    security_context_str_to_sid(&fake_state, scon, &ssid, GFP_KERNEL);
+	length = hide_context_to_sid(scon, strlen(scon), &ssid);
 	if (length)
 		goto out;
 
-	length =
-	    security_context_str_to_sid(&fake_state, tcon, &tsid, GFP_KERNEL);
+	length = hide_context_to_sid(tcon, strlen(tcon), &tsid);
 	if (length)
 		goto out;
 
-	security_compute_av_user(&fake_state, ssid, tsid, tclass, &avd);
-#endif // #if LINUX_VERSION_CODE >= KERNEL_VERSIO...
+	hide_compute_av(ssid, tsid, tclass, &avd);
 
 	length = scnprintf(buf, SIMPLE_TRANSACTION_LIMIT, "%x %x %x %x %u %x",
 			   avd.allowed, 0xffffffff, avd.auditallow,
 			   avd.auditdeny, avd.seqno, avd.flags);
 out:
-	kfree(tcon);
-	kfree(scon);
 	return length;
 }
 
@@ -252,13 +356,7 @@ static int __nocfi my_setprocattr(const char *name, void *value, size_t size)
 			str[size - 1] = 0;
 			size--;
 		}
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
-		error = security_context_to_sid_with_policy(
-		    backup_sepolicy, str, size, &sid, SECSID_NULL, GFP_KERNEL);
-#else
-		error = security_context_to_sid(&fake_state, str, size, &sid,
-						GFP_KERNEL);
-#endif // #if LINUX_VERSION_CODE >= KERNEL_VERSIO...
+		error = hide_context_to_sid(str, size, &sid);
 		if (error) {
 			return error;
 		}
@@ -353,12 +451,13 @@ static int ksu_selinux_hide_enable()
 {
 	int ret;
 	pr_info("selinux_hide: init selinux hide\n");
+	hide_cache_flush();
 	if (!backup_sepolicy) {
 		pr_err("no backup sepolicy available, please save feature and "
 		       "reboot to retry!\n");
 		return -EAGAIN;
 	}
-	selinux_write_op = (write_op_fn *)find_kernel_symbol_exact("write_op");
+	selinux_write_op = (write_op_fn *)ksu_lookup_symbol_exact("write_op");
 	if (!selinux_write_op) {
 		pr_err("selinux_hide: no write_op found!\n");
 		return -ENOSYS;
@@ -367,12 +466,12 @@ static int ksu_selinux_hide_enable()
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
 	security_dump_masked_av_fn =
-	    (void *)find_kernel_symbol_exact("security_dump_masked_av");
+	    (void *)ksu_lookup_symbol_exact("security_dump_masked_av");
 	if (!security_dump_masked_av_fn) {
 		pr_warn("security_dump_masked_av not found!\n");
 	}
 	context_struct_compute_av_fn =
-	    (void *)find_kernel_symbol_exact("context_struct_compute_av");
+	    (void *)ksu_lookup_symbol_exact("context_struct_compute_av");
 	if (!context_struct_compute_av_fn) {
 		pr_warn("context_struct_compute_av not found!\n");
 	}
@@ -542,7 +641,7 @@ static void hook_selinux_status_open(void)
 	if (orig_sel_open_handle_status)
 		return;
 	if (!sel_open_handle_status_slot) {
-		ops = (struct file_operations *)find_kernel_symbol_exact(
+		ops = (struct file_operations *)ksu_lookup_symbol_exact(
 		    "sel_handle_status_ops");
 		if (!ops) {
 			pr_err("selinux_hide: sel_handle_status_ops not found, "
@@ -601,6 +700,7 @@ void ksu_selinux_hide_drop_backup_if_unused()
 	mutex_lock(&selinux_hide_mutex);
 	if (!ksu_selinux_hide_running && backup_sepolicy) {
 		pr_info("selinux_hide is not enabled - drop backup_sepolicy\n");
+		hide_cache_flush();
 		sidtab_destroy(backup_sepolicy->sidtab);
 		kfree(backup_sepolicy->sidtab);
 		ksu_destroy_sepolicy(backup_sepolicy);
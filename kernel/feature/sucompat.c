@@ -16,8 +16,11 @@
 #include "arch.h"
 #include "policy/feature.h"
 #include "hook/syscall_hook.h"
+#include "hook/tp_marker.h"
 #include "klog.h" // IWYU pragma: keep
+#include "manager/manager_identity.h"
 #include "runtime/ksud.h"
+#include "selftest/selftest.h"
 #include "sulog/event.h"
 #include "uapi/supercall.h"
 #include "feature/sucompat.h"
@@ -103,39 +106,75 @@ static char __user *ksud_user_path(void)
 	return userspace_stack_buffer(ksud_path, sizeof(ksud_path));
 }
 
+/*
+ * Match a user path against SU_PATH without copying it: one 8-byte load of
+ * the head rejects almost every path, and a second load of the last 8 bytes
+ * (overlapping the first, and covering the terminating NUL) decides the rest.
+ * A fault on either load means the string cannot be SU_PATH.
+ */
+static bool is_su_path(const char __user *filename_user)
+{
+	static const char su[] = SU_PATH;
+	const char __user *fn;
+	u64 head, tail;
+	u64 word;
+
+	BUILD_BUG_ON(sizeof(su) < sizeof(u64) || sizeof(su) > 2 * sizeof(u64));
+
+	fn = (const char __user *)untagged_addr((unsigned long)filename_user);
+	memcpy(&head, su, sizeof(head));
+	if (get_user(word, (const u64 __user *)fn) || likely(word != head))
+		return false;
+
+	memcpy(&tail, su + sizeof(su) - sizeof(tail), sizeof(tail));
+	if (get_user(word,
+		     (const u64 __user *)(fn + sizeof(su) - sizeof(tail))))
+		return false;
+	return word == tail;
+}
+
+#ifdef CONFIG_KSU_SELFTEST
+const char *ksu_selftest_su_path(void)
+{
+	return SU_PATH;
+}
+
+bool ksu_selftest_is_su_path(const char __user *filename_user)
+{
+	return is_su_path(filename_user);
+}
+#endif // #ifdef CONFIG_KSU_SELFTEST
+
+/*
+ * setresuid() only leaves allowed app uids marked. One that is still marked
+ * but no longer allowed had its grant revoked since; drop the mark so its
+ * later syscalls skip the redirect instead of being turned away here.
+ */
+static void sucompat_unmark_denied(uid_t uid)
+{
+	if (is_appuid(uid) && !ksu_is_uid_manager(uid))
+		ksu_clear_task_tracepoint_flag_if_needed(current);
+}
+
 int ksu_handle_faccessat(int *dfd, const char __user **filename_user, int *mode,
 			 int *__unused_flags)
 {
-	const char su[] = SU_PATH;
-	unsigned long addr;
-	const char __user *fn;
-	long ret;
+	uid_t uid = current_uid().val;
 
 	if (!ksu_su_compat_enabled)
 		return 0;
 
-	if (!ksu_is_allow_uid_for_current(current_uid().val))
+	if (!ksu_is_allow_uid_for_current(uid)) {
+		sucompat_unmark_denied(uid);
 		return 0;
+	}
 
 	if (unlikely(!filename_user || !*filename_user))
 		return 0;
 
-	addr = untagged_addr((unsigned long)*filename_user);
-	fn = (const char __user *)addr;
-
-	{
-		char path[sizeof(su) + 1];
-
-		memset(path, 0, sizeof(path));
-		ret = strncpy_from_user(path, fn, sizeof(path));
-		if (ret < 0)
-			return 0;
-		path[sizeof(path) - 1] = '\0';
-
-		if (unlikely(!memcmp(path, su, sizeof(su)))) {
-			pr_info("faccessat su->sh!\n");
-			*filename_user = sh_user_path();
-		}
+	if (unlikely(is_su_path(*filename_user))) {
+		pr_info("faccessat su->sh!\n");
+		*filename_user = sh_user_path();
 	}
 
 	return 0;
@@ -143,36 +182,22 @@ int ksu_handle_faccessat(int *dfd, const char __user **filename_user, int *mode,
 
 int ksu_handle_stat(int *dfd, const char __user **filename_user, int *flags)
 {
-	const char su[] = SU_PATH;
-	unsigned long addr;
-	const char __user *fn;
-	long ret;
+	uid_t uid = current_uid().val;
 
 	if (!ksu_su_compat_enabled)
 		return 0;
 
-	if (!ksu_is_allow_uid_for_current(current_uid().val))
+	if (!ksu_is_allow_uid_for_current(uid)) {
+		sucompat_unmark_denied(uid);
 		return 0;
+	}
 
 	if (unlikely(!filename_user || !*filename_user))
 		return 0;
 
-	addr = untagged_addr((unsigned long)*filename_user);
-	fn = (const char __user *)addr;
-
-	{
-		char path[sizeof(su) + 1];
-
-		memset(path, 0, sizeof(path));
-		ret = strncpy_from_user(path, fn, sizeof(path));
-		if (ret < 0)
-			return 0;
-		path[sizeof(path) - 1] = '\0';
-
-		if (unlikely(!memcmp(path, su, sizeof(su)))) {
-			pr_info("newfstatat su->sh!\n");
-			*filename_user = sh_user_path();
-		}
+	if (unlikely(is_su_path(*filename_user))) {
+		pr_info("newfstatat su->sh!\n");
+		*filename_user = sh_user_path();
 	}
 
 	return 0;
@@ -183,12 +208,9 @@ ksu_handle_execve_sucompat_common(const char __user **filename_user,
 				  const char __user *const __user *argv_user,
 				  int orig_nr, const struct pt_regs *regs)
 {
-	const char su[] = SU_PATH;
-	const char __user *fn;
+	uid_t uid = current_uid().val;
 	struct ksu_sulog_pending_event *pending_sucompat = NULL;
-	char path[sizeof(su) + 1];
 	long ret;
-	unsigned long addr;
 
 	if (unlikely(!filename_user || !*filename_user))
 		goto do_orig_execve;
@@ -196,21 +218,12 @@ ksu_handle_execve_sucompat_common(const char __user **filename_user,
 	if (!ksu_su_compat_enabled)
 		goto do_orig_execve;
 
-	if (!ksu_is_allow_uid_for_current(current_uid().val))
-		goto do_orig_execve;
-
-	addr = untagged_addr((unsigned long)*filename_user);
-	fn = (const char __user *)addr;
-	memset(path, 0, sizeof(path));
-
-	ret = strncpy_from_user(path, fn, sizeof(path));
-	if (ret < 0) {
-		pr_warn("Access filename when exec failed: %ld", ret);
+	if (!ksu_is_allow_uid_for_current(uid)) {
+		sucompat_unmark_denied(uid);
 		goto do_orig_execve;
 	}
-	path[sizeof(path) - 1] = '\0';
 
-	if (likely(memcmp(path, su, sizeof(su))))
+	if (likely(!is_su_path(*filename_user)))
 		goto do_orig_execve;
 
 	pr_info("exec su found\n");
@@ -7,7 +7,7 @@
 #include "hook/syscall_hook.h"
 
 #include <linux/mutex.h>
-#include <linux/rwsem.h>
+#include <linux/srcu.h>
 #include <linux/string.h>
 #include "arch.h"
 #include "infra/symbol_resolver.h"
@@ -17,8 +17,16 @@
 syscall_fn_t *ksu_syscall_table = NULL;
 int ksu_dispatcher_nr = -1;
 
+/*
+ * Hooks are looked up without taking a lock: the dispatcher runs on every
+ * redirected newfstatat/faccessat, so a shared rwsem there bounced one cache
+ * line across all CPUs. Readers only enter an SRCU section (per-CPU counters,
+ * and hooks may sleep); writers serialise on a mutex, and unregistering waits
+ * for in-flight hooks with synchronize_srcu().
+ */
 static ksu_syscall_hook_fn syscall_hooks[KSU_NR_SYSCALLS];
-static DECLARE_RWSEM(syscall_hooks_lock);
+DEFINE_STATIC_SRCU(syscall_hooks_srcu);
+static DEFINE_MUTEX(syscall_hooks_mutex);
 
 struct syscall_hook_entry {
 	int nr;
@@ -151,31 +159,37 @@ static int ksu_find_ni_syscall_slots(int *out_slots, int max_slots)
 static long __nocfi ksu_syscall_dispatcher(const struct pt_regs *regs)
 {
 	int orig_nr;
+	int idx;
 	ksu_syscall_hook_fn fn;
 	long ret = -ENOSYS;
 
-	down_read(&syscall_hooks_lock);
-	if (regs->syscallno != ksu_dispatcher_nr)
-		goto out;
+	if (regs->syscallno != READ_ONCE(ksu_dispatcher_nr))
+		return ret;
 
 	orig_nr = (int)PT_REGS_ORIG_SYSCALL(regs);
 	if (regs->syscallno == orig_nr)
-		goto out;
+		return ret;
 
 	((struct pt_regs *)regs)->syscallno = orig_nr;
 	PT_REGS_ORIG_SYSCALL((struct pt_regs *)regs) = orig_nr;
 
-	if (likely(orig_nr >= 0 && orig_nr < KSU_NR_SYSCALLS)) {
-		fn = READ_ONCE(syscall_hooks[orig_nr]);
-		if (likely(fn))
-			ret = fn(orig_nr, regs);
-		else
-			ret = ksu_syscall_table[orig_nr](regs);
+	if (unlikely(orig_nr < 0 || orig_nr >= KSU_NR_SYSCALLS))
+		return ret;
+
+	idx = srcu_read_lock(&syscall_hooks_srcu);
+	fn = READ_ONCE(syscall_hooks[orig_nr]);
+	if (likely(fn)) {
+		ret = fn(orig_nr, regs);
+		srcu_read_unlock(&syscall_hooks_srcu, idx);
+		return ret;
 	}
+	srcu_read_unlock(&syscall_hooks_srcu, idx);
 
-out:
-	up_read(&syscall_hooks_lock);
-	return ret;
+	/*
+	 * Unhooked: run the original outside the read section so a blocking
+	 * syscall cannot hold up synchronize_srcu().
+	 */
+	return ksu_syscall_table[orig_nr](regs);
 }
 
 int ksu_register_syscall_hook(int nr, ksu_syscall_hook_fn fn)
@@ -183,16 +197,16 @@ int ksu_register_syscall_hook(int nr, ksu_syscall_hook_fn fn)
 	if (nr < 0 || nr >= KSU_NR_SYSCALLS)
 		return -EINVAL;
 
-	down_write(&syscall_hooks_lock);
+	mutex_lock(&syscall_hooks_mutex);
 	if (READ_ONCE(syscall_hooks[nr])) {
-		up_write(&syscall_hooks_lock);
+		mutex_unlock(&syscall_hooks_mutex);
 		pr_warn("syscall hook for nr=%d already registered, skip\n",
 			nr);
 		return -EEXIST;
 	}
 
 	WRITE_ONCE(syscall_hooks[nr], fn);
-	up_write(&syscall_hooks_lock);
+	mutex_unlock(&syscall_hooks_mutex);
 	pr_info("registered syscall hook for nr=%d\n", nr);
 	return 0;
 }
@@ -202,9 +216,12 @@ void ksu_unregister_syscall_hook(int nr)
 	if (nr < 0 || nr >= KSU_NR_SYSCALLS)
 		return;
 
-	down_write(&syscall_hooks_lock);
+	mutex_lock(&syscall_hooks_mutex);
 	WRITE_ONCE(syscall_hooks[nr], NULL);
-	up_write(&syscall_hooks_lock);
+	mutex_unlock(&syscall_hooks_mutex);
+
+	/* Callers may free or unload the hook once this returns */
+	synchronize_srcu(&syscall_hooks_srcu);
 	pr_info("unregistered syscall hook for nr=%d\n", nr);
 }
 
@@ -269,10 +286,13 @@ void ksu_syscall_hook_exit(void)
 	mutex_unlock(&hooked_entries_lock);
 
 clear_state:
-	down_write(&syscall_hooks_lock);
-	memset(syscall_hooks, 0, sizeof(syscall_hooks));
-	ksu_dispatcher_nr = -1;
-	up_write(&syscall_hooks_lock);
+	mutex_lock(&syscall_hooks_mutex);
+	/* Readers run concurrently now; clear slot by slot, untorn */
+	for (i = 0; i < KSU_NR_SYSCALLS; i++)
+		WRITE_ONCE(syscall_hooks[i], NULL);
+	WRITE_ONCE(ksu_dispatcher_nr, -1);
+	mutex_unlock(&syscall_hooks_mutex);
+	synchronize_srcu(&syscall_hooks_srcu);
 
 	pr_info("all syscall hooks restored\n");
 }
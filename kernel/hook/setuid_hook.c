@@ -1,4 +1,5 @@
 #include <linux/compiler.h>
+#include <linux/moduleparam.h>
 #include <linux/printk.h>
 #include <linux/sched.h>
 #include <linux/sched/signal.h>
@@ -13,6 +14,7 @@
 
 #include "policy/allowlist.h"
 #include "policy/feature.h"
+#include "policy/spawn_table.h"
 #include "feature/kernel_umount.h"
 #include "extension/uts_view.h"
 #ifdef CONFIG_KSU_YUKIZYGISK
@@ -28,6 +30,10 @@
 
 static bool ksu_enhanced_security_enabled = false;
 
+// log every uid transition (ratelimited); zygote forks make this very noisy
+static bool setuid_debug;
+module_param(setuid_debug, bool, 0644);
+
 static int enhanced_security_feature_get(u64 *value)
 {
 	*value = ksu_enhanced_security_enabled ? 1 : 0;
@@ -55,13 +61,19 @@ static const struct ksu_feature_handler enhanced_security_handler = {
  */
 int ksu_handle_setresuid(uid_t old_uid, uid_t new_uid)
 {
-	pr_info("handle_setresuid from %d to %d\n", old_uid, new_uid);
+	u8 decision;
+
+	if (unlikely(READ_ONCE(setuid_debug)))
+		pr_info_ratelimited("handle_setresuid from %d to %d\n",
+				    old_uid, new_uid);
 
 	/* Notify lifecycle tracking after a successful UID transition. */
 #ifdef CONFIG_KSU_YUKIZYGISK
 	ksu_yukizygisk_on_setresuid(old_uid, new_uid);
 #endif // #ifdef CONFIG_KSU_YUKIZYGISK
-	ksu_uts_view_on_setresuid(old_uid, new_uid);
+	decision = ksu_spawn_decision(new_uid);
+	ksu_uts_view_on_setresuid(old_uid, new_uid,
+				  decision & KSU_SPAWN_UMOUNT);
 
 	// if old process is root, ignore it.
 	if (old_uid != 0 && ksu_enhanced_security_enabled) {
@@ -97,7 +109,7 @@ int ksu_handle_setresuid(uid_t old_uid, uid_t new_uid)
 	 * prioritizes the globally authenticated SuperKey UID, which must not
 	 * prevent another trusted dynamic manager from receiving its driver fd.
 	 */
-	if (ksu_is_uid_manager(new_uid)) {
+	if (decision & KSU_SPAWN_MANAGER) {
 		spin_lock_irq(&current->sighand->siglock);
 		ksu_seccomp_allow_cache(current->seccomp.filter, __NR_reboot);
 		ksu_set_task_tracepoint_flag(current);
@@ -110,7 +122,7 @@ int ksu_handle_setresuid(uid_t old_uid, uid_t new_uid)
 		return 0;
 	}
 
-	if (ksu_is_allow_uid_for_current(new_uid)) {
+	if (decision & KSU_SPAWN_ALLOW) {
 		if (current->seccomp.mode == SECCOMP_MODE_FILTER &&
 		    current->seccomp.filter) {
 			spin_lock_irq(&current->sighand->siglock);
@@ -124,13 +136,14 @@ int ksu_handle_setresuid(uid_t old_uid, uid_t new_uid)
 	}
 
 	// Handle kernel umount
-	ksu_handle_umount(old_uid, new_uid);
+	ksu_handle_umount(old_uid, new_uid, decision & KSU_SPAWN_UMOUNT);
 
 	return 0;
 }
 
 void ksu_setuid_hook_init(void)
 {
+	ksu_spawn_table_init();
 	ksu_kernel_umount_init();
 	if (ksu_register_feature_handler(&enhanced_security_handler)) {
 		pr_err(
@@ -143,4 +156,5 @@ void ksu_setuid_hook_exit(void)
 	pr_info("ksu_core_exit\n");
 	ksu_kernel_umount_exit();
 	ksu_unregister_feature_handler(KSU_FEATURE_ENHANCED_SECURITY);
+	ksu_spawn_table_exit();
 }
@@ -14,6 +14,8 @@
 #include <linux/sched/task.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
 #include <linux/version.h>
 
 #include "policy/allowlist.h"
@@ -36,79 +38,157 @@ void ksu_clear_task_tracepoint_flag_if_needed(struct task_struct *t)
 	spin_unlock_irqrestore(&tracepoint_reg_lock, flags);
 }
 
-// Process marking management
-static void handle_process_mark(bool mark)
+/*
+ * Process marking management. Children inherit the mark on fork and the
+ * setresuid hook re-decides it for app transitions, so whole-system walks are
+ * only needed on load, on tracepoint handoff and on explicit requests. They
+ * walk the task list under RCU in bounded batches instead of holding
+ * tasklist_lock across every thread.
+ */
+enum tp_mark_op {
+	TP_MARK_ALL,
+	TP_UNMARK_ALL,
+	TP_MARK_REFRESH,
+	TP_MARK_REFRESH_UID,
+};
+
+#define TP_MARK_BATCH 256
+// give up yielding once the cursor keeps exiting under us
+#define TP_MARK_MAX_RESTARTS 8
+
+static DEFINE_MUTEX(tp_mark_walk_mutex);
+
+static bool tp_should_mark(struct task_struct *t)
 {
-	struct task_struct *p, *t;
-	read_lock(&tasklist_lock);
-	for_each_process_thread(p, t)
-	{
-		if (mark)
-			ksu_set_task_tracepoint_flag(t);
-		else
-			ksu_clear_task_tracepoint_flag(t);
-	}
-	read_unlock(&tasklist_lock);
+	const struct cred *cred = __task_cred(t);
+	uid_t uid = cred->uid.val;
+
+	// before boot completed, we shall mark init for marking zygote
+	if (t->pid == 1)
+		return true;
+	return (uid == 0 && is_task_ksu_domain(cred)) || is_zygote(cred) ||
+	       uid == 2000 || ksu_is_allow_uid(uid);
 }
 
-void ksu_mark_all_process(void)
+static bool tp_refresh(struct task_struct *t)
 {
-	handle_process_mark(true);
-	pr_info("tp_marker: mark all user process done!\n");
+	/* Skip kernel threads, but always keep pid 1 markable. */
+	if (t->pid != 1 && !t->mm)
+		return false;
+	if (tp_should_mark(t)) {
+		ksu_set_task_tracepoint_flag(t);
+		return true;
+	}
+	ksu_clear_task_tracepoint_flag(t);
+	return false;
 }
 
-void ksu_unmark_all_process(void)
+/* Called under rcu_read_lock() */
+static bool tp_apply(struct task_struct *t, enum tp_mark_op op, uid_t uid)
 {
-	handle_process_mark(false);
-	pr_info("tp_marker: unmark all user process done!\n");
+	switch (op) {
+	case TP_MARK_ALL:
+		ksu_set_task_tracepoint_flag(t);
+		return true;
+	case TP_UNMARK_ALL:
+		ksu_clear_task_tracepoint_flag(t);
+		return false;
+	case TP_MARK_REFRESH:
+		return tp_refresh(t);
+	case TP_MARK_REFRESH_UID:
+		return task_uid(t).val == uid && tp_refresh(t);
+	}
+	return false;
 }
 
-static void ksu_mark_running_process_locked(void)
+static void tp_mark_walk(enum tp_mark_op op, uid_t uid)
 {
 	struct task_struct *p, *t;
-	read_lock(&tasklist_lock);
-	for_each_process_thread(p, t)
-	{
-		if (t->pid != 1 && !t->mm) {
-			/* Skip kernel threads, but always keep pid 1 markable.
-			 */
-			continue;
+	unsigned int marked, threads;
+	int budget, restarts = 0;
+
+	mutex_lock(&tp_mark_walk_mutex);
+restart:
+	marked = 0;
+	threads = 0;
+	budget = TP_MARK_BATCH;
+	rcu_read_lock();
+	p = &init_task;
+	while ((p = next_task(p)) != &init_task) {
+		for_each_thread(p, t)
+		{
+			if (tp_apply(t, op, uid))
+				marked++;
+			threads++;
+			budget--;
 		}
-		int uid = task_uid(t).val;
-		const struct cred *cred = get_task_cred(t);
-		bool ksu_root_process = uid == 0 && is_task_ksu_domain(cred);
-		bool is_zygote_process = is_zygote(cred);
-		bool is_shell = uid == 2000;
-		// before boot completed, we shall mark init for marking zygote
-		bool is_init = t->pid == 1;
-		if (ksu_root_process || is_zygote_process || is_shell ||
-		    is_init || ksu_is_allow_uid(uid)) {
-			ksu_set_task_tracepoint_flag(t);
-			pr_info("tp_marker: mark process: pid:%d, uid: %d, "
-				"comm:%s\n",
-				t->pid, uid, t->comm);
-		} else {
-			ksu_clear_task_tracepoint_flag(t);
-			pr_info("tp_marker: unmark process: pid:%d, uid: "
-				"%d, comm:%s\n",
-				t->pid, uid, t->comm);
+		if (budget > 0 || restarts >= TP_MARK_MAX_RESTARTS)
+			continue;
+
+		/*
+		 * Yield between batches. The pinned leader is only a valid
+		 * cursor if it is still hashed; otherwise its list linkage
+		 * may be stale, so start over (marking is idempotent).
+		 */
+		get_task_struct(p);
+		rcu_read_unlock();
+		cond_resched();
+		rcu_read_lock();
+		if (!pid_alive(p)) {
+			rcu_read_unlock();
+			put_task_struct(p);
+			restarts++;
+			goto restart;
 		}
-		put_cred(cred);
+		// still hashed, so this is not the last reference
+		put_task_struct(p);
+		budget = TP_MARK_BATCH;
 	}
-	read_unlock(&tasklist_lock);
+	rcu_read_unlock();
+	mutex_unlock(&tp_mark_walk_mutex);
+
+	pr_info("tp_marker: op %d uid %d: %u of %u threads marked (%d "
+		"restarts)\n",
+		op, op == TP_MARK_REFRESH_UID ? (int)uid : -1, marked, threads,
+		restarts);
 }
 
-void ksu_mark_running_process(void)
+void ksu_mark_all_process(void)
+{
+	tp_mark_walk(TP_MARK_ALL, 0);
+	pr_info("tp_marker: mark all user process done!\n");
+}
+
+void ksu_unmark_all_process(void)
+{
+	tp_mark_walk(TP_UNMARK_ALL, 0);
+	pr_info("tp_marker: unmark all user process done!\n");
+}
+
+static bool tp_marker_exclusive(void)
 {
 	unsigned long flags;
+	bool exclusive;
+
 	spin_lock_irqsave(&tracepoint_reg_lock, flags);
-	if (tracepoint_reg_count <= 1) {
-		ksu_mark_running_process_locked();
-	} else {
+	exclusive = tracepoint_reg_count <= 1;
+	spin_unlock_irqrestore(&tracepoint_reg_lock, flags);
+	if (!exclusive)
 		pr_info("tp_marker: not mark running process since syscall "
 			"tracepoint is in use\n");
-	}
-	spin_unlock_irqrestore(&tracepoint_reg_lock, flags);
+	return exclusive;
+}
+
+void ksu_mark_running_process(void)
+{
+	if (tp_marker_exclusive())
+		tp_mark_walk(TP_MARK_REFRESH, 0);
+}
+
+void ksu_mark_uid_process(uid_t uid)
+{
+	if (tp_marker_exclusive())
+		tp_mark_walk(TP_MARK_REFRESH_UID, uid);
 }
 
 // Get task mark status
@@ -202,20 +282,42 @@ static void destroy_kretprobe(struct kretprobe **rp_ptr)
 	*rp_ptr = NULL;
 }
 
+/* Bring every task in line with the current tracepoint users */
+static void tp_marker_reconcile(struct work_struct *work)
+{
+	unsigned long flags;
+	int count;
+
+	(void)work;
+	spin_lock_irqsave(&tracepoint_reg_lock, flags);
+	count = tracepoint_reg_count;
+	spin_unlock_irqrestore(&tracepoint_reg_lock, flags);
+
+	if (count <= 0)
+		// no tracepoint left
+		tp_mark_walk(TP_UNMARK_ALL, 0);
+	else if (count == 1)
+		// just ours: mark our processes only
+		tp_mark_walk(TP_MARK_REFRESH, 0);
+	else
+		// someone else (e.g. ftrace) needs every process
+		tp_mark_walk(TP_MARK_ALL, 0);
+}
+
+static DECLARE_WORK(tp_marker_reconcile_work, tp_marker_reconcile);
+
 static int syscall_regfunc_handler(struct kretprobe_instance *ri,
 				   struct pt_regs *regs)
 {
 	unsigned long flags;
+	int count;
+
 	spin_lock_irqsave(&tracepoint_reg_lock, flags);
-	if (tracepoint_reg_count < 1) {
-		// while install our tracepoint, mark our processes
-		ksu_mark_running_process_locked();
-	} else if (tracepoint_reg_count == 1) {
-		// while other tracepoint first added, mark all processes
-		ksu_mark_all_process();
-	}
-	tracepoint_reg_count++;
+	count = ++tracepoint_reg_count;
 	spin_unlock_irqrestore(&tracepoint_reg_lock, flags);
+	// 1: our processes, 2: first foreign user, everyone
+	if (count <= 2)
+		schedule_work(&tp_marker_reconcile_work);
 	return 0;
 }
 
@@ -223,16 +325,14 @@ static int syscall_unregfunc_handler(struct kretprobe_instance *ri,
 				     struct pt_regs *regs)
 {
 	unsigned long flags;
+	int count;
+
 	spin_lock_irqsave(&tracepoint_reg_lock, flags);
-	tracepoint_reg_count--;
-	if (tracepoint_reg_count <= 0) {
-		// while no tracepoint left, unmark all processes
-		ksu_unmark_all_process();
-	} else if (tracepoint_reg_count == 1) {
-		// while just our tracepoint left, unmark disallowed processes
-		ksu_mark_running_process_locked();
-	}
+	count = --tracepoint_reg_count;
 	spin_unlock_irqrestore(&tracepoint_reg_lock, flags);
+	// 0: unmark everyone, 1: back to our processes only
+	if (count <= 1)
+		schedule_work(&tp_marker_reconcile_work);
 	return 0;
 }
 
@@ -250,7 +350,7 @@ void ksu_tp_marker_init(void)
 #endif // #ifdef CONFIG_KRETPROBES
 
 #ifndef CONFIG_KRETPROBES
-	ksu_mark_running_process_locked();
+	tp_mark_walk(TP_MARK_REFRESH, 0);
 #endif // #ifndef CONFIG_KRETPROBES
 }
 
@@ -259,5 +359,6 @@ void ksu_tp_marker_exit(void)
 #ifdef CONFIG_KRETPROBES
 	destroy_kretprobe(&syscall_regfunc_rp);
 	destroy_kretprobe(&syscall_unregfunc_rp);
+	cancel_work_sync(&tp_marker_reconcile_work);
 #endif // #ifdef CONFIG_KRETPROBES
 }
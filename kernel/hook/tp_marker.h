@@ -32,6 +32,8 @@ void ksu_tp_marker_exit(void);
 void ksu_mark_all_process(void);
 void ksu_unmark_all_process(void);
 void ksu_mark_running_process(void);
+// Re-decide the mark for tasks running as uid only
+void ksu_mark_uid_process(uid_t uid);
 
 /* Per-task mark operations */
 int ksu_get_task_mark(pid_t pid);
@@ -37,6 +37,29 @@ static long ksu_sys_setns(int fd, int flags)
 	return __arm64_sys_setns(&regs);
 }
 
+long ksu_setns_file(struct file *ns_file, int nstype)
+{
+	long ret;
+	int fd;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		pr_warn("failed to get an unused fd: %d\n", fd);
+		return fd;
+	}
+
+	fd_install(fd, get_file(ns_file));
+	ret = ksu_sys_setns(fd, nstype);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 11, 0)
+	ksys_close(fd);
+#else
+	close_fd(fd);
+#endif // #if LINUX_VERSION_CODE < KERNEL_VERSION...
+
+	return ret;
+}
+
 static void ksu_mnt_ns_global(void)
 {
 	char *pwd_path = NULL;
@@ -46,7 +69,6 @@ static void ksu_mnt_ns_global(void)
 	struct path ns_path;
 	struct file *ns_file;
 	long ret;
-	int fd;
 
 	if (!pwd_buf) {
 		pr_warn("no mem for pwd buffer, skip restore pwd!!\n");
@@ -101,22 +123,8 @@ try_setns:
 		goto out;
 	}
 
-	fd = get_unused_fd_flags(O_CLOEXEC);
-	if (fd < 0) {
-		pr_warn("failed to get an unused fd: %d\n", fd);
-		fput(ns_file);
-		goto out;
-	}
-
-	fd_install(fd, ns_file);
-	ret = ksu_sys_setns(fd, CLONE_NEWNS);
-
-#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 11, 0)
-	ksys_close(fd);
-#else
-	close_fd(fd);
-#endif // #if LINUX_VERSION_CODE < KERNEL_VERSION...
-
+	ret = ksu_setns_file(ns_file, CLONE_NEWNS);
+	fput(ns_file);
 	if (ret) {
 		pr_warn("call setns failed: %ld\n", ret);
 		goto out;
@@ -9,4 +9,9 @@
 
 void setup_mount_ns(int32_t ns_mode);
 
+struct file;
+
+// setns() into the namespace file, as current; ns_file keeps its reference
+long ksu_setns_file(struct file *ns_file, int nstype);
+
 #endif // #ifndef __KSU_SU_MOUNT_NS_H
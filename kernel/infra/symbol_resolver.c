@@ -2,7 +2,10 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/printk.h>
+#include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/hash.h>
+#include <linux/stringhash.h>
 #include <linux/version.h>
 
 #include "symbol_resolver.h"
@@ -166,11 +169,187 @@ void *ksu_resolve_symbol_for_functable_hook(const char *symbol_name)
 #endif // #if !USE_KCFI
 }
 
+/*
+ * Symbols looked up during init or from hot enable paths. They are resolved
+ * together in one kallsyms walk at init so each later lookup is a table hit
+ * instead of another walk over the whole symbol table.
+ */
+static const char *const ksu_boot_symbols[] = {
+    // hook/arm64/syscall_hook.c
+    "sys_call_table",
+    "__arm64_sys_ni_syscall",
+    // hook/lsm_hook.c
+    "security_hook_heads",
+    "static_calls_table",
+    "lsm_active_cnt",
+    // extension/uts_view.c
+    "uts_sem",
+    "init_uts_ns",
+    // feature/selinux_hide.c
+    "write_op",
+    "sel_handle_status_ops",
+    "security_dump_masked_av",
+    "context_struct_compute_av",
+    "selinux_setprocattr",
+    // feature/yukizygisk/exec.c
+    "selinux_bprm_committed_creds",
+};
+
+#define KSU_BOOT_SYMBOL_COUNT ARRAY_SIZE(ksu_boot_symbols)
+static struct ksu_symbol_request ksu_boot_requests[KSU_BOOT_SYMBOL_COUNT];
+static bool ksu_boot_requests_ready;
+
+/* Per-request state of a batched walk, indexed like the request array */
+struct ksu_batch_slot {
+	u32 hash;
+	u32 len;
+	int next; // next slot in the same bucket, -1 ends the chain
+	unsigned long first; // first exact or variant match, in walk order
+	unsigned long variant;
+#if !USE_KCFI
+	unsigned long cfi_jt;
+#endif // #if !USE_KCFI
+};
+
+#define KSU_BATCH_HASH_BITS 6
+
+struct ksu_batch_ctx {
+	struct ksu_symbol_request *reqs;
+	struct ksu_batch_slot *slots;
+	int buckets[1 << KSU_BATCH_HASH_BITS];
+};
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+static int resolve_batch_cb(void *data, const char *name, unsigned long addr)
+#else
+static int resolve_batch_cb(void *data, const char *name, struct module *mod,
+			    unsigned long addr)
+#endif // #if LINUX_VERSION_CODE >= KERNEL_VERSIO...
+{
+	struct ksu_batch_ctx *ctx = data;
+	size_t base_len;
+	u32 hash;
+	int i;
+
+	if (!name || !addr)
+		return 0;
+
+	// "foo", "foo.cfi_jt", "foo.llvm.123" and "foo$x" all belong to "foo"
+	base_len = strcspn(name, ".$");
+	hash = full_name_hash(NULL, name, base_len);
+	for (i = ctx->buckets[hash_32(hash, KSU_BATCH_HASH_BITS)]; i >= 0;
+	     i = ctx->slots[i].next) {
+		struct ksu_batch_slot *slot = &ctx->slots[i];
+
+		if (slot->hash != hash || slot->len != base_len ||
+		    strncmp(name, ctx->reqs[i].name, base_len))
+			continue;
+		if (!slot->first)
+			slot->first = addr;
+		if (!name[base_len]) {
+			ctx->reqs[i].exact = addr;
+			continue;
+		}
+#if !USE_KCFI
+		if (ksu_symbol_has_suffix(name, strlen(name), cfi_suffix,
+					  cfi_suffix_len))
+			slot->cfi_jt = addr;
+#endif // #if !USE_KCFI
+		if (!slot->variant)
+			slot->variant = addr;
+	}
+	return 0;
+}
+
+void __nocfi ksu_resolve_symbols(struct ksu_symbol_request *reqs, size_t count)
+{
+	struct ksu_batch_ctx ctx = {
+	    .reqs = reqs,
+	};
+	size_t i;
+
+	if (!count)
+		return;
+
+	for (i = 0; i < count; i++) {
+		reqs[i].exact = 0;
+		reqs[i].addr = NULL;
+	}
+
+	if (kallsyms_on_each_symbol_fn)
+		ctx.slots = kcalloc(count, sizeof(*ctx.slots), GFP_KERNEL);
+	if (ctx.slots) {
+		memset(ctx.buckets, -1, sizeof(ctx.buckets));
+		for (i = 0; i < count; i++) {
+			struct ksu_batch_slot *slot = &ctx.slots[i];
+			int *head;
+
+			slot->len = strlen(reqs[i].name);
+			slot->hash =
+			    full_name_hash(NULL, reqs[i].name, slot->len);
+			head = &ctx.buckets[hash_32(slot->hash,
+						    KSU_BATCH_HASH_BITS)];
+			slot->next = *head;
+			*head = i;
+		}
+		kallsyms_on_each_symbol_fn(resolve_batch_cb, &ctx);
+	}
+
+	for (i = 0; i < count; i++) {
+		struct ksu_batch_slot *slot = ctx.slots ? &ctx.slots[i] : NULL;
+
+		/* Same preference order as ksu_resolve_symbol_for_functable_hook */
+		if (slot) {
+#if !USE_KCFI
+			reqs[i].addr = (void *)(slot->cfi_jt ?: slot->first);
+#else
+			reqs[i].addr =
+			    (void *)(reqs[i].exact ?: slot->variant);
+#endif // #if !USE_KCFI
+		}
+		// symbols the walk cannot see, e.g. when it is unavailable
+		if (!reqs[i].addr) {
+			reqs[i].addr =
+			    ksu_resolve_symbol_for_functable_hook(reqs[i].name);
+			if (!reqs[i].exact)
+				reqs[i].exact =
+				    find_kernel_symbol_exact(reqs[i].name);
+		}
+	}
+	kfree(ctx.slots);
+}
+
+static struct ksu_symbol_request *boot_request(const char *symbol_name)
+{
+	size_t i;
+
+	if (!READ_ONCE(ksu_boot_requests_ready) || !symbol_name)
+		return NULL;
+	for (i = 0; i < KSU_BOOT_SYMBOL_COUNT; i++) {
+		if (!strcmp(ksu_boot_requests[i].name, symbol_name))
+			return &ksu_boot_requests[i];
+	}
+	return NULL;
+}
+
 void *ksu_lookup_symbol(const char *symbol_name)
 {
+	struct ksu_symbol_request *req = boot_request(symbol_name);
+
+	if (req && req->addr)
+		return req->addr;
 	return ksu_resolve_symbol_for_functable_hook(symbol_name);
 }
 
+unsigned long ksu_lookup_symbol_exact(const char *symbol_name)
+{
+	struct ksu_symbol_request *req = boot_request(symbol_name);
+
+	if (req && req->exact)
+		return req->exact;
+	return find_kernel_symbol_exact(symbol_name);
+}
+
 void __init ksu_init_symbol_resolver(void)
 {
 	kallsyms_on_each_symbol_fn =
@@ -184,4 +363,13 @@ void __init ksu_init_symbol_resolver(void)
 		"kallsyms_on_each_match_symbol");
 	if (!kallsyms_on_each_match_symbol_fn)
 		pr_warn("kallsyms_on_each_match_symbol not found\n");
+
+	{
+		size_t i;
+
+		for (i = 0; i < KSU_BOOT_SYMBOL_COUNT; i++)
+			ksu_boot_requests[i].name = ksu_boot_symbols[i];
+		ksu_resolve_symbols(ksu_boot_requests, KSU_BOOT_SYMBOL_COUNT);
+		WRITE_ONCE(ksu_boot_requests_ready, true);
+	}
 }
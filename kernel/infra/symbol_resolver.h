@@ -1,9 +1,22 @@
 #ifndef __KSU_SYMBOL_RESOLVER_H
 #define __KSU_SYMBOL_RESOLVER_H
 
+#include <linux/types.h>
+
 void *ksu_lookup_symbol(const char *symbol_name);
 void *ksu_resolve_symbol_for_functable_hook(const char *symbol_name);
 unsigned long find_kernel_symbol_exact(const char *symbol_name);
+// find_kernel_symbol_exact(), answered from the init batch when possible
+unsigned long ksu_lookup_symbol_exact(const char *symbol_name);
 void ksu_init_symbol_resolver(void);
 
+struct ksu_symbol_request {
+	const char *name;
+	void *addr;	     // as ksu_lookup_symbol() would resolve it
+	unsigned long exact; // exact name only, as find_kernel_symbol_exact()
+};
+
+// Resolve every request with a single kallsyms walk
+void ksu_resolve_symbols(struct ksu_symbol_request *reqs, size_t count);
+
 #endif // #ifndef __KSU_SYMBOL_RESOLVER_H
@@ -10,6 +10,7 @@
 #include "manager/apk_sign.h"
 #include "manager/dynamic_manager.h"
 #include "manager/manager_identity.h"
+#include "policy/allowlist.h"
 #include "uapi/supercall.h"
 
 #define KSU_DYNAMIC_MANAGER_HASH_BITS 6
@@ -137,6 +138,7 @@ static void rebuild_trusted_cache_locked(void)
 		WRITE_ONCE(trusted_dynamic_appids[i], appids[i]);
 
 	smp_store_release(&trusted_dynamic_count, count);
+	ksu_allowlist_bump_generation();
 }
 
 void ksu_dynamic_manager_init(void)
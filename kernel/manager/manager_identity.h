@@ -4,6 +4,8 @@
 #include <linux/cred.h>
 #include <linux/types.h>
 
+#include "policy/allowlist.h"
+
 #ifndef PER_USER_RANGE
 #define PER_USER_RANGE 100000
 #endif // #ifndef PER_USER_RANGE
@@ -191,6 +193,7 @@ static inline bool ksu_is_current_dynamic_manager(void)
 static inline void ksu_set_manager_uid(uid_t uid)
 {
 	ksu_manager_uid = uid;
+	ksu_allowlist_bump_generation();
 }
 
 static inline void ksu_set_manager_appid(uid_t appid)
@@ -199,6 +202,7 @@ static inline void ksu_set_manager_appid(uid_t appid)
 	ksu_manager_uid =
 	    current_uid().val / PER_USER_RANGE * PER_USER_RANGE + appid;
 	ksu_manager_appids[0] = appid;
+	ksu_allowlist_bump_generation();
 }
 
 void ksu_set_manager_appid_for_index(uid_t appid, int signature_index);
@@ -209,6 +213,7 @@ static inline void ksu_invalidate_manager_uid(void)
 #ifdef CONFIG_KSU_SUPERKEY
 	superkey_invalidate();
 #endif // #ifdef CONFIG_KSU_SUPERKEY
+	ksu_allowlist_bump_generation();
 }
 
 static inline void ksu_invalidate_manager_appid(void)
@@ -222,6 +227,7 @@ static inline void ksu_invalidate_manager_appid(void)
 #ifdef CONFIG_KSU_SUPERKEY
 	superkey_invalidate();
 #endif // #ifdef CONFIG_KSU_SUPERKEY
+	ksu_allowlist_bump_generation();
 }
 
 #endif // #ifdef CONFIG_KSU_DISABLE_MANAGER
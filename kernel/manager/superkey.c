@@ -229,7 +229,7 @@ void superkey_on_auth_fail(void)
 
 void superkey_on_auth_success(uid_t uid)
 {
-	ksu_set_manager_uid(uid);
 	superkey_set_manager_uid(uid);
+	ksu_set_manager_uid(uid);
 	atomic_set(&superkey_fail_count, 0);
 }
@@ -1,6 +1,9 @@
 #include <linux/err.h>
 #include <linux/fs.h>
+#include <linux/hashtable.h>
 #include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/types.h>
@@ -12,6 +15,8 @@
 #include "manager/dynamic_manager.h"
 #include "manager/manager_identity.h"
 #include "manager/throne_tracker.h"
+#include "runtime/ksud_boot.h"
+#include "selftest/selftest.h"
 
 uid_t ksu_manager_uid = KSU_INVALID_UID;
 uid_t ksu_manager_appid = KSU_INVALID_UID;
@@ -21,7 +26,10 @@ static uid_t locked_manager_appids[KSU_MAX_MANAGER_KEYS] = {KSU_INVALID_UID};
 
 static void update_primary_manager(void)
 {
+	uid_t old_appid = ksu_manager_appid;
+	uid_t old_uid = ksu_manager_uid;
 	int i;
+
 	ksu_manager_appid = KSU_INVALID_UID;
 	ksu_manager_uid = KSU_INVALID_UID;
 	for (i = 0; i < KSU_MAX_MANAGER_KEYS; i++) {
@@ -32,6 +40,9 @@ static void update_primary_manager(void)
 			break;
 		}
 	}
+	// Every tracker run lands here; only a real change may force a prune.
+	if (ksu_manager_appid != old_appid || ksu_manager_uid != old_uid)
+		ksu_allowlist_bump_generation();
 }
 
 void ksu_set_manager_appid_for_index(uid_t appid, int signature_index)
@@ -88,6 +99,136 @@ struct uid_data {
 	char package[KSU_MAX_PACKAGE_NAME];
 };
 
+/*
+ * packages.list snapshot kept between track_throne() runs. Every run diffs the
+ * file against it, so allowlist pruning only happens when a package really
+ * went away (or changed appid), and every lookup is a hash probe.
+ */
+#define PKG_MAP_BITS 10
+
+struct pkg_entry {
+	struct hlist_node by_name;
+	struct hlist_node by_appid;
+	unsigned int name_hash;
+	u32 appid;
+	u32 seen_gen;
+	char package[];
+};
+
+static DEFINE_HASHTABLE(pkg_by_name, PKG_MAP_BITS);
+static DEFINE_HASHTABLE(pkg_by_appid, PKG_MAP_BITS);
+static DEFINE_MUTEX(throne_mutex);
+static u32 pkg_map_gen;
+static unsigned int pkg_map_count;
+// Set whenever the map lost or remapped entries but the allowlist has not been
+// pruned against it yet (pruning is a no-op before boot completes).
+static bool prune_pending = true;
+// Allowlist generation as of the last prune; a profile added since then may
+// name a package packages.list never had.
+static u64 pruned_allowlist_gen;
+#ifdef CONFIG_KSU_SELFTEST
+static unsigned int throne_prune_count;
+#endif // #ifdef CONFIG_KSU_SELFTEST
+
+struct pkg_diff {
+	int added;
+	int removed;
+	int changed;
+	bool incomplete;
+};
+
+// Names are stored truncated, so hash and compare the same prefix
+static struct pkg_entry *pkg_map_find(const char *package)
+{
+	struct pkg_entry *e;
+	size_t len = strnlen(package, KSU_MAX_PACKAGE_NAME - 1);
+	unsigned int hash = full_name_hash(NULL, package, len);
+
+	hash_for_each_possible (pkg_by_name, e, by_name, hash) {
+		if (e->name_hash == hash && !strncmp(e->package, package, len) &&
+		    e->package[len] == '\0')
+			return e;
+	}
+	return NULL;
+}
+
+static bool pkg_map_has_appid(u32 appid)
+{
+	struct pkg_entry *e;
+
+	hash_for_each_possible (pkg_by_appid, e, by_appid, appid) {
+		if (e->appid == appid)
+			return true;
+	}
+	return false;
+}
+
+static void pkg_map_update(const char *package, u32 appid,
+			   struct pkg_diff *diff)
+{
+	struct pkg_entry *e = pkg_map_find(package);
+	size_t len;
+
+	if (e) {
+		if (e->appid != appid) {
+			hash_del(&e->by_appid);
+			e->appid = appid;
+			hash_add(pkg_by_appid, &e->by_appid, appid);
+			diff->changed++;
+		}
+		e->seen_gen = pkg_map_gen;
+		return;
+	}
+
+	len = strnlen(package, KSU_MAX_PACKAGE_NAME - 1);
+	e = kmalloc(sizeof(*e) + len + 1, GFP_KERNEL);
+	if (!e) {
+		pr_err("track_throne: OOM appid=%u\n", appid);
+		diff->incomplete = true;
+		return;
+	}
+	memcpy(e->package, package, len);
+	e->package[len] = '\0';
+	e->name_hash = full_name_hash(NULL, e->package, len);
+	e->appid = appid;
+	e->seen_gen = pkg_map_gen;
+	hash_add(pkg_by_name, &e->by_name, e->name_hash);
+	hash_add(pkg_by_appid, &e->by_appid, appid);
+	pkg_map_count++;
+	diff->added++;
+}
+
+static void pkg_map_sweep(struct pkg_diff *diff)
+{
+	struct pkg_entry *e;
+	struct hlist_node *tmp;
+	int bkt;
+
+	hash_for_each_safe (pkg_by_name, bkt, tmp, e, by_name) {
+		if (e->seen_gen == pkg_map_gen)
+			continue;
+		hash_del(&e->by_name);
+		hash_del(&e->by_appid);
+		kfree(e);
+		pkg_map_count--;
+		diff->removed++;
+	}
+}
+
+static void pkg_map_clear(void)
+{
+	struct pkg_entry *e;
+	struct hlist_node *tmp;
+	int bkt;
+
+	hash_for_each_safe (pkg_by_name, bkt, tmp, e, by_name) {
+		hash_del(&e->by_name);
+		hash_del(&e->by_appid);
+		kfree(e);
+	}
+	pkg_map_count = 0;
+}
+
 // Try read /data/misc/user_uid/uid_list
 static int uid_from_um_list(struct list_head *uid_list)
 {
@@ -214,10 +355,10 @@ static int get_pkg_from_apk_path(char *pkg, const char *path)
 	return 0;
 }
 
-static void crown_manager(const char *apk, struct list_head *uid_data,
-			  int signature_index)
+static void crown_manager(const char *apk, int signature_index)
 {
 	char pkg[KSU_MAX_PACKAGE_NAME];
+	struct pkg_entry *e;
 	if (get_pkg_from_apk_path(pkg, apk) < 0) {
 		pr_err("Failed to get package name from apk path: %s\n", apk);
 		return;
@@ -234,50 +375,38 @@ static void crown_manager(const char *apk, struct list_head *uid_data,
 		return;
 	}
 #endif // #ifdef KSU_MANAGER_PACKAGE
-	struct list_head *list = (struct list_head *)uid_data;
-	struct uid_data *np;
-
-	list_for_each_entry (np, list, list) {
-		if (strncmp(np->package, pkg, KSU_MAX_PACKAGE_NAME) == 0) {
-			pr_info("Crowning manager: %s (appid=%d) "
-				"signature_index=%d\n",
-				pkg, np->appid, signature_index);
-
-			if (signature_index >= 0 &&
-			    signature_index < KSU_MAX_MANAGER_KEYS) {
-				ksu_set_manager_appid_for_index(
-				    np->appid, signature_index);
-			} else {
-				ksu_set_manager_appid(np->appid);
-			}
-			break;
-		}
-	}
+	e = pkg_map_find(pkg);
+	if (!e)
+		return;
+
+	pr_info("Crowning manager: %s (appid=%d) signature_index=%d\n", pkg,
+		e->appid, signature_index);
+
+	if (signature_index >= 0 && signature_index < KSU_MAX_MANAGER_KEYS)
+		ksu_set_manager_appid_for_index(e->appid, signature_index);
+	else
+		ksu_set_manager_appid(e->appid);
 }
 
-static void note_scanned_manager(const char *apk, struct list_head *uid_data,
+static void note_scanned_manager(const char *apk,
 				 const struct apk_sign_match *match)
 {
 	char pkg[KSU_MAX_PACKAGE_NAME];
-	struct list_head *list = (struct list_head *)uid_data;
-	struct uid_data *np;
+	struct pkg_entry *e;
 
 	if (get_pkg_from_apk_path(pkg, apk) < 0) {
 		pr_err("Failed to get package name from apk path: %s\n", apk);
 		return;
 	}
 
-	list_for_each_entry (np, list, list) {
-		if (strncmp(np->package, pkg, KSU_MAX_PACKAGE_NAME) == 0) {
-			pr_info("Noting dynamic manager candidate: %s "
-				"(appid=%d) "
-				"signature=%s\n",
-				pkg, np->appid,
-				match && match->name ? match->name : "unknown");
-			ksu_dynamic_manager_note_scanned(np->appid, match);
-			break;
-		}
-	}
+	e = pkg_map_find(pkg);
+	if (!e)
+		return;
+
+	pr_info("Noting dynamic manager candidate: %s (appid=%d) "
+		"signature=%s\n",
+		pkg, e->appid, match && match->name ? match->name : "unknown");
+	ksu_dynamic_manager_note_scanned(e->appid, match);
 }
 
 #define DATA_PATH_LEN 384 // 384 is enough for /data/app/<package>/base.apk
@@ -301,7 +430,6 @@ struct my_dir_context {
 	struct dir_context ctx;
 	struct list_head *data_path_list;
 	char *parent_dir;
-	void *private_data;
 	int depth;
 	int *stop;
 };
@@ -393,15 +521,13 @@ FILLDIR_RETURN_TYPE my_actor(struct dir_context *ctx, const char *name,
 						"path: %s\n",
 						dirpath);
 					crown_manager(dirpath,
-						      my_ctx->private_data,
 						      signature_index);
 					/* Do not stop: continue scanning so
 					 * preset branch managers can be marked
 					 * even after YukiSU is found. */
 				} else {
-					note_scanned_manager(
-					    dirpath, my_ctx->private_data,
-					    &sign_match);
+					note_scanned_manager(dirpath,
+							     &sign_match);
 				}
 			}
 
@@ -427,7 +553,7 @@ FILLDIR_RETURN_TYPE my_actor(struct dir_context *ctx, const char *name,
 	return FILLDIR_ACTOR_CONTINUE;
 }
 
-void search_manager(const char *path, int depth, struct list_head *uid_data)
+void search_manager(const char *path, int depth)
 {
 	int i, stop = 0;
 	unsigned long data_app_magic = 0;
@@ -455,7 +581,6 @@ void search_manager(const char *path, int depth, struct list_head *uid_data)
 						     .data_path_list =
 							 &data_path_list,
 						     .parent_dir = pos->dirpath,
-						     .private_data = uid_data,
 						     .depth = pos->depth,
 						     .stop = &stop};
 			struct file *file;
@@ -519,25 +644,16 @@ void search_manager(const char *path, int depth, struct list_head *uid_data)
 
 static bool is_uid_exist(uid_t uid, char *package, void *data)
 {
-	struct list_head *list = (struct list_head *)data;
-	struct uid_data *np;
-	u32 appid = uid % 100000;
-	bool exist = false;
-
-	list_for_each_entry (np, list, list) {
-		if (np->appid == appid &&
-		    strncmp(np->package, package, KSU_MAX_PACKAGE_NAME) == 0) {
-			exist = true;
-			break;
-		}
-	}
-	return exist;
+	struct pkg_entry *e = pkg_map_find(package);
+
+	(void)data;
+	return e && e->appid == uid % 100000;
 }
 
-void track_throne(bool prune_only)
+// Diff packages.list against the snapshot; returns false if it was unreadable
+// and the snapshot was left untouched.
+static bool refresh_pkg_map(struct pkg_diff *diff)
 {
-	struct list_head uid_list;
-	struct uid_data *np, *n;
 	struct file *fp;
 	loff_t pos = 0;
 	loff_t size;
@@ -545,41 +661,37 @@ void track_throne(bool prune_only)
 	char *buf = NULL;
 	char *line = NULL;
 	char *next = NULL;
-	static bool manager_exist = false;
-	bool need_search = false;
-
-	// init uid list head
-	INIT_LIST_HEAD(&uid_list);
 
 	fp = filp_open(SYSTEM_PACKAGES_LIST_PATH, O_RDONLY, 0);
 	if (IS_ERR(fp)) {
 		pr_err("%s: open " SYSTEM_PACKAGES_LIST_PATH " failed: %ld\n",
 		       __func__, PTR_ERR(fp));
-		return;
+		return false;
 	}
 
 	size = i_size_read(file_inode(fp));
 	if (size <= 0) {
 		filp_close(fp, 0);
-		goto out;
+		return false;
 	}
 
-	buf = kzalloc(size + 1, GFP_KERNEL);
+	buf = kvmalloc(size + 1, GFP_KERNEL);
 	if (!buf) {
 		filp_close(fp, 0);
-		goto out;
+		return false;
 	}
 
 	nr = kernel_read(fp, buf, size, &pos);
 	filp_close(fp, 0);
 	if (nr <= 0) {
 		pr_err("track_throne: read packages.list failed: %zd\n", nr);
-		goto out;
+		kvfree(buf);
+		return false;
 	}
 	buf[nr] = '\0';
 
+	pkg_map_gen++;
 	for (line = buf; line && *line; line = next) {
-		struct uid_data *data = NULL;
 		const char *delim = " \t";
 		char *package = NULL;
 		char *tmp = NULL;
@@ -607,17 +719,30 @@ void track_throne(bool prune_only)
 			continue;
 		}
 
-		data = kzalloc(sizeof(*data), GFP_KERNEL);
-		if (!data) {
-			pr_err("track_throne: OOM appid=%u\n", res);
-			continue;
-		}
-		data->appid = res;
-		strscpy(data->package, package, KSU_MAX_PACKAGE_NAME);
-		list_add_tail(&data->list, &uid_list);
+		pkg_map_update(package, res, diff);
 	}
-	kfree(buf);
-	buf = NULL;
+	kvfree(buf);
+
+	pkg_map_sweep(diff);
+	return true;
+}
+
+void track_throne(bool prune_only)
+{
+	struct pkg_diff diff = {0};
+	static bool manager_exist = false;
+	bool need_search = false;
+
+	mutex_lock(&throne_mutex);
+
+	if (!refresh_pkg_map(&diff))
+		goto out;
+
+	pr_info("track_throne: packages.list +%d -%d ~%d, %u tracked\n",
+		diff.added, diff.removed, diff.changed, pkg_map_count);
+	if (diff.removed || diff.changed ||
+	    ksu_allowlist_generation() != pruned_allowlist_gen)
+		prune_pending = true;
 
 	if (prune_only)
 		goto prune;
@@ -628,23 +753,14 @@ void track_throne(bool prune_only)
 		int i;
 		for (i = 0; i < KSU_MAX_MANAGER_KEYS; i++) {
 			uid_t aid = ksu_manager_appids[i];
-			bool slot_still_exists = false;
 
-			if (aid == KSU_INVALID_UID)
+			if (aid == KSU_INVALID_UID || pkg_map_has_appid(aid))
 				continue;
-			list_for_each_entry (np, &uid_list, list) {
-				if (np->appid == aid) {
-					slot_still_exists = true;
-					break;
-				}
-			}
-			if (!slot_still_exists) {
-				pr_info("Manager slot %d (appid=%d) removed, "
-					"clearing\n",
-					i, aid);
-				ksu_manager_appids[i] = KSU_INVALID_UID;
-				locked_manager_appids[i] = KSU_INVALID_UID;
-			}
+			pr_info("Manager slot %d (appid=%d) removed, "
+				"clearing\n",
+				i, aid);
+			ksu_manager_appids[i] = KSU_INVALID_UID;
+			locked_manager_appids[i] = KSU_INVALID_UID;
 		}
 		update_primary_manager();
 		manager_exist = (ksu_manager_appid != KSU_INVALID_UID);
@@ -661,20 +777,27 @@ void track_throne(bool prune_only)
 
 	if (need_search) {
 		pr_info("Searching for manager(s)...\n");
-		search_manager("/data/app", 2, &uid_list);
+		search_manager("/data/app", 2);
 		pr_info("Manager search finished\n");
 	}
 
 prune:
-	// then prune the allowlist
-	ksu_prune_allowlist(is_uid_exist, &uid_list);
-out:
-	kfree(buf);
-	// free uid_list
-	list_for_each_entry_safe (np, n, &uid_list, list) {
-		list_del(&np->list);
-		kfree(np);
+	/*
+	 * A truncated snapshot (OOM) would make live packages look uninstalled,
+	 * so only prune against a complete one. Boot completion always prunes.
+	 */
+	if (diff.incomplete) {
+		prune_pending = true;
+	} else if ((prune_only || prune_pending) && ksu_boot_completed) {
+		ksu_prune_allowlist(is_uid_exist, NULL);
+		pruned_allowlist_gen = ksu_allowlist_generation();
+		prune_pending = false;
+#ifdef CONFIG_KSU_SELFTEST
+		throne_prune_count++;
+#endif // #ifdef CONFIG_KSU_SELFTEST
 	}
+out:
+	mutex_unlock(&throne_mutex);
 }
 
 /*
@@ -689,6 +812,18 @@ static void do_throne_search(struct work_struct *work)
 	track_throne(false);
 }
 
+#ifdef CONFIG_KSU_SELFTEST
+unsigned int ksu_selftest_throne_prune_count(void)
+{
+	unsigned int count;
+
+	mutex_lock(&throne_mutex);
+	count = throne_prune_count;
+	mutex_unlock(&throne_mutex);
+	return count;
+}
+#endif // #ifdef CONFIG_KSU_SELFTEST
+
 void ksu_request_manager_rescan(void)
 {
 	manager_scan_forced = true;
@@ -705,5 +840,8 @@ void ksu_throne_tracker_init()
 void ksu_throne_tracker_exit(void)
 {
 	cancel_delayed_work_sync(&throne_search_work);
+	mutex_lock(&throne_mutex);
+	pkg_map_clear();
+	mutex_unlock(&throne_mutex);
 	pr_info("throne_tracker: exit\n");
 }
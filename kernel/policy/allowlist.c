@@ -1,3 +1,4 @@
+#include <linux/atomic.h>
 #include <linux/capability.h>
 #include <linux/compiler.h>
 #include <linux/err.h>
@@ -71,6 +72,21 @@ static u16 allow_list_count = 0;
 
 #define KERNEL_SU_ALLOWLIST "/data/adb/ksu/.allowlist"
 
+// only compared against values sampled within this module lifetime
+static atomic64_t allow_list_generation = ATOMIC64_INIT(0);
+
+u64 ksu_allowlist_generation(void)
+{
+	return (u64)atomic64_read(&allow_list_generation);
+}
+
+void ksu_allowlist_bump_generation(void)
+{
+	// order the state change before the bump for ksu_spawn_decision()
+	smp_mb__before_atomic();
+	atomic64_inc(&allow_list_generation);
+}
+
 void ksu_show_allow_list(void)
 {
 	int bucket;
@@ -307,13 +323,14 @@ out:
 		default_non_root_profile.umount_modules =
 		    profile->nrp_config.profile.umount_modules;
 	}
+	ksu_allowlist_bump_generation();
 
 out_unlock:
 	mutex_unlock(&allowlist_mutex);
 
 	if (result && persist) {
 		persistent_allow_list();
-		ksu_mark_running_process();
+		ksu_mark_uid_process(profile->curr_uid);
 	}
 
 	return result;
@@ -746,6 +763,8 @@ void ksu_prune_allowlist(bool (*is_uid_valid)(uid_t, char *, void *),
 			--allow_list_count;
 		}
 	}
+	if (modified)
+		ksu_allowlist_bump_generation();
 	mutex_unlock(&allowlist_mutex);
 
 	if (modified) {
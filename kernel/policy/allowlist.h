@@ -38,6 +38,15 @@ struct app_profile *ksu_get_app_profile(uid_t uid);
 void ksu_put_app_profile(struct app_profile *profile);
 bool ksu_set_app_profile(struct app_profile *, bool persist);
 
+/*
+ * Bumped whenever the answer of ksu_is_allow_uid() may change for some uid
+ * (app profiles, pruning, manager identity). The spawn table rebuilds when it
+ * moves, and the throne tracker prunes again when a profile came in since its
+ * last prune.
+ */
+u64 ksu_allowlist_generation(void);
+void ksu_allowlist_bump_generation(void);
+
 bool ksu_uid_should_umount(uid_t uid);
 struct root_profile *ksu_get_root_profile(uid_t uid);
 void ksu_put_root_profile(struct root_profile *profile);
@@ -1,7 +1,9 @@
 #include "policy/feature.h"
 #include "klog.h" // IWYU pragma: keep
+#include "uapi/supercall.h"
 
 #include <linux/mutex.h>
+#include <linux/slab.h>
 
 static const struct ksu_feature_handler *feature_handlers[KSU_FEATURE_MAX];
 
@@ -150,6 +152,106 @@ out:
 	return ret;
 }
 
+void ksu_get_features(struct ksu_feature_batch_entry *entries, u32 count)
+{
+	const struct ksu_feature_handler *handler;
+	u32 i;
+
+	mutex_lock(&feature_mutex);
+
+	for (i = 0; i < count; i++) {
+		struct ksu_feature_batch_entry *entry = &entries[i];
+
+		entry->value = 0;
+		handler = entry->feature_id < KSU_FEATURE_MAX ?
+			      feature_handlers[entry->feature_id] :
+			      NULL;
+		if (!handler) {
+			entry->status = -ENOENT;
+			continue;
+		}
+		if (!handler->get_handler) {
+			entry->status = -EOPNOTSUPP;
+			continue;
+		}
+		entry->status = handler->get_handler(&entry->value);
+	}
+
+	mutex_unlock(&feature_mutex);
+}
+
+struct ksu_feature_undo {
+	u64 value;
+	bool saved;
+};
+
+int ksu_set_features(struct ksu_feature_batch_entry *entries, u32 count)
+{
+	const struct ksu_feature_handler *handler;
+	struct ksu_feature_undo *undo;
+	int ret = 0;
+	u32 i;
+
+	undo = kcalloc(count, sizeof(*undo), GFP_KERNEL);
+	if (count && !undo)
+		return -ENOMEM;
+
+	mutex_lock(&feature_mutex);
+
+	// Refuse the whole batch before touching anything
+	for (i = 0; i < count; i++) {
+		struct ksu_feature_batch_entry *entry = &entries[i];
+
+		handler = entry->feature_id < KSU_FEATURE_MAX ?
+			      feature_handlers[entry->feature_id] :
+			      NULL;
+		if (!handler)
+			entry->status = -ENOENT;
+		else if (!handler->set_handler)
+			entry->status = -EOPNOTSUPP;
+		else
+			entry->status = -ECANCELED;
+		if (entry->status != -ECANCELED && !ret)
+			ret = entry->status;
+	}
+	if (ret) {
+		pr_err("feature: batch set refused: %d\n", ret);
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct ksu_feature_batch_entry *entry = &entries[i];
+
+		handler = feature_handlers[entry->feature_id];
+		if (handler->get_handler &&
+		    !handler->get_handler(&undo[i].value))
+			undo[i].saved = true;
+
+		ret = handler->set_handler(entry->value);
+		entry->status = ret;
+		if (ret) {
+			pr_err("feature: set_handler for %u failed: %d\n",
+			       entry->feature_id, ret);
+			break;
+		}
+	}
+
+	// Roll back what was applied; features without a getter stay applied
+	if (ret) {
+		while (i-- > 0) {
+			handler = feature_handlers[entries[i].feature_id];
+			if (undo[i].saved &&
+			    !handler->set_handler(undo[i].value))
+				entries[i].status = -ECANCELED;
+		}
+	}
+
+out:
+	mutex_unlock(&feature_mutex);
+	kfree(undo);
+	return ret;
+}
+
 void ksu_feature_init(void)
 {
 	int i;
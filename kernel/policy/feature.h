@@ -22,6 +22,14 @@ int ksu_get_feature(u32 feature_id, u64 *value, bool *supported);
 
 int ksu_set_feature(u32 feature_id, u64 value);
 
+struct ksu_feature_batch_entry;
+
+// Fills value and status of each entry under a single lock hold
+void ksu_get_features(struct ksu_feature_batch_entry *entries, u32 count);
+
+// All-or-nothing where the features allow it; see KSU_IOCTL_FEATURE_BATCH
+int ksu_set_features(struct ksu_feature_batch_entry *entries, u32 count);
+
 void ksu_feature_init(void);
 
 void ksu_feature_exit(void);
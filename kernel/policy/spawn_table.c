@@ -0,0 +1,135 @@
+#include <linux/compiler.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include "klog.h" // IWYU pragma: keep
+#include "manager/manager_identity.h"
+#include "policy/allowlist.h"
+#include "policy/spawn_table.h"
+
+#define SPAWN_TABLE_SIZE (LAST_APPLICATION_UID - FIRST_APPLICATION_UID + 1)
+
+/*
+ * One byte of KSU_SPAWN_* flags per user 0 app uid. App profiles are keyed by
+ * full uid, so secondary users and isolated uids stay on the slow path.
+ */
+struct spawn_table {
+	u64 generation;
+	u8 decision[SPAWN_TABLE_SIZE];
+};
+
+static struct spawn_table __rcu *spawn_table;
+static DEFINE_MUTEX(spawn_table_mutex);
+static bool spawn_table_stopping;
+
+static void spawn_table_rebuild(struct work_struct *work);
+static DECLARE_WORK(spawn_table_work, spawn_table_rebuild);
+
+static u8 spawn_decide(uid_t uid)
+{
+	u8 decision = 0;
+
+	if (ksu_is_uid_manager(uid))
+		decision |= KSU_SPAWN_MANAGER;
+	if (__ksu_is_allow_uid_for_current(uid))
+		decision |= KSU_SPAWN_ALLOW;
+	if ((is_appuid(uid) || is_isolated_process(uid)) &&
+	    ksu_uid_should_umount(uid))
+		decision |= KSU_SPAWN_UMOUNT;
+	return decision;
+}
+
+static void spawn_table_rebuild(struct work_struct *work)
+{
+	struct spawn_table *table, *old;
+	u64 generation;
+	int i;
+
+	(void)work;
+	table = kvzalloc(sizeof(*table), GFP_KERNEL);
+	if (!table)
+		return;
+
+	/*
+	 * Sample the generation first: a bump racing with the walk leaves the
+	 * snapshot tagged stale, and the next lookup schedules another pass.
+	 */
+	generation = ksu_allowlist_generation();
+	smp_rmb();
+	for (i = 0; i < SPAWN_TABLE_SIZE; i++) {
+		table->decision[i] = spawn_decide(FIRST_APPLICATION_UID + i);
+		if ((i & 1023) == 1023)
+			cond_resched();
+	}
+	table->generation = generation;
+
+	mutex_lock(&spawn_table_mutex);
+	if (spawn_table_stopping) {
+		mutex_unlock(&spawn_table_mutex);
+		kvfree(table);
+		return;
+	}
+	old = rcu_dereference_protected(spawn_table,
+					lockdep_is_held(&spawn_table_mutex));
+	rcu_assign_pointer(spawn_table, table);
+	mutex_unlock(&spawn_table_mutex);
+
+	if (old) {
+		synchronize_rcu();
+		kvfree(old);
+	}
+	pr_info("spawn_table: rebuilt for generation %llu\n", generation);
+}
+
+u8 ksu_spawn_decision(uid_t uid)
+{
+	struct spawn_table *table;
+	u8 decision;
+
+	if (uid < FIRST_APPLICATION_UID || uid > LAST_APPLICATION_UID)
+		return spawn_decide(uid);
+
+	rcu_read_lock();
+	table = rcu_dereference(spawn_table);
+	if (likely(table && table->generation == ksu_allowlist_generation())) {
+		decision = table->decision[uid - FIRST_APPLICATION_UID];
+		rcu_read_unlock();
+		return decision;
+	}
+	rcu_read_unlock();
+
+	if (!READ_ONCE(spawn_table_stopping))
+		schedule_work(&spawn_table_work);
+	return spawn_decide(uid);
+}
+
+void ksu_spawn_table_init(void)
+{
+	WRITE_ONCE(spawn_table_stopping, false);
+	schedule_work(&spawn_table_work);
+}
+
+void ksu_spawn_table_exit(void)
+{
+	struct spawn_table *old;
+
+	mutex_lock(&spawn_table_mutex);
+	WRITE_ONCE(spawn_table_stopping, true);
+	mutex_unlock(&spawn_table_mutex);
+	cancel_work_sync(&spawn_table_work);
+
+	mutex_lock(&spawn_table_mutex);
+	old = rcu_dereference_protected(spawn_table,
+					lockdep_is_held(&spawn_table_mutex));
+	RCU_INIT_POINTER(spawn_table, NULL);
+	mutex_unlock(&spawn_table_mutex);
+
+	if (old) {
+		synchronize_rcu();
+		kvfree(old);
+	}
+}
@@ -0,0 +1,22 @@
+#ifndef __KSU_H_SPAWN_TABLE
+#define __KSU_H_SPAWN_TABLE
+
+#include <linux/bits.h>
+#include <linux/types.h>
+
+/* Per-uid decisions the setresuid hook acts on */
+#define KSU_SPAWN_ALLOW BIT(0)   // ksu_is_allow_uid_for_current()
+#define KSU_SPAWN_MANAGER BIT(1) // ksu_is_uid_manager()
+#define KSU_SPAWN_UMOUNT BIT(2)  // ksu_uid_should_umount()
+
+void ksu_spawn_table_init(void);
+void ksu_spawn_table_exit(void);
+
+/*
+ * Decision flags for new_uid. User 0 app uids come from a table snapshot
+ * rebuilt after every allowlist generation bump; anything else, or a stale
+ * snapshot, is answered by the allowlist/manager predicates directly.
+ */
+u8 ksu_spawn_decision(uid_t uid);
+
+#endif // #ifndef __KSU_H_SPAWN_TABLE
@@ -1,5 +1,7 @@
+#include <linux/compiler.h>
 #include <linux/err.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/namei.h>
 #include <linux/printk.h>
 #include <linux/string.h>
@@ -12,10 +14,28 @@
 #include "runtime/ksud_boot.h"
 #include "runtime/ksud.h"
 #include "selinux/selinux.h"
+#include "uapi/supercall.h"
 
 bool ksu_module_mounted __read_mostly = false;
 bool ksu_boot_completed __read_mostly = false;
 
+static u64 boot_stamps[KSU_BOOT_STAMP_MAX];
+
+void ksu_boot_stamp(unsigned int which)
+{
+	if (which >= KSU_BOOT_STAMP_MAX || READ_ONCE(boot_stamps[which]))
+		return;
+	WRITE_ONCE(boot_stamps[which], ktime_to_ns(ktime_get_boottime()));
+}
+
+void ksu_get_boot_stamps(struct ksu_get_boot_stamps_cmd *cmd)
+{
+	int i;
+
+	for (i = 0; i < KSU_BOOT_STAMP_MAX; i++)
+		cmd->ns[i] = READ_ONCE(boot_stamps[i]);
+}
+
 void on_post_fs_data(void)
 {
 	static bool done = false;
@@ -24,6 +44,7 @@ void on_post_fs_data(void)
 		return;
 	}
 	done = true;
+	ksu_boot_stamp(KSU_BOOT_STAMP_POST_FS_DATA);
 	pr_info("on_post_fs_data!\n");
 
 	ksu_load_allow_list();
@@ -34,6 +55,7 @@ void on_post_fs_data(void)
 	ksu_file_sid = ksu_get_ksu_file_sid();
 	pr_info("ksu_file sid: %u\n", ksu_file_sid);
 	ksu_selinux_hide_handle_post_fs_data();
+	ksu_boot_stamp(KSU_BOOT_STAMP_POST_FS_DATA_DONE);
 }
 
 extern void ext4_unregister_sysfs(struct super_block *sb);
@@ -68,6 +90,7 @@ void on_module_mounted(void)
 void on_boot_completed(void)
 {
 	ksu_boot_completed = true;
+	ksu_boot_stamp(KSU_BOOT_STAMP_BOOT_COMPLETED);
 	pr_info("on_boot_completed!\n");
 	track_throne(true);
 	ksu_selinux_hide_drop_backup_if_unused();
@@ -3,6 +3,8 @@
 
 #include <linux/types.h>
 
+struct ksu_get_boot_stamps_cmd;
+
 void on_post_fs_data(void);
 void on_module_mounted(void);
 void on_boot_completed(void);
@@ -11,6 +13,10 @@ bool ksu_is_safe_mode(void);
 
 int nuke_ext4_sysfs(const char *mnt);
 
+/* Record a KSU_BOOT_STAMP_* milestone; only the first call per slot counts */
+void ksu_boot_stamp(unsigned int which);
+void ksu_get_boot_stamps(struct ksu_get_boot_stamps_cmd *cmd);
+
 extern bool ksu_module_mounted;
 extern bool ksu_boot_completed;
 
@@ -32,6 +32,7 @@
 #include "runtime/ksud.h"
 #include "selinux/selinux.h"
 #include "manager/throne_tracker.h"
+#include "uapi/supercall.h"
 
 static const char KERNEL_SU_RC[] =
     "\n"
@@ -158,6 +159,7 @@ void ksu_handle_execveat_ksud(const char *filename, struct user_arg_ptr *argv,
 		    check_argv(*argv, 1, "second_stage", buf, sizeof(buf))) {
 			pr_info("/system/bin/init second_stage executed via "
 				"argv1 check\n");
+			ksu_boot_stamp(KSU_BOOT_STAMP_SECOND_STAGE);
 			ksu_initialize_selinux();
 			init_second_stage_executed = true;
 		}
@@ -175,6 +177,7 @@ void ksu_handle_execveat_ksud(const char *filename, struct user_arg_ptr *argv,
 				       sizeof(buf))) {
 				pr_info("/init second_stage executed via argv1 "
 					"check\n");
+				ksu_boot_stamp(KSU_BOOT_STAMP_SECOND_STAGE);
 				ksu_initialize_selinux();
 				init_second_stage_executed = true;
 			}
@@ -206,6 +209,8 @@ void ksu_handle_execveat_ksud(const char *filename, struct user_arg_ptr *argv,
 				     !strcmp(env_value, "true"))) {
 					pr_info("/init second_stage executed "
 						"via envp check\n");
+					ksu_boot_stamp(
+					    KSU_BOOT_STAMP_SECOND_STAGE);
 					ksu_initialize_selinux();
 					init_second_stage_executed = true;
 					break;
@@ -378,6 +383,12 @@ static void free_module_rc(void)
 	module_rc_len = 0;
 }
 
+static void stamp_rc_appended(void)
+{
+	if (ksu_rc_pos >= ksu_rc_len && module_rc_pos >= module_rc_len)
+		ksu_boot_stamp(KSU_BOOT_STAMP_INIT_RC_APPENDED);
+}
+
 static ssize_t read_proxy(struct file *file, char __user *buf, size_t count,
 			  loff_t *pos)
 {
@@ -436,6 +447,7 @@ append_module_rc:
 		}
 	}
 
+	stamp_rc_appended();
 	return ret;
 }
 
@@ -491,6 +503,8 @@ append_module_rc:
 			free_module_rc();
 		}
 	}
+
+	stamp_rc_appended();
 	return ret;
 }
 
@@ -539,6 +553,7 @@ static void ksu_handle_sys_read(unsigned int fd)
 		goto skip;
 	}
 	rc_hooked = true;
+	ksu_boot_stamp(KSU_BOOT_STAMP_INIT_RC_READ);
 
 	load_module_rc_once();
 
@@ -728,6 +743,8 @@ void ksu_ksud_init(void)
 {
 	int ret;
 
+	ksu_boot_stamp(KSU_BOOT_STAMP_MODULE_INIT);
+
 	/* Install syscall table hooks for init.rc injection */
 	ret = ksu_syscall_table_hook(__NR_read, ksu_sys_read, &orig_sys_read);
 	pr_info("ksud: sys_read table hook: %d\n", ret);
@@ -0,0 +1,47 @@
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+
+#include "klog.h" // IWYU pragma: keep
+#include "selftest/selftest.h"
+
+static bool ksu_selftest_enabled;
+module_param_named(selftest, ksu_selftest_enabled, bool, 0);
+
+struct ksu_selftest {
+	const char *name;
+	int (*run)(void);
+};
+
+static const struct ksu_selftest ksu_selftests[] = {
+    {"syscall_hook_stress", ksu_selftest_syscall_hook_stress},
+    {"sucompat_bench", ksu_selftest_sucompat_bench},
+#ifndef CONFIG_KSU_DISABLE_MANAGER
+    {"throne_prune", ksu_selftest_throne_prune},
+#endif // #ifndef CONFIG_KSU_DISABLE_MANAGER
+};
+
+void ksu_selftest_run(void)
+{
+	int failed = 0;
+	int i;
+
+	if (!ksu_selftest_enabled)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(ksu_selftests); i++) {
+		int ret;
+
+		pr_info("selftest: %s: running\n", ksu_selftests[i].name);
+		ret = ksu_selftests[i].run();
+		if (ret) {
+			pr_err("selftest: %s: FAILED (%d)\n",
+			       ksu_selftests[i].name, ret);
+			failed++;
+			continue;
+		}
+		pr_info("selftest: %s: passed\n", ksu_selftests[i].name);
+	}
+
+	pr_info("selftest: %d of %d failed\n", failed,
+		(int)ARRAY_SIZE(ksu_selftests));
+}
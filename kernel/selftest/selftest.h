@@ -0,0 +1,31 @@
+#ifndef __KSU_H_SELFTEST
+#define __KSU_H_SELFTEST
+
+#include <linux/compiler_types.h>
+#include <linux/types.h>
+
+#ifdef CONFIG_KSU_SELFTEST
+/*
+ * Run the in-module stress tests and benchmarks when kernelsu.ko was loaded
+ * with selftest=1. Results only go to the kernel log; a failure never fails
+ * the load.
+ */
+void ksu_selftest_run(void);
+
+int ksu_selftest_syscall_hook_stress(void);
+int ksu_selftest_sucompat_bench(void);
+int ksu_selftest_throne_prune(void);
+
+// sucompat internals for the benchmark
+const char *ksu_selftest_su_path(void);
+bool ksu_selftest_is_su_path(const char __user *filename_user);
+
+// allowlist prunes the throne tracker ran since load
+unsigned int ksu_selftest_throne_prune_count(void);
+#else
+static inline void ksu_selftest_run(void)
+{
+}
+#endif // #ifdef CONFIG_KSU_SELFTEST
+
+#endif // #ifndef __KSU_H_SELFTEST
@@ -0,0 +1,126 @@
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+#include "klog.h" // IWYU pragma: keep
+#include "selftest/selftest.h"
+
+/*
+ * Time is_su_path() against the strncpy_from_user() + memcmp() match it
+ * replaced, on a miss and on a hit, after checking that both agree on a set
+ * of paths laid out in a scratch user mapping of the loading process. The
+ * last case ends right before an unmapped page, so the second word load of
+ * is_su_path() faults and must be treated as no match.
+ */
+
+#define BENCH_ITERATIONS 100000
+
+struct bench_case {
+	const char *name;
+	const char *path;
+	size_t len; // bytes written, without a NUL when shorter than strlen + 1
+	unsigned long offset;
+	bool expected;
+};
+
+static bool bench_copy_is_su_path(const char __user *filename_user)
+{
+	const char *su = ksu_selftest_su_path();
+	size_t su_size = strlen(su) + 1;
+	const char __user *fn;
+	char path[32];
+	long ret;
+
+	fn = (const char __user *)untagged_addr((unsigned long)filename_user);
+	memset(path, 0, sizeof(path));
+	ret = strncpy_from_user(path, fn, su_size + 1);
+	if (ret < 0)
+		return false;
+	path[su_size] = '\0';
+	return !memcmp(path, su, su_size);
+}
+
+static u64 bench_ns_per_call(bool (*match)(const char __user *),
+			     const char __user *path)
+{
+	unsigned long hits = 0;
+	u64 start;
+	u64 elapsed;
+	int i;
+
+	start = ktime_get_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		hits += match(path);
+	elapsed = ktime_get_ns() - start;
+
+	// Keep the loop from being folded away
+	if (hits != 0 && hits != BENCH_ITERATIONS)
+		pr_warn("selftest: unstable match result\n");
+	return div_u64(elapsed, BENCH_ITERATIONS);
+}
+
+int ksu_selftest_sucompat_bench(void)
+{
+	struct bench_case cases[] = {
+	    {"hit", ksu_selftest_su_path(), 0, 0, true},
+	    {"miss", "/data/local/tmp/busybox", 0, 64, false},
+	    {"same head", "/system/bin/sh", 0, 128, false},
+	    {"longer", "/system/bin/sux", 0, 192, false},
+	    {"fault", "/system/", 8, PAGE_SIZE - 8, false},
+	};
+	unsigned long base;
+	int failed = 0;
+	int i;
+
+	if (!current->mm)
+		return -ENOENT;
+
+	base = vm_mmap(NULL, 0, 2 * PAGE_SIZE, PROT_READ | PROT_WRITE,
+		       MAP_ANONYMOUS | MAP_PRIVATE, 0);
+	if (IS_ERR_VALUE(base))
+		return (int)base;
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		size_t len = cases[i].len ?: strlen(cases[i].path) + 1;
+
+		if (copy_to_user((void __user *)(base + cases[i].offset),
+				 cases[i].path, len)) {
+			vm_munmap(base, 2 * PAGE_SIZE);
+			return -EFAULT;
+		}
+	}
+	// The fault case must not be able to read on past its 8 bytes
+	vm_munmap(base + PAGE_SIZE, PAGE_SIZE);
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		const char __user *path =
+		    (const char __user *)(base + cases[i].offset);
+		bool words = ksu_selftest_is_su_path(path);
+		bool copy = bench_copy_is_su_path(path);
+
+		if (words != cases[i].expected || copy != cases[i].expected) {
+			pr_err("selftest: %s: words %d, copy %d, want %d\n",
+			       cases[i].name, words, copy, cases[i].expected);
+			failed++;
+		}
+	}
+
+	for (i = 0; i < 2; i++) {
+		const char __user *path =
+		    (const char __user *)(base + cases[i].offset);
+
+		pr_info("selftest: %s: is_su_path %llu ns, copy %llu ns\n",
+			cases[i].name,
+			bench_ns_per_call(ksu_selftest_is_su_path, path),
+			bench_ns_per_call(bench_copy_is_su_path, path));
+	}
+
+	vm_munmap(base, PAGE_SIZE);
+	return failed ? -EINVAL : 0;
+}
@@ -0,0 +1,141 @@
+#include <linux/atomic.h>
+#include <linux/cpumask.h>
+#include <linux/delay.h>
+#include <linux/err.h>
+#include <linux/kthread.h>
+#include <linux/minmax.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+
+#include "arch.h"
+#include "hook/syscall_hook.h"
+#include "klog.h" // IWYU pragma: keep
+#include "selftest/selftest.h"
+
+/*
+ * Install and remove a dispatcher hook in a loop while worker threads keep
+ * entering the dispatcher the way a redirected syscall does. The hook counts
+ * itself in and out, and checks that it only ever runs while installed:
+ * once ksu_unregister_syscall_hook() returns, no call may still be inside
+ * the hook and no new one may reach it.
+ */
+
+#define STRESS_NR __NR_getppid
+#define STRESS_ROUNDS 200
+#define STRESS_MAX_WORKERS 4
+// Every this many calls the hook sleeps, to hold the read section open
+#define STRESS_SLEEP_EVERY 64
+
+static atomic_t stress_installed;
+static atomic_t stress_inflight;
+static atomic_t stress_violations;
+static atomic_long_t stress_hook_calls;
+static atomic_long_t stress_dispatches;
+
+static long __nocfi stress_hook(int orig_nr, const struct pt_regs *regs)
+{
+	long calls;
+	long ret;
+
+	atomic_inc(&stress_inflight);
+	if (!atomic_read(&stress_installed))
+		atomic_inc(&stress_violations);
+
+	calls = atomic_long_inc_return(&stress_hook_calls);
+	if (!(calls % STRESS_SLEEP_EVERY))
+		usleep_range(10, 20);
+
+	// Marked tasks share the hook while the test runs; stay transparent
+	ret = ksu_syscall_table[orig_nr](regs);
+	atomic_dec(&stress_inflight);
+	return ret;
+}
+
+static void __nocfi stress_dispatch(void)
+{
+	struct pt_regs regs;
+	int dispatcher_nr = READ_ONCE(ksu_dispatcher_nr);
+
+	if (dispatcher_nr < 0)
+		return;
+
+	memset(&regs, 0, sizeof(regs));
+	regs.syscallno = dispatcher_nr;
+	PT_REGS_ORIG_SYSCALL(&regs) = STRESS_NR;
+	ksu_syscall_table[dispatcher_nr](&regs);
+	atomic_long_inc(&stress_dispatches);
+}
+
+static int stress_worker(void *data)
+{
+	while (!kthread_should_stop()) {
+		stress_dispatch();
+		cond_resched();
+	}
+	return 0;
+}
+
+int ksu_selftest_syscall_hook_stress(void)
+{
+	struct task_struct *workers[STRESS_MAX_WORKERS];
+	int nr_workers = min_t(int, num_online_cpus(), STRESS_MAX_WORKERS);
+	int started = 0;
+	int ret = 0;
+	int round;
+	int i;
+
+	if (!ksu_syscall_table || READ_ONCE(ksu_dispatcher_nr) < 0)
+		return -ENOENT;
+	if (ksu_has_syscall_hook(STRESS_NR))
+		return -EBUSY;
+
+	atomic_set(&stress_installed, 0);
+	atomic_set(&stress_inflight, 0);
+	atomic_set(&stress_violations, 0);
+	atomic_long_set(&stress_hook_calls, 0);
+	atomic_long_set(&stress_dispatches, 0);
+
+	for (i = 0; i < nr_workers; i++) {
+		workers[i] =
+		    kthread_run(stress_worker, NULL, "ksu_hookstress/%d", i);
+		if (IS_ERR(workers[i])) {
+			ret = PTR_ERR(workers[i]);
+			goto stop;
+		}
+		started++;
+	}
+
+	for (round = 0; round < STRESS_ROUNDS; round++) {
+		atomic_set(&stress_installed, 1);
+		ret = ksu_register_syscall_hook(STRESS_NR, stress_hook);
+		if (ret) {
+			atomic_set(&stress_installed, 0);
+			goto stop;
+		}
+		usleep_range(50, 100);
+
+		ksu_unregister_syscall_hook(STRESS_NR);
+		if (atomic_read(&stress_inflight)) {
+			pr_err("selftest: hook still running after unregister\n");
+			atomic_inc(&stress_violations);
+		}
+		atomic_set(&stress_installed, 0);
+		usleep_range(20, 50);
+	}
+
+stop:
+	for (i = 0; i < started; i++)
+		kthread_stop(workers[i]);
+
+	pr_info("selftest: %d workers, %ld dispatches, %ld hook calls, %d "
+		"violations\n",
+		started, atomic_long_read(&stress_dispatches),
+		atomic_long_read(&stress_hook_calls),
+		atomic_read(&stress_violations));
+
+	if (!ret && atomic_read(&stress_violations))
+		ret = -EFAULT;
+	if (!ret && !atomic_long_read(&stress_hook_calls))
+		ret = -ENODATA;
+	return ret;
+}
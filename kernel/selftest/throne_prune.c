@@ -0,0 +1,47 @@
+#include <linux/errno.h>
+#include <linux/kernel.h>
+
+#include "klog.h" // IWYU pragma: keep
+#include "manager/throne_tracker.h"
+#include "policy/allowlist.h"
+#include "runtime/ksud_boot.h"
+#include "selftest/selftest.h"
+
+/*
+ * Run the tracker over packages.list a few times in a row. The first run
+ * settles any pending prune and manager change; after that nothing changed,
+ * so further runs must neither bump the allowlist generation nor prune.
+ * A package event landing in between would make this fail spuriously.
+ */
+
+#define PRUNE_RUNS 2
+
+int ksu_selftest_throne_prune(void)
+{
+	unsigned int prunes;
+	u64 gen;
+	int i;
+
+	// Pruning waits for boot completion, so there would be nothing to see
+	if (!ksu_boot_completed)
+		return -ENOENT;
+
+	track_throne(false);
+	prunes = ksu_selftest_throne_prune_count();
+	gen = ksu_allowlist_generation();
+
+	for (i = 0; i < PRUNE_RUNS; i++)
+		track_throne(false);
+
+	if (ksu_allowlist_generation() != gen) {
+		pr_err("selftest: throne_prune: generation moved %llu -> %llu\n",
+		       gen, ksu_allowlist_generation());
+		return -EINVAL;
+	}
+	if (ksu_selftest_throne_prune_count() != prunes) {
+		pr_err("selftest: throne_prune: %u prune(s) on unchanged runs\n",
+		       ksu_selftest_throne_prune_count() - prunes);
+		return -EINVAL;
+	}
+	return 0;
+}
@@ -18,6 +18,8 @@
 #define KSU_SULOG_MAX_ARG_STRINGS 0x7FFFFFFF
 #define KSU_SULOG_MAX_ARG_CHUNK 256U
 #define KSU_SULOG_MAX_FILENAME_LEN 256U
+// argv strings read with one copy_from_user() starting at argv[0]
+#define KSU_SULOG_ARGV_BLOCK_LEN 1024U
 
 struct user_arg_ptr {
 	const char __user *const __user *native;
@@ -25,12 +27,21 @@ struct user_arg_ptr {
 
 static struct ksu_event_queue sulog_queue;
 
+/*
+ * Lives from capture before execve to emit after it, so it cannot be per-CPU.
+ * Objects come from a dedicated slab cache and carry the payload and the argv
+ * scratch block inline; only the queue node is sized to the event.
+ */
 struct ksu_sulog_pending_event {
 	__u16 event_type;
 	void *payload;
 	__u32 payload_len;
+	u8 payload_buf[KSU_SULOG_MAX_PAYLOAD_LEN];
+	char argv_block[KSU_SULOG_ARGV_BLOCK_LEN];
 };
 
+static struct kmem_cache *sulog_pending_cache;
+
 struct ksu_sulog_identity {
 	__u32 uid;
 	__u32 euid;
@@ -120,10 +131,68 @@ static __u32 ksu_sulog_copy_filename(const char __user *filename_user,
 	return ret + 1;
 }
 
+/*
+ * argv[0] onwards is read with one bounded copy_from_user(). Strings that sit
+ * inside that block are taken from it; any other string, or one running past
+ * the block end, falls back to its own copy.
+ */
+struct ksu_sulog_argv_block {
+	unsigned long base;
+	const char *data;
+	size_t len;
+};
+
+static void ksu_sulog_read_argv_block(struct ksu_sulog_argv_block *block,
+				      const char __user *arg0, char *scratch,
+				      size_t scratch_len)
+{
+	const void __user *src;
+
+	block->base = untagged_addr((unsigned long)arg0);
+	block->data = scratch;
+	src = (const void __user *)block->base;
+#ifdef KSU_OPTIONAL_STRNCPY
+	// all or nothing; a partial block just means per-string copies
+	block->len = copy_from_user_nofault(scratch, src, scratch_len) ?
+			 0 :
+			 scratch_len;
+#else
+	block->len = scratch_len - copy_from_user(scratch, src, scratch_len);
+#endif // #ifdef KSU_OPTIONAL_STRNCPY
+}
+
+/*
+ * Same contract as ksu_sulog_copy_user_string(chunk_dst, arg_user, chunk):
+ * the string length if it ends within chunk bytes, chunk if it does not,
+ * <= 0 for an empty string or a fault. *out points at the copied bytes.
+ */
+static long ksu_sulog_copy_arg(const struct ksu_sulog_argv_block *block,
+			       const char __user *arg_user, char *chunk_dst,
+			       size_t chunk, const char **out)
+{
+	unsigned long addr = untagged_addr((unsigned long)arg_user);
+
+	if (addr >= block->base && addr - block->base < block->len) {
+		size_t off = addr - block->base;
+		size_t avail = min_t(size_t, block->len - off, chunk);
+		size_t len = strnlen(block->data + off, avail);
+
+		if (len < avail || avail == chunk) {
+			*out = block->data + off;
+			return len;
+		}
+	}
+
+	*out = chunk_dst;
+	return ksu_sulog_copy_user_string(chunk_dst, arg_user, chunk);
+}
+
 static __u32 ksu_sulog_flatten_argv(const char __user *const __user *argv_user,
-				    char *dst, __u32 dst_len)
+				    char *dst, __u32 dst_len, char *scratch,
+				    size_t scratch_len)
 {
 	struct user_arg_ptr argv = ksu_sulog_user_argv(argv_user);
+	struct ksu_sulog_argv_block block = {};
 	char arg[KSU_SULOG_MAX_ARG_CHUNK];
 	__u32 used = 0;
 	int i;
@@ -136,6 +205,7 @@ static __u32 ksu_sulog_flatten_argv(const char __user *const __user *argv_user,
 
 	for (i = 0; i < KSU_SULOG_MAX_ARG_STRINGS; i++) {
 		const char __user *arg_user;
+		const char *src;
 		long copied;
 		size_t arg_len;
 
@@ -148,16 +218,17 @@ static __u32 ksu_sulog_flatten_argv(const char __user *const __user *argv_user,
 		if (IS_ERR(arg_user))
 			return ksu_sulog_copy_empty_string(dst);
 
-		copied = ksu_sulog_copy_user_string(arg, arg_user, sizeof(arg));
+		if (!i)
+			ksu_sulog_read_argv_block(&block, arg_user, scratch,
+						  scratch_len);
+
+		copied =
+		    ksu_sulog_copy_arg(&block, arg_user, arg, sizeof(arg), &src);
 		if (copied <= 0)
 			return ksu_sulog_copy_empty_string(dst);
 
-		if (copied >= sizeof(arg))
-			arg[sizeof(arg) - 1] = '\0';
-
-		arg_len = strnlen(arg, sizeof(arg));
-		if (!arg_len)
-			continue;
+		// a full chunk keeps its first sizeof(arg) - 1 bytes
+		arg_len = min_t(size_t, copied, sizeof(arg) - 1);
 
 		if (used && used < dst_len - 1)
 			dst[used++] = ' ';
@@ -166,7 +237,7 @@ static __u32 ksu_sulog_flatten_argv(const char __user *const __user *argv_user,
 			break;
 
 		arg_len = min_t(size_t, arg_len, dst_len - used - 1);
-		memcpy(dst + used, arg, arg_len);
+		memcpy(dst + used, src, arg_len);
 		used += arg_len;
 
 		if (used >= dst_len - 1)
@@ -200,15 +271,15 @@ ksu_sulog_capture(__u16 event_type, const char __user *filename_user,
 		return NULL;
 #endif // #ifdef CONFIG_COMPAT
 
-	pending = kzalloc(sizeof(*pending), gfp);
+	if (unlikely(!sulog_pending_cache))
+		goto out_drop;
+	pending = kmem_cache_alloc(sulog_pending_cache, gfp);
 	if (!pending)
 		goto out_drop;
 
-	payload = kzalloc(KSU_SULOG_MAX_PAYLOAD_LEN, gfp);
-	if (!payload)
-		goto out_free_pending;
-
+	payload = pending->payload_buf;
 	event = payload;
+	memset(event, 0, sizeof(*event));
 	ksu_sulog_fill_task_info(event, event_type, 0);
 
 	remaining = KSU_SULOG_MAX_PAYLOAD_LEN - sizeof(*event);
@@ -217,22 +288,24 @@ ksu_sulog_capture(__u16 event_type, const char __user *filename_user,
 	    filename_user, filename_buf,
 	    min_t(__u32, remaining, KSU_SULOG_MAX_FILENAME_LEN));
 	if (!filename_len)
-		goto out_free_payload;
+		goto out_free_pending;
 
 	remaining -= filename_len;
 	argv_buf = filename_buf + filename_len;
-	argv_len = ksu_sulog_flatten_argv(argv_user, argv_buf, remaining);
+	argv_len = ksu_sulog_flatten_argv(argv_user, argv_buf, remaining,
+					  pending->argv_block,
+					  sizeof(pending->argv_block));
 	if (!argv_len)
-		goto out_free_payload;
+		goto out_free_pending;
 
 	event->filename_len = filename_len;
 	event->argv_len = argv_len;
 
 	if (filename_len > ((__u32)-1) - sizeof(*event))
-		goto out_free_payload;
+		goto out_free_pending;
 	payload_len = sizeof(*event) + filename_len;
 	if (argv_len > ((__u32)-1) - payload_len)
-		goto out_free_payload;
+		goto out_free_pending;
 	payload_len += argv_len;
 
 	pending->event_type = event_type;
@@ -240,10 +313,8 @@ ksu_sulog_capture(__u16 event_type, const char __user *filename_user,
 	pending->payload_len = payload_len;
 	return pending;
 
-out_free_payload:
-	kfree(payload);
 out_free_pending:
-	kfree(pending);
+	kmem_cache_free(sulog_pending_cache, pending);
 out_drop:
 	ksu_event_queue_drop(&sulog_queue);
 	return NULL;
@@ -268,6 +339,13 @@ ksu_sulog_capture_grant_root(const struct ksu_sulog_identity *identity,
 
 int ksu_sulog_events_init(void)
 {
+	sulog_pending_cache =
+	    kmem_cache_create("ksu_sulog_pending",
+			      sizeof(struct ksu_sulog_pending_event), 0, 0,
+			      NULL);
+	if (!sulog_pending_cache)
+		return -ENOMEM;
+
 	ksu_event_queue_init(&sulog_queue, KSU_SULOG_MAX_QUEUED,
 			     KSU_SULOG_MAX_PAYLOAD_LEN);
 	return 0;
@@ -276,14 +354,15 @@ int ksu_sulog_events_init(void)
 void ksu_sulog_events_exit(void)
 {
 	ksu_event_queue_destroy(&sulog_queue);
+	kmem_cache_destroy(sulog_pending_cache);
+	sulog_pending_cache = NULL;
 }
 
 static void ksu_sulog_free_pending(struct ksu_sulog_pending_event *pending)
 {
 	if (!pending)
 		return;
-	kfree(pending->payload);
-	kfree(pending);
+	kmem_cache_free(sulog_pending_cache, pending);
 }
 
 struct ksu_sulog_pending_event *
@@ -341,3 +420,7 @@ struct ksu_event_queue *ksu_sulog_get_queue(void)
 {
 	return &sulog_queue;
 }
+
+#ifdef CONFIG_KSU_SULOG_KUNIT_TEST
+#include "sulog/event_test.c"
+#endif // #ifdef CONFIG_KSU_SULOG_KUNIT_TEST
@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * KUnit tests for the sulog argv capture. Built into sulog/event.c so the
+ * static helpers are reachable; every case lays argv out in a user mapping
+ * owned by the test and flattens it the way an execve capture does.
+ */
+
+#include <kunit/test.h>
+#include <linux/mman.h>
+
+#define ARGV_TEST_PAGES 4
+// argv pointer arrays live on the first page, strings from the second on
+#define ARGV_TEST_STRINGS PAGE_SIZE
+
+struct argv_test_map {
+	struct kunit *test;
+	unsigned long base;
+};
+
+static void argv_test_map_init(struct kunit *test, struct argv_test_map *map)
+{
+#ifdef KSU_HAS_KUNIT_VM_MMAP
+	map->test = test;
+	map->base = kunit_vm_mmap(test, NULL, 0, ARGV_TEST_PAGES * PAGE_SIZE,
+				  PROT_READ | PROT_WRITE,
+				  MAP_ANONYMOUS | MAP_PRIVATE, 0);
+	KUNIT_ASSERT_FALSE_MSG(test, !map->base || IS_ERR_VALUE(map->base),
+			       "cannot map user memory");
+#else
+	kunit_skip(test, "needs kunit_vm_mmap()");
+#endif // #ifdef KSU_HAS_KUNIT_VM_MMAP
+}
+
+static const char __user *argv_test_put(struct argv_test_map *map,
+					unsigned long offset, const void *data,
+					size_t len)
+{
+	void __user *dst = (void __user *)(map->base + offset);
+
+	KUNIT_ASSERT_EQ(map->test, copy_to_user(dst, data, len), 0UL);
+	return dst;
+}
+
+static const char __user *argv_test_put_string(struct argv_test_map *map,
+					       unsigned long offset,
+					       const char *str)
+{
+	return argv_test_put(map, offset, str, strlen(str) + 1);
+}
+
+// A string of len copies of c, NUL terminated
+static const char __user *argv_test_put_run(struct argv_test_map *map,
+					    unsigned long offset, char c,
+					    size_t len)
+{
+	char *str = kunit_kzalloc(map->test, len + 1, GFP_KERNEL);
+
+	KUNIT_ASSERT_NOT_NULL(map->test, str);
+	memset(str, c, len);
+	return argv_test_put(map, offset, str, len + 1);
+}
+
+// Store the NULL-terminated pointer array at the start of the mapping
+static const char __user *const __user *
+argv_test_put_argv(struct argv_test_map *map, const char __user *const *args,
+		   int argc)
+{
+	const char __user *ptrs[8] = {};
+
+	KUNIT_ASSERT_LT(map->test, argc, (int)ARRAY_SIZE(ptrs));
+	memcpy(ptrs, args, argc * sizeof(*args));
+	argv_test_put(map, 0, ptrs, (argc + 1) * sizeof(*ptrs));
+	return (const char __user *const __user *)map->base;
+}
+
+static char *argv_test_flatten(struct argv_test_map *map,
+			       const char __user *const __user *argv,
+			       __u32 *len)
+{
+	char *scratch =
+	    kunit_kzalloc(map->test, KSU_SULOG_ARGV_BLOCK_LEN, GFP_KERNEL);
+	char *dst =
+	    kunit_kzalloc(map->test, KSU_SULOG_MAX_PAYLOAD_LEN, GFP_KERNEL);
+
+	KUNIT_ASSERT_NOT_NULL(map->test, scratch);
+	KUNIT_ASSERT_NOT_NULL(map->test, dst);
+	*len = ksu_sulog_flatten_argv(argv, dst, KSU_SULOG_MAX_PAYLOAD_LEN,
+				      scratch, KSU_SULOG_ARGV_BLOCK_LEN);
+	return dst;
+}
+
+static void argv_test_in_block(struct kunit *test)
+{
+	struct argv_test_map map;
+	const char __user *args[3];
+	char *out;
+	__u32 len;
+
+	argv_test_map_init(test, &map);
+	args[0] = argv_test_put_string(&map, ARGV_TEST_STRINGS, "su");
+	args[1] = argv_test_put_string(&map, ARGV_TEST_STRINGS + 3, "-c");
+	args[2] = argv_test_put_string(&map, ARGV_TEST_STRINGS + 6, "id");
+
+	out = argv_test_flatten(&map, argv_test_put_argv(&map, args, 3), &len);
+	KUNIT_EXPECT_STREQ(test, out, "su -c id");
+	KUNIT_EXPECT_EQ(test, len, (__u32)sizeof("su -c id"));
+}
+
+// Only the start of argv[1] is inside the block; it must be copied whole
+static void argv_test_crosses_block_end(struct kunit *test)
+{
+	const size_t offset = KSU_SULOG_ARGV_BLOCK_LEN - 24;
+	struct argv_test_map map;
+	const char __user *args[2];
+	char expected[3 + 100 + 1];
+	char *out;
+	__u32 len;
+
+	argv_test_map_init(test, &map);
+	args[0] = argv_test_put_string(&map, ARGV_TEST_STRINGS, "su");
+	args[1] = argv_test_put_run(&map, ARGV_TEST_STRINGS + offset, 'b', 100);
+
+	memcpy(expected, "su ", 3);
+	memset(expected + 3, 'b', 100);
+	expected[sizeof(expected) - 1] = '\0';
+	out = argv_test_flatten(&map, argv_test_put_argv(&map, args, 2), &len);
+	KUNIT_EXPECT_STREQ(test, out, expected);
+	KUNIT_EXPECT_EQ(test, len, (__u32)sizeof(expected));
+}
+
+// Arguments keep their first KSU_SULOG_MAX_ARG_CHUNK - 1 bytes, whether the
+// block holds the whole chunk or only part of it
+static void argv_test_long_arg(struct kunit *test)
+{
+	const size_t keep = KSU_SULOG_MAX_ARG_CHUNK - 1;
+	struct argv_test_map map;
+	const char __user *args[3];
+	char *expected;
+	char *out;
+	__u32 len;
+
+	argv_test_map_init(test, &map);
+	args[0] = argv_test_put_string(&map, ARGV_TEST_STRINGS, "su");
+	args[1] = argv_test_put_run(&map, ARGV_TEST_STRINGS + 16, 'c', 300);
+	args[2] = argv_test_put_run(
+	    &map, ARGV_TEST_STRINGS + KSU_SULOG_ARGV_BLOCK_LEN - 100, 'd', 300);
+
+	expected = kunit_kzalloc(test, 3 + 2 * (keep + 1), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, expected);
+	memcpy(expected, "su ", 3);
+	memset(expected + 3, 'c', keep);
+	expected[3 + keep] = ' ';
+	memset(expected + 4 + keep, 'd', keep);
+
+	out = argv_test_flatten(&map, argv_test_put_argv(&map, args, 3), &len);
+	KUNIT_EXPECT_STREQ(test, out, expected);
+	KUNIT_EXPECT_EQ(test, len, (__u32)(3 + 2 * keep + 2));
+}
+
+/*
+ * argv[0] sits 32 bytes before an unmapped page, so the block read faults
+ * part way. The nofault copy is all or nothing and leaves an empty block;
+ * plain copy_from_user() keeps the at most 32 bytes it got. Either way the
+ * strings still come out right.
+ */
+static void argv_test_block_fault(struct kunit *test)
+{
+	const unsigned long hole = (ARGV_TEST_PAGES - 1) * PAGE_SIZE;
+	struct ksu_sulog_argv_block block = {};
+	struct argv_test_map map;
+	const char __user *args[3];
+	char *scratch;
+	char *out;
+	__u32 len;
+
+	argv_test_map_init(test, &map);
+	args[0] = argv_test_put_string(&map, hole - 32, "su");
+	args[1] = argv_test_put_string(&map, hole - 29, "-c");
+	args[2] = argv_test_put_string(&map, ARGV_TEST_STRINGS, "id");
+	KUNIT_ASSERT_EQ(test, vm_munmap(map.base + hole, PAGE_SIZE), 0);
+
+	scratch = kunit_kzalloc(test, KSU_SULOG_ARGV_BLOCK_LEN, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, scratch);
+	ksu_sulog_read_argv_block(&block, args[0], scratch,
+				  KSU_SULOG_ARGV_BLOCK_LEN);
+#ifdef KSU_OPTIONAL_STRNCPY
+	KUNIT_EXPECT_EQ(test, block.len, (size_t)0);
+#else
+	// copy_from_user() may stop a little short of the fault
+	KUNIT_EXPECT_LE(test, block.len, (size_t)32);
+	if (block.len >= sizeof("su"))
+		KUNIT_EXPECT_STREQ(test, block.data, "su");
+#endif // #ifdef KSU_OPTIONAL_STRNCPY
+
+	out = argv_test_flatten(&map, argv_test_put_argv(&map, args, 3), &len);
+	KUNIT_EXPECT_STREQ(test, out, "su -c id");
+	KUNIT_EXPECT_EQ(test, len, (__u32)sizeof("su -c id"));
+}
+
+// An argument that cannot be read blanks the whole argv
+static void argv_test_unreadable_arg(struct kunit *test)
+{
+	const unsigned long hole = (ARGV_TEST_PAGES - 1) * PAGE_SIZE;
+	struct argv_test_map map;
+	const char __user *args[2];
+	char *out;
+	__u32 len;
+
+	argv_test_map_init(test, &map);
+	args[0] = argv_test_put_string(&map, ARGV_TEST_STRINGS, "su");
+	args[1] = (const char __user *)(map.base + hole);
+	KUNIT_ASSERT_EQ(test, vm_munmap(map.base + hole, PAGE_SIZE), 0);
+
+	out = argv_test_flatten(&map, argv_test_put_argv(&map, args, 2), &len);
+	KUNIT_EXPECT_STREQ(test, out, "");
+	KUNIT_EXPECT_EQ(test, len, (__u32)1);
+}
+
+static struct kunit_case ksu_sulog_argv_cases[] = {
+    KUNIT_CASE(argv_test_in_block),
+    KUNIT_CASE(argv_test_crosses_block_end),
+    KUNIT_CASE(argv_test_long_arg),
+    KUNIT_CASE(argv_test_block_fault),
+    KUNIT_CASE(argv_test_unreadable_arg),
+    {},
+};
+
+static struct kunit_suite ksu_sulog_argv_suite = {
+    .name = "ksu_sulog_argv",
+    .test_cases = ksu_sulog_argv_cases,
+};
+
+kunit_test_suite(ksu_sulog_argv_suite);
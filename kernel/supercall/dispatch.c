@@ -309,6 +309,16 @@ static int do_uid_granted_root(void __user *arg)
 	return 0;
 }
 
+static int do_get_boot_stamps(void __user *arg)
+{
+	struct ksu_get_boot_stamps_cmd cmd;
+
+	ksu_get_boot_stamps(&cmd);
+	if (copy_to_user(arg, &cmd, sizeof(cmd)))
+		return -EFAULT;
+	return 0;
+}
+
 static int do_uid_should_umount(void __user *arg)
 {
 	struct ksu_uid_should_umount_cmd cmd;
@@ -541,6 +551,42 @@ static int do_set_feature(void __user *arg)
 	return 0;
 }
 
+static int do_feature_batch(void __user *arg)
+{
+	struct ksu_feature_batch_cmd cmd;
+	struct ksu_feature_batch_entry *entries = NULL;
+	void __user *user_entries;
+	size_t size;
+	int ret = 0;
+
+	if (copy_from_user(&cmd, arg, sizeof(cmd)))
+		return -EFAULT;
+	if (cmd.flags & ~KSU_FEATURE_BATCH_SET)
+		return -EINVAL;
+	if (cmd.count > KSU_FEATURE_MAX || (cmd.count && !cmd.entries))
+		return -EINVAL;
+	if (!cmd.count)
+		return 0;
+
+	user_entries = (void __user *)(uintptr_t)cmd.entries;
+	size = sizeof(*entries) * cmd.count;
+	entries = memdup_user(user_entries, size);
+	if (IS_ERR(entries))
+		return PTR_ERR(entries);
+
+	if (cmd.flags & KSU_FEATURE_BATCH_SET)
+		ret = ksu_set_features(entries, cmd.count);
+	else
+		ksu_get_features(entries, cmd.count);
+
+	// Per-entry status is reported even when a set is refused
+	if (copy_to_user(user_entries, entries, size))
+		ret = -EFAULT;
+
+	kfree(entries);
+	return ret;
+}
+
 static int do_get_uts_view_config(void __user *arg)
 {
 	struct ksu_uts_view_config config = {};
@@ -1485,6 +1531,14 @@ static const struct ksu_ioctl_cmd_map ksu_ioctl_handlers[] = {
      .name = "SET_FEATURE",
      .handler = do_set_feature,
      .perm_check = manager_or_root},
+    {.cmd = KSU_IOCTL_FEATURE_BATCH,
+     .name = "FEATURE_BATCH",
+     .handler = do_feature_batch,
+     .perm_check = manager_or_root},
+    {.cmd = KSU_IOCTL_GET_BOOT_STAMPS,
+     .name = "GET_BOOT_STAMPS",
+     .handler = do_get_boot_stamps,
+     .perm_check = only_root},
     {.cmd = KSU_IOCTL_GET_WRAPPER_FD,
      .name = "GET_WRAPPER_FD",
      .handler = do_get_wrapper_fd,
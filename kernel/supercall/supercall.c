@@ -47,10 +47,17 @@ static void ksu_install_fd_tw_func(struct callback_head *cb)
 {
 	struct ksu_install_fd_tw *tw =
 	    container_of(cb, struct ksu_install_fd_tw, cb);
-	int fd = ksu_install_fd();
-	pr_info("[%d] install ksu fd: %d\n", current->pid, fd);
+	int fd = ksu_find_installed_fd();
+	bool reused = fd >= 0;
 
-	if (copy_to_user(tw->outp, &fd, sizeof(fd))) {
+	// Hand back the fd the caller already holds instead of a duplicate, so
+	// asking the kernel is an O(1) lookup rather than a /proc/self/fd scan.
+	if (!reused)
+		fd = ksu_install_fd();
+	pr_info("[%d] %s ksu fd: %d\n", current->pid,
+		reused ? "reuse" : "install", fd);
+
+	if (copy_to_user(tw->outp, &fd, sizeof(fd)) && !reused) {
 		pr_err("install ksu fd reply err\n");
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
 		close_fd(fd);
@@ -312,6 +319,7 @@ static int ksu_handle_prctl_superkey(int option, unsigned long arg2)
 		struct ksu_prctl_get_fd_cmd __user *cmd_user =
 		    (struct ksu_prctl_get_fd_cmd __user *)arg2;
 		struct ksu_prctl_get_fd_cmd cmd;
+		bool reused;
 
 		// Security: Check if caller is authenticated manager
 		// IMPORTANT: Do NOT return -EPERM or any error that reveals KSU
@@ -321,8 +329,13 @@ static int ksu_handle_prctl_superkey(int option, unsigned long arg2)
 			return 0; // Silent fail - don't reveal KSU exists
 		}
 
+		// Reuse the fd installed at app specialization if there is one
+		cmd.fd = ksu_find_installed_fd();
+		reused = cmd.fd >= 0;
+
 		// Open driver fd for authenticated manager
-		cmd.fd = ksu_install_fd();
+		if (!reused)
+			cmd.fd = ksu_install_fd();
 		if (cmd.fd >= 0) {
 			cmd.result = 0;
 			pr_info("prctl get_fd: success, fd=%d for uid=%d\n",
@@ -336,7 +349,7 @@ static int ksu_handle_prctl_superkey(int option, unsigned long arg2)
 
 		if (copy_to_user(cmd_user, &cmd, sizeof(cmd))) {
 			// Failed to copy, must close the fd we just opened
-			if (cmd.fd >= 0) {
+			if (cmd.fd >= 0 && !reused) {
 				pr_err("prctl get_fd: copy_to_user failed, "
 				       "closing fd=%d\n",
 				       cmd.fd);
@@ -493,6 +506,25 @@ static const struct file_operations anon_ksu_fops = {
     .release = anon_ksu_release,
 };
 
+static int ksu_match_driver_file(const void *p, struct file *file,
+				 unsigned int fd)
+{
+	// fd 0 is valid, so report fd + 1 to stop iterate_fd()
+	return file->f_op == &anon_ksu_fops ? fd + 1 : 0;
+}
+
+// Find a driver fd already present in current's fd table
+int ksu_find_installed_fd(void)
+{
+	int found;
+
+	if (!current->files)
+		return -ENOENT;
+
+	found = iterate_fd(current->files, 0, ksu_match_driver_file, NULL);
+	return found > 0 ? found - 1 : -ENOENT;
+}
+
 // Install KSU fd to current process
 int ksu_install_fd(void)
 {
@@ -4,6 +4,7 @@
 #include "uapi/supercall.h"
 
 int ksu_install_fd(void);
+int ksu_find_installed_fd(void);
 void ksu_supercalls_init(void);
 void ksu_supercalls_exit(void);
 
@@ -4,7 +4,9 @@
 
 #include <android/log.h>
 #include <dirent.h>
+#include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -67,9 +69,10 @@ static inline int request_driver_fd_via_prctl() {
   };
 
   /*
-   * Ask kernel for a dedicated KSU driver fd when none is inherited.
-   * This is required for manager coexistence, where one manager process
-   * may not have an existing [ksu_driver] fd to scan from /proc/self/fd.
+   * Ask kernel for the KSU driver fd. It returns the fd installed at app
+   * specialization if present, otherwise a dedicated one. The latter is
+   * required for manager coexistence, where one manager process may not
+   * have an existing [ksu_driver] fd to scan from /proc/self/fd.
    */
   long ret = prctl(KSU_PRCTL_GET_FD, &cmd, 0, 0, 0);
   (void)ret;
@@ -81,9 +84,14 @@ static inline int request_driver_fd_via_prctl() {
 
 static int ksuctl(unsigned long op, void *arg) {
   if (fd < 0) {
-    fd = scan_driver_fd();
+    /*
+     * The kernel answers prctl with the fd it installed at specialization
+     * when there is one, which spares the readlink-per-fd scan below on
+     * every process start. Kernels without the prctl hook fall through.
+     */
+    fd = request_driver_fd_via_prctl();
     if (fd < 0) {
-      fd = request_driver_fd_via_prctl();
+      fd = scan_driver_fd();
     }
   }
   return ioctl(fd, op, arg);
@@ -212,57 +220,127 @@ int get_app_profile(struct app_profile *profile) {
   return -1;
 }
 
-bool set_su_enabled(bool enabled) {
-  struct ksu_set_feature_cmd cmd = {};
-  cmd.feature_id = KSU_FEATURE_SU_COMPAT;
-  cmd.value = enabled ? 1 : 0;
-  return ksuctl(KSU_IOCTL_SET_FEATURE, &cmd) == 0;
+/*
+ * Feature reads are served from one batched snapshot of every feature id, so
+ * a settings screen asking for each toggle costs a single ioctl. Writes drop
+ * the snapshot, and it ages out quickly so changes made through ksud show up.
+ */
+#define FEATURE_SNAPSHOT_TTL_NS 500000000LL
+
+static pthread_mutex_t g_feature_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ksu_feature_batch_entry g_feature_snapshot[KSU_FEATURE_MAX];
+static int64_t g_feature_snapshot_ns = 0;
+static bool g_feature_snapshot_valid = false;
+static bool g_feature_batch_unsupported = false;
+
+static int64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
-bool is_su_enabled() {
-  struct ksu_get_feature_cmd cmd = {};
-  cmd.feature_id = KSU_FEATURE_SU_COMPAT;
-  if (ksuctl(KSU_IOCTL_GET_FEATURE, &cmd) == 0 && cmd.supported) {
-    return cmd.value != 0;
+// Called with g_feature_lock held
+static bool refresh_feature_snapshot() {
+  if (g_feature_batch_unsupported) {
+    return false;
+  }
+  int64_t now = monotonic_ns();
+  if (g_feature_snapshot_valid &&
+      now - g_feature_snapshot_ns < FEATURE_SNAPSHOT_TTL_NS) {
+    return true;
   }
-  return false;
-}
 
-bool set_magisk_compat_enabled(bool enabled) {
-  struct ksu_set_feature_cmd cmd = {};
-  cmd.feature_id = KSU_FEATURE_MAGISK_COMPAT;
-  cmd.value = enabled ? 1 : 0;
-  return ksuctl(KSU_IOCTL_SET_FEATURE, &cmd) == 0;
+  for (uint32_t i = 0; i < KSU_FEATURE_MAX; i++) {
+    g_feature_snapshot[i].feature_id = i;
+  }
+  struct ksu_feature_batch_cmd cmd = {};
+  cmd.count = KSU_FEATURE_MAX;
+  cmd.entries = (uint64_t)(uintptr_t)g_feature_snapshot;
+  if (ksuctl(KSU_IOCTL_FEATURE_BATCH, &cmd) != 0) {
+    if (errno == ENOTTY) {
+      g_feature_batch_unsupported = true;
+    }
+    g_feature_snapshot_valid = false;
+    return false;
+  }
+  g_feature_snapshot_ns = now;
+  g_feature_snapshot_valid = true;
+  return true;
 }
 
-bool is_magisk_compat_enabled() {
-  struct ksu_get_feature_cmd cmd = {};
-  cmd.feature_id = KSU_FEATURE_MAGISK_COMPAT;
-  if (ksuctl(KSU_IOCTL_GET_FEATURE, &cmd) == 0 && cmd.supported) {
-    return cmd.value != 0;
+static bool get_feature(uint32_t feature_id, uint64_t *out_value,
+                        bool *out_supported) {
+  uint64_t value = 0;
+  bool supported = false;
+  bool ok = false;
+
+  pthread_mutex_lock(&g_feature_lock);
+  if (feature_id < KSU_FEATURE_MAX && refresh_feature_snapshot()) {
+    const struct ksu_feature_batch_entry *entry =
+        &g_feature_snapshot[feature_id];
+    if (entry->status == 0 || entry->status == -ENOENT) {
+      value = entry->value;
+      supported = entry->status == 0;
+      ok = true;
+    }
   }
-  return false;
-}
+  pthread_mutex_unlock(&g_feature_lock);
 
-static inline bool get_feature(uint32_t feature_id, uint64_t *out_value,
-                               bool *out_supported) {
-  struct ksu_get_feature_cmd cmd = {};
-  cmd.feature_id = feature_id;
-  if (ksuctl(KSU_IOCTL_GET_FEATURE, &cmd) != 0) {
-    return false;
+  if (!ok) {
+    // Kernels without the batched ioctl, or a failing getter
+    struct ksu_get_feature_cmd cmd = {};
+    cmd.feature_id = feature_id;
+    if (ksuctl(KSU_IOCTL_GET_FEATURE, &cmd) != 0) {
+      return false;
+    }
+    value = cmd.value;
+    supported = cmd.supported;
   }
+
   if (out_value)
-    *out_value = cmd.value;
+    *out_value = value;
   if (out_supported)
-    *out_supported = cmd.supported;
+    *out_supported = supported;
   return true;
 }
 
-static inline bool set_feature(uint32_t feature_id, uint64_t value) {
+static bool set_feature(uint32_t feature_id, uint64_t value) {
   struct ksu_set_feature_cmd cmd = {};
   cmd.feature_id = feature_id;
   cmd.value = value;
-  return ksuctl(KSU_IOCTL_SET_FEATURE, &cmd) == 0;
+  bool ok = ksuctl(KSU_IOCTL_SET_FEATURE, &cmd) == 0;
+
+  pthread_mutex_lock(&g_feature_lock);
+  g_feature_snapshot_valid = false;
+  pthread_mutex_unlock(&g_feature_lock);
+  return ok;
+}
+
+bool set_su_enabled(bool enabled) {
+  return set_feature(KSU_FEATURE_SU_COMPAT, enabled ? 1 : 0);
+}
+
+bool is_su_enabled() {
+  uint64_t value = 0;
+  bool supported = false;
+  if (get_feature(KSU_FEATURE_SU_COMPAT, &value, &supported) && supported) {
+    return value != 0;
+  }
+  return false;
+}
+
+bool set_magisk_compat_enabled(bool enabled) {
+  return set_feature(KSU_FEATURE_MAGISK_COMPAT, enabled ? 1 : 0);
+}
+
+bool is_magisk_compat_enabled() {
+  uint64_t value = 0;
+  bool supported = false;
+  if (get_feature(KSU_FEATURE_MAGISK_COMPAT, &value, &supported) &&
+      supported) {
+    return value != 0;
+  }
+  return false;
 }
 
 bool set_kernel_umount_enabled(bool enabled) {
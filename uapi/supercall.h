@@ -254,6 +254,47 @@ struct ksu_get_dynamic_managers_cmd {
 #define KSU_SU_CHOICE_DENY 3
 #define KSU_SU_CHOICE_DENY_HIDE 4
 
+/*
+ * Reads or writes several features in one call. Reads are taken under one
+ * lock. Writes are checked up front and applied in order; if a handler fails,
+ * the entries before it are restored where their feature can report its
+ * previous value, and the ioctl returns that handler's error.
+ */
+#define KSU_FEATURE_BATCH_SET (1 << 0)
+
+/*
+ * status is 0 when the value was read or is in effect, -ENOENT for a feature
+ * the kernel does not register, and another -errno on failure.
+ */
+struct ksu_feature_batch_entry {
+  __u32 feature_id;
+  __s32 status; // Output
+  __u64 value;  // Input for set, output for get
+};
+
+struct ksu_feature_batch_cmd {
+  __u32 flags;            // KSU_FEATURE_BATCH_SET, or 0 to get
+  __u32 count;            // Number of entries, at most KSU_FEATURE_MAX
+  __aligned_u64 entries;  // struct ksu_feature_batch_entry[count]
+};
+
+/*
+ * Boot milestones seen by the kernel, as CLOCK_BOOTTIME nanoseconds; 0 when
+ * the milestone has not happened this boot. Unused slots stay 0.
+ */
+#define KSU_BOOT_STAMP_MODULE_INIT 0
+#define KSU_BOOT_STAMP_SECOND_STAGE 1
+#define KSU_BOOT_STAMP_INIT_RC_READ 2
+#define KSU_BOOT_STAMP_INIT_RC_APPENDED 3
+#define KSU_BOOT_STAMP_POST_FS_DATA 4
+#define KSU_BOOT_STAMP_POST_FS_DATA_DONE 5
+#define KSU_BOOT_STAMP_BOOT_COMPLETED 6
+#define KSU_BOOT_STAMP_MAX 16
+
+struct ksu_get_boot_stamps_cmd {
+  __u64 ns[KSU_BOOT_STAMP_MAX];
+};
+
 /* Root-only, constrained to allowlist or module-umount profiles. */
 struct ksu_magisk_persist_cmd {
   __u32 uid;
@@ -302,6 +343,9 @@ struct ksu_magisk_persist_cmd {
 #define KSU_IOCTL_SET_UTS_VIEW_CONFIG _IOW('K', 244, struct ksu_uts_view_config)
 #define KSU_IOCTL_GET_UTS_VIEW_STATUS _IOR('K', 245, struct ksu_uts_view_status)
 #define KSU_IOCTL_GET_LOAD_MODE _IOR('K', 246, struct ksu_get_load_mode_cmd)
+#define KSU_IOCTL_FEATURE_BATCH _IOWR('K', 248, struct ksu_feature_batch_cmd)
+#define KSU_IOCTL_GET_BOOT_STAMPS                                              \
+  _IOR('K', 249, struct ksu_get_boot_stamps_cmd)
 
 #define KSU_IOCTL_SUPERKEY_AUTH _IOC(_IOC_READ | _IOC_WRITE, 'K', 107, 0)
 #define KSU_IOCTL_SUPERKEY_STATUS _IOC(_IOC_READ, 'K', 108, 0)
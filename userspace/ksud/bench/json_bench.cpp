@@ -0,0 +1,243 @@
+// Encode/decode benchmark for core/json.hpp: streams representative payloads
+// (yzctl status, a plugin config, module list) through json::Writer and
+// json::Reader and compares them against building/walking a json::Value DOM.
+// Each payload is round-tripped once and checked before timing. Not embedded
+// into ksud; build with -DKSUD_BUILD_BENCH=ON, e.g. `json_bench -n 2000`.
+
+#include "../src/core/json.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Payload {
+    const char* name;
+    int indent;
+    void (*write)(json::Writer* writer);
+    json::Value (*build)();
+};
+
+// Roughly what `yzctl status --json` prints with a few dozen tracked processes
+constexpr int kRuntimeRecords = 48;
+// A busy module directory
+constexpr int kModules = 120;
+// A plugin config with nested settings
+constexpr int kConfigEntries = 64;
+
+void write_status(json::Writer* writer) {
+    writer->begin_object().member("count", 12).member("enabled", true);
+    writer->key("runtime").begin_array();
+    for (int i = 0; i < kRuntimeRecords; ++i) {
+        writer->begin_object()
+            .member("abi", "arm64")
+            .member("pid", 1000 + i)
+            .member("process", "com.example.app" + std::to_string(i))
+            .member("state", "injected")
+            .member("target", "com.example.app" + std::to_string(i))
+            .end_object();
+    }
+    writer->end_array().member("safe_mode", false).end_object();
+}
+
+json::Value build_status() {
+    json::Value root = json::Value::object();
+    root["count"] = json::Value(12);
+    root["enabled"] = json::Value(true);
+    root["runtime"] = json::Value::array();
+    for (int i = 0; i < kRuntimeRecords; ++i) {
+        json::Value entry = json::Value::object();
+        entry["abi"] = json::Value("arm64");
+        entry["pid"] = json::Value(1000 + i);
+        entry["process"] = json::Value("com.example.app" + std::to_string(i));
+        entry["state"] = json::Value("injected");
+        entry["target"] = json::Value("com.example.app" + std::to_string(i));
+        root["runtime"].push_back(entry);
+    }
+    root["safe_mode"] = json::Value(false);
+    return root;
+}
+
+void write_config(json::Writer* writer) {
+    writer->begin_object();
+    for (int i = 0; i < kConfigEntries; ++i) {
+        writer->key("option_" + std::to_string(100 + i))
+            .begin_object()
+            .member("enabled", i % 2 == 0)
+            .member("label", "Option \"" + std::to_string(i) + "\"\tsettings")
+            .member("level", i)
+            .end_object();
+    }
+    writer->end_object();
+}
+
+json::Value build_config() {
+    json::Value root = json::Value::object();
+    for (int i = 0; i < kConfigEntries; ++i) {
+        json::Value entry = json::Value::object();
+        entry["enabled"] = json::Value(i % 2 == 0);
+        entry["label"] = json::Value("Option \"" + std::to_string(i) + "\"\tsettings");
+        entry["level"] = json::Value(i);
+        root["option_" + std::to_string(100 + i)] = entry;
+    }
+    return root;
+}
+
+void write_modules(json::Writer* writer) {
+    writer->begin_array();
+    for (int i = 0; i < kModules; ++i) {
+        writer->begin_object()
+            .member("author", "someone")
+            .member("description", "Module number " + std::to_string(i) + " does things\n")
+            .member("enabled", "true")
+            .member("id", "module_" + std::to_string(i))
+            .member("version", "v1.0." + std::to_string(i))
+            .end_object();
+    }
+    writer->end_array();
+}
+
+json::Value build_modules() {
+    json::Value root = json::Value::array();
+    for (int i = 0; i < kModules; ++i) {
+        json::Value entry = json::Value::object();
+        entry["author"] = json::Value("someone");
+        entry["description"] = json::Value("Module number " + std::to_string(i) + " does things\n");
+        entry["enabled"] = json::Value("true");
+        entry["id"] = json::Value("module_" + std::to_string(i));
+        entry["version"] = json::Value("v1.0." + std::to_string(i));
+        root.push_back(entry);
+    }
+    return root;
+}
+
+// SAX handler that only counts, standing in for a consumer that reads fields
+// as they stream past
+struct CountingHandler {
+    size_t values = 0;
+    size_t bytes = 0;
+
+    bool null() { return ++values != 0; }
+    bool boolean(bool) { return ++values != 0; }
+    bool integer(int64_t) { return ++values != 0; }
+    bool number(double) { return ++values != 0; }
+    bool string(std::string_view value) {
+        bytes += value.size();
+        return ++values != 0;
+    }
+    bool key(std::string_view name) {
+        bytes += name.size();
+        return true;
+    }
+    bool begin_object() { return ++values != 0; }
+    bool end_object() { return true; }
+    bool begin_array() { return ++values != 0; }
+    bool end_array() { return true; }
+    const char* failure() const { return "rejected"; }
+};
+
+double elapsed_us(Clock::time_point start, long iterations) {
+    const std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count() / static_cast<double>(iterations);
+}
+
+bool verify(const Payload& payload) {
+    std::string streamed;
+    json::Writer writer(&streamed, payload.indent);
+    payload.write(&writer);
+    if (!writer.ok() || streamed != json::dump(payload.build(), payload.indent)) {
+        (void)fprintf(stderr, "json_bench: %s: writer and DOM output differ\n", payload.name);
+        return false;
+    }
+    std::string error;
+    const std::optional<json::Value> parsed = json::try_parse(streamed, &error);
+    if (!parsed || json::dump(*parsed, payload.indent) != streamed) {
+        (void)fprintf(stderr, "json_bench: %s: round trip failed: %s\n", payload.name,
+                      error.c_str());
+        return false;
+    }
+    CountingHandler handler;
+    json::Reader<CountingHandler> reader(streamed, &handler);
+    if (!reader.parse()) {
+        (void)fprintf(stderr, "json_bench: %s: reader failed: %s\n", payload.name,
+                      reader.error().c_str());
+        return false;
+    }
+    return true;
+}
+
+void run(const Payload& payload, long iterations) {
+    std::string text;
+    size_t sink = 0;
+
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        text = json::dump(payload.build(), payload.indent);
+        sink += text.size();
+    }
+    const double dom_encode = elapsed_us(start, iterations);
+
+    start = Clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        text.clear();
+        json::Writer writer(&text, payload.indent);
+        payload.write(&writer);
+        sink += text.size();
+    }
+    const double stream_encode = elapsed_us(start, iterations);
+
+    start = Clock::now();
+    for (long i = 0; i < iterations; ++i)
+        sink += json::try_parse(text).has_value() ? 1 : 0;
+    const double dom_decode = elapsed_us(start, iterations);
+
+    start = Clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        CountingHandler handler;
+        json::Reader<CountingHandler> reader(text, &handler);
+        sink += reader.parse() ? handler.values : 0;
+    }
+    const double stream_decode = elapsed_us(start, iterations);
+
+    (void)printf("%-8s %6zu bytes  encode %8.2f -> %8.2f us  decode %8.2f -> %8.2f us  (%zu)\n",
+                 payload.name, text.size(), dom_encode, stream_encode, dom_decode, stream_decode,
+                 sink % 10);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    long iterations = 1000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt == 'n') {
+            iterations = strtol(optarg, nullptr, 10);
+        } else {
+            (void)fprintf(stderr, "usage: %s [-n iterations]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations <= 0)
+        iterations = 1;
+
+    const std::vector<Payload> payloads = {
+        {"status", -1, write_status, build_status},
+        {"config", 2, write_config, build_config},
+        {"modules", 2, write_modules, build_modules},
+    };
+    for (const Payload& payload : payloads) {
+        if (!verify(payload))
+            return 1;
+    }
+    (void)printf("DOM -> streaming, per iteration (%ld iterations)\n", iterations);
+    for (const Payload& payload : payloads)
+        run(payload, iterations);
+    return 0;
+}
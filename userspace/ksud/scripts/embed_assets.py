@@ -1,13 +1,24 @@
 #!/usr/bin/env python3
 """
 Generate C++ source file containing embedded binary assets.
-Compresses binaries with zlib for efficient storage.
+Compresses binaries with zlib (default, smallest) or LZ4 (fastest to extract)
+and records the SHA-256 of every asset so ksud can skip unchanged extractions.
 """
 
+import hashlib
+import struct
 import sys
 import zlib
 from pathlib import Path
 
+# LZ4 assets are split into independently compressed blocks of this size so
+# the extractor can stream them into the destination with a bounded buffer.
+# Keep in sync with kLz4BlockSize in src/core/assets.cpp.
+LZ4_BLOCK_SIZE = 256 * 1024
+LZ4_STORED_FLAG = 0x80000000
+
+CODECS = ('zlib', 'lz4', 'lz4hc')
+
 
 def to_c_identifier(name: str) -> str:
     """Convert filename to valid C identifier."""
@@ -27,7 +38,87 @@ def normalize_asset_data(filepath: Path, data: bytes) -> bytes:
     return data
 
 
-def generate_asset_array(filepath: Path) -> tuple[str, str, int, int]:
+def lz4_block_compress_fallback(data: bytes) -> bytes:
+    """Greedy LZ4 block compressor used when the lz4 module is unavailable."""
+    n = len(data)
+    out = bytearray()
+
+    def emit(literals: bytes, offset: int = 0, match_length: int = 0):
+        lit_len = len(literals)
+        ml = match_length - 4 if match_length else 0
+        out.append((min(lit_len, 15) << 4) | min(ml, 15))
+        if lit_len >= 15:
+            rest = lit_len - 15
+            while rest >= 255:
+                out.append(255)
+                rest -= 255
+            out.append(rest)
+        out.extend(literals)
+        if not match_length:
+            return
+        out.extend(struct.pack('<H', offset))
+        if ml >= 15:
+            rest = ml - 15
+            while rest >= 255:
+                out.append(255)
+                rest -= 255
+            out.append(rest)
+
+    # LZ4 requires the last 5 bytes to be literals and no match to start in
+    # the last 12 bytes of a block.
+    match_limit = n - 12
+    match_end_limit = n - 5
+    table = {}
+    anchor = 0
+    i = 0
+    while i < match_limit:
+        key = data[i:i + 4]
+        candidate = table.get(key)
+        table[key] = i
+        if candidate is None or i - candidate > 0xFFFF:
+            i += 1
+            continue
+        length = 4
+        while (i + length + 32 <= match_end_limit and
+               data[candidate + length:candidate + length + 32] ==
+               data[i + length:i + length + 32]):
+            length += 32
+        while i + length < match_end_limit and data[candidate + length] == data[i + length]:
+            length += 1
+        emit(data[anchor:i], i - candidate, length)
+        i += length
+        anchor = i
+    emit(data[anchor:])
+    return bytes(out)
+
+
+def lz4_compress(data: bytes, high_compression: bool) -> bytes:
+    """Compress into the chunked LZ4 container read by ksud."""
+    try:
+        import lz4.block  # type: ignore
+
+        def compress_block(block: bytes) -> bytes:
+            if high_compression:
+                return lz4.block.compress(block, mode='high_compression', compression=12,
+                                          store_size=False)
+            return lz4.block.compress(block, store_size=False)
+    except ImportError:
+        compress_block = lz4_block_compress_fallback
+
+    out = bytearray()
+    for start in range(0, len(data), LZ4_BLOCK_SIZE):
+        block = data[start:start + LZ4_BLOCK_SIZE]
+        compressed = compress_block(block)
+        if len(compressed) >= len(block):
+            out.extend(struct.pack('<II', len(block) | LZ4_STORED_FLAG, len(block)))
+            out.extend(block)
+        else:
+            out.extend(struct.pack('<II', len(compressed), len(block)))
+            out.extend(compressed)
+    return bytes(out)
+
+
+def generate_asset_array(filepath: Path, codec: str) -> tuple[str, str, int, int, str]:
     """Generate C array for a single file."""
     name = to_c_identifier(filepath.name)
 
@@ -35,22 +126,27 @@ def generate_asset_array(filepath: Path) -> tuple[str, str, int, int]:
         data = normalize_asset_data(filepath, f.read())
 
     original_size = len(data)
-    compressed_data = zlib.compress(data, level=9)
+    if codec == 'zlib':
+        compressed_data = zlib.compress(data, level=9)
+    else:
+        compressed_data = lz4_compress(data, codec == 'lz4hc')
     compressed_size = len(compressed_data)
 
     # Generate hex array
     hex_data = ', '.join(f'0x{b:02x}' for b in compressed_data)
 
-    return name, hex_data, compressed_size, original_size
+    return name, hex_data, compressed_size, original_size, hashlib.sha256(data).hexdigest()
 
 
 def main():
-    if len(sys.argv) < 3:
-        print(f"Usage: {sys.argv[0]} <assets_dir> <output.cpp>")
+    if len(sys.argv) < 3 or (len(sys.argv) > 3 and sys.argv[3] not in CODECS):
+        print(f"Usage: {sys.argv[0]} <assets_dir> <output.cpp> [{'|'.join(CODECS)}]")
         sys.exit(1)
     
     assets_dir = Path(sys.argv[1])
     output_file = Path(sys.argv[2])
+    codec = sys.argv[3] if len(sys.argv) > 3 else 'zlib'
+    codec_enum = 'AssetCodec::Zlib' if codec == 'zlib' else 'AssetCodec::Lz4'
     
     # Collect all files in assets directory
     assets = []
@@ -69,12 +165,12 @@ def main():
 #include "log.hpp"
 #include <array>
 #include <cstring>
-#include <map>
+#include <string_view>
 #include <sys/stat.h>
 #include <cerrno>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
-#include <zlib.h>
 
 namespace ksud {
 
@@ -83,7 +179,7 @@ namespace ksud {
     # Generate arrays for each asset
     asset_infos = []
     for filepath in assets:
-        name, hex_data, size, original_size = generate_asset_array(filepath)
+        name, hex_data, size, original_size, sha256 = generate_asset_array(filepath, codec)
         output += f'// Asset: {filepath.name}\n'
         output += f'static const unsigned char asset_{name}[] = {{\n'
         
@@ -96,25 +192,19 @@ namespace ksud {
         output += f'static const size_t asset_{name}_size = {size};\n'
         output += f'static const size_t asset_{name}_original_size = {original_size};\n\n'
         
-        asset_infos.append((filepath.name, name, size, original_size))
+        asset_infos.append((filepath.name, name, size, original_size, sha256))
     
     # Generate asset registry (std::array for clang-tidy)
     n_entries = len(asset_infos) + 1  # +1 for sentinel
     output += '''
-struct AssetEntry {
-    const char* name;
-    const unsigned char* data;
-    size_t size;
-    size_t original_size;
-};
-
 static const std::array<AssetEntry, ''' + str(n_entries) + '''> asset_registry = {{
 '''
     
-    for filename, name, size, original_size in asset_infos:
-        output += f'    {{"{filename}", asset_{name}, asset_{name}_size, asset_{name}_original_size}},\n'
+    for filename, name, size, original_size, sha256 in asset_infos:
+        output += (f'    {{"{filename}", asset_{name}, asset_{name}_size, '
+                   f'asset_{name}_original_size, {codec_enum}, "{sha256}"}},\n')
     
-    output += '''    {nullptr, nullptr, 0, 0}  // sentinel
+    output += '''    {nullptr, nullptr, 0, 0, AssetCodec::Zlib, nullptr}  // sentinel
 }};
 
 const std::vector<std::string>& list_assets() {
@@ -130,55 +220,26 @@ const std::vector<std::string>& list_assets() {
     return names;
 }
 
-bool get_asset(const std::string& name, const uint8_t*& data, size_t& size) {
-    for (const auto& entry : asset_registry) {
-        if (entry.name == nullptr) break;
-        if (name == entry.name) {
-            data = entry.data;
-            size = entry.size;
-            return true;
+const AssetEntry* find_asset(const std::string& name) {
+    static const auto index = [] {
+        std::unordered_map<std::string_view, const AssetEntry*> map;
+        for (const auto& entry : asset_registry) {
+            if (entry.name == nullptr) break;
+            map.emplace(entry.name, &entry);
         }
-    }
-    return false;
+        return map;
+    }();
+    const auto it = index.find(name);
+    return it == index.end() ? nullptr : it->second;
 }
 
-bool copy_asset_to_file(const std::string& name, const std::string& dest_path) {
-    const AssetEntry* entry = nullptr;
-    for (const auto& e : asset_registry) {
-        if (e.name == nullptr) break;
-        if (name == e.name) {
-            entry = &e;
-            break;
-        }
-    }
-    
-    if (!entry) {
-        LOGE("Asset not found: %s", name.c_str());
-        return false;
-    }
-    
-    // Remove existing file first
-    unlink(dest_path.c_str());
-    
-    // Decompress
-    std::vector<uint8_t> buffer(entry->original_size);
-    uLongf destLen = entry->original_size;
-    const int ret = uncompress(buffer.data(), &destLen, entry->data, entry->size);
-    if (ret != Z_OK) {
-        LOGE("Decompression failed for %s: %d", name.c_str(), ret);
-        return false;
-    }
-    
-    std::ofstream ofs(dest_path, std::ios::binary);
-    if (!ofs) {
-        LOGE("Failed to open file for writing: %s (errno=%d: %s)", dest_path.c_str(), errno, strerror(errno));
-        return false;
-    }
-    ofs.write(reinterpret_cast<const char*>(buffer.data()), destLen);
-    if (!ofs.good()) {
-        LOGE("Failed to write asset %s to %s", name.c_str(), dest_path.c_str());
+bool get_asset(const std::string& name, const uint8_t*& data, size_t& size) {
+    const AssetEntry* entry = find_asset(name);
+    if (entry == nullptr) {
         return false;
     }
+    data = entry->data;
+    size = entry->size;
     return true;
 }
 
@@ -217,10 +278,11 @@ int ensure_binaries(bool ignore_if_exist) {
         
         const std::string dest = std::string(BINARY_DIR) + name;
         
-        // Unconditionally overwrite so a stale binary from an older build is
-        // never left behind (copy_asset_to_file removes the dest first).
+        // The asset manifest compares the embedded hash with what is on disk,
+        // so a stale binary from an older build is still replaced while an
+        // up-to-date one is left alone.
         (void)ignore_if_exist;
-        if (!copy_asset_to_file(name, dest)) {
+        if (!sync_asset_to_file(name, dest)) {
             LOGE("Failed to extract binary: %s", name.c_str());
             return 1;
         }
@@ -268,8 +330,8 @@ int ensure_binaries(bool ignore_if_exist) {
     with open(output_file, 'w', newline='\n') as f:
         f.write(output)
     
-    print(f"Generated {output_file} with {len(assets)} assets")
-    for filename, name, size, original_size in asset_infos:
+    print(f"Generated {output_file} with {len(assets)} {codec} assets")
+    for filename, name, size, original_size, _ in asset_infos:
         print(f"  - {filename}: {size} bytes (original: {original_size})")
 
 if __name__ == '__main__':
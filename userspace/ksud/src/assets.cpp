@@ -7,11 +7,12 @@ namespace ksud {
 
 // Assets are now embedded at compile time by embed_assets.py
 // The generated assets_data.cpp contains:
+// - find_asset()
 // - list_assets()
 // - get_asset()
-// - copy_asset_to_file()
 // - list_supported_kmi()
 // - ensure_binaries()
+// Extraction (copy_asset_to_file, sync_asset_to_file) lives in core/assets.cpp.
 
 // This file is kept for any additional asset-related utilities
 
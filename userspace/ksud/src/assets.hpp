@@ -7,6 +7,23 @@
 
 namespace ksud {
 
+enum class AssetCodec : uint8_t {
+    Zlib,  // Single zlib stream
+    Lz4,   // Chunked LZ4 blocks, see embed_assets.py
+};
+
+struct AssetEntry {
+    const char* name;
+    const unsigned char* data;
+    size_t size;
+    size_t original_size;
+    AssetCodec codec;
+    const char* sha256;  // Hex SHA-256 of the uncompressed asset
+};
+
+// Look up an embedded asset by name, nullptr if it is not embedded
+const AssetEntry* find_asset(const std::string& name);
+
 // List all embedded asset names
 const std::vector<std::string>& list_assets();
 
@@ -16,6 +33,9 @@ bool get_asset(const std::string& name, const uint8_t*& data, size_t& size);
 // Copy asset to file
 bool copy_asset_to_file(const std::string& name, const std::string& dest_path);
 
+// Copy asset to file unless the asset manifest shows dest_path already holds it
+bool sync_asset_to_file(const std::string& name, const std::string& dest_path);
+
 // List supported KMI versions (extracted from embedded LKM names)
 std::vector<std::string> list_supported_kmi();
 
@@ -2,6 +2,7 @@
 #include "../assets.hpp"
 #include "../core/uts_view.hpp"
 #include "../defs.hpp"
+#include "../flash/block_io.hpp"
 #include "../log.hpp"
 #include "../utils.hpp"
 #include "lkm_image.hpp"
@@ -264,17 +265,7 @@ bool flash_boot(const std::string& bootdevice, const std::string& new_boot) {
 
 // Calculate SHA1 hash
 std::string calculate_sha1(const std::string& file_path) {
-    // Use sha1sum command
-    auto result = exec_command({"sha1sum", file_path});
-    if (result.exit_code != 0) {
-        return "";
-    }
-    // Output format: "hash  filename"
-    const size_t space = result.stdout_str.find(' ');
-    if (space != std::string::npos) {
-        return result.stdout_str.substr(0, space);
-    }
-    return trim(result.stdout_str);
+    return flash::hash_range(file_path, 0, flash::DigestKind::Sha1);
 }
 
 // Backup stock boot image
@@ -293,15 +284,10 @@ bool do_backup(const std::string& magiskboot, const std::string& workdir,
     const std::string target = std::string(KSU_BACKUP_DIR) + filename;
 
     // Copy image to backup location
-    std::ifstream src(image, std::ios::binary);
-    std::ofstream dst(target, std::ios::binary);
-    if (!src || !dst) {
+    if (!flash::copy_range(image, target, 0, flash::DigestKind::None).ok) {
         LOGE("Failed to backup boot image to %s", target.c_str());
         return false;
     }
-    dst << src.rdbuf();
-    src.close();
-    dst.close();
 
     // Write sha1 to workdir
     const std::string sha1_file = workdir + "/" + BACKUP_FILENAME;
@@ -1,4 +1,5 @@
 #include "tools.hpp"
+#include "../flash/block_io.hpp"
 #include "../log.hpp"
 #include "../utils.hpp"
 
@@ -32,6 +33,19 @@ std::string find_magiskboot(const std::string& specified_path, const std::string
 
 // DD command wrapper
 bool exec_dd(const std::string& input, const std::string& output) {
+    // Reflashing a boot partition usually changes only the kernel, so compare
+    // against what an existing block device already holds and skip equal blocks.
+    struct stat output_status{};
+    const bool to_block_device =
+        stat(output.c_str(), &output_status) == 0 && S_ISBLK(output_status.st_mode);
+    const auto copied = to_block_device
+                            ? flash::delta_copy_range(input, output, 0, flash::DigestKind::None)
+                            : flash::copy_range(input, output, 0, flash::DigestKind::None);
+    if (copied.ok) {
+        return true;
+    }
+    LOGW("Native copy %s -> %s failed, falling back to dd", input.c_str(), output.c_str());
+
     auto result = exec_command({"dd", "if=" + input, "of=" + output, "bs=4M", "conv=fsync"});
     if (result.exit_code == 0) {
         return true;
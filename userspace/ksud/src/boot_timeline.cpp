@@ -0,0 +1,242 @@
+#include "boot_timeline.hpp"
+#include "boot_timeline_report.hpp"
+#include "core/ksucalls.hpp"
+#include "defs.hpp"
+#include "log.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace ksud {
+
+namespace {
+
+using namespace boot_timeline;
+
+// Enough for a few hundred module scripts per stage; older spans are
+// overwritten past that and counted as dropped
+constexpr size_t kRingSize = 512;
+constexpr size_t kMaxDepth = 16;
+
+struct Recorder {
+    bool active = false;
+    pid_t pid = 0;
+    Record stage{};  // Kept outside the ring so the root always survives
+    Record ring[kRingSize]{};
+    uint32_t next_id = kStageId + 1;
+    uint32_t stack[kMaxDepth]{};
+    size_t depth = 0;
+};
+
+Recorder g_recorder;
+
+template <size_t N>
+void copy_field(char (&field)[N], std::string_view value) {
+    const size_t length = std::min(value.size(), N - 1);
+    memcpy(field, value.data(), length);
+    field[length] = '\0';
+}
+
+Record* slot_of(uint32_t id) {
+    Record& record = g_recorder.ring[(id - kStageId - 1) % kRingSize];
+    return record.id == id ? &record : nullptr;
+}
+
+Record* open_record(BootSpanKind kind, std::string_view name, std::string_view detail,
+                    uint64_t start_ns) {
+    const uint32_t id = g_recorder.next_id++;
+    Record& record = g_recorder.ring[(id - kStageId - 1) % kRingSize];
+    record = {};
+    record.start_ns = start_ns;
+    record.id = id;
+    record.parent = g_recorder.depth > 0 ? g_recorder.stack[g_recorder.depth - 1] : kStageId;
+    record.kind = static_cast<uint8_t>(kind);
+    copy_field(record.name, name);
+    copy_field(record.detail, detail);
+    return &record;
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    const auto* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+std::vector<char> build_chunk(int32_t pid, const std::vector<Record>& records, uint32_t dropped) {
+    ChunkHeader header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.record_size = sizeof(Record);
+    header.pid = pid;
+    header.count = static_cast<uint32_t>(records.size());
+    header.dropped = dropped;
+
+    std::vector<char> chunk(sizeof(header) + records.size() * sizeof(Record));
+    memcpy(chunk.data(), &header, sizeof(header));
+    if (!records.empty())
+        memcpy(chunk.data() + sizeof(header), records.data(), records.size() * sizeof(Record));
+    return chunk;
+}
+
+// Appended in one write so concurrent stages never interleave records
+bool append_chunk(const std::vector<char>& chunk) {
+    const int fd =
+        open(BOOT_TIMELINE_PENDING_PATH, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return false;
+    const bool ok = write_all(fd, chunk.data(), chunk.size());
+    close(fd);
+    return ok;
+}
+
+std::vector<Record> collect_stage(uint64_t end_ns, uint32_t* dropped) {
+    std::vector<Record> records;
+    g_recorder.stage.end_ns = end_ns;
+    records.push_back(g_recorder.stage);
+
+    const uint32_t recorded = g_recorder.next_id - kStageId - 1;
+    const uint32_t kept = std::min<uint32_t>(recorded, kRingSize);
+    *dropped = recorded - kept;
+    for (uint32_t id = g_recorder.next_id - kept; id < g_recorder.next_id; ++id) {
+        Record record = *slot_of(id);
+        if (record.end_ns == 0) {
+            record.end_ns = end_ns;
+            record.flags |= kFlagOpen;
+        }
+        records.push_back(record);
+    }
+    return records;
+}
+
+std::vector<Record> collect_kernel() {
+    std::vector<Record> records;
+    ksu_get_boot_stamps_cmd stamps{};
+    if (!get_boot_stamps(&stamps))
+        return records;
+
+    const auto add = [&](const char* name, int start, int end) {
+        if (stamps.ns[start] == 0)
+            return;
+        Record record{};
+        record.start_ns = stamps.ns[start];
+        record.end_ns = end >= 0 && stamps.ns[end] >= stamps.ns[start] ? stamps.ns[end]
+                                                                         : stamps.ns[start];
+        record.id = static_cast<uint32_t>(records.size() + 1);
+        record.kind = static_cast<uint8_t>(BootSpanKind::Kernel);
+        copy_field(record.name, name);
+        records.push_back(record);
+    };
+    add("module-init", KSU_BOOT_STAMP_MODULE_INIT, -1);
+    add("init-second-stage", KSU_BOOT_STAMP_SECOND_STAGE, -1);
+    add("init.rc-inject", KSU_BOOT_STAMP_INIT_RC_READ, KSU_BOOT_STAMP_INIT_RC_APPENDED);
+    add("post-fs-data", KSU_BOOT_STAMP_POST_FS_DATA, KSU_BOOT_STAMP_POST_FS_DATA_DONE);
+    add("boot-completed", KSU_BOOT_STAMP_BOOT_COMPLETED, -1);
+    return records;
+}
+
+}  // namespace
+
+uint64_t boot_timeline_now() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+BootStageScope::BootStageScope(const char* stage, BootStagePhase phase) : phase_(phase) {
+    if (phase == BootStagePhase::First && unlink(BOOT_TIMELINE_PENDING_PATH) != 0 &&
+        errno != ENOENT) {
+        LOGW("boot timeline: cannot reset pending timeline: %s", strerror(errno));
+    }
+
+    g_recorder.stage = {};
+    g_recorder.stage.start_ns = boot_timeline_now();
+    g_recorder.stage.id = kStageId;
+    g_recorder.stage.kind = static_cast<uint8_t>(BootSpanKind::Stage);
+    copy_field(g_recorder.stage.name, stage);
+    g_recorder.next_id = kStageId + 1;
+    g_recorder.stack[0] = kStageId;
+    g_recorder.depth = 1;
+    g_recorder.pid = getpid();
+    g_recorder.active = true;
+}
+
+BootStageScope::~BootStageScope() {
+    // Forked children that unwind through here must not flush the parent's ring
+    if (!g_recorder.active || g_recorder.pid != getpid())
+        return;
+    g_recorder.active = false;
+
+    // The Last stage already renamed the pending file: this chunk starts a
+    // new pending timeline that no stage will publish
+    if (phase_ == BootStagePhase::Middle && access(BOOT_TIMELINE_PENDING_PATH, F_OK) != 0 &&
+        access(BOOT_TIMELINE_PATH, F_OK) == 0) {
+        LOGW("boot timeline: %s finished after the timeline was published, left in %s",
+             g_recorder.stage.name, BOOT_TIMELINE_PENDING_PATH);
+    }
+
+    uint32_t dropped = 0;
+    const std::vector<Record> records = collect_stage(boot_timeline_now(), &dropped);
+    if (!append_chunk(build_chunk(g_recorder.pid, records, dropped))) {
+        LOGW("boot timeline: cannot write %s: %s", BOOT_TIMELINE_PENDING_PATH, strerror(errno));
+        return;
+    }
+    if (phase_ != BootStagePhase::Last)
+        return;
+
+    const std::vector<Record> kernel = collect_kernel();
+    if (!kernel.empty() && !append_chunk(build_chunk(0, kernel, 0)))
+        LOGW("boot timeline: cannot record kernel milestones");
+    if (rename(BOOT_TIMELINE_PENDING_PATH, BOOT_TIMELINE_PATH) != 0)
+        LOGW("boot timeline: cannot publish %s: %s", BOOT_TIMELINE_PATH, strerror(errno));
+}
+
+BootSpan::BootSpan(BootSpanKind kind, std::string_view name, std::string_view detail) {
+    if (!g_recorder.active)
+        return;
+    Record* record = open_record(kind, name, detail, boot_timeline_now());
+    id_ = record->id;
+    if (g_recorder.depth < kMaxDepth)
+        g_recorder.stack[g_recorder.depth++] = id_;
+}
+
+BootSpan::~BootSpan() {
+    if (id_ == 0 || !g_recorder.active)
+        return;
+    Record* record = slot_of(id_);
+    if (record != nullptr)
+        record->end_ns = boot_timeline_now();
+    if (g_recorder.depth > 1 && g_recorder.stack[g_recorder.depth - 1] == id_)
+        --g_recorder.depth;
+}
+
+void BootSpan::set_async() {
+    if (id_ == 0 || !g_recorder.active)
+        return;
+    Record* record = slot_of(id_);
+    if (record != nullptr)
+        record->flags |= kFlagAsync;
+}
+
+void boot_timeline_record(BootSpanKind kind, std::string_view name, std::string_view detail,
+                          uint64_t start_ns, uint64_t end_ns) {
+    if (!g_recorder.active)
+        return;
+    Record* record = open_record(kind, name, detail, start_ns);
+    record->end_ns = std::max(start_ns, end_ns);
+}
+
+}  // namespace ksud
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ksud {
+
+enum class BootSpanKind : uint8_t {
+    Stage = 1,  // post-fs-data, services, boot-completed
+    Step,       // A group of work inside a stage
+    Module,     // One module's script or rule file
+    Script,     // A common *.d script
+    Plugin,     // One plugin's stage callback
+    Kernel,     // A kernel milestone (KSU_BOOT_STAMP_*)
+};
+
+enum class BootStagePhase : uint8_t {
+    First,  // Starts a new boot's timeline
+    Middle,
+    Last,   // Publishes the boot's timeline
+};
+
+// CLOCK_BOOTTIME in nanoseconds, the clock the kernel stamps use
+uint64_t boot_timeline_now();
+
+/**
+ * Record spans for one boot stage in this process until the scope ends
+ *
+ * Each stage runs in its own ksud process, so spans go into a fixed in-memory
+ * ring that is appended to the pending timeline when the scope ends. The Last
+ * stage then adds the kernel's milestones and publishes the pending timeline
+ * as BOOT_TIMELINE_PATH. Outside a stage scope every span is a no-op.
+ */
+class BootStageScope {
+public:
+    BootStageScope(const char* stage, BootStagePhase phase);
+    BootStageScope(const BootStageScope&) = delete;
+    BootStageScope& operator=(const BootStageScope&) = delete;
+    BootStageScope(BootStageScope&&) = delete;
+    BootStageScope& operator=(BootStageScope&&) = delete;
+    ~BootStageScope();
+
+private:
+    BootStagePhase phase_;
+};
+
+/**
+ * A timed span nested under the innermost open span of the current stage
+ */
+class BootSpan {
+public:
+    BootSpan(BootSpanKind kind, std::string_view name, std::string_view detail = {});
+    BootSpan(const BootSpan&) = delete;
+    BootSpan& operator=(const BootSpan&) = delete;
+    BootSpan(BootSpan&&) = delete;
+    BootSpan& operator=(BootSpan&&) = delete;
+    ~BootSpan();
+
+    // The work was spawned without waiting; only its start is meaningful
+    void set_async();
+
+private:
+    uint32_t id_ = 0;
+};
+
+// Record a finished span measured elsewhere, e.g. a worker reaped out of order
+void boot_timeline_record(BootSpanKind kind, std::string_view name, std::string_view detail,
+                          uint64_t start_ns, uint64_t end_ns);
+
+// Render a recorded timeline; an empty path picks the last published one
+int boot_timeline_show(const std::string& path);
+
+}  // namespace ksud
@@ -0,0 +1,294 @@
+#include "boot_timeline_report.hpp"
+#include "boot_timeline.hpp"
+#include "defs.hpp"
+#include "log.hpp"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ksud {
+
+namespace boot_timeline {
+
+namespace {
+
+const char* kind_name(uint8_t kind) {
+    switch (static_cast<BootSpanKind>(kind)) {
+    case BootSpanKind::Stage:
+        return "stage";
+    case BootSpanKind::Step:
+        return "step";
+    case BootSpanKind::Module:
+        return "module";
+    case BootSpanKind::Script:
+        return "script";
+    case BootSpanKind::Plugin:
+        return "plugin";
+    case BootSpanKind::Kernel:
+        return "kernel";
+    }
+    return "?";
+}
+
+double to_seconds(uint64_t ns) {
+    return static_cast<double>(ns) / 1e9;
+}
+
+double to_ms(uint64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+uint64_t duration(const Record& record) {
+    return record.end_ns > record.start_ns ? record.end_ns - record.start_ns : 0;
+}
+
+std::string label(const Record& record) {
+    std::string text = record.name;
+    if (record.detail[0] != '\0') {
+        text += ' ';
+        text += record.detail;
+    }
+    return text;
+}
+
+}  // namespace
+
+bool parse_timeline(const std::string& path, std::vector<Chunk>* chunks) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs)
+        return false;
+    const std::vector<char> data{std::istreambuf_iterator<char>(ifs),
+                                 std::istreambuf_iterator<char>()};
+
+    size_t offset = 0;
+    while (data.size() - offset >= sizeof(ChunkHeader)) {
+        ChunkHeader header{};
+        memcpy(&header, data.data() + offset, sizeof(header));
+        if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+            header.version != kFormatVersion || header.record_size != sizeof(Record)) {
+            LOGW("boot timeline: unknown chunk at offset %zu", offset);
+            break;
+        }
+        offset += sizeof(header);
+        if (header.count > (data.size() - offset) / sizeof(Record)) {
+            LOGW("boot timeline: truncated chunk at offset %zu", offset);
+            break;
+        }
+
+        Chunk chunk;
+        chunk.pid = header.pid;
+        chunk.dropped = header.dropped;
+        chunk.records.resize(header.count);
+        if (header.count != 0)
+            memcpy(chunk.records.data(), data.data() + offset, header.count * sizeof(Record));
+        for (Record& record : chunk.records) {
+            record.name[sizeof(record.name) - 1] = '\0';
+            record.detail[sizeof(record.detail) - 1] = '\0';
+        }
+        offset += header.count * sizeof(Record);
+        chunks->push_back(std::move(chunk));
+    }
+    return true;
+}
+
+// Children of each span in start order; spans whose parent was dropped from
+// the ring hang off the stage
+SpanTree build_tree(const Chunk& chunk) {
+    std::map<uint32_t, const Record*> by_id;
+    for (const Record& record : chunk.records)
+        by_id[record.id] = &record;
+
+    SpanTree children;
+    for (const Record& record : chunk.records) {
+        if (record.id == kStageId)
+            continue;
+        const uint32_t parent = by_id.count(record.parent) != 0 ? record.parent : kStageId;
+        children[parent].push_back(&record);
+    }
+    for (auto& [id, list] : children) {
+        (void)id;
+        std::stable_sort(list.begin(), list.end(), [](const Record* a, const Record* b) {
+            return a->start_ns < b->start_ns;
+        });
+    }
+    return children;
+}
+
+/*
+ * Walk back from the end of a span: the child that finished last held the
+ * span open, and before that child started, the one that finished last before
+ * it, and so on. For serial work this picks every child; for parallel plugin
+ * workers it picks the chain that bounded the stage.
+ */
+bool print_critical_path(const SpanTree& children, const Record& span, int depth) {
+    const auto found = children.find(span.id);
+    if (found == children.end())
+        return false;
+
+    std::vector<const Record*> path;
+    uint64_t cursor = span.end_ns;
+    while (true) {
+        const Record* best = nullptr;
+        for (const Record* child : found->second) {
+            if ((child->flags & kFlagAsync) != 0 || child->end_ns > cursor ||
+                child->start_ns >= cursor)
+                continue;
+            if (best == nullptr || child->end_ns > best->end_ns)
+                best = child;
+        }
+        if (best == nullptr)
+            break;
+        path.push_back(best);
+        cursor = best->start_ns;
+    }
+
+    bool printed = false;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        const Record& record = **it;
+        if (duration(record) == 0)
+            continue;
+        printf("  %*s%9.1f ms  %-6s  %s\n", depth * 2, "", to_ms(duration(record)),
+               kind_name(record.kind), label(record).c_str());
+        (void)print_critical_path(children, record, depth + 1);
+        printed = true;
+    }
+    return printed;
+}
+
+namespace {
+
+void print_tree(const SpanTree& children, uint32_t id, int depth) {
+    const auto found = children.find(id);
+    if (found == children.end())
+        return;
+    for (const Record* record : found->second) {
+        char took[32];
+        if ((record->flags & kFlagAsync) != 0)
+            (void)snprintf(took, sizeof(took), "spawned");
+        else
+            (void)snprintf(took, sizeof(took), "%.1f ms%s", to_ms(duration(*record)),
+                           (record->flags & kFlagOpen) != 0 ? "+" : "");
+        printf("  %10.3f  %12s  %*s%-6s  %s\n", to_seconds(record->start_ns), took, depth * 2, "",
+               kind_name(record->kind), label(*record).c_str());
+        print_tree(children, record->id, depth + 1);
+    }
+}
+
+struct ModuleCost {
+    uint64_t blocking_ns = 0;
+    unsigned runs = 0;
+    unsigned spawned = 0;
+    uint8_t kind = 0;
+};
+
+void print_modules(const std::vector<Chunk>& chunks) {
+    std::map<std::string, ModuleCost> costs;
+    for (const Chunk& chunk : chunks) {
+        for (const Record& record : chunk.records) {
+            const auto kind = static_cast<BootSpanKind>(record.kind);
+            if (kind != BootSpanKind::Module && kind != BootSpanKind::Plugin &&
+                kind != BootSpanKind::Script)
+                continue;
+            ModuleCost& cost = costs[record.name];
+            cost.kind = record.kind;
+            if ((record.flags & kFlagAsync) != 0) {
+                ++cost.spawned;
+            } else {
+                ++cost.runs;
+                cost.blocking_ns += duration(record);
+            }
+        }
+    }
+    if (costs.empty())
+        return;
+
+    std::vector<std::pair<std::string, ModuleCost>> sorted(costs.begin(), costs.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.second.blocking_ns > b.second.blocking_ns;
+    });
+    printf("\nModules, plugins and scripts (blocking time, slowest first):\n");
+    for (const auto& [name, cost] : sorted) {
+        printf("  %10.1f ms  %-6s  %s  (%u run%s, %u spawned)\n", to_ms(cost.blocking_ns),
+               kind_name(cost.kind), name.c_str(), cost.runs, cost.runs == 1 ? "" : "s",
+               cost.spawned);
+    }
+}
+
+}  // namespace
+
+}  // namespace boot_timeline
+
+int boot_timeline_show(const std::string& path) {
+    using namespace boot_timeline;
+
+
+    std::string source = path;
+    if (source.empty())
+        source = access(BOOT_TIMELINE_PATH, R_OK) == 0 ? BOOT_TIMELINE_PATH
+                                                         : BOOT_TIMELINE_PENDING_PATH;
+
+    std::vector<Chunk> chunks;
+    if (!parse_timeline(source, &chunks)) {
+        printf("No boot timeline at %s\n", source.c_str());
+        return 1;
+    }
+    if (chunks.empty()) {
+        printf("Boot timeline %s is empty\n", source.c_str());
+        return 1;
+    }
+
+    printf("Boot timeline: %s\n", source.c_str());
+    printf("Start times are seconds since boot (CLOCK_BOOTTIME)\n");
+
+    std::vector<const Chunk*> stages;
+    for (const Chunk& chunk : chunks) {
+        if (chunk.pid != 0) {
+            if (!chunk.records.empty() && chunk.records.front().id == kStageId)
+                stages.push_back(&chunk);
+            continue;
+        }
+        printf("\nKernel:\n");
+        for (const Record& record : chunk.records) {
+            if (duration(record) != 0)
+                printf("  %10.3f  %9.1f ms  %s\n", to_seconds(record.start_ns),
+                       to_ms(duration(record)), record.name);
+            else
+                printf("  %10.3f  %12s  %s\n", to_seconds(record.start_ns), "", record.name);
+        }
+    }
+    std::stable_sort(stages.begin(), stages.end(), [](const Chunk* a, const Chunk* b) {
+        return a->records.front().start_ns < b->records.front().start_ns;
+    });
+
+    printf("\nStages:\n");
+    for (const Chunk* chunk : stages) {
+        const Record& stage = chunk->records.front();
+        printf("  %10.3f  %9.1f ms  %-16s pid %d\n", to_seconds(stage.start_ns),
+               to_ms(duration(stage)), stage.name, chunk->pid);
+    }
+
+    for (const Chunk* chunk : stages) {
+        const Record& stage = chunk->records.front();
+        const auto children = build_tree(*chunk);
+        printf("\n%s (%.1f ms):\n", stage.name, to_ms(duration(stage)));
+        print_tree(children, kStageId, 0);
+        if (chunk->dropped != 0)
+            printf("  (%u earlier spans were dropped from the ring)\n", chunk->dropped);
+        printf("  critical path:\n");
+        if (!print_critical_path(children, stage, 1))
+            printf("    (nothing blocking)\n");
+    }
+
+    print_modules(chunks);
+    return 0;
+}
+
+}  // namespace ksud
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Boot timeline file format, shared by the recorder in boot_timeline.cpp and
+ * the reader that renders it for `ksud debug boot-timeline`
+ */
+namespace ksud::boot_timeline {
+
+// The file is a sequence of chunks, one per stage process plus one for the
+// kernel milestones: a ChunkHeader followed by `count` Records.
+constexpr char kMagic[4] = {'K', 'S', 'B', 'T'};
+constexpr uint16_t kFormatVersion = 1;
+
+constexpr uint8_t kFlagAsync = 1 << 0;
+constexpr uint8_t kFlagOpen = 1 << 1;  // Still running when the stage ended
+
+constexpr uint32_t kStageId = 1;
+
+struct ChunkHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    int32_t pid;  // 0 for the kernel chunk
+    uint32_t count;
+    uint32_t dropped;
+    uint32_t reserved;
+};
+static_assert(sizeof(ChunkHeader) == 24, "boot timeline chunk header layout");
+
+struct Record {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint32_t id;      // Unique within its chunk; the stage span is kStageId
+    uint32_t parent;  // 0 for roots
+    uint8_t kind;
+    uint8_t flags;
+    uint8_t reserved[6];
+    char name[40];
+    char detail[24];
+};
+static_assert(sizeof(Record) == 96, "boot timeline record layout");
+
+struct Chunk {
+    int32_t pid = 0;
+    uint32_t dropped = 0;
+    std::vector<Record> records;
+};
+
+// Children of each span id, in start order
+using SpanTree = std::map<uint32_t, std::vector<const Record*>>;
+
+/**
+ * Read the chunks of a timeline file up to the first unknown or truncated one
+ *
+ * @return false if the file cannot be opened
+ */
+bool parse_timeline(const std::string& path, std::vector<Chunk>* chunks);
+
+/**
+ * Index the spans of a stage chunk by parent
+ */
+SpanTree build_tree(const Chunk& chunk);
+
+/**
+ * Print the chain of children that kept span open, recursing into each
+ *
+ * @return false if no child blocked the span
+ */
+bool print_critical_path(const SpanTree& children, const Record& span, int depth);
+
+}  // namespace ksud::boot_timeline
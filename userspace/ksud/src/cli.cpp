@@ -8,6 +8,7 @@
 #include "core/ksucalls.hpp"
 #include "core/restorecon.hpp"
 #include "core/uts_view.hpp"
+#include "boot_timeline.hpp"
 #include "debug.hpp"
 #include "defs.hpp"
 #include "dynamic_manager.hpp"
@@ -24,6 +25,7 @@
 #include "plugin/plugin.hpp"
 #include "profile/profile.hpp"
 #include "sepolicy/sepolicy.hpp"
+#include "serve.hpp"
 #include "su.hpp"
 #include "sulog.hpp"
 #include "umount.hpp"
@@ -164,6 +166,7 @@ void print_usage() {
     printf("  initrc         Manage init.rc injection\n");
     printf("  sulogd         Run sulog reader daemon\n");
     printf("  msud           Run magisk-compat su prompt daemon\n");
+    printf("  serve          Run the command daemon the CLI forwards to\n");
     printf("  boot-patch     Patch boot image\n");
     printf("  boot-patch-v2  Patch boot.img with direct LKM injection (or flash boot with --flash)\n");
     printf("  boot-restore   Restore boot image\n");
@@ -322,6 +325,7 @@ int cmd_debug(const std::vector<std::string>& args) {
         printf("  version            Get kernel version\n");
         printf("  mark <get|mark|unmark|refresh> [PID]\n");
         printf("  sulogd             Launch sulog daemon now\n");
+        printf("  boot-timeline [FILE]  Show per-stage and per-module boot timings\n");
         return 1;
     }
 
@@ -342,6 +346,8 @@ int cmd_debug(const std::vector<std::string>& args) {
         return debug_mark(std::vector<std::string>(args.begin() + 1, args.end()));
     } else if (subcmd == "sulogd") {
         return ensure_sulogd_running();
+    } else if (subcmd == "boot-timeline") {
+        return boot_timeline_show(args.size() > 1 ? args[1] : "");
     }
 
     printf("Unknown debug subcommand: %s\n", subcmd.c_str());
@@ -617,6 +623,8 @@ int cmd_flash_new(const std::vector<std::string>& args) {
         printf("                             Default: current active slot\n");
         printf("  --use-mkbootfs             Let AK3 use ksud's built-in mkbootfs\n");
         printf("  --all                      List all partitions (not just common ones)\n");
+        printf("  --full                     Rewrite the whole partition instead of only\n");
+        printf("                             the blocks that differ from the image\n");
         printf("\nEXAMPLES:\n");
         printf("  ksud flash image boot.img boot\n");
         printf("  ksud flash ak3 kernel.zip --slot _b\n");
@@ -679,6 +687,7 @@ int cmd_flash_new(const std::vector<std::string>& args) {
     // Parse common options
     std::string target_slot;
     bool scan_all = false;
+    bool delta = true;
     std::vector<std::string> filtered_args;
 
     for (size_t i = 0; i < args.size(); ++i) {
@@ -690,6 +699,8 @@ int cmd_flash_new(const std::vector<std::string>& args) {
             }
         } else if (args[i] == "--all") {
             scan_all = true;
+        } else if (args[i] == "--full") {
+            delta = false;
         } else {
             filtered_args.push_back(args[i]);
         }
@@ -705,8 +716,11 @@ int cmd_flash_new(const std::vector<std::string>& args) {
         }
         printf("...\n");
 
-        if (ksud::flash::flash_partition(image_path, partition, target_slot)) {
-            printf("Flash successful!\n");
+        uint64_t bytes_written = 0;
+        if (ksud::flash::flash_partition(image_path, partition, target_slot, true, delta,
+                                         &bytes_written)) {
+            printf("Flash successful! (%llu bytes written)\n",
+                   static_cast<unsigned long long>(bytes_written));
             return 0;
         } else {
             printf("Flash failed!\n");
@@ -956,6 +970,11 @@ int cli_run(int argc, char** argv) {
         args.push_back(argv[i]);
     }
 
+    // Hand short commands to a running `ksud serve` when there is one
+    int served_exit_code = 0;
+    if (serve_forward(cmd, args, &served_exit_code))
+        return served_exit_code;
+
     const bool plugin_command = cmd == "plugin";
     const bool plugin_callback_command =
         plugin_command && !args.empty() && (args[0] == "action" || args[0] == "run");
@@ -965,7 +984,10 @@ int cli_run(int argc, char** argv) {
     if (plugin_command && !plugin_callback_command)
         log_set_stderr_enabled(true);
 
-    // Dispatch commands
+    return cli_dispatch(cmd, args);
+}
+
+int cli_dispatch(const std::string& cmd, const std::vector<std::string>& args) {
     if (cmd == "help" || cmd == "-h" || cmd == "--help") {
         print_usage();
         return 0;
@@ -1030,6 +1052,8 @@ int cli_run(int argc, char** argv) {
         return run_sulogd();
     } else if (cmd == "msud") {
         return run_msud();
+    } else if (cmd == "serve") {
+        return run_serve();
     } else if (cmd == "magisk-compat") {
         if (!args.empty() && args[0] == "apply") {
             return apply_magisk_compat_now();
@@ -10,6 +10,9 @@ namespace ksud {
 
 int cli_run(int argc, char** argv);
 
+// Run one ksud subcommand (argv[1] onwards) in this process
+int cli_dispatch(const std::string& cmd, const std::vector<std::string>& args);
+
 // Command handler type
 using CommandHandler = std::function<int(const std::vector<std::string>&)>;
 
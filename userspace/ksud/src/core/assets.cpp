@@ -1,16 +1,241 @@
 #include "../assets.hpp"
 #include "restorecon.hpp"
 
+#include <fcntl.h>
+#include <lz4.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <cerrno>
+#include <cstring>
 #include <filesystem>
+#include <map>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "../defs.hpp"
+#include "../flash/block_io.hpp"
 #include "../log.hpp"
 #include "../utils.hpp"
 
 namespace ksud {
 
+namespace {
+
+constexpr size_t kInflateBufferSize = size_t{256} * 1024;
+// Keep in sync with LZ4_BLOCK_SIZE / LZ4_STORED_FLAG in scripts/embed_assets.py.
+constexpr size_t kLz4BlockSize = size_t{256} * 1024;
+constexpr uint32_t kLz4StoredFlag = 0x80000000U;
+
+bool write_all(int fd, const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool inflate_to_fd(const AssetEntry& entry, int fd) {
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK)
+        return false;
+    std::vector<uint8_t> buffer(kInflateBufferSize);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast) zlib never writes next_in
+    stream.next_in = const_cast<Bytef*>(entry.data);
+    stream.avail_in = static_cast<uInt>(entry.size);
+    size_t total = 0;
+    int ret = Z_OK;
+    while (ret != Z_STREAM_END) {
+        stream.next_out = buffer.data();
+        stream.avail_out = static_cast<uInt>(buffer.size());
+        ret = inflate(&stream, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END)
+            break;
+        const size_t produced = buffer.size() - stream.avail_out;
+        if (!write_all(fd, buffer.data(), produced)) {
+            ret = Z_ERRNO;
+            break;
+        }
+        total += produced;
+        if (ret == Z_OK && produced == 0 && stream.avail_in == 0) {
+            ret = Z_DATA_ERROR;  // Truncated stream
+            break;
+        }
+    }
+    inflateEnd(&stream);
+    if (ret != Z_STREAM_END)
+        LOGE("Decompression failed for %s: %d", entry.name, ret);
+    return ret == Z_STREAM_END && total == entry.original_size;
+}
+
+bool lz4_to_fd(const AssetEntry& entry, int fd) {
+    std::vector<char> buffer(kLz4BlockSize);
+    size_t offset = 0;
+    size_t total = 0;
+    while (offset < entry.size) {
+        uint32_t packed_size = 0;
+        uint32_t raw_size = 0;
+        if (entry.size - offset < sizeof(packed_size) + sizeof(raw_size))
+            return false;
+        memcpy(&packed_size, entry.data + offset, sizeof(packed_size));
+        memcpy(&raw_size, entry.data + offset + sizeof(packed_size), sizeof(raw_size));
+        offset += sizeof(packed_size) + sizeof(raw_size);
+
+        const bool stored = (packed_size & kLz4StoredFlag) != 0;
+        const size_t block_size = packed_size & ~kLz4StoredFlag;
+        if (raw_size > kLz4BlockSize || block_size > entry.size - offset)
+            return false;
+        const char* block = reinterpret_cast<const char*>(entry.data + offset);
+        if (stored) {
+            if (block_size != raw_size || !write_all(fd, block, block_size))
+                return false;
+        } else {
+            const int decoded =
+                LZ4_decompress_safe(block, buffer.data(), static_cast<int>(block_size),
+                                    static_cast<int>(raw_size));
+            if (decoded != static_cast<int>(raw_size)) {
+                LOGE("Decompression failed for %s at offset %zu", entry.name, offset);
+                return false;
+            }
+            if (!write_all(fd, buffer.data(), raw_size))
+                return false;
+        }
+        offset += block_size;
+        total += raw_size;
+    }
+    return total == entry.original_size;
+}
+
+// Decode straight into a temporary file next to dest_path and rename it into
+// place, so nothing ever sees a half-written binary and a running executable
+// is replaced rather than rewritten (ETXTBSY).
+bool extract_asset(const AssetEntry& entry, const std::string& dest_path, struct stat* result) {
+    const std::string tmp_path = dest_path + ".tmp";
+    unlink(tmp_path.c_str());
+    const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("Failed to open file for writing: %s (errno=%d: %s)", tmp_path.c_str(), errno,
+             strerror(errno));
+        return false;
+    }
+    bool ok = entry.codec == AssetCodec::Lz4 ? lz4_to_fd(entry, fd) : inflate_to_fd(entry, fd);
+    if (ok && result != nullptr && fstat(fd, result) != 0)
+        ok = false;
+    if (close(fd) != 0)
+        ok = false;
+    if (ok && rename(tmp_path.c_str(), dest_path.c_str()) != 0) {
+        LOGE("Failed to move asset into %s: %s", dest_path.c_str(), strerror(errno));
+        ok = false;
+    }
+    if (!ok) {
+        LOGE("Failed to write asset %s to %s", entry.name, dest_path.c_str());
+        unlink(tmp_path.c_str());
+    }
+    return ok;
+}
+
+// On-disk record of what sync_asset_to_file() last wrote to each path. The
+// stat triple lets an unchanged file be trusted without reading it back.
+struct ManifestRecord {
+    std::string sha256;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    uint64_t ino = 0;
+};
+
+int64_t stat_mtime_ns(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+std::map<std::string, ManifestRecord>& asset_manifest() {
+    static std::map<std::string, ManifestRecord> records = [] {
+        std::map<std::string, ManifestRecord> loaded;
+        const auto content = read_file(ASSET_MANIFEST_PATH);
+        if (!content)
+            return loaded;
+        std::istringstream lines(*content);
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::istringstream fields(line);
+            std::string path;
+            ManifestRecord record;
+            if (std::getline(fields, path, '\t') &&
+                fields >> record.sha256 >> record.size >> record.mtime_ns >> record.ino) {
+                loaded[path] = record;
+            }
+        }
+        return loaded;
+    }();
+    return records;
+}
+
+void save_asset_manifest() {
+    std::string content;
+    for (const auto& [path, record] : asset_manifest()) {
+        content += path + "\t" + record.sha256 + " " + std::to_string(record.size) + " " +
+                   std::to_string(record.mtime_ns) + " " + std::to_string(record.ino) + "\n";
+    }
+    const std::string tmp_path = std::string(ASSET_MANIFEST_PATH) + ".tmp";
+    if (!write_file(tmp_path, content) || rename(tmp_path.c_str(), ASSET_MANIFEST_PATH) != 0) {
+        LOGW("Failed to update asset manifest: %s", strerror(errno));
+    }
+}
+
+void record_asset(const std::string& dest_path, const AssetEntry& entry, const struct stat& st) {
+    asset_manifest()[dest_path] = {entry.sha256, static_cast<uint64_t>(st.st_size),
+                                   stat_mtime_ns(st), static_cast<uint64_t>(st.st_ino)};
+    save_asset_manifest();
+}
+
+}  // namespace
+
+bool copy_asset_to_file(const std::string& name, const std::string& dest_path) {
+    const AssetEntry* entry = find_asset(name);
+    if (entry == nullptr) {
+        LOGE("Asset not found: %s", name.c_str());
+        return false;
+    }
+    return extract_asset(*entry, dest_path, nullptr);
+}
+
+bool sync_asset_to_file(const std::string& name, const std::string& dest_path) {
+    const AssetEntry* entry = find_asset(name);
+    if (entry == nullptr) {
+        LOGE("Asset not found: %s", name.c_str());
+        return false;
+    }
+
+    struct stat st{};
+    if (lstat(dest_path.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+        static_cast<uint64_t>(st.st_size) == entry->original_size) {
+        const auto& records = asset_manifest();
+        const auto it = records.find(dest_path);
+        if (it != records.end() && it->second.sha256 == entry->sha256 &&
+            it->second.mtime_ns == stat_mtime_ns(st) &&
+            it->second.ino == static_cast<uint64_t>(st.st_ino)) {
+            LOGD("Asset %s is up to date", dest_path.c_str());
+            return true;
+        }
+        // Not recorded, or touched since: hash it once before rewriting.
+        if (flash::hash_range(dest_path, 0, flash::DigestKind::Sha256) == entry->sha256) {
+            record_asset(dest_path, *entry, st);
+            return true;
+        }
+    }
+
+    if (!extract_asset(*entry, dest_path, &st))
+        return false;
+    record_asset(dest_path, *entry, st);
+    return true;
+}
+
 // Hand-written asset helpers.
 // Stage YukiZygisk payloads when embedded.
 int ensure_yukizygisk(bool ignore_if_exist) {
@@ -32,9 +257,7 @@ int ensure_yukizygisk(bool ignore_if_exist) {
     bool embedded = false;
     int result = 0;
     for (const auto& p : payload) {
-        const uint8_t* data = nullptr;
-        size_t size = 0;
-        if (get_asset(p.asset, data, size)) {
+        if (find_asset(p.asset) != nullptr) {
             embedded = true;
             break;
         }
@@ -49,16 +272,14 @@ int ensure_yukizygisk(bool ignore_if_exist) {
     }
 
     for (const auto& p : payload) {
-        const uint8_t* data = nullptr;
-        size_t size = 0;
-        if (!get_asset(p.asset, data, size)) {
+        if (find_asset(p.asset) == nullptr) {
             LOGE("yukizygisk: embedded payload missing: %s", p.asset);
             result = 1;
             continue;
         }
 
         (void)ignore_if_exist;
-        if (!copy_asset_to_file(p.asset, p.dest)) {
+        if (!sync_asset_to_file(p.asset, p.dest)) {
             LOGE("yukizygisk: failed to stage %s", p.dest);
             result = 1;
             continue;
@@ -8,6 +8,7 @@
 #include "../yukizygisk_snapshot.hpp"
 #include "ksucalls.hpp"
 
+#include <cerrno>
 #include <cinttypes>
 #include <cstdio>
 #include <cstring>
@@ -108,17 +109,54 @@ const char* feature_id_to_description(uint32_t id) {
     return "Unknown feature";
 }
 
+// Every known feature, read in one batch; entries the kernel lacks are absent
 std::map<uint32_t, uint64_t> get_current_feature_values() {
-    std::map<uint32_t, uint64_t> features;
+    std::vector<ksu_feature_batch_entry> entries;
+    entries.reserve(get_feature_map().size());
     for (const auto& [_, id] : get_feature_map()) {
-        auto [value, supported] = get_feature(id);
-        if (supported) {
-            features[id] = value;
+        entries.push_back({id, 0, 0});
+    }
+
+    std::map<uint32_t, uint64_t> features;
+    if (get_features(&entries) != 0) {
+        return features;
+    }
+    for (const auto& entry : entries) {
+        if (entry.status == 0) {
+            features[entry.feature_id] = entry.value;
         }
     }
     return features;
 }
 
+/**
+ * Write features, as one batch when every entry applies cleanly
+ * @return Per-feature status, 0 when the value is in effect
+ */
+std::map<uint32_t, int> set_feature_values(const std::map<uint32_t, uint64_t>& features) {
+    std::vector<ksu_feature_batch_entry> entries;
+    entries.reserve(features.size());
+    for (const auto& [id, value] : features) {
+        entries.push_back({id, 0, value});
+    }
+
+    // The batch is all-or-nothing; keep the best-effort behaviour of applying
+    // what we can when some entry is refused or fails.
+    if (!entries.empty() && set_features(&entries) != 0) {
+        for (auto& entry : entries) {
+            if (entry.status != 0) {
+                entry.status = set_feature(entry.feature_id, entry.value) < 0 ? -EIO : 0;
+            }
+        }
+    }
+
+    std::map<uint32_t, int> status;
+    for (const auto& entry : entries) {
+        status[entry.feature_id] = entry.status;
+    }
+    return status;
+}
+
 }  // namespace
 
 int feature_get(const std::string& id) {
@@ -177,11 +215,13 @@ void feature_list() {
     printf("Available Features:\n");
     printf("================================================================================\n");
 
+    const auto current = get_current_feature_values();
     for (const auto& [name, id] : get_feature_map()) {
-        auto [value, supported] = get_feature(id);
+        const auto it = current.find(id);
+        const uint64_t value = it != current.end() ? it->second : 0;
 
         const char* status;
-        if (!supported) {
+        if (it == current.end()) {
             status = "NOT_SUPPORTED";
         } else if (value != 0) {
             status = "ENABLED";
@@ -242,7 +282,6 @@ int feature_load_config() {
         if (valid) {
             uint64_t value = 0;
             if (parse_uint64(val, &value)) {
-                set_feature(feature_id, value);
                 loaded_features[feature_id] = value;
                 LOGI("Loaded feature %s = %" PRIu64, key.c_str(), value);
             } else {
@@ -251,6 +290,8 @@ int feature_load_config() {
         }
     }
 
+    set_feature_values(loaded_features);
+
     if (save_binary_config(loaded_features) != 0) {
         LOGW("Failed to sync loaded feature config to binary cache");
     }
@@ -363,9 +404,10 @@ int save_binary_config(const std::map<uint32_t, uint64_t>& features) {
 void apply_config(const std::map<uint32_t, uint64_t>& features) {
     LOGI("Applying feature configuration to kernel...");
 
+    const auto status = set_feature_values(features);
     int applied = 0;
     for (const auto& [id, value] : features) {
-        const int ret = set_feature(id, value);
+        const int ret = status.at(id);
         if (ret >= 0) {
             if (id == KSU_FEATURE_SULOG && value != 0 && ensure_sulogd_running() != 0) {
                 LOGW("Failed to ensure sulogd is running while applying config");
@@ -1,22 +1,33 @@
 /* SPDX-License-Identifier: GPL-3.0 */
 /*
- * Minimal self-contained JSON (value / parse / dump). Header-only and suitable
- * for small ksud and zygiskd configuration files.
+ * Self-contained JSON for ksud, its plugins and zygiskd. Header-only.
+ *
+ * Writer streams straight into a string under an optional byte budget, and
+ * Reader is a SAX parser that hands out views into the input (or into one
+ * reused scratch buffer for escaped strings), so neither needs a tree. Value
+ * is a small DOM built on Reader for the configuration files that want one.
  *
  * Author: Anatdx
  */
 #pragma once
 
-#include <cctype>
-#include <iomanip>
+#include <charconv>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
 #include <map>
-#include <sstream>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace json {
 
-enum class Type { Null, Bool, Number, String, Array, Object };
+enum class Type { Null, Bool, Integer, Number, String, Array, Object };
 
 struct Value;
 
@@ -26,6 +37,7 @@ using Object = std::map<std::string, Value>;
 struct Value {
     Type type = Type::Null;
     bool b = false;
+    int64_t i = 0;
     double n = 0;
     std::string s;
     Array a;
@@ -33,12 +45,16 @@ struct Value {
 
     Value() = default;
     Value(bool v) : type(Type::Bool), b(v) {}
-    Value(int v) : type(Type::Number), n(static_cast<double>(v)) {}
+    Value(int v) : type(Type::Integer), i(v) {}
+    Value(int64_t v) : type(Type::Integer), i(v) {}
     Value(double v) : type(Type::Number), n(v) {}
     Value(const char* v) : type(Type::String), s(v) {}
     Value(const std::string& v) : type(Type::String), s(v) {}
+    Value(std::string&& v) : type(Type::String), s(std::move(v)) {}
     Value(const Array& v) : type(Type::Array), a(v) {}
+    Value(Array&& v) : type(Type::Array), a(std::move(v)) {}
     Value(const Object& v) : type(Type::Object), o(v) {}
+    Value(Object&& v) : type(Type::Object), o(std::move(v)) {}
 
     static Value object() { return Value(Object{}); }
     static Value array() { return Value(Array{}); }
@@ -72,217 +88,745 @@ struct Value {
     }
 
     bool as_bool() const { return b; }
-    double as_number() const { return n; }
+    double as_number() const { return type == Type::Integer ? static_cast<double>(i) : n; }
     std::string as_string() const { return s; }
     const Array& as_array() const { return a; }
     const Object& as_object() const { return o; }
 };
 
-inline std::string escape_string(const std::string& s) {
-    std::ostringstream ss;
-    ss << '"';
-    for (char c : s) {
-        if (c == '"')
-            ss << "\\\"";
-        else if (c == '\\')
-            ss << "\\\\";
-        else if (c == '\b')
-            ss << "\\b";
-        else if (c == '\f')
-            ss << "\\f";
-        else if (c == '\n')
-            ss << "\\n";
-        else if (c == '\r')
-            ss << "\\r";
-        else if (c == '\t')
-            ss << "\\t";
-        else if ((unsigned char)c < 0x20)
-            ss << "\\u" << std::setfill('0') << std::setw(4) << std::hex << (int)(unsigned char)c;
-        else
-            ss << c;
+/**
+ * Length of the valid UTF-8 sequence starting at data[0], or 0
+ */
+inline size_t utf8_sequence_length(const unsigned char* data, size_t available) {
+    const unsigned char first = data[0];
+    if (first <= 0x7FU)
+        return 1;
+
+    size_t continuation_count = 0;
+    unsigned char second_minimum = 0x80U;
+    unsigned char second_maximum = 0xBFU;
+    if (first >= 0xC2U && first <= 0xDFU) {
+        continuation_count = 1;
+    } else if (first >= 0xE0U && first <= 0xEFU) {
+        continuation_count = 2;
+        if (first == 0xE0U)
+            second_minimum = 0xA0U;
+        else if (first == 0xEDU)
+            second_maximum = 0x9FU;
+    } else if (first >= 0xF0U && first <= 0xF4U) {
+        continuation_count = 3;
+        if (first == 0xF0U)
+            second_minimum = 0x90U;
+        else if (first == 0xF4U)
+            second_maximum = 0x8FU;
+    } else {
+        return 0;
+    }
+    if (available - 1 < continuation_count)
+        return 0;
+    if (data[1] < second_minimum || data[1] > second_maximum)
+        return 0;
+    for (size_t index = 2; index <= continuation_count; ++index) {
+        if ((data[index] & 0xC0U) != 0x80U)
+            return 0;
     }
-    ss << '"';
-    return ss.str();
+    return continuation_count + 1;
 }
 
-inline std::string dump(const Value& v, int indent = -1, int level = 0) {
-    switch (v.type) {
-    case Type::Null:
-        return "null";
-    case Type::Bool:
-        return v.b ? "true" : "false";
-    case Type::Number: {
-        std::string s = std::to_string(v.n);
-        s.erase(s.find_last_not_of('0') + 1, std::string::npos);
-        if (!s.empty() && s.back() == '.')
-            s.pop_back();
-        return s;
+inline bool is_valid_utf8(std::string_view value) {
+    const auto* data = reinterpret_cast<const unsigned char*>(value.data());
+    for (size_t index = 0; index < value.size();) {
+        const size_t length = utf8_sequence_length(data + index, value.size() - index);
+        if (length == 0)
+            return false;
+        index += length;
     }
-    case Type::String:
-        return escape_string(v.s);
-    case Type::Array: {
-        if (v.a.empty())
-            return "[]";
-        std::ostringstream ss;
-        ss << "[" << (indent >= 0 ? "\n" : "");
-        for (size_t i = 0; i < v.a.size(); ++i) {
-            if (indent >= 0)
-                ss << std::string((level + 1) * indent, ' ');
-            ss << dump(v.a[i], indent, level + 1);
-            if (i < v.a.size() - 1)
-                ss << "," << (indent >= 0 ? "\n" : " ");
+    return true;
+}
+
+/**
+ * Streaming JSON writer
+ *
+ * Appends to a caller-owned string as values are written. Commas are tracked
+ * per container, so callers only describe structure. Once the byte budget is
+ * exceeded (or a string fails UTF-8 validation) the writer stops appending
+ * and ok() turns false; the output is then incomplete and must be dropped.
+ *
+ * Layout matches the historical dump(): ", " between compact items, and with
+ * an indent one item per line with ": " after keys.
+ */
+class Writer {
+public:
+    explicit Writer(std::string* output, int indent = -1)
+        : out_(output), start_(output->size()), indent_(indent) {}
+
+    // Cap the bytes this writer may append
+    void set_budget(size_t bytes) { budget_ = bytes; }
+
+    // Reject strings and keys that are not valid UTF-8
+    void set_validate_utf8(bool validate) { validate_utf8_ = validate; }
+
+    bool ok() const { return error_ == nullptr; }
+    const char* error() const { return error_; }
+    size_t written() const { return out_->size() - start_; }
+
+    Writer& begin_object() { return open('{'); }
+    Writer& end_object() { return close('}'); }
+    Writer& begin_array() { return open('['); }
+    Writer& end_array() { return close(']'); }
+
+    Writer& key(std::string_view name) {
+        separate();
+        quoted(name);
+        if (indent_ >= 0)
+            put(": ", 2);
+        else
+            put(":", 1);
+        after_key_ = true;
+        return *this;
+    }
+
+    Writer& null() {
+        separate();
+        put("null", 4);
+        return *this;
+    }
+
+    Writer& boolean(bool value) {
+        separate();
+        if (value)
+            put("true", 4);
+        else
+            put("false", 5);
+        return *this;
+    }
+
+    Writer& integer(int64_t value) {
+        char buffer[24];
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        separate();
+        put(buffer, static_cast<size_t>(result.ptr - buffer));
+        return *this;
+    }
+
+    Writer& number(double value) {
+        if (!std::isfinite(value))
+            return null();
+        char buffer[32];
+        const int length = snprintf(buffer, sizeof(buffer), "%.*g",
+                                    std::numeric_limits<double>::max_digits10, value);
+        separate();
+        put(buffer, static_cast<size_t>(length));
+        return *this;
+    }
+
+    Writer& string(std::string_view value) {
+        separate();
+        quoted(value);
+        return *this;
+    }
+
+    // Convenience for "key": value members
+    Writer& member(std::string_view name, std::string_view value) { return key(name).string(value); }
+    Writer& member(std::string_view name, const char* value) {
+        return key(name).string(value);
+    }
+    Writer& member(std::string_view name, bool value) { return key(name).boolean(value); }
+    Writer& member(std::string_view name, int value) { return key(name).integer(value); }
+    Writer& member(std::string_view name, int64_t value) { return key(name).integer(value); }
+    Writer& member(std::string_view name, uint32_t value) {
+        return key(name).integer(static_cast<int64_t>(value));
+    }
+
+    Writer& value(const Value& v) {
+        switch (v.type) {
+        case Type::Null:
+            return null();
+        case Type::Bool:
+            return boolean(v.b);
+        case Type::Integer:
+            return integer(v.i);
+        case Type::Number:
+            return number(v.n);
+        case Type::String:
+            return string(v.s);
+        case Type::Array:
+            begin_array();
+            for (const Value& item : v.a)
+                value(item);
+            return end_array();
+        case Type::Object:
+            begin_object();
+            for (const auto& [name, item] : v.o)
+                key(name).value(item);
+            return end_object();
         }
-        if (indent >= 0)
-            ss << "\n" << std::string(level * indent, ' ');
-        ss << "]";
-        return ss.str();
-    }
-    case Type::Object: {
-        if (v.o.empty())
-            return "{}";
-        std::ostringstream ss;
-        ss << "{" << (indent >= 0 ? "\n" : "");
-        size_t i = 0;
-        for (const auto& kv : v.o) {
-            if (indent >= 0)
-                ss << std::string((level + 1) * indent, ' ');
-            ss << escape_string(kv.first) << ":" << (indent >= 0 ? " " : "");
-            ss << dump(kv.second, indent, level + 1);
-            if (i < v.o.size() - 1)
-                ss << "," << (indent >= 0 ? "\n" : " ");
-            i++;
+        return *this;
+    }
+
+private:
+    Writer& open(char bracket) {
+        separate();
+        put(&bracket, 1);
+        has_items_.push_back(false);
+        return *this;
+    }
+
+    Writer& close(char bracket) {
+        const bool had_items = !has_items_.empty() && has_items_.back();
+        if (!has_items_.empty())
+            has_items_.pop_back();
+        if (had_items && indent_ >= 0)
+            newline(has_items_.size());
+        put(&bracket, 1);
+        return *this;
+    }
+
+    void separate() {
+        if (after_key_) {
+            after_key_ = false;
+            return;
         }
-        if (indent >= 0)
-            ss << "\n" << std::string(level * indent, ' ');
-        ss << "}";
-        return ss.str();
+        if (has_items_.empty())
+            return;
+        if (has_items_.back()) {
+            if (indent_ >= 0)
+                put(",", 1);
+            else
+                put(", ", 2);
+        }
+        has_items_.back() = true;
+        if (indent_ >= 0)
+            newline(has_items_.size());
     }
+
+    void newline(size_t level) {
+        put("\n", 1);
+        for (size_t i = 0; i < level * static_cast<size_t>(indent_); ++i)
+            put(" ", 1);
     }
-    return "";
-}
 
-class Parser {
-    const std::string& str;
-    size_t pos = 0;
+    void quoted(std::string_view value) {
+        if (validate_utf8_ && !is_valid_utf8(value)) {
+            fail("strings must be valid UTF-8");
+            return;
+        }
+        static constexpr char kHex[] = "0123456789abcdef";
+        put("\"", 1);
+        size_t run = 0;
+        for (size_t index = 0; index < value.size(); ++index) {
+            const auto c = static_cast<unsigned char>(value[index]);
+            const char* escape = nullptr;
+            char unicode[6] = {'\\', 'u', '0', '0', 0, 0};
+            switch (c) {
+            case '"':
+                escape = "\\\"";
+                break;
+            case '\\':
+                escape = "\\\\";
+                break;
+            case '\b':
+                escape = "\\b";
+                break;
+            case '\f':
+                escape = "\\f";
+                break;
+            case '\n':
+                escape = "\\n";
+                break;
+            case '\r':
+                escape = "\\r";
+                break;
+            case '\t':
+                escape = "\\t";
+                break;
+            default:
+                if (c >= 0x20U)
+                    continue;
+                unicode[4] = kHex[c >> 4U];
+                unicode[5] = kHex[c & 0xFU];
+                break;
+            }
+            // Flush the unescaped run before this character in one append
+            put(value.data() + run, index - run);
+            if (escape != nullptr)
+                put(escape, 2);
+            else
+                put(unicode, sizeof(unicode));
+            run = index + 1;
+        }
+        put(value.data() + run, value.size() - run);
+        put("\"", 1);
+    }
+
+    void put(const char* data, size_t length) {
+        if (error_ != nullptr)
+            return;
+        if (length > budget_ - written()) {
+            fail("JSON output exceeds the size limit");
+            return;
+        }
+        out_->append(data, length);
+    }
+
+    void fail(const char* message) {
+        if (error_ == nullptr)
+            error_ = message;
+    }
+
+    std::string* out_;
+    size_t start_;
+    int indent_;
+    size_t budget_ = std::numeric_limits<size_t>::max();
+    bool validate_utf8_ = false;
+    bool after_key_ = false;
+    std::vector<bool> has_items_;
+    const char* error_ = nullptr;
+};
+
+struct ReaderLimits {
+    size_t max_depth = 128;
+    size_t max_values = 100000;
+};
+
+/**
+ * SAX JSON reader (RFC 8259, UTF-8 only)
+ *
+ * Calls into Handler as it scans:
+ *   bool null(), boolean(bool), integer(int64_t), number(double),
+ *        string(std::string_view), key(std::string_view),
+ *        begin_object(), end_object(), begin_array(), end_array()
+ *   const char* failure()   reason reported when a callback returned false
+ * String views are only valid for the duration of the callback.
+ */
+template <typename Handler>
+class Reader {
+public:
+    Reader(std::string_view input, Handler* handler, ReaderLimits limits = {})
+        : str_(input), handler_(handler), limits_(limits) {}
+
+    bool parse() {
+        if (!parse_value(0))
+            return false;
+        skip_whitespace();
+        if (pos_ != str_.size())
+            return fail("trailing data");
+        return true;
+    }
+
+    const std::string& error() const { return error_; }
+
+private:
+    bool fail(const char* message) {
+        if (error_.empty())
+            error_ = std::string("JSON parse error at byte ") + std::to_string(pos_) + ": " + message;
+        return false;
+    }
+
+    bool emit(bool accepted) { return accepted || fail(handler_->failure()); }
 
     void skip_whitespace() {
-        while (pos < str.size() && std::isspace((unsigned char)str[pos]))
-            pos++;
+        while (pos_ < str_.size() && (str_[pos_] == ' ' || str_[pos_] == '\t' ||
+                                      str_[pos_] == '\n' || str_[pos_] == '\r')) {
+            ++pos_;
+        }
+    }
+
+    bool consume(char expected) {
+        if (pos_ < str_.size() && str_[pos_] == expected) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool consume_literal(std::string_view literal) {
+        if (str_.compare(pos_, literal.size(), literal) != 0)
+            return fail("invalid literal");
+        pos_ += literal.size();
+        return true;
     }
 
-    Value parse_value() {
+    static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    bool parse_value(size_t depth) {
+        if (depth > limits_.max_depth)
+            return fail("nesting is too deep");
+        if (++values_ > limits_.max_values)
+            return fail("too many values");
         skip_whitespace();
-        if (pos >= str.size())
-            return Value();
-        char c = str[pos];
-        if (c == 'n') {
-            pos += 4;
-            return Value();
+        if (pos_ >= str_.size())
+            return fail("expected a value");
+        const char c = str_[pos_];
+        switch (c) {
+        case 'n':
+            return consume_literal("null") && emit(handler_->null());
+        case 't':
+            return consume_literal("true") && emit(handler_->boolean(true));
+        case 'f':
+            return consume_literal("false") && emit(handler_->boolean(false));
+        case '"': {
+            std::string_view text;
+            return parse_string(&text) && emit(handler_->string(text));
         }
-        if (c == 't') {
-            pos += 4;
-            return Value(true);
+        case '[':
+            return parse_array(depth);
+        case '{':
+            return parse_object(depth);
+        default:
+            if (c == '-' || is_digit(c))
+                return parse_number();
+            return fail("unexpected character");
         }
-        if (c == 'f') {
-            pos += 5;
-            return Value(false);
+    }
+
+    bool parse_hex_quad(unsigned int* output) {
+        if (str_.size() - pos_ < 4)
+            return fail("incomplete Unicode escape");
+        unsigned int value = 0;
+        for (size_t index = 0; index < 4; ++index) {
+            const char character = str_[pos_++];
+            value <<= 4U;
+            if (character >= '0' && character <= '9')
+                value |= static_cast<unsigned int>(character - '0');
+            else if (character >= 'a' && character <= 'f')
+                value |= static_cast<unsigned int>(character - 'a' + 10);
+            else if (character >= 'A' && character <= 'F')
+                value |= static_cast<unsigned int>(character - 'A' + 10);
+            else
+                return fail("invalid Unicode escape");
         }
-        if (c == '"')
-            return parse_string();
-        if (c == '[')
-            return parse_array();
-        if (c == '{')
-            return parse_object();
-        if (c == '-' || std::isdigit((unsigned char)c))
-            return parse_number();
-        return Value();
-    }
-
-    Value parse_string() {
-        std::string s;
-        pos++;  // skip "
-        while (pos < str.size()) {
-            char c = str[pos++];
-            if (c == '"')
-                break;
+        *output = value;
+        return true;
+    }
+
+    static void append_utf8(std::string* output, unsigned int codepoint) {
+        if (codepoint <= 0x7FU) {
+            output->push_back(static_cast<char>(codepoint));
+        } else if (codepoint <= 0x7FFU) {
+            output->push_back(static_cast<char>(0xC0U | (codepoint >> 6U)));
+            output->push_back(static_cast<char>(0x80U | (codepoint & 0x3FU)));
+        } else if (codepoint <= 0xFFFFU) {
+            output->push_back(static_cast<char>(0xE0U | (codepoint >> 12U)));
+            output->push_back(static_cast<char>(0x80U | ((codepoint >> 6U) & 0x3FU)));
+            output->push_back(static_cast<char>(0x80U | (codepoint & 0x3FU)));
+        } else {
+            output->push_back(static_cast<char>(0xF0U | (codepoint >> 18U)));
+            output->push_back(static_cast<char>(0x80U | ((codepoint >> 12U) & 0x3FU)));
+            output->push_back(static_cast<char>(0x80U | ((codepoint >> 6U) & 0x3FU)));
+            output->push_back(static_cast<char>(0x80U | (codepoint & 0x3FU)));
+        }
+    }
+
+    bool parse_escape() {
+        if (pos_ >= str_.size())
+            return fail("incomplete escape sequence");
+        const char next = str_[pos_++];
+        switch (next) {
+        case '"':
+        case '\\':
+        case '/':
+            scratch_ += next;
+            return true;
+        case 'b':
+            scratch_ += '\b';
+            return true;
+        case 'f':
+            scratch_ += '\f';
+            return true;
+        case 'n':
+            scratch_ += '\n';
+            return true;
+        case 'r':
+            scratch_ += '\r';
+            return true;
+        case 't':
+            scratch_ += '\t';
+            return true;
+        case 'u':
+            break;
+        default:
+            return fail("invalid escape sequence");
+        }
+        unsigned int codepoint = 0;
+        if (!parse_hex_quad(&codepoint))
+            return false;
+        if (codepoint >= 0xD800U && codepoint <= 0xDBFFU) {
+            if (!consume('\\') || !consume('u'))
+                return fail("missing low surrogate");
+            unsigned int low = 0;
+            if (!parse_hex_quad(&low))
+                return false;
+            if (low < 0xDC00U || low > 0xDFFFU)
+                return fail("invalid low surrogate");
+            codepoint = 0x10000U + ((codepoint - 0xD800U) << 10U) + (low - 0xDC00U);
+        } else if (codepoint >= 0xDC00U && codepoint <= 0xDFFFU) {
+            return fail("unexpected low surrogate");
+        }
+        append_utf8(&scratch_, codepoint);
+        return true;
+    }
+
+    // Views the input directly until the first escape, then decodes into
+    // scratch_, which is reused across strings instead of allocating each.
+    bool parse_string(std::string_view* output) {
+        if (!consume('"'))
+            return fail("expected a string");
+        const size_t start = pos_;
+        bool escaped = false;
+        const auto* data = reinterpret_cast<const unsigned char*>(str_.data());
+        while (pos_ < str_.size()) {
+            const unsigned char c = data[pos_];
+            if (c == '"') {
+                if (escaped) {
+                    *output = scratch_;
+                } else {
+                    *output = str_.substr(start, pos_ - start);
+                }
+                ++pos_;
+                return true;
+            }
             if (c == '\\') {
-                if (pos >= str.size())
-                    break;
-                char next = str[pos++];
-                if (next == 'n')
-                    s += '\n';
-                else if (next == 't')
-                    s += '\t';
-                else if (next == '"')
-                    s += '"';
-                else if (next == '\\')
-                    s += '\\';
-                else
-                    s += next;
-            } else {
-                s += c;
+                if (!escaped) {
+                    scratch_.assign(str_.data() + start, pos_ - start);
+                    escaped = true;
+                }
+                ++pos_;
+                if (!parse_escape())
+                    return false;
+                continue;
+            }
+            if (c < 0x20U)
+                return fail("unescaped control character");
+            size_t length = 1;
+            if (c >= 0x80U) {
+                length = utf8_sequence_length(data + pos_, str_.size() - pos_);
+                if (length == 0)
+                    return fail("invalid UTF-8 sequence");
             }
+            if (escaped)
+                scratch_.append(str_.data() + pos_, length);
+            pos_ += length;
         }
-        return Value(s);
+        return fail("unterminated string");
     }
 
-    Value parse_number() {
-        size_t start = pos;
-        while (pos < str.size() &&
-               (std::isdigit((unsigned char)str[pos]) || str[pos] == '-' || str[pos] == '.'))
-            pos++;
-        return Value(std::stod(str.substr(start, pos - start)));
+    bool parse_number() {
+        const size_t start = pos_;
+        bool integer_syntax = true;
+        (void)consume('-');
+        if (pos_ >= str_.size())
+            return fail("incomplete number");
+        if (consume('0')) {
+            if (pos_ < str_.size() && is_digit(str_[pos_]))
+                return fail("leading zero in number");
+        } else {
+            if (!is_digit(str_[pos_]))
+                return fail("invalid number");
+            while (pos_ < str_.size() && is_digit(str_[pos_]))
+                ++pos_;
+        }
+        if (consume('.')) {
+            integer_syntax = false;
+            if (pos_ >= str_.size() || !is_digit(str_[pos_]))
+                return fail("fraction has no digits");
+            while (pos_ < str_.size() && is_digit(str_[pos_]))
+                ++pos_;
+        }
+        if (pos_ < str_.size() && (str_[pos_] == 'e' || str_[pos_] == 'E')) {
+            integer_syntax = false;
+            ++pos_;
+            if (pos_ < str_.size() && (str_[pos_] == '+' || str_[pos_] == '-'))
+                ++pos_;
+            if (pos_ >= str_.size() || !is_digit(str_[pos_]))
+                return fail("exponent has no digits");
+            while (pos_ < str_.size() && is_digit(str_[pos_]))
+                ++pos_;
+        }
+
+        const char* first = str_.data() + start;
+        const char* last = str_.data() + pos_;
+        if (integer_syntax) {
+            int64_t integer = 0;
+            const auto result = std::from_chars(first, last, integer);
+            if (result.ec == std::errc() && result.ptr == last)
+                return emit(handler_->integer(integer));
+            return fail("integer is out of range");
+        }
+        // strtod needs a terminator, the input view may not have one
+        scratch_.assign(first, last);
+        char* end = nullptr;
+        errno = 0;
+        const double number = std::strtod(scratch_.c_str(), &end);
+        if (errno == ERANGE || end != scratch_.c_str() + scratch_.size() || !std::isfinite(number))
+            return fail("number is out of range");
+        return emit(handler_->number(number));
     }
 
-    Value parse_array() {
-        Value v;
-        v.type = Type::Array;
-        pos++;  // skip [
-        while (pos < str.size()) {
-            skip_whitespace();
-            if (pos >= str.size() || str[pos] == ']') {
-                if (pos < str.size())
-                    pos++;
-                break;
-            }
-            v.a.push_back(parse_value());
+    bool parse_array(size_t depth) {
+        ++pos_;
+        if (!emit(handler_->begin_array()))
+            return false;
+        skip_whitespace();
+        if (consume(']'))
+            return emit(handler_->end_array());
+        while (true) {
+            if (!parse_value(depth + 1))
+                return false;
             skip_whitespace();
-            if (pos < str.size() && str[pos] == ',')
-                pos++;
+            if (consume(']'))
+                return emit(handler_->end_array());
+            if (!consume(','))
+                return fail("expected ',' or ']' in array");
         }
-        return v;
     }
 
-    Value parse_object() {
-        Value v;
-        v.type = Type::Object;
-        pos++;  // skip {
-        while (pos < str.size()) {
+    bool parse_object(size_t depth) {
+        ++pos_;
+        if (!emit(handler_->begin_object()))
+            return false;
+        skip_whitespace();
+        if (consume('}'))
+            return emit(handler_->end_object());
+        while (true) {
             skip_whitespace();
-            if (pos >= str.size() || str[pos] == '}') {
-                if (pos < str.size())
-                    pos++;
-                break;
-            }
-            Value key = parse_string();
+            std::string_view name;
+            if (!parse_string(&name) || !emit(handler_->key(name)))
+                return false;
             skip_whitespace();
-            if (pos < str.size() && str[pos] == ':')
-                pos++;
-            v.o[key.s] = parse_value();
+            if (!consume(':'))
+                return fail("expected ':' after object key");
+            if (!parse_value(depth + 1))
+                return false;
             skip_whitespace();
-            if (pos < str.size() && str[pos] == ',')
-                pos++;
+            if (consume('}'))
+                return emit(handler_->end_object());
+            if (!consume(','))
+                return fail("expected ',' or '}' in object");
         }
-        return v;
     }
 
+    std::string_view str_;
+    Handler* handler_;
+    ReaderLimits limits_;
+    size_t pos_ = 0;
+    size_t values_ = 0;
+    std::string scratch_;
+    std::string error_;
+};
+
+/**
+ * Reader handler that assembles a Value tree
+ */
+class ValueBuilder {
 public:
-    explicit Parser(const std::string& s) : str(s) {}
-    Value parse() { return parse_value(); }
+    bool null() { return add(Value()); }
+    bool boolean(bool v) { return add(Value(v)); }
+    bool integer(int64_t v) { return add(Value(v)); }
+    bool number(double v) { return add(Value(v)); }
+    bool string(std::string_view v) { return add(Value(std::string(v))); }
+    bool key(std::string_view name) {
+        key_.assign(name);
+        return true;
+    }
+    bool begin_object() { return open(Value::object()); }
+    bool begin_array() { return open(Value::array()); }
+    bool end_object() { return close(); }
+    bool end_array() { return close(); }
+    const char* failure() const { return "duplicate object key"; }
+
+    Value take() { return std::move(root_); }
+
+private:
+    // Places v in the innermost open container (or at the root) and returns it
+    Value* place(Value&& v) {
+        if (stack_.empty()) {
+            root_ = std::move(v);
+            return &root_;
+        }
+        Value* parent = stack_.back();
+        if (parent->type == Type::Array) {
+            parent->a.push_back(std::move(v));
+            return &parent->a.back();
+        }
+        auto [it, inserted] = parent->o.emplace(std::move(key_), std::move(v));
+        return inserted ? &it->second : nullptr;
+    }
+
+    bool add(Value&& v) { return place(std::move(v)) != nullptr; }
+
+    bool open(Value&& v) {
+        Value* container = place(std::move(v));
+        if (container == nullptr)
+            return false;
+        stack_.push_back(container);
+        return true;
+    }
+
+    bool close() {
+        stack_.pop_back();
+        return true;
+    }
+
+    Value root_;
+    std::vector<Value*> stack_;
+    std::string key_;
 };
 
-inline Value parse(const std::string& s) {
-    return Parser(s).parse();
+/**
+ * Strict parse into a Value tree
+ * @return nullopt with *error set on malformed input
+ */
+inline std::optional<Value> try_parse(std::string_view s, std::string* error = nullptr) {
+    ValueBuilder builder;
+    Reader<ValueBuilder> reader(s, &builder);
+    if (!reader.parse()) {
+        if (error)
+            *error = reader.error();
+        return std::nullopt;
+    }
+    return builder.take();
+}
+
+/**
+ * Parse into a Value tree; malformed input yields a Null value
+ */
+inline Value parse(std::string_view s) {
+    auto value = try_parse(s);
+    return value ? std::move(*value) : Value();
+}
+
+inline bool has_valid_utf8(const Value& value) {
+    switch (value.type) {
+    case Type::String:
+        return is_valid_utf8(value.s);
+    case Type::Array:
+        for (const Value& item : value.a) {
+            if (!has_valid_utf8(item))
+                return false;
+        }
+        return true;
+    case Type::Object:
+        for (const auto& [name, item] : value.o) {
+            if (!is_valid_utf8(name) || !has_valid_utf8(item))
+                return false;
+        }
+        return true;
+    default:
+        return true;
+    }
+}
+
+inline std::string escape_string(std::string_view s) {
+    std::string output;
+    Writer(&output).string(s);
+    return output;
+}
+
+inline std::string dump(const Value& v, int indent = -1) {
+    std::string output;
+    Writer(&output, indent).value(v);
+    return output;
 }
 
 }  // namespace json
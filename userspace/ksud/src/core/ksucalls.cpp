@@ -79,14 +79,12 @@ auto scan_driver_fd() -> int {
 }
 
 auto init_driver_fd() -> int {
-    // Method 1: Check if we already have an inherited fd
-    const int driver_fd = scan_driver_fd();
-    if (driver_fd >= 0) {
-        LOGD("Found inherited driver fd: %d", driver_fd);
-        return driver_fd;
-    }
+    // Ask the kernel first. Our own fd is O_CLOEXEC, so a fresh ksud rarely
+    // inherits one, and current kernels answer with the fd already in our
+    // table rather than a new one, which makes the /proc/self/fd scan (a
+    // readlink per open fd) redundant on every short-lived CLI call.
 
-    // Method 2: Try prctl to get fd (SECCOMP-safe)
+    // Method 1: Try prctl to get fd (SECCOMP-safe, manager only)
     PrctlGetFdCmd prctl_cmd = {-1, -1};
     prctl(KSU_PRCTL_GET_FD, &prctl_cmd, 0, 0, 0);
     if (prctl_cmd.result == 0 && prctl_cmd.fd >= 0) {
@@ -94,7 +92,7 @@ auto init_driver_fd() -> int {
         return prctl_cmd.fd;
     }
 
-    // Method 3: Fallback to reboot syscall (may be blocked by SECCOMP)
+    // Method 2: Reboot syscall (may be blocked by SECCOMP)
     int fd_reboot = -1;  // NOLINT(misc-const-correctness) written via pointer by syscall
     syscall(SYS_reboot, KSU_INSTALL_MAGIC1, KSU_INSTALL_MAGIC2, 0, &fd_reboot);
     if (fd_reboot >= 0) {
@@ -102,6 +100,13 @@ auto init_driver_fd() -> int {
         return fd_reboot;
     }
 
+    // Method 3: Look for an inherited fd
+    const int driver_fd = scan_driver_fd();
+    if (driver_fd >= 0) {
+        LOGD("Found inherited driver fd: %d", driver_fd);
+        return driver_fd;
+    }
+
     LOGE("Failed to get driver fd");
     return -1;
 }
@@ -257,6 +262,70 @@ int set_feature(uint32_t feature_id, uint64_t value) {
     return ksuctl(KSU_IOCTL_SET_FEATURE, &cmd);
 }
 
+namespace {
+
+// Cleared once the kernel rejects KSU_IOCTL_FEATURE_BATCH
+bool g_feature_batch_supported = true;
+
+int feature_batch(uint32_t flags, std::vector<ksu_feature_batch_entry>* entries) {
+    if (!g_feature_batch_supported) {
+        return -ENOTTY;
+    }
+    const int fd = get_driver_fd();
+    if (fd < 0) {
+        return -ENODEV;
+    }
+    ksu_feature_batch_cmd cmd{};
+    cmd.flags = flags;
+    cmd.count = static_cast<uint32_t>(entries->size());
+    cmd.entries = reinterpret_cast<uint64_t>(entries->data());
+    if (ioctl(fd, KSU_IOCTL_FEATURE_BATCH, &cmd) < 0) {
+        const int error = errno;
+        if (error == ENOTTY) {
+            LOGD("Kernel has no batched feature ioctl, falling back");
+            g_feature_batch_supported = false;
+        }
+        return -error;
+    }
+    return 0;
+}
+
+}  // namespace
+
+int get_features(std::vector<ksu_feature_batch_entry>* entries) {
+    const int ret = feature_batch(0, entries);
+    if (ret != -ENOTTY) {
+        return ret;
+    }
+    for (auto& entry : *entries) {
+        GetFeatureCmd cmd = {entry.feature_id, 0, 0};
+        if (ksuctl(KSU_IOCTL_GET_FEATURE, &cmd) < 0) {
+            entry.value = 0;
+            entry.status = -EIO;
+            continue;
+        }
+        entry.value = cmd.value;
+        entry.status = cmd.supported != 0 ? 0 : -ENOENT;
+    }
+    return 0;
+}
+
+int set_features(std::vector<ksu_feature_batch_entry>* entries) {
+    const int ret = feature_batch(KSU_FEATURE_BATCH_SET, entries);
+    if (ret != -ENOTTY) {
+        return ret;
+    }
+    int first_error = 0;
+    for (auto& entry : *entries) {
+        SetFeatureCmd cmd = {entry.feature_id, entry.value};
+        entry.status = ksuctl(KSU_IOCTL_SET_FEATURE, &cmd) < 0 ? -EIO : 0;
+        if (entry.status != 0 && first_error == 0) {
+            first_error = entry.status;
+        }
+    }
+    return first_error;
+}
+
 int get_uts_view_config(ksu_uts_view_config* config) {
     if (config == nullptr)
         return -EINVAL;
@@ -285,6 +354,11 @@ bool uid_granted_root(uint32_t uid) {
     return cmd.granted != 0;
 }
 
+bool get_boot_stamps(ksu_get_boot_stamps_cmd* stamps) {
+    *stamps = {};
+    return ksuctl(KSU_IOCTL_GET_BOOT_STAMPS, stamps) == 0;
+}
+
 bool uid_should_umount(uint32_t uid) {
     ksu_uid_should_umount_cmd cmd{};
     cmd.uid = uid;
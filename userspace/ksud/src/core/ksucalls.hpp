@@ -71,6 +71,21 @@ int set_sepolicy(const void* payload, uint64_t payload_len);
 // Returns: pair<value, supported>
 std::pair<uint64_t, bool> get_feature(uint32_t feature_id);
 int set_feature(uint32_t feature_id, uint64_t value);
+
+/**
+ * Read several features with one ioctl (one per feature on older kernels)
+ * @param entries feature_id in; value and status out, status -ENOENT meaning
+ *        not supported by the kernel
+ * @return 0, or a negative errno if the driver could not be reached
+ */
+int get_features(std::vector<ksu_feature_batch_entry>* entries);
+
+/**
+ * Write several features with one ioctl (one per feature on older kernels)
+ * @param entries feature_id and value in; status out
+ * @return 0 if every entry was applied, otherwise a negative errno
+ */
+int set_features(std::vector<ksu_feature_batch_entry>* entries);
 int get_uts_view_config(ksu_uts_view_config* config);
 int set_uts_view_config(const ksu_uts_view_config& config);
 int get_uts_view_status(ksu_uts_view_status* status);
@@ -96,6 +111,8 @@ std::optional<std::string> umount_list_list();
 
 bool uid_granted_root(uint32_t uid);
 bool uid_should_umount(uint32_t uid);
+// Kernel boot milestones (KSU_BOOT_STAMP_*); false on older kernels
+bool get_boot_stamps(ksu_get_boot_stamps_cmd* stamps);
 
 int set_magisk_su_profile(const std::string& package, uint32_t uid, bool allow);
 
@@ -0,0 +1,476 @@
+#include "package_index.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+
+#include "../defs.hpp"
+#include "../log.hpp"
+#include "../utils.hpp"
+
+namespace ksud {
+namespace package_index {
+
+namespace {
+
+constexpr const char* kPackagesList = "/data/system/packages.list";
+constexpr const char* kAppDir = "/data/app";
+constexpr uint32_t kIndexMagic = 0x58444950;  // "PIDX"
+constexpr uint32_t kIndexVersion = 2;
+constexpr uint32_t kEmptySlot = UINT32_MAX;
+constexpr uint32_t kPerUserRange = 100000;
+
+// Everything below the header is addressed by offsets from the start of the
+// file, so the mapping can be used in place.
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    int64_t list_mtime_ns;
+    uint64_t list_size;
+    uint64_t list_ino;
+    int64_t app_dir_mtime_ns;
+    uint32_t package_count;
+    uint32_t packages_offset;
+    uint32_t uid_slot_count;  // Power of two
+    uint32_t uid_slots_offset;
+    uint32_t name_slot_count;  // Power of two
+    uint32_t name_slots_offset;
+    uint32_t path_count;
+    uint32_t paths_offset;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+};
+
+struct PackageRecord {
+    uint32_t appid;
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t first_path;
+    uint32_t path_count;
+};
+
+struct UidSlot {
+    uint32_t appid;  // kEmptySlot when unused
+    uint32_t first_package;
+    uint32_t package_count;
+};
+
+struct NameSlot {
+    uint32_t hash;
+    uint32_t package;  // kEmptySlot when unused
+};
+
+struct PathRecord {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SourceStamp {
+    int64_t list_mtime_ns = 0;
+    uint64_t list_size = 0;
+    uint64_t list_ino = 0;
+    int64_t app_dir_mtime_ns = 0;
+};
+
+int64_t mtime_ns(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+bool read_source_stamp(SourceStamp* stamp) {
+    struct stat list_status{};
+    if (stat(kPackagesList, &list_status) != 0)
+        return false;
+    stamp->list_mtime_ns = mtime_ns(list_status);
+    stamp->list_size = static_cast<uint64_t>(list_status.st_size);
+    stamp->list_ino = static_cast<uint64_t>(list_status.st_ino);
+    struct stat app_status{};
+    stamp->app_dir_mtime_ns = stat(kAppDir, &app_status) == 0 ? mtime_ns(app_status) : 0;
+    return true;
+}
+
+uint32_t hash_name(std::string_view name) {
+    uint32_t hash = 2166136261U;  // FNV-1a
+    for (const char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+uint32_t hash_appid(uint32_t appid) {
+    return appid * 2654435761U;
+}
+
+uint32_t slot_count_for(size_t entries) {
+    uint32_t count = 16;
+    while (count < entries * 2)
+        count <<= 1;
+    return count;
+}
+
+// /data/app/~~<random>==/<package>-<random>==/base.apk on current releases,
+// /data/app/<package>-<n>/base.apk on older ones.
+void collect_apks(const std::string& dir, std::map<std::string, std::vector<std::string>>* apks) {
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr)
+        return;
+    while (dirent* entry = readdir(d)) {
+        const std::string name = entry->d_name;
+        if (name == "." || name == ".." || entry->d_type != DT_DIR)
+            continue;
+        const std::string path = dir + "/" + name;
+        if (starts_with(name, "~~")) {
+            collect_apks(path, apks);
+            continue;
+        }
+        const size_t dash = name.rfind('-');
+        if (dash == std::string::npos || dash == 0)
+            continue;
+        std::vector<std::string> files;
+        if (DIR* code_dir = opendir(path.c_str())) {
+            while (dirent* file = readdir(code_dir)) {
+                const std::string file_name = file->d_name;
+                if (ends_with(file_name, ".apk"))
+                    files.push_back(path + "/" + file_name);
+            }
+            closedir(code_dir);
+        }
+        std::sort(files.begin(), files.end(), [](const std::string& lhs, const std::string& rhs) {
+            const bool lhs_base = ends_with(lhs, "/base.apk");
+            const bool rhs_base = ends_with(rhs, "/base.apk");
+            return lhs_base != rhs_base ? lhs_base : lhs < rhs;
+        });
+        if (!files.empty())
+            (*apks)[name.substr(0, dash)] = std::move(files);
+    }
+    closedir(d);
+}
+
+template <typename T>
+void append_pod(std::string* blob, const T& value) {
+    blob->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+void append_pods(std::string* blob, const std::vector<T>& values) {
+    if (!values.empty())
+        blob->append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+std::string build_index(const SourceStamp& stamp) {
+    std::vector<std::pair<uint32_t, std::string>> parsed;
+    std::ifstream in(kPackagesList);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream iss(line);
+        std::string package;
+        uint32_t appid = 0;
+        if (iss >> package >> appid)
+            parsed.emplace_back(appid % kPerUserRange, package);
+    }
+    // Keep packages.list order within a shared uid; callers take the first match
+    std::stable_sort(parsed.begin(), parsed.end(),
+                     [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+    std::map<std::string, std::vector<std::string>> apks;
+    collect_apks(kAppDir, &apks);
+
+    std::string strings;
+    std::vector<PackageRecord> packages;
+    std::vector<PathRecord> paths;
+    for (const auto& [appid, package] : parsed) {
+        PackageRecord record{appid, static_cast<uint32_t>(strings.size()),
+                             static_cast<uint32_t>(package.size()),
+                             static_cast<uint32_t>(paths.size()), 0};
+        strings += package;
+        const auto it = apks.find(package);
+        if (it != apks.end()) {
+            for (const auto& path : it->second) {
+                paths.push_back(
+                    {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(path.size())});
+                strings += path;
+            }
+            record.path_count = static_cast<uint32_t>(it->second.size());
+        }
+        packages.push_back(record);
+    }
+
+    std::vector<UidSlot> uid_slots(slot_count_for(packages.size()), {kEmptySlot, 0, 0});
+    std::vector<NameSlot> name_slots(slot_count_for(packages.size()), {0, kEmptySlot});
+    const uint32_t uid_mask = static_cast<uint32_t>(uid_slots.size()) - 1;
+    const uint32_t name_mask = static_cast<uint32_t>(name_slots.size()) - 1;
+    for (uint32_t i = 0; i < packages.size(); ++i) {
+        const PackageRecord& record = packages[i];
+        // Packages are sorted by app id, so a shared uid is one contiguous run.
+        if (i == 0 || packages[i - 1].appid != record.appid) {
+            uint32_t slot = hash_appid(record.appid) & uid_mask;
+            while (uid_slots[slot].appid != kEmptySlot)
+                slot = (slot + 1) & uid_mask;
+            uid_slots[slot] = {record.appid, i, 0};
+            uint32_t end = i;
+            while (end < packages.size() && packages[end].appid == record.appid)
+                ++end;
+            uid_slots[slot].package_count = end - i;
+        }
+        const uint32_t hash =
+            hash_name(std::string_view(strings).substr(record.name_offset, record.name_length));
+        uint32_t slot = hash & name_mask;
+        while (name_slots[slot].package != kEmptySlot)
+            slot = (slot + 1) & name_mask;
+        name_slots[slot] = {hash, i};
+    }
+
+    IndexHeader header{};
+    header.magic = kIndexMagic;
+    header.version = kIndexVersion;
+    header.list_mtime_ns = stamp.list_mtime_ns;
+    header.list_size = stamp.list_size;
+    header.list_ino = stamp.list_ino;
+    header.app_dir_mtime_ns = stamp.app_dir_mtime_ns;
+    header.package_count = static_cast<uint32_t>(packages.size());
+    header.packages_offset = sizeof(IndexHeader);
+    header.uid_slot_count = static_cast<uint32_t>(uid_slots.size());
+    header.uid_slots_offset = header.packages_offset + header.package_count * sizeof(PackageRecord);
+    header.name_slot_count = static_cast<uint32_t>(name_slots.size());
+    header.name_slots_offset = header.uid_slots_offset + header.uid_slot_count * sizeof(UidSlot);
+    header.path_count = static_cast<uint32_t>(paths.size());
+    header.paths_offset = header.name_slots_offset + header.name_slot_count * sizeof(NameSlot);
+    header.strings_offset = header.paths_offset + header.path_count * sizeof(PathRecord);
+    header.strings_size = static_cast<uint32_t>(strings.size());
+
+    std::string blob;
+    blob.reserve(header.strings_offset + strings.size());
+    append_pod(&blob, header);
+    append_pods(&blob, packages);
+    append_pods(&blob, uid_slots);
+    append_pods(&blob, name_slots);
+    append_pods(&blob, paths);
+    blob += strings;
+    return blob;
+}
+
+bool section_fits(size_t size, uint32_t offset, uint32_t count, size_t element) {
+    return offset <= size && count <= (size - offset) / element;
+}
+
+bool header_valid(const void* data, size_t size) {
+    if (size < sizeof(IndexHeader))
+        return false;
+    const auto* header = static_cast<const IndexHeader*>(data);
+    return header->magic == kIndexMagic && header->version == kIndexVersion &&
+           header->uid_slot_count != 0 && (header->uid_slot_count & (header->uid_slot_count - 1)) == 0 &&
+           header->name_slot_count != 0 &&
+           (header->name_slot_count & (header->name_slot_count - 1)) == 0 &&
+           section_fits(size, header->packages_offset, header->package_count, sizeof(PackageRecord)) &&
+           section_fits(size, header->uid_slots_offset, header->uid_slot_count, sizeof(UidSlot)) &&
+           section_fits(size, header->name_slots_offset, header->name_slot_count, sizeof(NameSlot)) &&
+           section_fits(size, header->paths_offset, header->path_count, sizeof(PathRecord)) &&
+           section_fits(size, header->strings_offset, header->strings_size, 1);
+}
+
+bool header_matches(const void* data, const SourceStamp& stamp) {
+    const auto* header = static_cast<const IndexHeader*>(data);
+    return header->list_mtime_ns == stamp.list_mtime_ns && header->list_size == stamp.list_size &&
+           header->list_ino == stamp.list_ino && header->app_dir_mtime_ns == stamp.app_dir_mtime_ns;
+}
+
+// A validated view of the index: either the shared file mapping or, when the
+// file cannot be written, a private copy of a freshly built blob.
+class IndexView {
+public:
+    IndexView(const void* data, size_t size, bool mapped, std::string owned = {})
+        : data_(static_cast<const uint8_t*>(data)),
+          size_(size),
+          mapped_(mapped),
+          owned_(std::move(owned)) {
+        if (!mapped_)
+            data_ = reinterpret_cast<const uint8_t*>(owned_.data());
+    }
+    ~IndexView() {
+        if (mapped_)
+            munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    IndexView(const IndexView&) = delete;
+    IndexView& operator=(const IndexView&) = delete;
+
+    [[nodiscard]] const IndexHeader& header() const {
+        return *reinterpret_cast<const IndexHeader*>(data_);
+    }
+
+    template <typename T>
+    [[nodiscard]] const T& at(uint32_t offset, uint32_t index) const {
+        return reinterpret_cast<const T*>(data_ + offset)[index];
+    }
+
+    [[nodiscard]] std::string_view string(uint32_t offset, uint32_t length) const {
+        const IndexHeader& h = header();
+        if (offset > h.strings_size || length > h.strings_size - offset)
+            return {};
+        return {reinterpret_cast<const char*>(data_ + h.strings_offset + offset), length};
+    }
+
+    [[nodiscard]] const PackageRecord* package(uint32_t index) const {
+        if (index >= header().package_count)
+            return nullptr;
+        return &at<PackageRecord>(header().packages_offset, index);
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    bool mapped_;
+    std::string owned_;
+};
+
+std::shared_ptr<const IndexView> map_index_file(const SourceStamp& stamp) {
+    const int fd = open(PACKAGE_INDEX_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+    struct stat st{};
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(IndexHeader))
+        data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return nullptr;
+    const auto size = static_cast<size_t>(st.st_size);
+    if (!header_valid(data, size) || !header_matches(data, stamp)) {
+        munmap(data, size);
+        return nullptr;
+    }
+    return std::make_shared<const IndexView>(data, size, true);
+}
+
+bool write_index_file(const std::string& blob) {
+    const std::string tmp_path =
+        std::string(PACKAGE_INDEX_PATH) + "." + std::to_string(getpid()) + ".tmp";
+    const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return false;
+    bool ok = true;
+    size_t written = 0;
+    while (ok && written < blob.size()) {
+        const ssize_t count = write(fd, blob.data() + written, blob.size() - written);
+        if (count < 0 && errno == EINTR)
+            continue;
+        ok = count > 0;
+        if (ok)
+            written += static_cast<size_t>(count);
+    }
+    ok = close(fd) == 0 && ok;
+    // rename() keeps existing mappings of the old index valid in other processes.
+    if (!ok || rename(tmp_path.c_str(), PACKAGE_INDEX_PATH) != 0) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::mutex index_mutex;
+std::shared_ptr<const IndexView> current_index;
+
+// Return an index matching the current packages.list, rebuilding it if needed.
+// Costs two stat() calls when nothing changed.
+std::shared_ptr<const IndexView> acquire_index() {
+    SourceStamp stamp;
+    if (!read_source_stamp(&stamp))
+        return nullptr;
+
+    const std::lock_guard<std::mutex> lock(index_mutex);
+    if (current_index && header_matches(&current_index->header(), stamp))
+        return current_index;
+
+    current_index = map_index_file(stamp);
+    if (current_index)
+        return current_index;
+
+    std::string blob = build_index(stamp);
+    if (write_index_file(blob)) {
+        current_index = map_index_file(stamp);
+        if (current_index) {
+            LOGD("package index rebuilt: %u packages",
+                 current_index->header().package_count);
+            return current_index;
+        }
+    }
+    LOGW("package index: using a private copy, %s not writable", PACKAGE_INDEX_PATH);
+    const size_t size = blob.size();
+    current_index = std::make_shared<const IndexView>(nullptr, size, false, std::move(blob));
+    return current_index;
+}
+
+const PackageRecord* find_package(const IndexView& index, std::string_view package) {
+    const IndexHeader& header = index.header();
+    const uint32_t mask = header.name_slot_count - 1;
+    const uint32_t hash = hash_name(package);
+    for (uint32_t probe = 0, slot = hash & mask; probe < header.name_slot_count;
+         ++probe, slot = (slot + 1) & mask) {
+        const auto& entry = index.at<NameSlot>(header.name_slots_offset, slot);
+        if (entry.package == kEmptySlot)
+            return nullptr;
+        if (entry.hash != hash)
+            continue;
+        const PackageRecord* record = index.package(entry.package);
+        if (record && index.string(record->name_offset, record->name_length) == package)
+            return record;
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+std::vector<std::string> packages_for_uid(uint32_t uid) {
+    std::vector<std::string> result;
+    const auto index = acquire_index();
+    if (!index)
+        return result;
+    const IndexHeader& header = index->header();
+    const uint32_t appid = uid % kPerUserRange;
+    const uint32_t mask = header.uid_slot_count - 1;
+    for (uint32_t probe = 0, slot = hash_appid(appid) & mask; probe < header.uid_slot_count;
+         ++probe, slot = (slot + 1) & mask) {
+        const auto& entry = index->at<UidSlot>(header.uid_slots_offset, slot);
+        if (entry.appid == kEmptySlot)
+            break;
+        if (entry.appid != appid)
+            continue;
+        for (uint32_t i = 0; i < entry.package_count; ++i) {
+            const PackageRecord* record = index->package(entry.first_package + i);
+            if (record)
+                result.emplace_back(index->string(record->name_offset, record->name_length));
+        }
+        break;
+    }
+    return result;
+}
+
+std::vector<std::string> apk_paths(const std::string& package) {
+    std::vector<std::string> result;
+    const auto index = acquire_index();
+    if (!index)
+        return result;
+    const PackageRecord* record = find_package(*index, package);
+    if (!record || !section_fits(index->header().path_count, record->first_path,
+                                 record->path_count, 1))
+        return result;
+    for (uint32_t i = 0; i < record->path_count; ++i) {
+        const auto& path = index->at<PathRecord>(index->header().paths_offset, record->first_path + i);
+        result.emplace_back(index->string(path.offset, path.length));
+    }
+    return result;
+}
+
+}  // namespace package_index
+}  // namespace ksud
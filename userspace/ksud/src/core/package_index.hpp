@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ksud {
+namespace package_index {
+
+// Compact binary index of /data/system/packages.list (uid -> packages) and the
+// installed APKs under /data/app (package -> apk paths). It lives at
+// PACKAGE_INDEX_PATH, is rebuilt by whichever process first notices that
+// packages.list or /data/app changed, and is otherwise shared read-only
+// through mmap, so lookups are a hash probe instead of a file scan or a
+// `cmd package` spawn.
+
+/**
+ * Packages sharing the app id of a uid (any Android user)
+ * @param uid Linux uid, e.g. 10123 or 1010123
+ * Installation per Android user is not recorded; callers filter for that.
+ * @return Package names in packages.list order; empty if the index is
+ *         unavailable or has no match
+ */
+std::vector<std::string> packages_for_uid(uint32_t uid);
+
+/**
+ * APKs of an installed (non-system) package, base.apk first
+ * @param package Package name
+ * @return APK paths; empty for unknown and preinstalled packages
+ */
+std::vector<std::string> apk_paths(const std::string& package);
+
+}  // namespace package_index
+}  // namespace ksud
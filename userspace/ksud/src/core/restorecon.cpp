@@ -1,8 +1,20 @@
 #include "restorecon.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/xattr.h>
+#include <unistd.h>
+#include <algorithm>
 #include <array>
+#include <condition_variable>
+#include <cstdio>
 #include <cstring>
+#include <deque>
 #include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include "../defs.hpp"
 #include "../log.hpp"
@@ -55,26 +67,279 @@ bool restore_syscon(const fs::path& dir) {
     return true;
 }
 
-bool restore_syscon_if_unlabeled(const fs::path& dir) {
-    if (!fs::exists(dir)) {
+namespace {
+
+constexpr size_t kMaxRelabelThreads = 4;
+
+bool is_unlabeled(const char* con, ssize_t len) {
+    if (len <= 0) {
         return true;
     }
+    const size_t n = strnlen(con, static_cast<size_t>(len));
+    return strncmp(con, UNLABEL_CON, n) == 0 && UNLABEL_CON[n] == '\0';
+}
 
-    std::error_code ec;
-    for (auto it = fs::recursive_directory_iterator(dir, ec);
-         it != fs::recursive_directory_iterator() && !ec; it.increment(ec)) {
-        const std::string con = lgetfilecon(it->path());
-        if (con.empty() || con == UNLABEL_CON) {
-            if (!lsetfilecon(it->path(), SYSTEM_CON)) {
-                LOGW("Failed to restore context for %s", it->path().c_str());
+// Directory state at the moment its entries were last known to be labeled.
+// Creating, removing or renaming an entry moves the directory mtime, and
+// relabeling it moves its ctime, so an exact match means the directory and its
+// non-directory entries need no xattr work. Subdirectories are still visited:
+// their changes do not show up in the parent.
+struct DirStamp {
+    int64_t mtime_ns;
+    int64_t ctime_ns;
+
+    bool operator==(const DirStamp& other) const {
+        return mtime_ns == other.mtime_ns && ctime_ns == other.ctime_ns;
+    }
+};
+
+DirStamp stamp_of(const struct stat& st) {
+    return {(static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL) + st.st_mtim.tv_nsec,
+            (static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000LL) + st.st_ctim.tv_nsec};
+}
+
+// Keyed by inode, so a module tree keeps its entries when modules_update/<id>
+// is renamed into modules/ on the next boot.
+using Journal = std::unordered_map<uint64_t, DirStamp>;
+
+Journal load_journal() {
+    Journal journal;
+    std::ifstream in(RESTORECON_JOURNAL_PATH);
+    uint64_t ino = 0;
+    DirStamp stamp{};
+    while (in >> ino >> stamp.mtime_ns >> stamp.ctime_ns) {
+        journal[ino] = stamp;
+    }
+    return journal;
+}
+
+void save_journal(const Journal& journal) {
+    const std::string tmp = std::string(RESTORECON_JOURNAL_PATH) + ".tmp";
+    FILE* out = fopen(tmp.c_str(), "we");
+    if (out == nullptr) {
+        return;
+    }
+    for (const auto& [ino, stamp] : journal) {
+        (void)fprintf(out, "%llu %lld %lld\n", static_cast<unsigned long long>(ino),
+                      static_cast<long long>(stamp.mtime_ns),
+                      static_cast<long long>(stamp.ctime_ns));
+    }
+    if (fclose(out) != 0 || rename(tmp.c_str(), RESTORECON_JOURNAL_PATH) != 0) {
+        unlink(tmp.c_str());
+    }
+}
+
+// Label every unlabeled inode under a root with SYSTEM_CON. Directories are
+// handed out to a few threads through a shared queue; each one is read through
+// its own fd and regular files are checked with fgetxattr on an openat() fd.
+// The queue holds paths rather than open fds so wide trees cannot run the
+// process out of descriptors.
+class Relabeler {
+public:
+    explicit Relabeler(const Journal* journal) : journal_(journal) {}
+
+    bool run(const fs::path& root) {
+        queue_.push_back(root.string());
+        pending_ = 1;
+
+        const size_t threads =
+            std::clamp<size_t>(std::thread::hardware_concurrency(), 1, kMaxRelabelThreads);
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (size_t i = 1; i < threads; ++i) {
+            workers.emplace_back([this] { work(); });
+        }
+        work();
+        for (auto& t : workers) {
+            t.join();
+        }
+        return ok_;
+    }
+
+    // Stamps of every directory visited, taken after it was labeled
+    Journal& stamps() { return stamps_; }
+
+    size_t relabeled() const { return relabeled_; }
+    size_t skipped_dirs() const { return skipped_dirs_; }
+
+private:
+    void work() {
+        for (;;) {
+            std::string path;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return !queue_.empty() || pending_ == 0; });
+                if (queue_.empty()) {
+                    return;
+                }
+                path = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            visit(path);
+            {
+                const std::lock_guard<std::mutex> lock(mutex_);
+                if (--pending_ == 0) {
+                    cv_.notify_all();
+                }
             }
         }
     }
-    if (ec) {
-        LOGE("Error walking directory %s: %s", dir.c_str(), ec.message().c_str());
-        return false;
+
+    void push(std::string path) {
+        {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(path));
+            ++pending_;
+        }
+        cv_.notify_one();
     }
-    return true;
+
+    void fail() {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        ok_ = false;
+    }
+
+    void count(size_t relabeled, bool skipped, uint64_t ino, const DirStamp& stamp) {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        relabeled_ += relabeled;
+        skipped_dirs_ += skipped ? 1 : 0;
+        if (ino != 0) {
+            stamps_[ino] = stamp;
+        }
+    }
+
+    // Both return whether the inode was unlabeled; *failed is set when it stays so.
+    static bool fix_fd(int fd, const std::string& path, bool* failed) {
+        std::array<char, 256> con{};
+        const ssize_t len = fgetxattr(fd, SELINUX_XATTR, con.data(), con.size() - 1);
+        if (!is_unlabeled(con.data(), len)) {
+            return false;
+        }
+        if (fsetxattr(fd, SELINUX_XATTR, SYSTEM_CON, strlen(SYSTEM_CON) + 1, 0) != 0) {
+            LOGW("Failed to restore context for %s: %s", path.c_str(), strerror(errno));
+            *failed = true;
+        }
+        return true;
+    }
+
+    static bool fix_path(const std::string& path, bool* failed) {
+        std::array<char, 256> con{};
+        const ssize_t len = lgetxattr(path.c_str(), SELINUX_XATTR, con.data(), con.size() - 1);
+        if (!is_unlabeled(con.data(), len)) {
+            return false;
+        }
+        if (!lsetfilecon(path, SYSTEM_CON)) {
+            LOGW("Failed to restore context for %s", path.c_str());
+            *failed = true;
+        }
+        return true;
+    }
+
+    void visit(const std::string& dir_path) {
+        const int dir_fd = open(dir_path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (dir_fd < 0) {
+            LOGE("Error walking directory %s: %s", dir_path.c_str(), strerror(errno));
+            fail();
+            return;
+        }
+        bool failed = false;
+        size_t relabeled = fix_fd(dir_fd, dir_path, &failed) ? 1 : 0;
+
+        // Stamp after fixing the directory's own label but before reading it:
+        // an entry created while we read moves the mtime past the stamp and is
+        // picked up next time. Relabeling entries does not touch the stamp.
+        struct stat st{};
+        if (fstat(dir_fd, &st) != 0) {
+            close(dir_fd);
+            fail();
+            return;
+        }
+        const DirStamp stamp = stamp_of(st);
+        const auto known = journal_->find(st.st_ino);
+        const bool skip_entries = known != journal_->end() && known->second == stamp;
+
+        DIR* dir = fdopendir(dir_fd);
+        if (dir == nullptr) {
+            LOGE("Error walking directory %s: %s", dir_path.c_str(), strerror(errno));
+            close(dir_fd);
+            fail();
+            return;
+        }
+        while (const struct dirent* entry = readdir(dir)) {  // NOLINT(concurrency-mt-unsafe)
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat est{};
+                if (fstatat(dir_fd, name, &est, AT_SYMLINK_NOFOLLOW) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(est.st_mode) ? DT_DIR : (S_ISREG(est.st_mode) ? DT_REG : DT_LNK);
+            }
+
+            std::string path = dir_path + "/" + name;
+            if (type == DT_DIR) {
+                push(std::move(path));
+                continue;
+            }
+            if (skip_entries) {
+                continue;
+            }
+            if (type == DT_REG) {
+                const int file = openat(dir_fd, name,
+                                        O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC | O_NOATIME);
+                if (file >= 0) {
+                    relabeled += fix_fd(file, path, &failed) ? 1 : 0;
+                    close(file);
+                    continue;
+                }
+            }
+            // Symlinks and special files cannot be opened safely; go by path.
+            relabeled += fix_path(path, &failed) ? 1 : 0;
+        }
+        closedir(dir);
+
+        // Leave directories with entries we could not fix out of the journal.
+        count(relabeled, skip_entries, failed ? 0 : st.st_ino, stamp);
+    }
+
+    const Journal* journal_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::string> queue_;
+    size_t pending_ = 0;
+    bool ok_ = true;
+    Journal stamps_;
+    size_t relabeled_ = 0;
+    size_t skipped_dirs_ = 0;
+};
+
+}  // namespace
+
+bool restore_syscon_if_unlabeled(const fs::path& dir) {
+    if (!fs::exists(dir)) {
+        return true;
+    }
+
+    const fs::path root = dir.has_filename() ? dir : dir.parent_path();
+    Journal journal = load_journal();
+    Relabeler relabeler(&journal);
+    const bool ok = relabeler.run(root);
+    LOGI("restorecon %s: %zu relabeled, %zu directories unchanged", root.c_str(),
+         relabeler.relabeled(), relabeler.skipped_dirs());
+
+    // A walk over all of /data/adb has seen every live directory; drop the rest.
+    if (root == fs::path(ADB_DIR).parent_path()) {
+        journal = std::move(relabeler.stamps());
+    } else {
+        for (const auto& [ino, stamp] : relabeler.stamps()) {
+            journal[ino] = stamp;
+        }
+    }
+    save_journal(journal);
+    return ok;
 }
 
 bool restorecon() {
@@ -23,7 +23,8 @@ bool setsyscon(const std::filesystem::path& path);
 // Restore system context for directory recursively
 bool restore_syscon(const std::filesystem::path& dir);
 
-// Restore system context if unlabeled
+// Restore system context if unlabeled. Runs on a few threads and skips the
+// entries of directories unchanged since RESTORECON_JOURNAL_PATH recorded them.
 bool restore_syscon_if_unlabeled(const std::filesystem::path& dir);
 
 // Restore contexts for KSU files
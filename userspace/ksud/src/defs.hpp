@@ -35,6 +35,11 @@ constexpr const char* PROFILE_SELINUX_DIR = "/data/adb/ksu/profile/selinux/";
 constexpr const char* PROFILE_TEMPLATE_DIR = "/data/adb/ksu/profile/templates/";
 
 constexpr const char* KSURC_PATH = "/data/adb/ksu/.ksurc";
+constexpr const char* ASSET_MANIFEST_PATH = "/data/adb/ksu/.asset_manifest";
+constexpr const char* PACKAGE_INDEX_PATH = "/data/adb/ksu/.package_index";
+constexpr const char* RESTORECON_JOURNAL_PATH = "/data/adb/ksu/.restorecon_journal";
+constexpr const char* BOOT_TIMELINE_PATH = "/data/adb/ksu/log/boot_timeline.bin";
+constexpr const char* BOOT_TIMELINE_PENDING_PATH = "/data/adb/ksu/log/.boot_timeline.pending";
 constexpr const char* DAEMON_PATH = "/data/adb/ksud";
 constexpr const char* MAGISKBOOT_PATH = "/data/adb/ksu/bin/magiskboot";
 constexpr const char* LIBADBROOT_PATH = "/data/adb/ksu/lib/libadbroot.so";
@@ -80,6 +85,7 @@ constexpr const char* YUKIZYGISK_DIAGNOSTIC_EVIDENCE_PATH =
 constexpr const char* YUKIZYGISK_LEGACY_LOG_DIR = "/data/adb/ksu/yukizygisk/log";
 constexpr const char* DAEMON_LINK_PATH = "/data/adb/ksu/bin/ksud";
 constexpr const char* SULOGD_LOCK_PATH = "/data/adb/ksu/sulogd.lock";
+constexpr const char* SERVE_LOCK_PATH = "/data/adb/ksu/serve.lock";
 
 constexpr const char* MODULE_DIR = "/data/adb/modules/";
 constexpr const char* MODULE_UPDATE_DIR = "/data/adb/modules_update/";
@@ -110,6 +116,7 @@ constexpr const char* METAMODULE_METAUNINSTALL_SCRIPT = "metauninstall.sh";
 constexpr const char* PLUGIN_DIR = "/data/adb/plugins/";
 constexpr const char* PLUGIN_STAGE_DIR = "/data/adb/ksu/plugin_stage/";
 constexpr const char* PLUGIN_LOCK_DIR = "/data/adb/ksu/plugin_locks/";
+constexpr const char* PLUGIN_CACHE_DIR = "/data/adb/ksu/plugin_cache/";
 constexpr const char* PLUGIN_MANIFEST = "plugin.json";
 constexpr const char* PLUGIN_ENTRY = "main.lua";
 constexpr const char* PLUGIN_OUTPUT_LOG = "last_output.log";
@@ -1,6 +1,7 @@
 #include "dynamic_manager.hpp"
 #include "boot/apk_sign.hpp"
 #include "core/json.hpp"
+#include "core/package_index.hpp"
 #include "defs.hpp"
 #include "log.hpp"
 #include "utils.hpp"
@@ -39,6 +40,14 @@ bool parse_size(const std::string& value, uint32_t* out) {
 }
 
 bool parse_size(const json::Value& value, uint32_t* out) {
+    if (value.type == json::Type::Integer) {
+        if (value.i < 0 || value.i > std::numeric_limits<uint32_t>::max()) {
+            return false;
+        }
+        *out = static_cast<uint32_t>(value.i);
+        return true;
+    }
+
     if (value.type == json::Type::Number) {
         if (value.n < 0 || value.n > std::numeric_limits<uint32_t>::max()) {
             return false;
@@ -286,8 +295,24 @@ bool sign_from_apk(const std::string& apk, DynamicManagerSign* sign) {
     return true;
 }
 
+// packages.list lists every package once, whichever users have it installed;
+// a package is installed for a user when its device-encrypted data dir exists.
+bool installed_for_user(const std::string& package_name, uint32_t user_id) {
+    const std::string data_dir = "/data/user_de/" + std::to_string(user_id) + "/" + package_name;
+    return access(data_dir.c_str(), F_OK) == 0;
+}
+
 std::vector<std::string> packages_for_uid(uint32_t uid, uint32_t user_id) {
-    std::vector<std::string> packages;
+    std::vector<std::string> packages = package_index::packages_for_uid(uid);
+    packages.erase(std::remove_if(packages.begin(), packages.end(),
+                                  [user_id](const std::string& package_name) {
+                                      return !installed_for_user(package_name, user_id);
+                                  }),
+                   packages.end());
+    if (!packages.empty()) {
+        return packages;
+    }
+
     const std::string user = std::to_string(user_id);
     ExecResult result = exec_command({"cmd", "package", "list", "packages", "--user", user, "-U"});
     if (result.exit_code != 0 || result.stdout_str.empty()) {
@@ -337,7 +362,12 @@ std::vector<std::string> packages_for_uid(uint32_t uid, uint32_t user_id) {
 }
 
 std::vector<std::string> apk_paths_for_package(const std::string& package_name, uint32_t user_id) {
-    std::vector<std::string> paths;
+    // Preinstalled packages are not indexed; ask the package manager for those.
+    std::vector<std::string> paths = package_index::apk_paths(package_name);
+    if (!paths.empty()) {
+        return paths;
+    }
+
     const std::string user = std::to_string(user_id);
     ExecResult result = exec_command({"cmd", "package", "path", "--user", user, package_name});
     if (result.exit_code != 0 || result.stdout_str.empty()) {
@@ -0,0 +1,525 @@
+#include "block_io.hpp"
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <mbedtls/sha1.h>
+#include <mbedtls/sha256.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "../log.hpp"
+
+namespace ksud::flash {
+
+namespace {
+
+constexpr size_t kChunkSize = size_t{4} * 1024 * 1024;
+constexpr size_t kChunkCount = 3;
+constexpr size_t kBufferAlignment = 4096;
+constexpr uint64_t kZeroOutAlignment = 4096;
+// Granularity of delta writes: small enough that a changed kernel does not drag
+// whole chunks along, large enough to keep the number of pwrite calls low.
+constexpr size_t kDeltaBlockSize = size_t{64} * 1024;
+
+struct AlignedFree {
+    // NOLINTNEXTLINE(cppcoreguidelines-no-malloc): pairs with std::aligned_alloc.
+    void operator()(uint8_t* buffer) const { std::free(buffer); }
+};
+
+using AlignedBuffer = std::unique_ptr<uint8_t[], AlignedFree>;
+
+AlignedBuffer allocate_buffer(size_t size = kChunkSize) {
+    // NOLINTNEXTLINE(cppcoreguidelines-no-malloc): page-aligned block I/O buffer.
+    return AlignedBuffer(static_cast<uint8_t*>(std::aligned_alloc(kBufferAlignment, size)));
+}
+
+class ScopedFd {
+public:
+    explicit ScopedFd(int fd) : fd_(fd) {}
+    ~ScopedFd() {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+    ScopedFd(const ScopedFd&) = delete;
+    ScopedFd& operator=(const ScopedFd&) = delete;
+
+    [[nodiscard]] int get() const { return fd_; }
+    [[nodiscard]] bool valid() const { return fd_ >= 0; }
+    int release() {
+        const int fd = fd_;
+        fd_ = -1;
+        return fd;
+    }
+
+private:
+    int fd_;
+};
+
+class Hasher {
+public:
+    explicit Hasher(DigestKind kind) : kind_(kind) {
+        mbedtls_sha1_init(&sha1_);
+        mbedtls_sha256_init(&sha256_);
+        if (kind_ == DigestKind::Sha1)
+            ok_ = mbedtls_sha1_starts(&sha1_) == 0;
+        else if (kind_ == DigestKind::Sha256)
+            ok_ = mbedtls_sha256_starts(&sha256_, 0) == 0;
+    }
+    ~Hasher() {
+        mbedtls_sha1_free(&sha1_);
+        mbedtls_sha256_free(&sha256_);
+    }
+    Hasher(const Hasher&) = delete;
+    Hasher& operator=(const Hasher&) = delete;
+
+    bool update(const uint8_t* data, size_t size) {
+        if (kind_ == DigestKind::Sha1)
+            ok_ = ok_ && mbedtls_sha1_update(&sha1_, data, size) == 0;
+        else if (kind_ == DigestKind::Sha256)
+            ok_ = ok_ && mbedtls_sha256_update(&sha256_, data, size) == 0;
+        return ok_;
+    }
+
+    std::string finish_hex() {
+        std::array<uint8_t, 32> digest{};
+        size_t size = 0;
+        if (kind_ == DigestKind::Sha1) {
+            ok_ = ok_ && mbedtls_sha1_finish(&sha1_, digest.data()) == 0;
+            size = 20;
+        } else if (kind_ == DigestKind::Sha256) {
+            ok_ = ok_ && mbedtls_sha256_finish(&sha256_, digest.data()) == 0;
+            size = 32;
+        }
+        if (!ok_)
+            return "";
+        static constexpr std::string_view hex_chars = "0123456789abcdef";
+        std::string result;
+        result.reserve(size * 2);
+        for (size_t i = 0; i < size; ++i) {
+            result.push_back(hex_chars[(digest[i] >> 4) & 0xF]);
+            result.push_back(hex_chars[digest[i] & 0xF]);
+        }
+        return result;
+    }
+
+private:
+    DigestKind kind_;
+    bool ok_ = true;
+    mbedtls_sha1_context sha1_{};
+    mbedtls_sha256_context sha256_{};
+};
+
+// Fixed set of buffers handed between the reader thread and the consumer.
+class ChunkQueue {
+public:
+    struct Chunk {
+        uint8_t* data = nullptr;
+        size_t size = 0;
+        uint64_t offset = 0;
+    };
+
+    void push(std::deque<Chunk>* queue, Chunk chunk) {
+        {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            queue->push_back(chunk);
+        }
+        changed_.notify_all();
+    }
+
+    Chunk pop(std::deque<Chunk>* queue) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [queue] { return !queue->empty(); });
+        const Chunk chunk = queue->front();
+        queue->pop_front();
+        return chunk;
+    }
+
+    std::deque<Chunk> free;
+    std::deque<Chunk> filled;
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+};
+
+// Pipes and sockets reject positioned I/O with ESPIPE. Chunks are read and
+// written strictly in order, so plain read()/write() continue the stream there.
+ssize_t pread_full(int fd, uint8_t* buffer, size_t size, uint64_t offset) {
+    size_t total = 0;
+    while (total < size) {
+        ssize_t count =
+            pread(fd, buffer + total, size - total, static_cast<off_t>(offset + total));
+        if (count < 0 && errno == ESPIPE)
+            count = read(fd, buffer + total, size - total);
+        if (count == 0)
+            break;
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        total += static_cast<size_t>(count);
+    }
+    return static_cast<ssize_t>(total);
+}
+
+bool pwrite_full(int fd, const uint8_t* buffer, size_t size, uint64_t offset) {
+    size_t total = 0;
+    while (total < size) {
+        ssize_t count =
+            pwrite(fd, buffer + total, size - total, static_cast<off_t>(offset + total));
+        if (count < 0 && errno == ESPIPE)
+            count = write(fd, buffer + total, size - total);
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR)
+                continue;
+            return false;
+        }
+        total += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+using ChunkFn = std::function<bool(const uint8_t* data, size_t size, uint64_t offset)>;
+
+struct Pipeline {
+    int source_fd = -1;
+    int peer_fd = -1;     // Optional, read alongside the source into data + kChunkSize
+    uint64_t offset = 0;  // Where to start reading both fds
+    uint64_t length = 0;  // 0 reads the source until EOF
+    ChunkFn on_read;      // Runs on the reader thread, may be empty
+    ChunkFn consume;      // Runs on the calling thread
+};
+
+// Stream a range of source_fd through a fixed set of buffers. `on_read` runs on
+// the reader thread right after each read, `consume` on the calling thread, so
+// the two overlap across chunks.
+bool run_pipeline(const Pipeline& pipeline, uint64_t* copied) {
+    const size_t buffer_size = pipeline.peer_fd >= 0 ? kChunkSize * 2 : kChunkSize;
+    std::array<AlignedBuffer, kChunkCount> buffers;
+    ChunkQueue queue;
+    for (auto& buffer : buffers) {
+        buffer = allocate_buffer(buffer_size);
+        if (!buffer) {
+            LOGE("Failed to allocate block I/O buffer");
+            return false;
+        }
+        queue.free.push_back({buffer.get(), 0, 0});
+    }
+
+    const uint64_t length = pipeline.length;
+    std::atomic<bool> stop{false};
+    bool read_ok = true;
+    std::thread reader([&] {
+        uint64_t offset = pipeline.offset;
+        uint64_t remaining = length;
+        while (!stop.load(std::memory_order_relaxed) && (length == 0 || remaining > 0)) {
+            ChunkQueue::Chunk chunk = queue.pop(&queue.free);
+            const size_t requested =
+                length == 0 ? kChunkSize
+                            : static_cast<size_t>(std::min<uint64_t>(kChunkSize, remaining));
+            const ssize_t count = pread_full(pipeline.source_fd, chunk.data, requested, offset);
+            if (count < 0 || (length != 0 && static_cast<size_t>(count) < requested)) {
+                LOGE("Block read failed: %s", count < 0 ? strerror(errno) : "short read");
+                read_ok = false;
+                break;
+            }
+            if (count == 0)
+                break;
+            chunk.size = static_cast<size_t>(count);
+            chunk.offset = offset;
+            if (pipeline.peer_fd >= 0 &&
+                pread_full(pipeline.peer_fd, chunk.data + kChunkSize, chunk.size, offset) !=
+                    count) {
+                LOGE("Block read of target failed: %s", strerror(errno));
+                read_ok = false;
+                break;
+            }
+            if (pipeline.on_read && !pipeline.on_read(chunk.data, chunk.size, chunk.offset)) {
+                read_ok = false;
+                break;
+            }
+            queue.push(&queue.filled, chunk);
+            offset += chunk.size;
+            remaining -= chunk.size;
+            if (length == 0 && chunk.size < requested)
+                break;
+        }
+        queue.push(&queue.filled, {nullptr, 0, 0});
+    });
+
+    bool consume_ok = true;
+    uint64_t total = 0;
+    while (true) {
+        const ChunkQueue::Chunk chunk = queue.pop(&queue.filled);
+        if (chunk.data == nullptr)
+            break;
+        if (consume_ok && !pipeline.consume(chunk.data, chunk.size, chunk.offset)) {
+            consume_ok = false;
+            stop.store(true, std::memory_order_relaxed);
+        }
+        total += chunk.size;
+        queue.push(&queue.free, {chunk.data, 0, 0});
+    }
+    reader.join();
+    if (copied)
+        *copied = total;
+    return read_ok && consume_ok;
+}
+
+// Write the kDeltaBlockSize blocks of `data` that differ from `current`,
+// coalescing neighbouring blocks into one pwrite.
+bool write_changed_blocks(int fd, const uint8_t* data, const uint8_t* current, size_t size,
+                          uint64_t offset, uint64_t* written) {
+    size_t position = 0;
+    while (position < size) {
+        size_t block = std::min(kDeltaBlockSize, size - position);
+        if (std::memcmp(data + position, current + position, block) == 0) {
+            position += block;
+            continue;
+        }
+        const size_t start = position;
+        position += block;
+        while (position < size) {
+            block = std::min(kDeltaBlockSize, size - position);
+            if (std::memcmp(data + position, current + position, block) == 0)
+                break;
+            position += block;
+        }
+        if (!pwrite_full(fd, data + start, position - start, offset + start)) {
+            LOGE("Block write failed: %s", strerror(errno));
+            return false;
+        }
+        *written += position - start;
+    }
+    return true;
+}
+
+uint64_t block_device_size(int fd) {
+    uint64_t size = 0;
+    return ioctl(fd, BLKGETSIZE64, &size) == 0 ? size : 0;
+}
+
+bool zero_with_writes(int fd, uint64_t offset, uint64_t end) {
+    const AlignedBuffer zeroes = allocate_buffer();
+    if (!zeroes)
+        return false;
+    std::memset(zeroes.get(), 0, kChunkSize);
+    while (offset < end) {
+        const size_t size = static_cast<size_t>(std::min<uint64_t>(kChunkSize, end - offset));
+        if (!pwrite_full(fd, zeroes.get(), size, offset))
+            return false;
+        offset += size;
+    }
+    return true;
+}
+
+// Zero [offset, end). The aligned middle goes through BLKZEROOUT so the device
+// (or the block layer) clears it without streaming zero pages from userspace.
+bool zero_range(int fd, uint64_t offset, uint64_t end, bool block_device) {
+    if (offset >= end)
+        return true;
+    const uint64_t aligned_start =
+        std::min(end, (offset + kZeroOutAlignment - 1) & ~(kZeroOutAlignment - 1));
+    const uint64_t aligned_end = aligned_start + ((end - aligned_start) & ~(kZeroOutAlignment - 1));
+    if (!block_device || aligned_end <= aligned_start)
+        return zero_with_writes(fd, offset, end);
+
+    if (!zero_with_writes(fd, offset, aligned_start))
+        return false;
+    std::array<uint64_t, 2> range = {aligned_start, aligned_end - aligned_start};
+    if (ioctl(fd, BLKZEROOUT, range.data()) != 0) {
+        LOGW("BLKZEROOUT failed (%s), zeroing with writes", strerror(errno));
+        return zero_with_writes(fd, aligned_start, end);
+    }
+    return zero_with_writes(fd, aligned_end, end);
+}
+
+}  // namespace
+
+CopyResult copy_range(const std::string& source, const std::string& target, uint64_t length,
+                      DigestKind digest, uint64_t zero_tail_to) {
+    CopyResult result;
+    const ScopedFd input(open(source.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!input.valid()) {
+        LOGE("Failed to open %s: %s", source.c_str(), strerror(errno));
+        return result;
+    }
+    (void)posix_fadvise(input.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    struct stat target_status{};
+    const bool block_device =
+        stat(target.c_str(), &target_status) == 0 && S_ISBLK(target_status.st_mode);
+    const int flags = block_device ? O_WRONLY | O_CLOEXEC : O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    ScopedFd output(open(target.c_str(), flags, 0644));
+    if (!output.valid()) {
+        LOGE("Failed to open %s for writing: %s", target.c_str(), strerror(errno));
+        return result;
+    }
+
+    Hasher hasher(digest);
+    const int output_fd = output.get();
+    Pipeline pipeline;
+    pipeline.source_fd = input.get();
+    pipeline.length = length;
+    pipeline.on_read = [&hasher, digest](const uint8_t* data, size_t size, uint64_t) {
+        return digest == DigestKind::None || hasher.update(data, size);
+    };
+    pipeline.consume = [output_fd](const uint8_t* data, size_t size, uint64_t offset) {
+        if (pwrite_full(output_fd, data, size, offset))
+            return true;
+        LOGE("Block write failed: %s", strerror(errno));
+        return false;
+    };
+    bool success = run_pipeline(pipeline, &result.bytes);
+    result.written = result.bytes;
+
+    if (success && zero_tail_to > result.bytes) {
+        LOGD("Zeroing unwritten tail [%llu, %llu)", static_cast<unsigned long long>(result.bytes),
+             static_cast<unsigned long long>(zero_tail_to));
+        if (zero_range(output_fd, result.bytes, zero_tail_to, block_device)) {
+            result.written += zero_tail_to - result.bytes;
+        } else {
+            LOGE("Failed to zero target tail: %s", strerror(errno));
+            success = false;
+        }
+    }
+    if (fsync(output_fd) != 0) {
+        LOGE("Failed to sync %s: %s", target.c_str(), strerror(errno));
+        success = false;
+    }
+    if (close(output.release()) != 0)
+        success = false;
+
+    if (!success)
+        return result;
+    if (digest != DigestKind::None) {
+        result.digest = hasher.finish_hex();
+        if (result.digest.empty())
+            return result;
+    }
+    result.ok = true;
+    return result;
+}
+
+CopyResult delta_copy_range(const std::string& source, const std::string& target, uint64_t length,
+                            DigestKind digest, uint64_t zero_tail_to) {
+    CopyResult result;
+    const ScopedFd input(open(source.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!input.valid()) {
+        LOGE("Failed to open %s: %s", source.c_str(), strerror(errno));
+        return result;
+    }
+    struct stat source_status{};
+    if (length == 0 && fstat(input.get(), &source_status) == 0 && S_ISREG(source_status.st_mode))
+        length = static_cast<uint64_t>(source_status.st_size);
+
+    ScopedFd output(open(target.c_str(), O_RDWR | O_CLOEXEC));
+    struct stat target_status{};
+    if (length == 0 || !output.valid() || fstat(output.get(), &target_status) != 0) {
+        LOGD("Delta copy to %s not possible, rewriting it", target.c_str());
+        return copy_range(source, target, length, digest, zero_tail_to);
+    }
+    const bool block_device = S_ISBLK(target_status.st_mode);
+    const uint64_t target_size = block_device ? block_device_size(output.get())
+                                              : static_cast<uint64_t>(target_status.st_size);
+    if (target_size < std::max(length, zero_tail_to)) {
+        LOGD("Target %s is smaller than the copy, rewriting it", target.c_str());
+        close(output.release());
+        return copy_range(source, target, length, digest, zero_tail_to);
+    }
+    (void)posix_fadvise(input.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    (void)posix_fadvise(output.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    Hasher hasher(digest);
+    const int output_fd = output.get();
+    Pipeline pipeline;
+    pipeline.source_fd = input.get();
+    pipeline.peer_fd = output_fd;
+    pipeline.length = length;
+    pipeline.on_read = [&hasher, digest](const uint8_t* data, size_t size, uint64_t) {
+        return digest == DigestKind::None || hasher.update(data, size);
+    };
+    pipeline.consume = [output_fd, &result](const uint8_t* data, size_t size, uint64_t offset) {
+        return write_changed_blocks(output_fd, data, data + kChunkSize, size, offset,
+                                    &result.written);
+    };
+    bool success = run_pipeline(pipeline, &result.bytes);
+
+    // The tail is compared against zeroes the same way, so an already clean
+    // tail costs reads only.
+    if (success && zero_tail_to > result.bytes) {
+        const AlignedBuffer zeroes = allocate_buffer();
+        success = zeroes != nullptr;
+        if (success) {
+            std::memset(zeroes.get(), 0, kChunkSize);
+            Pipeline tail;
+            tail.source_fd = output_fd;
+            tail.offset = result.bytes;
+            tail.length = zero_tail_to - result.bytes;
+            tail.consume = [output_fd, &zeroes, &result](const uint8_t* data, size_t size,
+                                                         uint64_t offset) {
+                return write_changed_blocks(output_fd, zeroes.get(), data, size, offset,
+                                            &result.written);
+            };
+            success = run_pipeline(tail, nullptr);
+        }
+        if (!success)
+            LOGE("Failed to zero target tail");
+    }
+    if (result.written > 0 && fsync(output_fd) != 0) {
+        LOGE("Failed to sync %s: %s", target.c_str(), strerror(errno));
+        success = false;
+    }
+    if (close(output.release()) != 0)
+        success = false;
+
+    LOGI("Delta copy %s -> %s: wrote %llu of %llu bytes", source.c_str(), target.c_str(),
+         static_cast<unsigned long long>(result.written),
+         static_cast<unsigned long long>(std::max(result.bytes, zero_tail_to)));
+    if (!success)
+        return result;
+    if (digest != DigestKind::None) {
+        result.digest = hasher.finish_hex();
+        if (result.digest.empty())
+            return result;
+    }
+    result.ok = true;
+    return result;
+}
+
+std::string hash_range(const std::string& path, uint64_t length, DigestKind digest,
+                       bool drop_cache) {
+    const ScopedFd input(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!input.valid()) {
+        LOGE("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return "";
+    }
+    if (drop_cache)
+        (void)posix_fadvise(input.get(), 0, 0, POSIX_FADV_DONTNEED);
+    (void)posix_fadvise(input.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    Hasher hasher(digest);
+    Pipeline pipeline;
+    pipeline.source_fd = input.get();
+    pipeline.length = length;
+    pipeline.consume = [&hasher](const uint8_t* data, size_t size, uint64_t) {
+        return hasher.update(data, size);
+    };
+    return run_pipeline(pipeline, nullptr) ? hasher.finish_hex() : "";
+}
+
+}  // namespace ksud::flash
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace ksud {
+namespace flash {
+
+enum class DigestKind { None, Sha1, Sha256 };
+
+struct CopyResult {
+    bool ok = false;
+    uint64_t bytes = 0;    // Bytes read from the source
+    uint64_t written = 0;  // Bytes written to the target, including a zeroed tail
+    std::string digest;  // Hex digest of the copied bytes, empty for DigestKind::None
+};
+
+/**
+ * Copy a file or block device to another file or block device.
+ * Reads run on a helper thread with large aligned buffers and hash the data
+ * there, so hashing overlaps the writes. The target is fsync'ed once at the end.
+ * @param source Source path
+ * @param target Target path (a regular file is created/truncated, a block device is not)
+ * @param length Bytes to copy, 0 to copy until EOF
+ * @param digest Digest to compute over the copied bytes
+ * @param zero_tail_to If larger than the copied size, zero the target up to this offset
+ *                     (BLKZEROOUT on block devices, buffered writes otherwise)
+ * @return Copy result; ok is false on any read/write/sync error or short source
+ */
+CopyResult copy_range(const std::string& source, const std::string& target, uint64_t length,
+                      DigestKind digest, uint64_t zero_tail_to = 0);
+
+/**
+ * Copy like copy_range(), but compare every chunk with what the target already
+ * holds and rewrite only the 64 KiB blocks that differ. The zeroed tail is
+ * handled the same way. Falls back to copy_range() when the target does not
+ * exist yet or is smaller than the copy.
+ * @param source Source path
+ * @param target Existing target file or block device
+ * @param length Bytes to copy, 0 for the size of a regular source file
+ * @param digest Digest to compute over the source bytes
+ * @param zero_tail_to If larger than the copied size, make the target zero up to this offset
+ * @return Copy result; written holds the bytes actually rewritten
+ */
+CopyResult delta_copy_range(const std::string& source, const std::string& target,
+                            uint64_t length, DigestKind digest, uint64_t zero_tail_to = 0);
+
+/**
+ * Hash the first bytes of a file or block device.
+ * @param path File or block device path
+ * @param length Bytes to hash, 0 to hash until EOF
+ * @param digest Digest to compute
+ * @param drop_cache Drop cached pages first so data is read back from the device
+ * @return Hex digest, empty on failure or short input
+ */
+std::string hash_range(const std::string& path, uint64_t length, DigestKind digest,
+                       bool drop_cache = false);
+
+}  // namespace flash
+}  // namespace ksud
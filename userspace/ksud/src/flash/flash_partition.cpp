@@ -1,21 +1,22 @@
 #include "flash_partition.hpp"
 #include <fcntl.h>
 #include <linux/fs.h>
-#include <mbedtls/sha256.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <algorithm>
 #include <array>
+#include <cerrno>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <sstream>  // for std::istringstream
 #include <string>
-#include <string_view>
 #include <vector>
 #include "../boot/tools.hpp"
 #include "../log.hpp"
 #include "../utils.hpp"
+#include "block_io.hpp"
 
 // miniz is header-only in this context or linked
 #define MINIZ_HEADER_FILE_ONLY
@@ -32,18 +33,6 @@ ExecResult exec_command_sync(const std::vector<std::string>& args) {
     return exec_command(args);
 }
 
-// Helper: Convert bytes to hex string
-std::string bytes_to_hex(const unsigned char* data, size_t len) {
-    static constexpr std::string_view hex_chars = "0123456789abcdef";
-    std::string result;
-    result.reserve(len * 2);
-    for (size_t i = 0; i < len; ++i) {
-        result.push_back(hex_chars[(data[i] >> 4) & 0xF]);
-        result.push_back(hex_chars[data[i] & 0xF]);
-    }
-    return result;
-}
-
 // Helper: Get file size (handles both regular files and block devices)
 uint64_t get_file_size(const std::string& path) {
     struct stat st{};
@@ -93,19 +82,6 @@ std::string get_block_device_slot_suffix(const std::string& block_device) {
     return suffix == "_a" || suffix == "_b" ? suffix : "";
 }
 
-std::string shell_quote(const std::string& value) {
-    std::string quoted = "'";
-    for (const char c : value) {
-        if (c == '\'') {
-            quoted += "'\\''";
-        } else {
-            quoted.push_back(c);
-        }
-    }
-    quoted.push_back('\'');
-    return quoted;
-}
-
 // Helper: Execute command and get output
 std::string exec_cmd(const std::string& cmd) {
     auto result = exec_command_sync({"/system/bin/sh", "-c", cmd});
@@ -337,7 +313,7 @@ std::vector<std::string> get_available_partitions(bool scan_all, const std::stri
 }
 
 std::string flash_physical_partition(const std::string& image_path, const std::string& block_device,
-                                     bool verify_hash) {
+                                     bool verify_hash, bool delta, uint64_t* bytes_written) {
     LOGI("Flashing %s to %s (physical)", image_path.c_str(), block_device.c_str());
 
     if (!fs::exists(image_path)) {
@@ -364,178 +340,45 @@ std::string flash_physical_partition(const std::string& image_path, const std::s
         return "";
     }
 
-    // Open both ends before modifying the target. This avoids clearing a
-    // partition only to discover that the source cannot be read.
-    std::ifstream input(image_path, std::ios::binary);
-    if (!input) {
-        LOGE("Failed to open image file");
-        return "";
+    // Both copy paths open the source before touching the target and only zero
+    // the unwritten tail after the image has been copied, so a failed preflight
+    // never clears the partition. The delta path additionally skips blocks the
+    // partition already holds, which is most of them for kernel-only updates.
+    const DigestKind digest = verify_hash ? DigestKind::Sha256 : DigestKind::None;
+    const CopyResult copied =
+        delta ? delta_copy_range(image_path, block_device, image_size, digest, partition_size)
+              : copy_range(image_path, block_device, image_size, digest, partition_size);
+    if (bytes_written) {
+        *bytes_written = copied.written;
     }
-
-    const int fd = open(block_device.c_str(), O_WRONLY | O_SYNC);
-    if (fd < 0) {
-        LOGE("Failed to open block device for writing: %s", strerror(errno));
-        return "";
-    }
-
-    std::array<char, 4096> buffer{};
-    bool success = true;
-    mbedtls_sha256_context source_hash_context{};
-    std::array<unsigned char, 32> source_digest{};
-    mbedtls_sha256_init(&source_hash_context);
-    if (verify_hash && mbedtls_sha256_starts(&source_hash_context, 0) != 0) {
-        LOGE("Failed to initialize source SHA256");
-        mbedtls_sha256_free(&source_hash_context);
-        close(fd);
-        return "";
-    }
-
-    while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0) {
-        const auto bytes_read = static_cast<size_t>(input.gcount());
-
-        if (verify_hash &&
-            mbedtls_sha256_update(
-                &source_hash_context,
-                reinterpret_cast<const unsigned char*>(buffer.data()),
-                bytes_read) != 0) {
-            LOGE("Failed to update source SHA256");
-            success = false;
-            break;
-        }
-
-        size_t written = 0;
-        while (written < bytes_read) {
-            const ssize_t result = write(fd, buffer.data() + written, bytes_read - written);
-            if (result <= 0) {
-                LOGE("Write failed: %s", strerror(errno));
-                success = false;
-                break;
-            }
-            written += static_cast<size_t>(result);
-        }
-        if (!success) {
-            break;
-        }
-    }
-    if (input.bad()) {
-        LOGE("Failed while reading image file");
-        success = false;
-    }
-
-    // Clear only the unwritten tail after the image has been copied. This keeps
-    // stale bytes out without destructively zeroing the target before preflight.
-    if (success && image_size < partition_size) {
-        LOGD("Zeroing unwritten partition tail");
-        std::array<char, 4096> zero_buffer{};
-        uint64_t remaining = partition_size - image_size;
-        while (remaining > 0) {
-            const size_t requested =
-                static_cast<size_t>(std::min<uint64_t>(zero_buffer.size(), remaining));
-            size_t written = 0;
-            while (written < requested) {
-                const ssize_t result =
-                    write(fd, zero_buffer.data() + written, requested - written);
-                if (result <= 0) {
-                    LOGE("Failed to zero partition tail: %s", strerror(errno));
-                    success = false;
-                    break;
-                }
-                written += static_cast<size_t>(result);
-            }
-            if (!success) {
-                break;
-            }
-            remaining -= requested;
-        }
-    }
-
-    if (fsync(fd) != 0) {
-        LOGE("Failed to sync block device: %s", strerror(errno));
-        success = false;
-    }
-    close(fd);
-    input.close();
-
-    if (verify_hash &&
-        mbedtls_sha256_finish(&source_hash_context, source_digest.data()) != 0) {
-        LOGE("Failed to finish source SHA256");
-        success = false;
-    }
-    mbedtls_sha256_free(&source_hash_context);
-
-    if (!success) {
+    if (!copied.ok) {
+        LOGE("Failed to write %s to %s", image_path.c_str(), block_device.c_str());
         return "";
     }
+    LOGI("Wrote %lu of %lu bytes to %s", static_cast<unsigned long>(copied.written),
+         static_cast<unsigned long>(partition_size), block_device.c_str());
 
     if (!verify_hash) {
         LOGI("Flash complete (no verification)");
-        sync();
         return "success";
     }
 
-    // Read back exactly the bytes written and compare hashes. The previous
-    // implementation only hashed the source and retained the entire image in
-    // memory, which could OOM on large dynamic partitions without verifying
-    // what reached the block device.
-    const int verify_fd = open(block_device.c_str(), O_RDONLY);
-    if (verify_fd < 0) {
-        LOGE("Failed to open block device for verification: %s", strerror(errno));
-        return "";
-    }
-
-    mbedtls_sha256_context target_hash_context{};
-    std::array<unsigned char, 32> target_digest{};
-    mbedtls_sha256_init(&target_hash_context);
-    if (mbedtls_sha256_starts(&target_hash_context, 0) != 0) {
-        LOGE("Failed to initialize target SHA256");
-        mbedtls_sha256_free(&target_hash_context);
-        close(verify_fd);
-        return "";
-    }
-
-    uint64_t remaining = image_size;
-    while (remaining > 0) {
-        const size_t requested =
-            static_cast<size_t>(std::min<uint64_t>(buffer.size(), remaining));
-        const ssize_t bytes_read = read(verify_fd, buffer.data(), requested);
-        if (bytes_read <= 0) {
-            LOGE("Failed to read flashed data for verification: %s", strerror(errno));
-            success = false;
-            break;
-        }
-        if (mbedtls_sha256_update(
-                &target_hash_context,
-                reinterpret_cast<const unsigned char*>(buffer.data()),
-                static_cast<size_t>(bytes_read)) != 0) {
-            LOGE("Failed to update target SHA256");
-            success = false;
-            break;
-        }
-        remaining -= static_cast<uint64_t>(bytes_read);
-    }
-    close(verify_fd);
-
-    if (success &&
-        mbedtls_sha256_finish(&target_hash_context, target_digest.data()) != 0) {
-        LOGE("Failed to finish target SHA256");
-        success = false;
-    }
-    mbedtls_sha256_free(&target_hash_context);
-
-    if (!success || source_digest != target_digest) {
+    // Read back exactly the bytes written and compare hashes. The page cache is
+    // dropped first so the comparison sees what reached the block device.
+    const std::string target_hash = hash_range(block_device, image_size, DigestKind::Sha256, true);
+    if (target_hash.empty() || target_hash != copied.digest) {
         LOGE("Flash verification failed: source and target SHA256 differ");
         return "";
     }
 
-    const std::string hash = bytes_to_hex(source_digest.data(), source_digest.size());
-    LOGI("Flash verified, SHA256: %s", hash.c_str());
-    sync();
-    return hash;
+    LOGI("Flash verified, SHA256: %s", copied.digest.c_str());
+    return copied.digest;
 }
 
 std::string flash_logical_partition(const std::string& image_path,
                                     const std::string& partition_name,
-                                    const std::string& slot_suffix, bool verify_hash) {
+                                    const std::string& slot_suffix, bool verify_hash, bool delta,
+                                    uint64_t* bytes_written) {
     LOGI("Flashing %s to %s%s (logical)", image_path.c_str(), partition_name.c_str(),
          slot_suffix.c_str());
 
@@ -574,7 +417,7 @@ std::string flash_logical_partition(const std::string& image_path,
         }
 
         const std::string block_dev = "/dev/block/mapper/" + full_partition;
-        return flash_physical_partition(image_path, block_dev, verify_hash);
+        return flash_physical_partition(image_path, block_dev, verify_hash, delta, bytes_written);
     }
 
     // Unmap and remap temp partition
@@ -582,7 +425,9 @@ std::string flash_logical_partition(const std::string& image_path,
     exec_cmd("lptools map " + temp_partition);
 
     const std::string temp_block_dev = "/dev/block/mapper/" + temp_partition;
-    std::string hash = flash_physical_partition(image_path, temp_block_dev, verify_hash);
+    // The temporary partition is freshly allocated, so there is nothing to diff against.
+    std::string hash =
+        flash_physical_partition(image_path, temp_block_dev, verify_hash, false, bytes_written);
 
     if (hash.empty()) {
         LOGE("Failed to flash temporary partition");
@@ -604,7 +449,8 @@ std::string flash_logical_partition(const std::string& image_path,
 
 // NOLINTNEXTLINE(bugprone-easily-swappable-parameters) image_path vs partition_name are distinct
 bool flash_partition(const std::string& image_path, const std::string& partition_name,
-                     const std::string& slot_suffix, bool verify_hash) {
+                     const std::string& slot_suffix, bool verify_hash, bool delta,
+                     uint64_t* bytes_written) {
     // Use provided slot, or auto-detect if empty
     const std::string suffix = slot_suffix.empty() ? get_current_slot_suffix() : slot_suffix;
 
@@ -616,9 +462,11 @@ bool flash_partition(const std::string& image_path, const std::string& partition
 
     std::string hash;
     if (info.is_logical) {
-        hash = flash_logical_partition(image_path, partition_name, suffix, verify_hash);
+        hash = flash_logical_partition(image_path, partition_name, suffix, verify_hash, delta,
+                                       bytes_written);
     } else {
-        hash = flash_physical_partition(image_path, info.block_device, verify_hash);
+        hash = flash_physical_partition(image_path, info.block_device, verify_hash, delta,
+                                        bytes_written);
     }
 
     return !hash.empty();
@@ -648,20 +496,20 @@ bool backup_partition(const std::string& partition_name, const std::string& outp
         }
     }
 
-    // Use dd for backup and require both a successful command and an exact-size
-    // output. A truncated non-empty file must never be reported as a valid backup.
-    const std::string cmd = "dd if=" + shell_quote(info.block_device) +
-                            " of=" + shell_quote(output_path) + " bs=4096 2>/dev/null && sync";
-    const auto result = exec_command_sync({"/system/bin/sh", "-c", cmd});
+    // Require both a successful copy and an exact-size output. A truncated
+    // non-empty file must never be reported as a valid backup.
+    const CopyResult copied =
+        info.size > 0 ? copy_range(info.block_device, output_path, info.size, DigestKind::None)
+                      : CopyResult{};
     const uint64_t output_size = get_file_size(output_path);
 
-    if (result.exit_code == 0 && info.size > 0 && output_size == info.size) {
+    if (copied.ok && output_size == info.size) {
         LOGI("Backup complete: %s", output_path.c_str());
         return true;
     }
 
-    LOGE("Backup failed: exit=%d, expected=%lu, actual=%lu", result.exit_code,
-         static_cast<unsigned long>(info.size), static_cast<unsigned long>(output_size));
+    LOGE("Backup failed: expected=%lu, actual=%lu", static_cast<unsigned long>(info.size),
+         static_cast<unsigned long>(output_size));
     std::error_code remove_error;
     fs::remove(output_path, remove_error);
     return false;
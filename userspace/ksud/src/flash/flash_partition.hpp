@@ -86,10 +86,13 @@ bool is_excluded_from_batch(const std::string& partition_name);
  * @param image_path Path to image file to flash
  * @param block_device Block device path
  * @param verify_hash Whether to verify SHA256 hash after flashing
+ * @param delta Compare with the partition first and rewrite only differing blocks
+ * @param bytes_written Optional output for the number of bytes actually written
  * @return SHA256 hash of flashed data, empty on failure
  */
 std::string flash_physical_partition(const std::string& image_path, const std::string& block_device,
-                                     bool verify_hash = true);
+                                     bool verify_hash = true, bool delta = true,
+                                     uint64_t* bytes_written = nullptr);
 
 /**
  * Flash image to logical partition (dynamic partition)
@@ -97,11 +100,14 @@ std::string flash_physical_partition(const std::string& image_path, const std::s
  * @param partition_name Partition name without slot suffix
  * @param slot_suffix Current slot suffix
  * @param verify_hash Whether to verify SHA256 hash after flashing
+ * @param delta Rewrite only differing blocks when flashing the partition in place
+ * @param bytes_written Optional output for the number of bytes actually written
  * @return SHA256 hash of flashed data, empty on failure
  */
 std::string flash_logical_partition(const std::string& image_path,
                                     const std::string& partition_name,
-                                    const std::string& slot_suffix, bool verify_hash = true);
+                                    const std::string& slot_suffix, bool verify_hash = true,
+                                    bool delta = true, uint64_t* bytes_written = nullptr);
 
 /**
  * Flash image to partition (auto-detect logical/physical)
@@ -109,10 +115,13 @@ std::string flash_logical_partition(const std::string& image_path,
  * @param partition_name Partition name
  * @param slot_suffix Slot suffix (optional, auto-detected if empty)
  * @param verify_hash Whether to verify hash
+ * @param delta Compare with the partition first and rewrite only differing blocks
+ * @param bytes_written Optional output for the number of bytes actually written
  * @return true on success, false on failure
  */
 bool flash_partition(const std::string& image_path, const std::string& partition_name,
-                     const std::string& slot_suffix = "", bool verify_hash = true);
+                     const std::string& slot_suffix = "", bool verify_hash = true,
+                     bool delta = true, uint64_t* bytes_written = nullptr);
 
 /**
  * Backup partition to file
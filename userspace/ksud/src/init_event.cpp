@@ -1,5 +1,6 @@
 #include "init_event.hpp"
 #include "assets.hpp"
+#include "boot_timeline.hpp"
 #include "core/feature.hpp"
 #include "core/hide_bootloader.hpp"
 #include "core/ksucalls.hpp"
@@ -15,6 +16,7 @@
 #include "module/module_config.hpp"
 #include "plugin/lua_engine.hpp"
 #include "profile/profile.hpp"
+#include "serve.hpp"
 #include "sulog.hpp"
 #include "umount.hpp"
 #include "utils.hpp"
@@ -209,15 +211,25 @@ void run_stage(const std::string& stage, bool block) {
     }
 
     // Execute common scripts first
-    exec_common_scripts(stage + ".d", block);
+    {
+        const BootSpan span(BootSpanKind::Step, "common-scripts", stage);
+        exec_common_scripts(stage + ".d", block);
+    }
 
     // Execute metamodule stage script (priority)
-    metamodule_exec_stage_script(stage, block);
+    {
+        const BootSpan span(BootSpanKind::Step, "metamodule-script", stage);
+        metamodule_exec_stage_script(stage, block);
+    }
 
     // Execute regular modules stage scripts
-    exec_stage_script(stage, block);
+    {
+        const BootSpan span(BootSpanKind::Step, "module-scripts", stage);
+        exec_stage_script(stage, block);
+    }
 
     // Execute plugin stage callbacks
+    const BootSpan span(BootSpanKind::Step, "plugins", stage);
     exec_plugin_stage(stage, block);
 }
 
@@ -400,6 +412,7 @@ void ensure_zygiskd_running_if_enabled() {
 
 int on_post_data_fs() {
     LOGI("post-fs-data triggered");
+    const BootStageScope timeline("post-fs-data", BootStagePhase::First);
     (void)prepare_yukizygisk_diagnostics(false);
 
     if (!ensure_uapi_version_matched()) {
@@ -440,6 +453,7 @@ int on_post_data_fs() {
         LOGW("safe mode, skip common post-fs-data.d scripts");
     } else {
         // Execute common post-fs-data scripts
+        const BootSpan span(BootSpanKind::Step, "common-scripts", "post-fs-data");
         exec_common_scripts("post-fs-data.d", true);
     }
 
@@ -450,8 +464,11 @@ int on_post_data_fs() {
     ensure_dir_exists(PROFILE_DIR);
 
     // Ensure binaries exist (AFTER safe mode check, like Rust)
-    if (ensure_binaries(true) != 0) {
-        LOGW("Failed to ensure binaries");
+    {
+        const BootSpan span(BootSpanKind::Step, "extract-assets");
+        if (ensure_binaries(true) != 0) {
+            LOGW("Failed to ensure binaries");
+        }
     }
 
     // if we are in safe mode, we should disable all modules
@@ -461,26 +478,41 @@ int on_post_data_fs() {
         return 0;
     }
 
-    // Handle updated modules
-    handle_updated_modules();
+    {
+        const BootSpan span(BootSpanKind::Step, "update-modules");
+        // Handle updated modules
+        handle_updated_modules();
 
-    // Prune modules marked for removal
-    prune_modules();
+        // Prune modules marked for removal
+        prune_modules();
+    }
 
     // Refresh custom init rc for the next boot. This also covers manual edits in
     // /data/adb/initrc.d.
-    if (regenerate_preinit_rc() != 0) {
-        LOGW("regenerate preinit rc failed");
+    {
+        const BootSpan span(BootSpanKind::Step, "preinit-rc");
+        if (regenerate_preinit_rc() != 0) {
+            LOGW("regenerate preinit rc failed");
+        }
     }
 
     // Restorecon
-    restorecon("/data/adb", true);
+    {
+        const BootSpan span(BootSpanKind::Step, "restorecon", "/data/adb");
+        restorecon("/data/adb", true);
+    }
 
     // Load sepolicy rules from modules
-    load_sepolicy_rule();
+    {
+        const BootSpan span(BootSpanKind::Step, "sepolicy-rules");
+        load_sepolicy_rule();
+    }
 
     // Apply profile sepolicies
-    apply_profile_sepolies();
+    {
+        const BootSpan span(BootSpanKind::Step, "profile-sepolicy");
+        apply_profile_sepolies();
+    }
 
     // Restore the independent UTS extension before generic feature handling.
     if (apply_uts_view_config() != 0) {
@@ -488,7 +520,10 @@ int on_post_data_fs() {
     }
 
     // Load feature config (with init_features handling managed features)
-    init_features();
+    {
+        const BootSpan span(BootSpanKind::Step, "features");
+        init_features();
+    }
     const auto [yz_value, yz_supported] = get_feature(KSU_FEATURE_YUKIZYGISK);
     const bool yz_enabled = yz_supported && yz_value != 0;
     if (yz_enabled)
@@ -509,13 +544,28 @@ int on_post_data_fs() {
     // 5. Metamodule's metamount.sh  <-- MUST run AFTER all post-fs-data
     // 6. post-mount.d
 
-    metamodule_exec_stage_script("post-fs-data", true);
-    exec_stage_script("post-fs-data", true);
-    exec_plugin_stage("post-fs-data", true);
-    load_system_prop();
+    {
+        const BootSpan span(BootSpanKind::Step, "metamodule-script", "post-fs-data");
+        metamodule_exec_stage_script("post-fs-data", true);
+    }
+    {
+        const BootSpan span(BootSpanKind::Step, "module-scripts", "post-fs-data");
+        exec_stage_script("post-fs-data", true);
+    }
+    {
+        const BootSpan span(BootSpanKind::Step, "plugins", "post-fs-data");
+        exec_plugin_stage("post-fs-data", true);
+    }
+    {
+        const BootSpan span(BootSpanKind::Step, "system-prop");
+        load_system_prop();
+    }
 
     // Metamodule metamount runs AFTER all post-fs-data.
-    metamodule_exec_mount_script();
+    {
+        const BootSpan span(BootSpanKind::Step, "metamount");
+        metamodule_exec_mount_script();
+    }
 
     umount_apply_config();
 
@@ -532,6 +582,7 @@ int on_post_data_fs() {
 
 void on_services() {
     LOGI("services triggered");
+    const BootStageScope timeline("services", BootStagePhase::Middle);
 
     if (!ensure_uapi_version_matched()) {
         LOGE("Skip services due to UAPI version mismatch");
@@ -540,7 +591,10 @@ void on_services() {
 
     // Hide bootloader unlock status (soft BL hiding)
     // Service stage is the correct timing - after boot_completed is set
-    hide_bootloader_status();
+    {
+        const BootSpan span(BootSpanKind::Step, "hide-bootloader");
+        hide_bootloader_status();
+    }
 
     run_stage("service", false);
 
@@ -549,6 +603,7 @@ void on_services() {
 
 void on_boot_completed() {
     LOGI("boot-completed triggered");
+    const BootStageScope timeline("boot-completed", BootStagePhase::Last);
 
     if (!ensure_uapi_version_matched()) {
         LOGE("Skip boot-completed due to UAPI version mismatch");
@@ -558,7 +613,13 @@ void on_boot_completed() {
     // Report to kernel
     report_boot_complete();
 
-    ensure_msud_running_if_enabled();
+    {
+        const BootSpan span(BootSpanKind::Step, "daemons");
+        ensure_msud_running_if_enabled();
+        if (ensure_serve_running() != 0) {
+            LOGW("Failed to start ksud serve");
+        }
+    }
 
     // Run boot-completed stage
     run_stage("boot-completed", false);
@@ -1,6 +1,7 @@
 #include "magisk_compat/msud.hpp"
 
 #include "core/ksucalls.hpp"
+#include "core/package_index.hpp"
 #include "defs.hpp"
 #include "log.hpp"
 #include "magisk_compat/su_protocol.hpp"
@@ -15,6 +16,7 @@ extern "C" {
 #include <dirent.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <sched.h>
 #include <sys/file.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -23,8 +25,10 @@ extern "C" {
 #include <termios.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
 #include <cerrno>
+#include <chrono>
 #include <csignal>
 #include <cstdarg>
 #include <cstddef>
@@ -35,8 +39,8 @@ extern "C" {
 #include <ctime>
 #include <fstream>
 #include <iterator>
-#include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace ksud {
@@ -51,6 +55,16 @@ constexpr int kVerdictTimeoutMs = 11000;
 
 constexpr uint32_t kMsudMagic = 0x4D535544U;  // "MSUD"
 
+// Pre-forked handler processes sharing the su listen socket.
+constexpr size_t kHandlerPoolSize = 4;
+
+// A new connection must deliver its whole first request within this time.
+constexpr int kRequestTimeoutMs = 10000;
+
+// Connections a handler holds before their first request is complete; past
+// this it leaves new connections to the other handlers.
+constexpr size_t kMaxPendingClients = 32;
+
 struct __attribute__((packed)) MsudReply {
     uint32_t magic;
     uint32_t req_id;
@@ -135,20 +149,8 @@ void spawn_detached(const std::vector<std::string>& argv) {
 }
 
 std::string uid_to_package(uint32_t uid) {
-    std::ifstream in("/data/system/packages.list");
-    if (!in.is_open()) {
-        return {};
-    }
-    std::string line;
-    while (std::getline(in, line)) {
-        std::istringstream iss(line);
-        std::string pkg;
-        uint32_t puid = 0;
-        if ((iss >> pkg >> puid) && puid == uid) {
-            return pkg;
-        }
-    }
-    return {};
+    const auto packages = package_index::packages_for_uid(uid);
+    return packages.empty() ? std::string() : packages.front();
 }
 
 std::string read_comm(pid_t pid) {
@@ -192,7 +194,8 @@ int create_verdict_listener(std::string* out_name) {
 }
 
 int create_su_listener() {
-    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    // Non-blocking: every pooled handler polls it, only one wins each accept.
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
     if (fd < 0) {
         mlog("msud: su socket() failed: %s", strerror(errno));
         return -1;
@@ -400,119 +403,638 @@ void send_result(int conn, int32_t granted, int32_t exit_code) {
     _exit(127);
 }
 
-void handle_su_client(int conn) {
-    if (signal(SIGCHLD, SIG_DFL) == SIG_ERR) {
-        mlog("msud: failed to reset SIGCHLD handler: %s", strerror(errno));
-    }
-    set_recv_timeout(conn, 10);
+struct PendingRequest {
+    std::array<int, 3> fds = {-1, -1, -1};
+    std::string cwd;
+    std::vector<std::string> args;
+    std::vector<std::string> env;
+};
 
-    struct ucred cred{};
-    socklen_t clen = sizeof(cred);
-    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &clen) != 0) {
-        send_result(conn, 0, 0);
-        return;
+void close_fds(std::array<int, 3>* fds) {
+    for (int& f : *fds) {
+        if (f >= 0) {
+            close(f);
+            f = -1;
+        }
     }
-    mlog("handle: connection from uid %u pid %d", cred.uid, cred.pid);
+}
 
-    sucompat::SuRequest hdr{};
+// A frame received piecemeal. Handlers never wait on a client, so the bytes
+// and the fds sent with them are collected across polls until it is whole.
+struct FrameBuffer {
+    std::string bytes;
     std::array<int, 3> fds = {-1, -1, -1};
     int nfds = 0;
-    if (!sucompat::recv_with_fds(conn, &hdr, sizeof(hdr), fds.data(), 3, &nfds) ||
-        hdr.magic != sucompat::kSuMagic || hdr.payload_len > sucompat::kSuMaxPayload) {
-        mlog("msud: bad su request from uid %u", cred.uid);
-        for (int const f : fds) {
-            if (f >= 0) {
+
+    // Hand the received fds to a request
+    std::array<int, 3> take_fds() {
+        const std::array<int, 3> taken = fds;
+        fds = {-1, -1, -1};
+        nfds = 0;
+        return taken;
+    }
+
+    void discard() {
+        bytes.clear();
+        close_fds(&fds);
+        nfds = 0;
+    }
+};
+
+enum class FrameStatus { Partial, Complete, Failed };
+
+// Read until the frame holds size bytes or nothing more is queued
+FrameStatus fill_frame(int conn, size_t size, FrameBuffer* frame) {
+    std::array<char, 16384> chunk{};
+    while (frame->bytes.size() < size) {
+        const size_t want = std::min(chunk.size(), size - frame->bytes.size());
+        const ssize_t n = sucompat::recv_some_with_fds(conn, chunk.data(), want, frame->fds.data(),
+                                                       3, &frame->nfds);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return FrameStatus::Partial;
+        }
+        if (n <= 0) {
+            return FrameStatus::Failed;
+        }
+        frame->bytes.append(chunk.data(), static_cast<size_t>(n));
+    }
+    return FrameStatus::Complete;
+}
+
+// Collect a header of header_size bytes, which ends with its payload_len, and
+// then the payload.
+FrameStatus read_frame(int conn, size_t header_size, FrameBuffer* frame) {
+    const FrameStatus status = fill_frame(conn, header_size, frame);
+    if (status != FrameStatus::Complete) {
+        return status;
+    }
+    uint32_t payload_len = 0;
+    memcpy(&payload_len, frame->bytes.data() + header_size - sizeof(payload_len),
+           sizeof(payload_len));
+    if (payload_len > sucompat::kSuMaxPayload) {
+        return FrameStatus::Failed;
+    }
+    return fill_frame(conn, header_size + payload_len, frame);
+}
+
+bool parse_frame_payload(const FrameBuffer& frame, size_t header_size, uint32_t argc,
+                         uint32_t envc, PendingRequest* req) {
+    if (!sucompat::parse_payload(frame.bytes.substr(header_size), argc, envc, &req->cwd,
+                                 &req->args, &req->env)) {
+        return false;
+    }
+    if (req->args.empty()) {
+        req->args.emplace_back("su");
+    }
+    return true;
+}
+
+// Turn a complete first frame into a request. *session is set when it opens a
+// session instead of carrying a command.
+bool parse_request(FrameBuffer* frame, PendingRequest* req, bool* session) {
+    sucompat::SuRequest hdr{};
+    memcpy(&hdr, frame->bytes.data(), sizeof(hdr));
+    req->fds = frame->take_fds();
+    if (hdr.magic != sucompat::kSuMagic && hdr.magic != sucompat::kSuSessionMagic) {
+        close_fds(&req->fds);
+        return false;
+    }
+
+    *session = hdr.magic == sucompat::kSuSessionMagic;
+    if (*session) {
+        close_fds(&req->fds);
+        return hdr.payload_len == 0;
+    }
+
+    if (!parse_frame_payload(*frame, sizeof(hdr), hdr.argc, hdr.envc, req)) {
+        close_fds(&req->fds);
+        return false;
+    }
+    return true;
+}
+
+// Turn a complete session frame into the command it carries
+bool parse_command(FrameBuffer* frame, uint32_t* seq, PendingRequest* req) {
+    sucompat::SuCommand cmd{};
+    memcpy(&cmd, frame->bytes.data(), sizeof(cmd));
+    req->fds = frame->take_fds();
+    if (cmd.magic != sucompat::kSuSessionMagic ||
+        !parse_frame_payload(*frame, sizeof(cmd), cmd.argc, cmd.envc, req)) {
+        close_fds(&req->fds);
+        return false;
+    }
+    *seq = cmd.seq;
+    return true;
+}
+
+// Start the shell through vfork(): the launch is planned here, so the child
+// only dup2()s the client fds, enters the mount namespace and cwd, switches
+// identity and execs (searching PATH there). The broker already runs in the
+// root cgroups (spawn_msud), which the shell inherits. Requests the plan cannot
+// express (--help/--version output, --ksu-no-new-privs, which needs a driver
+// ioctl from the shell process itself) take the fork() path. Invalid arguments
+// set *invalid and start nothing; the client gets exit status 1.
+pid_t start_root_shell(PendingRequest* req, bool* invalid) {
+    std::vector<char*> argv;
+    argv.reserve(req->args.size() + 1);
+    for (auto& a : req->args) {
+        argv.push_back(a.data());
+    }
+    argv.push_back(nullptr);
+
+    SuLaunch launch;
+    std::string message;
+    const SuPlanResult plan =
+        plan_su_shell(static_cast<int>(req->args.size()), argv.data(), req->env, &launch, &message);
+    *invalid = plan == SuPlanResult::Invalid;
+    if (*invalid) {
+        while (!message.empty() && message.back() == '\n') {
+            message.pop_back();
+        }
+        mlog("msud: %s", message.c_str());
+        return -1;
+    }
+    if (plan == SuPlanResult::Message || launch.no_new_privs) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            exec_root_shell(req->fds, req->cwd, req->args, req->env);
+        }
+        return pid;
+    }
+
+    std::array<int, 3> fds = req->fds;
+    if (launch.wrap_tty) {
+        for (int& f : fds) {
+            if (f < 0 || isatty(f) != 1) {
+                continue;
+            }
+            const int wrapped = get_wrapped_fd(f);
+            if (wrapped >= 0) {
                 close(f);
+                f = wrapped;
             }
         }
-        send_result(conn, 0, 0);
-        return;
+        req->fds = fds;
     }
+    const int mnt_fd = launch.mount_master ? open("/proc/1/ns/mnt", O_RDONLY | O_CLOEXEC) : -1;
+    const char* cwd = req->cwd.empty() ? nullptr : req->cwd.c_str();
+    prepare_su_launch(&launch);
 
-    std::string payload(hdr.payload_len, '\0');
-    if (hdr.payload_len > 0 && !sucompat::read_all(conn, payload.data(), payload.size())) {
-        for (int const f : fds) {
-            if (f >= 0) {
-                close(f);
+    // NOLINTNEXTLINE(clang-analyzer-security.insecureAPI.vfork) the child only makes syscalls
+    const pid_t pid = vfork();
+    if (pid == 0) {
+        setsid();
+        for (int i = 0; i < 3; ++i) {
+            if (fds[i] >= 0) {
+                dup2(fds[i], i);
             }
         }
+        if (isatty(0) == 1) {
+            ioctl(0, TIOCSCTTY, 1);
+        }
+        if (mnt_fd >= 0) {
+            setns(mnt_fd, CLONE_NEWNS);
+        }
+        if (cwd != nullptr && chdir(cwd) != 0) {
+            chdir("/");
+        }
+        exec_su_launch(launch);
+        _exit(127);
+    }
+    if (mnt_fd >= 0) {
+        close(mnt_fd);
+    }
+    return pid;
+}
+
+int exit_code_of(int status) {
+    return WIFEXITED(status) ? WEXITSTATUS(status)
+                             : (WIFSIGNALED(status) ? 128 + WTERMSIG(status) : 1);
+}
+
+// Slow path for uids the kernel does not already allow: runs in its own
+// process because the manager prompt can block for kVerdictTimeoutMs.
+void handle_prompted_client(int conn, const struct ucred& cred, PendingRequest* req) {
+    if (signal(SIGCHLD, SIG_DFL) == SIG_ERR) {
+        mlog("msud: failed to reset SIGCHLD handler: %s", strerror(errno));
+    }
+
+    const uint32_t choice = prompt_for_choice(cred.uid, cred.pid);
+    const bool granted =
+        (choice == KSU_SU_CHOICE_ALLOW_FOREVER || choice == KSU_SU_CHOICE_ALLOW_ONCE);
+    // One-shot choices never touch the persistent app profile.
+    if (choice == KSU_SU_CHOICE_ALLOW_FOREVER || choice == KSU_SU_CHOICE_DENY_HIDE) {
+        const std::string pkg = uid_to_package(cred.uid);
+        const bool allow = (choice == KSU_SU_CHOICE_ALLOW_FOREVER);
+        const int rc = set_magisk_su_profile(pkg, cred.uid, allow);
+        mlog("handle: persist uid %u pkg %s allow=%d rc=%d", cred.uid, pkg.c_str(), allow, rc);
+    }
+
+    if (!granted) {
+        mlog("handle: uid %u DENIED", cred.uid);
+        close_fds(&req->fds);
         send_result(conn, 0, 0);
         return;
     }
 
-    std::string cwd;
-    std::vector<std::string> args;
-    std::vector<std::string> env;
-    if (!sucompat::parse_payload(payload, hdr.argc, hdr.envc, &cwd, &args, &env)) {
-        mlog("msud: malformed payload from uid %u", cred.uid);
-        for (int const f : fds) {
-            if (f >= 0) {
-                close(f);
+    bool invalid = false;
+    const pid_t shell = start_root_shell(req, &invalid);
+    close_fds(&req->fds);
+    if (shell < 0) {
+        send_result(conn, invalid ? 1 : 0, invalid ? 1 : 0);
+        return;
+    }
+    mlog("handle: uid %u GRANTED, shell pid %d running", cred.uid, shell);
+
+    int status = 0;
+    while (waitpid(shell, &status, 0) < 0 && errno == EINTR) {
+    }
+    const int code = exit_code_of(status);
+    mlog("handle: uid %u shell exit %d", cred.uid, code);
+    send_result(conn, 1, code);
+}
+
+int g_sigchld_pipe[2] = {-1, -1};
+
+void notify_sigchld(int /*sig*/) {
+    const int saved = errno;
+    const char c = 0;
+    (void)write(g_sigchld_pipe[1], &c, 1);
+    errno = saved;
+}
+
+void send_command_result(int conn, uint32_t seq, int32_t granted, int32_t exit_code) {
+    sucompat::SuCommandResult r{};
+    r.magic = sucompat::kSuSessionMagic;
+    r.seq = seq;
+    r.granted = granted;
+    r.exit_code = exit_code;
+    sucompat::write_all(conn, &r, sizeof(r));
+}
+
+// One member of the pre-forked pool. Handlers share the non-blocking listen
+// socket and multiplex their clients: a new connection waits in the poll set
+// until its first request has fully arrived, a granted shell is registered by
+// pid and its result is sent when SIGCHLD reports the exit, so neither a slow
+// client nor a long interactive shell ever ties up a handler. Session
+// connections stay in the poll set and each command on them is re-checked
+// against the kernel allowlist.
+class Handler {
+public:
+    explicit Handler(int listen_fd) : listen_fd_(listen_fd) {}
+
+    [[noreturn]] void run() {
+        if (pipe2(g_sigchld_pipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+            mlog("msud: handler pipe failed: %s", strerror(errno));
+            _exit(1);
+        }
+        struct sigaction sa{};
+        sa.sa_handler = notify_sigchld;
+        sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(SIGCHLD, &sa, nullptr) != 0) {
+            mlog("msud: handler SIGCHLD setup failed: %s", strerror(errno));
+            _exit(1);
+        }
+
+        std::vector<struct pollfd> pfds;
+        std::vector<uint64_t> polled_sessions;
+        std::vector<int> polled_pending;
+        for (;;) {
+            pfds.assign(2, pollfd{});
+            // A full handler stops accepting; poll() skips negative fds.
+            pfds[0].fd = pending_.size() < kMaxPendingClients ? listen_fd_ : -1;
+            pfds[0].events = POLLIN;
+            pfds[1].fd = g_sigchld_pipe[0];
+            pfds[1].events = POLLIN;
+            polled_sessions.clear();
+            for (const auto& [id, session] : sessions_) {
+                struct pollfd pfd{};
+                pfd.fd = session.conn;
+                pfd.events = POLLIN;
+                pfds.push_back(pfd);
+                polled_sessions.push_back(id);
+            }
+            polled_pending.clear();
+            for (const auto& [conn, client] : pending_) {
+                struct pollfd pfd{};
+                pfd.fd = conn;
+                pfd.events = POLLIN;
+                pfds.push_back(pfd);
+                polled_pending.push_back(conn);
+            }
+            if (poll(pfds.data(), pfds.size(), poll_timeout()) < 0) {
+                continue;
+            }
+
+            if (pfds[1].revents != 0) {
+                reap_shells();
+            }
+            size_t index = 2;
+            for (const uint64_t id : polled_sessions) {
+                if (pfds[index++].revents != 0) {
+                    serve_session(id);
+                }
+            }
+            for (const int conn : polled_pending) {
+                if (pfds[index++].revents != 0) {
+                    serve_pending(conn);
+                }
+            }
+            expire_pending();
+            if ((pfds[0].revents & POLLIN) != 0) {
+                accept_client();
             }
         }
-        send_result(conn, 0, 0);
-        return;
     }
 
-    bool granted = uid_granted_root(cred.uid);
-    mlog("handle: uid %u allowlisted=%d argc=%u", cred.uid, granted, hdr.argc);
-    if (!granted) {
-        const uint32_t choice = prompt_for_choice(cred.uid, cred.pid);
-        granted = (choice == KSU_SU_CHOICE_ALLOW_FOREVER || choice == KSU_SU_CHOICE_ALLOW_ONCE);
-        // One-shot choices never touch the persistent app profile.
-        if (choice == KSU_SU_CHOICE_ALLOW_FOREVER || choice == KSU_SU_CHOICE_DENY_HIDE) {
-            const std::string pkg = uid_to_package(cred.uid);
-            const bool allow = (choice == KSU_SU_CHOICE_ALLOW_FOREVER);
-            const int rc = set_magisk_su_profile(pkg, cred.uid, allow);
-            mlog("handle: persist uid %u pkg %s allow=%d rc=%d", cred.uid, pkg.c_str(), allow, rc);
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Session {
+        int conn;
+        uint32_t uid;
+        FrameBuffer frame;  // The next command, as far as it has arrived
+    };
+
+    // A connection whose first request is still arriving
+    struct PendingClient {
+        struct ucred cred;
+        Clock::time_point deadline;
+        FrameBuffer frame;
+    };
+
+    // Who a running shell answers to: a one-shot connection, or a session command
+    struct ShellOwner {
+        int conn = -1;
+        uint64_t session = 0;
+        uint32_t seq = 0;
+    };
+
+    // Wake up for the nearest pending deadline
+    [[nodiscard]] int poll_timeout() const {
+        if (pending_.empty()) {
+            return -1;
         }
+        Clock::time_point nearest = Clock::time_point::max();
+        for (const auto& [conn, client] : pending_) {
+            nearest = std::min(nearest, client.deadline);
+        }
+        const auto wait =
+            std::chrono::duration_cast<std::chrono::milliseconds>(nearest - Clock::now()).count();
+        return wait <= 0 ? 0 : static_cast<int>(wait) + 1;
     }
 
-    if (!granted) {
-        mlog("handle: uid %u DENIED", cred.uid);
-        for (int const f : fds) {
-            if (f >= 0) {
-                close(f);
+    // A prompt child lives for up to kVerdictTimeoutMs without exec()ing, so
+    // it must not hold other clients' connections or the pool's fds open.
+    void close_inherited_fds() {
+        close(listen_fd_);
+        close(g_sigchld_pipe[0]);
+        close(g_sigchld_pipe[1]);
+        for (auto& [id, session] : sessions_) {
+            session.frame.discard();
+            close(session.conn);
+        }
+        for (auto& [conn, client] : pending_) {
+            client.frame.discard();
+            close(conn);
+        }
+        for (const auto& [pid, owner] : shells_) {
+            if (owner.conn >= 0) {
+                close(owner.conn);
             }
         }
-        send_result(conn, 0, 0);
-        return;
     }
 
-    const pid_t shell = fork();
-    if (shell < 0) {
-        for (int const f : fds) {
-            if (f >= 0) {
-                close(f);
+    void reap_shells() {
+        char drain[64];
+        while (read(g_sigchld_pipe[0], drain, sizeof(drain)) > 0) {
+        }
+        int status = 0;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            const auto it = shells_.find(pid);
+            if (it == shells_.end()) {
+                continue;  // a prompt handler, which answers its client itself
             }
+            const int code = exit_code_of(status);
+            mlog("handle: shell pid %d exit %d", pid, code);
+            const ShellOwner& owner = it->second;
+            if (owner.session == 0) {
+                send_result(owner.conn, 1, code);
+                close(owner.conn);
+            } else {
+                const auto session = sessions_.find(owner.session);
+                if (session != sessions_.end()) {
+                    send_command_result(session->second.conn, owner.seq, 1, code);
+                } else {
+                    mlog("handle: session %llu closed before command %u finished",
+                         static_cast<unsigned long long>(owner.session), owner.seq);
+                }
+            }
+            shells_.erase(it);
         }
-        send_result(conn, 0, 0);
-        return;
     }
-    if (shell == 0) {
+
+    void close_session(std::unordered_map<uint64_t, Session>::iterator it) {
+        it->second.frame.discard();
+        close(it->second.conn);
+        sessions_.erase(it);
+    }
+
+    // Run every command that has fully arrived; a partial one waits in the
+    // session's buffer for the next poll.
+    void serve_session(uint64_t id) {
+        for (;;) {
+            const auto it = sessions_.find(id);
+            if (it == sessions_.end()) {
+                return;
+            }
+            Session& session = it->second;
+
+            switch (read_frame(session.conn, sizeof(sucompat::SuCommand), &session.frame)) {
+            case FrameStatus::Partial:
+                return;
+            case FrameStatus::Failed:
+                mlog("handle: session %llu of uid %u closed", static_cast<unsigned long long>(id),
+                     session.uid);
+                close_session(it);
+                return;
+            case FrameStatus::Complete:
+                break;
+            }
+
+            uint32_t seq = 0;
+            PendingRequest req;
+            if (!parse_command(&session.frame, &seq, &req)) {
+                mlog("handle: malformed command on session %llu",
+                     static_cast<unsigned long long>(id));
+                close_session(it);
+                return;
+            }
+            session.frame.bytes.clear();
+            run_command(id, session, seq, &req);
+        }
+    }
+
+    void run_command(uint64_t id, const Session& session, uint32_t seq, PendingRequest* req) {
+        if (!uid_granted_root(session.uid)) {
+            mlog("handle: session uid %u no longer granted", session.uid);
+            close_fds(&req->fds);
+            send_command_result(session.conn, seq, 0, 0);
+            return;
+        }
+        bool invalid = false;
+        const pid_t shell = start_root_shell(req, &invalid);
+        close_fds(&req->fds);
+        if (shell < 0) {
+            send_command_result(session.conn, seq, invalid ? 1 : 0, invalid ? 1 : 0);
+            return;
+        }
+        shells_.emplace(shell, ShellOwner{-1, id, seq});
+    }
+
+    void accept_client() {
+        // Another handler may have taken the connection already (EAGAIN).
+        const int conn = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (conn < 0) {
+            return;
+        }
+
+        struct ucred cred{};
+        socklen_t clen = sizeof(cred);
+        if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &clen) != 0) {
+            close(conn);
+            return;
+        }
+        mlog("handle: connection from uid %u pid %d", cred.uid, cred.pid);
+        pending_.emplace(conn, PendingClient{cred, Clock::now() + std::chrono::milliseconds(
+                                                                      kRequestTimeoutMs),
+                                             {}});
+        // The request usually arrives together with the connection.
+        serve_pending(conn);
+    }
+
+    void drop_pending(int conn) {
+        const auto it = pending_.find(conn);
+        if (it == pending_.end()) {
+            return;
+        }
+        it->second.frame.discard();
+        pending_.erase(it);
+        send_result(conn, 0, 0);
         close(conn);
-        exec_root_shell(fds, cwd, args, env);
     }
 
-    mlog("handle: uid %u GRANTED, shell pid %d running", cred.uid, shell);
+    void serve_pending(int conn) {
+        const auto it = pending_.find(conn);
+        if (it == pending_.end()) {
+            return;
+        }
+        switch (read_frame(conn, sizeof(sucompat::SuRequest), &it->second.frame)) {
+        case FrameStatus::Partial:
+            return;
+        case FrameStatus::Failed:
+            mlog("msud: bad su request from uid %u", it->second.cred.uid);
+            drop_pending(conn);
+            return;
+        case FrameStatus::Complete:
+            break;
+        }
 
-    for (int const f : fds) {
-        if (f >= 0) {
-            close(f);
+        PendingClient client = std::move(it->second);
+        pending_.erase(it);
+        PendingRequest req;
+        bool session = false;
+        if (!parse_request(&client.frame, &req, &session)) {
+            mlog("msud: malformed su request from uid %u", client.cred.uid);
+            send_result(conn, 0, 0);
+            close(conn);
+            return;
         }
+        handle_request(conn, client.cred, &req, session);
     }
-    int status = 0;
-    while (waitpid(shell, &status, 0) < 0 && errno == EINTR) {
+
+    void expire_pending() {
+        const Clock::time_point now = Clock::now();
+        std::vector<int> expired;
+        for (const auto& [conn, client] : pending_) {
+            if (client.deadline <= now) {
+                mlog("msud: request from uid %u stalled, dropping it", client.cred.uid);
+                expired.push_back(conn);
+            }
+        }
+        for (const int conn : expired) {
+            drop_pending(conn);
+        }
     }
-    const int code = WIFEXITED(status) ? WEXITSTATUS(status)
-                                       : (WIFSIGNALED(status) ? 128 + WTERMSIG(status) : 1);
-    mlog("handle: uid %u shell exit %d", cred.uid, code);
-    send_result(conn, 1, code);
-}
 
-void reap_children(int /*sig*/) {
-    while (waitpid(-1, nullptr, WNOHANG) > 0) {
+    void handle_request(int conn, const struct ucred& cred, PendingRequest* req, bool session) {
+        const bool granted = uid_granted_root(cred.uid);
+        mlog("handle: uid %u allowlisted=%d session=%d argc=%zu", cred.uid, granted, session,
+             req->args.size());
+        if (session) {
+            // Sessions never prompt: an ALLOW_ONCE answer could not outlive
+            // the prompt process, so the uid must already hold a grant.
+            send_result(conn, granted ? 1 : 0, 0);
+            if (!granted) {
+                close(conn);
+                return;
+            }
+            sessions_.emplace(++last_session_, Session{conn, cred.uid, {}});
+            return;
+        }
+
+        if (!granted) {
+            const pid_t prompt = fork();
+            if (prompt == 0) {
+                close_inherited_fds();
+                handle_prompted_client(conn, cred, req);
+                close(conn);
+                _exit(0);
+            }
+            if (prompt < 0) {
+                mlog("msud: fork prompt handler failed: %s", strerror(errno));
+                send_result(conn, 0, 0);
+            }
+            close_fds(&req->fds);
+            close(conn);
+            return;
+        }
+
+        bool invalid = false;
+        const pid_t shell = start_root_shell(req, &invalid);
+        close_fds(&req->fds);
+        if (shell < 0) {
+            if (!invalid) {
+                mlog("msud: spawn shell failed: %s", strerror(errno));
+            }
+            send_result(conn, invalid ? 1 : 0, invalid ? 1 : 0);
+            close(conn);
+            return;
+        }
+        mlog("handle: uid %u GRANTED, shell pid %d running", cred.uid, shell);
+        ShellOwner owner;
+        owner.conn = conn;
+        shells_.emplace(shell, owner);
+    }
+
+    int listen_fd_;
+    std::unordered_map<pid_t, ShellOwner> shells_;
+    std::unordered_map<uint64_t, Session> sessions_;
+    std::unordered_map<int, PendingClient> pending_;
+    uint64_t last_session_ = 0;
+};
+
+pid_t spawn_handler(int listen_fd) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        Handler(listen_fd).run();
+    }
+    if (pid < 0) {
+        mlog("msud: fork handler failed: %s", strerror(errno));
     }
+    return pid;
 }
 
 int acquire_lock() {
@@ -580,9 +1102,6 @@ int run_msud() {
     if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
         mlog("msud: failed to ignore SIGPIPE: %s", strerror(errno));
     }
-    if (signal(SIGCHLD, reap_children) == SIG_ERR) {
-        mlog("msud: failed to install SIGCHLD handler: %s", strerror(errno));
-    }
 
     const int listen_fd = create_su_listener();
     if (listen_fd < 0) {
@@ -591,30 +1110,34 @@ int run_msud() {
     }
     mlog("msud: su broker started, listening on @%s", sucompat::kSuSocketName);
 
+    std::unordered_map<pid_t, time_t> handlers;  // pid -> start time
     for (;;) {
-        const int conn = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
-        if (conn < 0) {
-            if (errno == EINTR) {
-                continue;
+        while (handlers.size() < kHandlerPoolSize) {
+            const pid_t pid = spawn_handler(listen_fd);
+            if (pid < 0) {
+                break;
             }
-            mlog("msud: accept failed: %s", strerror(errno));
-            continue;
+            handlers.emplace(pid, time(nullptr));
         }
 
-        const pid_t handler = fork();
-        if (handler < 0) {
-            mlog("msud: fork handler failed: %s", strerror(errno));
-            send_result(conn, 0, 0);
-            close(conn);
+        int status = 0;
+        const pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno != EINTR) {
+                sleep(1);
+            }
             continue;
         }
-        if (handler == 0) {
-            close(listen_fd);
-            handle_su_client(conn);
-            close(conn);
-            _exit(0);
+        const auto it = handlers.find(pid);
+        if (it == handlers.end()) {
+            continue;
         }
-        close(conn);
+        mlog("msud: handler %d exited (status %d), respawning", pid, status);
+        // Do not spin on a handler that dies right away.
+        if (time(nullptr) - it->second < 1) {
+            sleep(1);
+        }
+        handlers.erase(it);
     }
 }
 
@@ -191,7 +191,7 @@ void rm_rf(const std::string& path) {
 
 bool prepare_data_su() {
     mkdir(kSuDataDir, 0755);
-    if (!copy_asset_to_file("su", std::string(kSuDataPath))) {
+    if (!sync_asset_to_file("su", std::string(kSuDataPath))) {
         LOGE("magisk_su: failed to extract embedded su asset");
         return false;
     }
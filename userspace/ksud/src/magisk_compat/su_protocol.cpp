@@ -130,9 +130,10 @@ bool send_with_fds(int sock, const void* buf, size_t len, const int* fds, int nf
     }
 }
 
-bool recv_with_fds(int sock, void* buf, size_t len, int* out_fds, int max_fds, int* out_nfds) {
-    *out_nfds = 0;
+namespace {
 
+ssize_t recvmsg_with_fds(int sock, void* buf, size_t len, int flags, int* out_fds, int max_fds,
+                         int* out_nfds) {
     struct iovec iov{};
     iov.iov_base = buf;
     iov.iov_len = len;
@@ -148,14 +149,14 @@ bool recv_with_fds(int sock, void* buf, size_t len, int* out_fds, int max_fds, i
 
     ssize_t n;
     for (;;) {
-        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        n = recvmsg(sock, &msg, flags | MSG_CMSG_CLOEXEC);
         if (n < 0 && errno == EINTR) {
             continue;
         }
         break;
     }
-    if (n != static_cast<ssize_t>(len)) {
-        return false;
+    if (n < 0) {
+        return n;
     }
 
     for (struct cmsghdr* h = CMSG_FIRSTHDR(&msg); h != nullptr; h = CMSG_NXTHDR(&msg, h)) {
@@ -172,7 +173,28 @@ bool recv_with_fds(int sock, void* buf, size_t len, int* out_fds, int max_fds, i
             }
         }
     }
+    return n;
+}
+
+}  // namespace
+
+bool recv_with_fds(int sock, void* buf, size_t len, int* out_fds, int max_fds, int* out_nfds) {
+    *out_nfds = 0;
+    const ssize_t n = recvmsg_with_fds(sock, buf, len, 0, out_fds, max_fds, out_nfds);
+    if (n != static_cast<ssize_t>(len)) {
+        for (int i = 0; i < *out_nfds; ++i) {
+            close(out_fds[i]);
+            out_fds[i] = -1;
+        }
+        *out_nfds = 0;
+        return false;
+    }
     return true;
 }
 
+ssize_t recv_some_with_fds(int sock, void* buf, size_t len, int* out_fds, int max_fds,
+                           int* out_nfds) {
+    return recvmsg_with_fds(sock, buf, len, MSG_DONTWAIT, out_fds, max_fds, out_nfds);
+}
+
 }  // namespace ksud::sucompat
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <sys/types.h>
+
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -26,6 +28,29 @@ struct __attribute__((packed)) SuResult {
     int32_t exit_code;
 };
 
+// Session mode: a SuRequest carrying kSuSessionMagic and no payload opens a
+// long-lived connection for a uid that is already granted. The broker answers
+// with one SuResult, then runs every SuCommand sent on the connection, each
+// with its own fd triple, and streams back a SuCommandResult per command as it
+// exits (not necessarily in order). Closing the connection ends the session.
+inline constexpr uint32_t kSuSessionMagic = 0x4B535353U;  // "KSSS"
+
+// Followed by payload_len bytes, laid out like a SuRequest payload
+struct __attribute__((packed)) SuCommand {
+    uint32_t magic;  // kSuSessionMagic
+    uint32_t seq;    // Echoed in the result
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t payload_len;
+};
+
+struct __attribute__((packed)) SuCommandResult {
+    uint32_t magic;  // kSuSessionMagic
+    uint32_t seq;
+    int32_t granted;  // 0 once the uid lost root; the session stays open
+    int32_t exit_code;
+};
+
 std::string build_payload(const std::string& cwd, int argc, char** argv, char** envp,
                           uint32_t* out_argc, uint32_t* out_envc);
 
@@ -39,4 +64,14 @@ bool send_with_fds(int sock, const void* buf, size_t len, const int* fds, int nf
 
 bool recv_with_fds(int sock, void* buf, size_t len, int* out_fds, int max_fds, int* out_nfds);
 
+/**
+ * One non-blocking recvmsg() of at most len bytes
+ *
+ * Received fds are appended after the *out_nfds already in out_fds; any beyond
+ * max_fds are closed.
+ * @return bytes read, 0 on EOF, -1 with errno set (EAGAIN when nothing is queued)
+ */
+ssize_t recv_some_with_fds(int sock, void* buf, size_t len, int* out_fds, int max_fds,
+                           int* out_nfds);
+
 }  // namespace ksud::sucompat
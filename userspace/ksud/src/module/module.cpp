@@ -1,5 +1,7 @@
 #include "module.hpp"
 #include "../assets.hpp"
+#include "../boot_timeline.hpp"
+#include "../core/json.hpp"
 #include "../core/ksucalls.hpp"
 #include "../core/restorecon.hpp"
 #include "../defs.hpp"
@@ -25,6 +27,7 @@
 #include <fstream>
 #include <map>
 #include <sstream>
+#include <string_view>
 #include <vector>
 
 #if defined(RESETPROP_ALONE_AVAILABLE) && RESETPROP_ALONE_AVAILABLE
@@ -56,49 +59,6 @@ namespace {
 constexpr const char* INSTALLER_SCRIPT_NAME = "installer.sh";
 constexpr const char* METADATA_FILE_CON = "u:object_r:metadata_file:s0";
 
-// Escape special characters for JSON string
-std::string escape_json(const std::string& s) {
-    std::string result;
-    result.reserve(s.size());
-    for (const char c : s) {
-        switch (c) {
-        case '"':
-            result += "\\\"";
-            break;
-        case '\\':
-            result += "\\\\";
-            break;
-        case '\b':
-            result += "\\b";
-            break;
-        case '\f':
-            result += "\\f";
-            break;
-        case '\n':
-            result += "\\n";
-            break;
-        case '\r':
-            result += "\\r";
-            break;
-        case '\t':
-            result += "\\t";
-            break;
-        default:
-            if (static_cast<unsigned char>(c) < 0x20) {
-                std::array<char, 8> buf{};
-                const int snp =
-                    snprintf(buf.data(), buf.size(), "\\u%04x", static_cast<unsigned char>(c));
-                if (snp > 0 && static_cast<size_t>(snp) < buf.size()) {
-                    result += buf.data();
-                }
-            } else {
-                result += c;
-            }
-        }
-    }
-    return result;
-}
-
 bool file_exists(const std::string& path) {
     struct stat st{};
     return stat(path.c_str(), &st) == 0;
@@ -731,6 +691,12 @@ int module_install(const std::string& zip_path) {
         return 1;
     }
 
+    // Label the new tree now and journal it, so post-fs-data only has to look
+    // at what changed after install.
+    if (!restore_syscon_if_unlabeled(std::string(MODULE_UPDATE_DIR) + mod_id)) {
+        LOGW("Failed to restore contexts for module %s", mod_id.c_str());
+    }
+
     const std::string final_module = std::string(MODULE_DIR) + mod_id;
     exec_command({"mkdir", "-p", std::string(MODULE_DIR)});
     exec_command({"mkdir", "-p", final_module});
@@ -963,33 +929,33 @@ int module_list() {
     collect_module_infos(MODULE_DIR, false, modules, module_index);
     collect_module_infos(MODULE_UPDATE_DIR, true, modules, module_index);
 
-    // Output JSON array
-    printf("[\n");
-    for (size_t i = 0; i < modules.size(); i++) {
-        const auto& m = modules[i];
-        printf("  {\n");
-        printf("    \"id\": \"%s\",\n", escape_json(m.id).c_str());
-        printf("    \"name\": \"%s\",\n", escape_json(m.name).c_str());
-        printf("    \"version\": \"%s\",\n", escape_json(m.version).c_str());
-        printf("    \"versionCode\": \"%s\",\n", escape_json(m.version_code).c_str());
-        printf("    \"author\": \"%s\",\n", escape_json(m.author).c_str());
-        printf("    \"description\": \"%s\",\n", escape_json(m.description).c_str());
-        printf("    \"enabled\": \"%s\",\n", m.enabled ? "true" : "false");
-        printf("    \"update\": \"%s\",\n", m.update ? "true" : "false");
-        printf("    \"remove\": \"%s\",\n", m.remove ? "true" : "false");
-        printf("    \"web\": \"%s\",\n", m.web ? "true" : "false");
-        printf("    \"action\": \"%s\",\n", m.action ? "true" : "false");
-        printf("    \"mount\": \"%s\",\n", m.mount ? "true" : "false");
-        printf("    \"metamodule\": \"%s\"", m.metamodule ? "true" : "false");
-        if (!m.actionIcon.empty()) {
-            printf(",\n    \"actionIcon\": \"%s\"", escape_json(m.actionIcon).c_str());
-        }
-        if (!m.webuiIcon.empty()) {
-            printf(",\n    \"webuiIcon\": \"%s\"", escape_json(m.webuiIcon).c_str());
-        }
-        printf("\n  }%s\n", i < modules.size() - 1 ? "," : "");
-    }
-    printf("]\n");
+    // Output JSON array; flags stay quoted strings, which is what the manager reads
+    std::string output;
+    json::Writer writer(&output, 2);
+    writer.begin_array();
+    for (const auto& m : modules) {
+        writer.begin_object()
+            .member("id", m.id)
+            .member("name", m.name)
+            .member("version", m.version)
+            .member("versionCode", m.version_code)
+            .member("author", m.author)
+            .member("description", m.description)
+            .member("enabled", m.enabled ? "true" : "false")
+            .member("update", m.update ? "true" : "false")
+            .member("remove", m.remove ? "true" : "false")
+            .member("web", m.web ? "true" : "false")
+            .member("action", m.action ? "true" : "false")
+            .member("mount", m.mount ? "true" : "false")
+            .member("metamodule", m.metamodule ? "true" : "false");
+        if (!m.actionIcon.empty())
+            writer.member("actionIcon", m.actionIcon);
+        if (!m.webuiIcon.empty())
+            writer.member("webuiIcon", m.webuiIcon);
+        writer.end_object();
+    }
+    writer.end_array();
+    printf("%s\n", output.c_str());
 
     return 0;
 }
@@ -1141,6 +1107,17 @@ int run_script(const std::string& script, bool block, const std::string& module_
 
     LOGI("Running script: %s", script.c_str());
 
+    // Module scripts are keyed by module id, common *.d scripts by file name
+    const size_t name_pos = script.find_last_of('/');
+    const std::string_view file_name =
+        name_pos == std::string::npos ? std::string_view(script)
+                                      : std::string_view(script).substr(name_pos + 1);
+    BootSpan span(module_id.empty() ? BootSpanKind::Script : BootSpanKind::Module,
+                  module_id.empty() ? file_name : std::string_view(module_id),
+                  module_id.empty() ? std::string_view() : file_name);
+    if (!block)
+        span.set_async();
+
     // Use busybox for script execution (like Rust version)
     std::string busybox = BUSYBOX_PATH;
     if (!file_exists(busybox)) {
@@ -1350,6 +1327,7 @@ int load_sepolicy_rule() {
         }
 
         if (!all_rules.empty()) {
+            const BootSpan span(BootSpanKind::Module, entry->d_name, "sepolicy.rule");
             LOGI("Applying sepolicy rules from %s", entry->d_name);
             const int ret = sepolicy_live_patch(all_rules);
             if (ret != 0) {
@@ -1,9 +1,10 @@
 #include "lua_engine.hpp"
 
+#include "../boot_timeline.hpp"
 #include "../defs.hpp"
 #include "../log.hpp"
 #include "../utils.hpp"
-#include "json.hpp"
+#include "../core/json.hpp"
 #include "plugin.hpp"
 
 extern "C" {
@@ -14,8 +15,11 @@ extern "C" {
 
 #include <fcntl.h>
 #include <linux/close_range.h>
+#include <mbedtls/sha256.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include <sys/file.h>
+#include <sys/random.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
@@ -26,14 +30,17 @@ extern "C" {
 #include <cerrno>
 #include <chrono>
 #include <climits>
+#include <cmath>
 #include <csignal>
 #include <cstdarg>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <exception>
 #include <filesystem>
+#include <map>
 #include <memory>
 #include <optional>
 #include <set>
@@ -74,7 +81,12 @@ constexpr size_t kMaxLuaMemory = size_t{64} * 1024 * 1024;
 constexpr int kStageCallbackTimeoutSeconds = 120;
 constexpr int kManualCallbackTimeoutSeconds = 300;
 constexpr int kDaemonReadyTimeoutMilliseconds = 10000;
+constexpr int kWorkerPollFallbackMilliseconds = 10;
+constexpr long kMaxConcurrentStageWorkers = 8;
 constexpr uint32_t kDaemonStateMagic = 0x4b504c47;
+constexpr uint32_t kBytecodeCacheMagic = 0x4b504243;
+constexpr uint32_t kBytecodeCacheVersion = 1;
+constexpr size_t kDigestSize = 32;
 
 struct DaemonState {
     uint32_t magic = kDaemonStateMagic;
@@ -84,6 +96,22 @@ struct DaemonState {
     uint8_t reserved[3]{};
 };
 
+using Digest = std::array<uint8_t, kDigestSize>;
+
+struct BytecodeCacheHeader {
+    uint32_t magic = kBytecodeCacheMagic;
+    uint32_t version = kBytecodeCacheVersion;
+    uint32_t lua_version = LUA_VERSION_NUM;
+    uint32_t reserved = 0;
+    uint64_t bytecode_size = 0;
+    Digest source_digest{};
+    Digest bytecode_digest{};
+};
+
+// Benchmarks toggle these to compare the cold and the warm callback paths.
+bool bytecode_cache_enabled = true;
+bool fork_server_enabled = true;
+
 void print_error(const char* format, ...) {
     va_list arguments;
     va_start(arguments, format);
@@ -114,7 +142,7 @@ struct CapturedCommand {
 struct JsonEncodeContext {
     std::set<const void*> tables;
     size_t nodes = 0;
-    size_t output_bytes = 0;
+    json::Writer* writer = nullptr;
     std::string error;
 };
 
@@ -131,6 +159,24 @@ struct LuaStateCloser {
 
 using ScopedLuaState = std::unique_ptr<lua_State, LuaStateCloser>;
 
+// A Lua state with the standard libraries and the plugin API registered. The
+// API closures capture `context`, so a runtime never moves once created.
+struct LuaRuntime {
+    LuaMemoryContext memory;
+    PluginApiContext context;
+    ScopedLuaState state;
+};
+
+struct PrewarmedRuntime {
+    std::unique_ptr<LuaRuntime> runtime;
+    pid_t owner = -1;
+};
+
+PrewarmedRuntime& prewarmed_runtime() {
+    static PrewarmedRuntime prewarmed;
+    return prewarmed;
+}
+
 void* limited_lua_allocator(void* opaque, void* pointer, size_t old_size, size_t new_size) {
     auto* context = static_cast<LuaMemoryContext*>(opaque);
     if (pointer == nullptr)
@@ -762,200 +808,236 @@ std::optional<std::string> read_plugin_file(const std::string& path, std::string
     return output;
 }
 
-size_t escaped_json_string_size(std::string_view value) {
-    size_t size = 2;
-    for (const unsigned char character : value) {
-        if (character == '"' || character == '\\' || character == '\b' || character == '\f' ||
-            character == '\n' || character == '\r' || character == '\t') {
-            size += 2;
-        } else if (character < 0x20U) {
-            size += 6;
-        } else {
-            ++size;
-        }
-    }
-    return size;
-}
+bool lua_to_json(lua_State* state, int index, size_t depth, JsonEncodeContext* context);
 
-bool account_json_output(JsonEncodeContext* context, size_t bytes) {
-    if (bytes > kMaxJsonInput - context->output_bytes) {
-        context->error = "JSON output exceeds the size limit";
+// Lua key of an object member, kept so the value can be fetched after sorting
+struct JsonObjectKey {
+    std::string text;
+    bool integer = false;
+    lua_Integer number = 0;
+};
+
+bool lua_table_to_json(lua_State* state, int index, size_t depth, JsonEncodeContext* context) {
+    json::Writer& writer = *context->writer;
+    const void* identity = lua_topointer(state, index);
+    if (!context->tables.insert(identity).second) {
+        context->error = "Cannot encode a cyclic Lua table";
         return false;
     }
-    context->output_bytes += bytes;
-    return true;
-}
 
-bool account_json_string(JsonEncodeContext* context, std::string_view value) {
-    if (value.size() > kMaxJsonInput) {
-        context->error = "JSON output exceeds the size limit";
-        return false;
+    bool array = true;
+    size_t entries = 0;
+    lua_Integer maximum = 0;
+    std::vector<JsonObjectKey> keys;
+    lua_pushnil(state);
+    while (lua_next(state, index) != 0) {
+        if (++entries > kMaxJsonNodes) {
+            lua_pop(state, 2);
+            context->tables.erase(identity);
+            context->error = "JSON table has too many entries";
+            return false;
+        }
+        JsonObjectKey key;
+        if (lua_type(state, -2) == LUA_TSTRING) {
+            size_t size = 0;
+            const char* text = lua_tolstring(state, -2, &size);
+            key.text.assign(text, size);
+            array = false;
+        } else if (lua_isinteger(state, -2)) {
+            key.integer = true;
+            key.number = lua_tointeger(state, -2);
+            key.text = std::to_string(key.number);
+            if (key.number <= 0)
+                array = false;
+            else
+                maximum = std::max(maximum, key.number);
+        } else {
+            lua_pop(state, 2);
+            context->tables.erase(identity);
+            context->error = "JSON object keys must be strings or integers";
+            return false;
+        }
+        keys.push_back(std::move(key));
+        lua_pop(state, 1);
+    }
+    array = array && entries > 0 && maximum == static_cast<lua_Integer>(entries);
+
+    bool ok = true;
+    if (array) {
+        writer.begin_array();
+        for (size_t item = 1; ok && item <= entries; ++item) {
+            lua_rawgeti(state, index, static_cast<lua_Integer>(item));
+            ok = lua_to_json(state, -1, depth + 1, context);
+            lua_pop(state, 1);
+        }
+        writer.end_array();
+    } else {
+        // Members in key order, so output does not depend on the hash layout
+        std::sort(keys.begin(), keys.end(),
+                  [](const JsonObjectKey& a, const JsonObjectKey& b) { return a.text < b.text; });
+        for (size_t item = 1; item < keys.size(); ++item) {
+            if (keys[item].text == keys[item - 1].text) {
+                context->tables.erase(identity);
+                context->error = "JSON object keys collide after normalization";
+                return false;
+            }
+        }
+        writer.begin_object();
+        for (size_t item = 0; ok && item < keys.size(); ++item) {
+            const JsonObjectKey& key = keys[item];
+            writer.key(key.text);
+            if (key.integer) {
+                lua_rawgeti(state, index, key.number);
+            } else {
+                lua_pushlstring(state, key.text.data(), key.text.size());
+                lua_rawget(state, index);
+            }
+            ok = lua_to_json(state, -1, depth + 1, context);
+            lua_pop(state, 1);
+        }
+        writer.end_object();
     }
-    return account_json_output(context, escaped_json_string_size(value));
+    context->tables.erase(identity);
+    return ok && writer.ok();
 }
 
-std::optional<plugin_json::Value> lua_to_json(lua_State* state, int index, size_t depth,
-                                              JsonEncodeContext* context) {
+// Writes the Lua value at index straight into context->writer
+bool lua_to_json(lua_State* state, int index, size_t depth, JsonEncodeContext* context) {
     if (depth > kMaxJsonDepth || ++context->nodes > kMaxJsonNodes) {
         context->error = "JSON value exceeds the depth or node limit";
-        return std::nullopt;
+        return false;
     }
-    if (!account_json_output(context, 32))
-        return std::nullopt;
+    json::Writer& writer = *context->writer;
     index = lua_absindex(state, index);
     switch (lua_type(state, index)) {
     case LUA_TNIL:
-        return plugin_json::Value();
+        writer.null();
+        break;
     case LUA_TBOOLEAN:
-        return plugin_json::Value(lua_toboolean(state, index) != 0);
+        writer.boolean(lua_toboolean(state, index) != 0);
+        break;
     case LUA_TNUMBER:
-        if (lua_isinteger(state, index))
-            return plugin_json::Value(static_cast<int64_t>(lua_tointeger(state, index)));
+        if (lua_isinteger(state, index)) {
+            writer.integer(static_cast<int64_t>(lua_tointeger(state, index)));
+            break;
+        }
         if (!std::isfinite(lua_tonumber(state, index))) {
             context->error = "Cannot encode a non-finite JSON number";
-            return std::nullopt;
+            return false;
         }
-        return plugin_json::Value(lua_tonumber(state, index));
+        writer.number(lua_tonumber(state, index));
+        break;
     case LUA_TSTRING: {
         size_t size = 0;
         const char* value = lua_tolstring(state, index, &size);
-        if (!account_json_string(context, {value, size})) {
-            return std::nullopt;
-        }
-        return plugin_json::Value(std::string(value, size));
+        writer.string({value, size});
+        break;
     }
-    case LUA_TTABLE: {
-        const void* identity = lua_topointer(state, index);
-        if (!context->tables.insert(identity).second) {
-            context->error = "Cannot encode a cyclic Lua table";
-            return std::nullopt;
-        }
+    case LUA_TTABLE:
+        return lua_table_to_json(state, index, depth, context);
+    default:
+        context->error = "Unsupported Lua value for JSON encoding";
+        return false;
+    }
+    return writer.ok();
+}
 
-        bool array = true;
-        size_t entries = 0;
-        lua_Integer maximum = 0;
-        lua_pushnil(state);
-        while (lua_next(state, index) != 0) {
-            if (++entries > kMaxJsonNodes) {
-                lua_pop(state, 2);
-                context->tables.erase(identity);
-                context->error = "JSON table has too many entries";
-                return std::nullopt;
-            }
-            if (!lua_isinteger(state, -2)) {
-                array = false;
-            } else {
-                const lua_Integer key = lua_tointeger(state, -2);
-                if (key <= 0)
-                    array = false;
-                else
-                    maximum = std::max(maximum, key);
-            }
-            lua_pop(state, 1);
-        }
-        array = array && entries > 0 && maximum == static_cast<lua_Integer>(entries);
-
-        if (array) {
-            plugin_json::Array output;
-            output.reserve(entries);
-            for (size_t item = 1; item <= entries; ++item) {
-                lua_geti(state, index, static_cast<lua_Integer>(item));
-                auto value = lua_to_json(state, -1, depth + 1, context);
-                lua_pop(state, 1);
-                if (!value) {
-                    context->tables.erase(identity);
-                    return std::nullopt;
-                }
-                output.push_back(std::move(*value));
-            }
-            context->tables.erase(identity);
-            return plugin_json::Value(std::move(output));
+/**
+ * json::Reader handler that builds Lua values on the stack as it parses,
+ * leaving the decoded document on top
+ */
+class LuaJsonBuilder {
+public:
+    explicit LuaJsonBuilder(lua_State* state) : state_(state) {}
+
+    bool null() {
+        lua_pushnil(state_);
+        return attach();
+    }
+    bool boolean(bool value) {
+        lua_pushboolean(state_, value ? 1 : 0);
+        return attach();
+    }
+    bool integer(int64_t value) {
+        lua_pushinteger(state_, static_cast<lua_Integer>(value));
+        return attach();
+    }
+    bool number(double value) {
+        lua_pushnumber(state_, value);
+        return attach();
+    }
+    bool string(std::string_view value) {
+        lua_pushlstring(state_, value.data(), value.size());
+        return attach();
+    }
+
+    // Leaves the key above the object table until its value arrives
+    bool key(std::string_view name) {
+        Frame& frame = frames_.back();
+        lua_pushlstring(state_, name.data(), name.size());
+        lua_pushvalue(state_, -1);
+        const bool exists = lua_rawget(state_, -3) != LUA_TNIL;
+        lua_pop(state_, 1);
+        if (exists || std::find(frame.null_keys.begin(), frame.null_keys.end(), name) !=
+                          frame.null_keys.end()) {
+            failure_ = "duplicate object key";
+            return false;
         }
+        return true;
+    }
 
-        plugin_json::Object output;
-        lua_pushnil(state);
-        while (lua_next(state, index) != 0) {
-            std::string key;
-            if (lua_type(state, -2) == LUA_TSTRING) {
-                size_t size = 0;
-                const char* text = lua_tolstring(state, -2, &size);
-                if (!account_json_string(context, {text, size})) {
-                    lua_pop(state, 2);
-                    context->tables.erase(identity);
-                    return std::nullopt;
-                }
-                key.assign(text, size);
-            } else if (lua_isinteger(state, -2)) {
-                key = std::to_string(lua_tointeger(state, -2));
-                if (!account_json_string(context, key)) {
-                    lua_pop(state, 2);
-                    context->tables.erase(identity);
-                    return std::nullopt;
-                }
-            } else {
-                lua_pop(state, 2);
-                context->tables.erase(identity);
-                context->error = "JSON object keys must be strings or integers";
-                return std::nullopt;
-            }
-            auto value = lua_to_json(state, -1, depth + 1, context);
-            if (!value) {
-                lua_pop(state, 2);
-                context->tables.erase(identity);
-                return std::nullopt;
-            }
-            lua_pop(state, 1);
-            if (!output.emplace(std::move(key), std::move(*value)).second) {
-                lua_pop(state, 1);
-                context->tables.erase(identity);
-                context->error = "JSON object keys collide after normalization";
-                return std::nullopt;
-            }
+    bool begin_object() { return open(false); }
+    bool begin_array() { return open(true); }
+    bool end_object() { return close(); }
+    bool end_array() { return close(); }
+
+    const char* failure() const { return failure_; }
+
+private:
+    struct Frame {
+        bool array = false;
+        lua_Integer next = 1;
+        // Keys whose value was null; a nil table slot cannot show duplicates
+        std::vector<std::string> null_keys;
+    };
+
+    bool open(bool array) {
+        if (lua_checkstack(state_, 4) == 0) {
+            failure_ = "nesting exceeds the Lua stack";
+            return false;
         }
-        context->tables.erase(identity);
-        return plugin_json::Value(std::move(output));
+        lua_createtable(state_, 0, 0);
+        frames_.push_back(Frame{array, 1, {}});
+        return true;
     }
-    default:
-        break;
+
+    bool close() {
+        frames_.pop_back();
+        return attach();
     }
-    context->error = "Unsupported Lua value for JSON encoding";
-    return std::nullopt;
-}
 
-void json_to_lua(lua_State* state, const plugin_json::Value& value) {
-    switch (value.type) {
-    case plugin_json::Type::Null:
-        lua_pushnil(state);
-        break;
-    case plugin_json::Type::Bool:
-        lua_pushboolean(state, value.b);
-        break;
-    case plugin_json::Type::Integer:
-        lua_pushinteger(state, static_cast<lua_Integer>(value.i));
-        break;
-    case plugin_json::Type::Number:
-        lua_pushnumber(state, value.n);
-        break;
-    case plugin_json::Type::String:
-        lua_pushlstring(state, value.s.data(), value.s.size());
-        break;
-    case plugin_json::Type::Array:
-        lua_createtable(state, static_cast<int>(value.a.size()), 0);
-        for (size_t index = 0; index < value.a.size(); ++index) {
-            json_to_lua(state, value.a[index]);
-            lua_seti(state, -2, static_cast<lua_Integer>(index) + 1);
+    // Moves the value on top of the stack into the innermost open container
+    bool attach() {
+        if (frames_.empty())
+            return true;
+        Frame& frame = frames_.back();
+        if (frame.array) {
+            lua_rawseti(state_, -2, frame.next++);
+            return true;
         }
-        break;
-    case plugin_json::Type::Object:
-        lua_createtable(state, 0, static_cast<int>(value.o.size()));
-        for (const auto& [key, item] : value.o) {
-            lua_pushlstring(state, key.data(), key.size());
-            json_to_lua(state, item);
-            lua_settable(state, -3);
+        if (lua_isnil(state_, -1)) {
+            size_t size = 0;
+            const char* name = lua_tolstring(state_, -2, &size);
+            frame.null_keys.emplace_back(name, size);
         }
-        break;
+        lua_rawset(state_, -3);
+        return true;
     }
-}
+
+    lua_State* state_;
+    std::vector<Frame> frames_;
+    const char* failure_ = "rejected";
+};
 
 bool spawn_daemon_process(PluginApiContext* context, const std::string& callback,
                           int interval_seconds) {
@@ -1339,28 +1421,32 @@ int lua_api_json_decode(lua_State* state) {
     const char* text = lua_tolstring(state, 1, &size);
     if (size > kMaxJsonInput)
         return luaL_error(state, "json_decode input exceeds the size limit");
+    const int top = lua_gettop(state);
+    std::string error;
     try {
-        std::string error;
-        const auto value = plugin_json::parse(std::string(text, size), &error);
-        if (!value)
-            return luaL_error(state, "json_decode failed: %s", error.c_str());
-        json_to_lua(state, *value);
-        return 1;
+        LuaJsonBuilder builder(state);
+        json::Reader<LuaJsonBuilder> reader({text, size}, &builder);
+        if (reader.parse())
+            return 1;
+        error = reader.error();
     } catch (const std::exception& exception) {
-        return luaL_error(state, "json_decode failed: %s", exception.what());
+        error = exception.what();
     }
+    lua_settop(state, top);
+    return luaL_error(state, "json_decode failed: %s", error.c_str());
 }
 
 int lua_api_json_encode(lua_State* state) {
+    std::string output;
+    json::Writer writer(&output);
+    writer.set_budget(kMaxJsonInput);
+    writer.set_validate_utf8(true);
     JsonEncodeContext context;
-    auto value = lua_to_json(state, 1, 0, &context);
-    if (!value)
-        return luaL_error(state, "json_encode failed: %s", context.error.c_str());
-    if (!plugin_json::has_valid_utf8(*value))
-        return luaL_error(state, "json_encode failed: strings must be valid UTF-8");
-    const std::string output = plugin_json::dump(*value);
-    if (output.size() > kMaxJsonInput)
-        return luaL_error(state, "json_encode output exceeds the size limit");
+    context.writer = &writer;
+    if (!lua_to_json(state, 1, 0, &context)) {
+        const std::string error = context.error.empty() ? writer.error() : context.error;
+        return luaL_error(state, "json_encode failed: %s", error.c_str());
+    }
     lua_pushlstring(state, output.data(), output.size());
     return 1;
 }
@@ -1441,6 +1527,197 @@ void prepend_package_path(lua_State* state, const std::string& directory) {
     lua_pop(state, 1);
 }
 
+bool fill_random(void* buffer, size_t size) {
+    auto* bytes = static_cast<uint8_t*>(buffer);
+    while (size > 0) {
+        const ssize_t count = getrandom(bytes, size, 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        bytes += count;
+        size -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+// luaL_makeseed() mixes the clock with addresses, which forked siblings share
+unsigned int lua_state_seed() {
+    unsigned int seed = 0;
+    return fill_random(&seed, sizeof(seed)) ? seed : luaL_makeseed(nullptr);
+}
+
+// Give this process its own math.random sequence
+void reseed_lua_random(lua_State* state) {
+    std::array<lua_Integer, 2> seed{};
+    if (!fill_random(seed.data(), sizeof(seed)))
+        return;
+    lua_getglobal(state, "math");
+    if (lua_istable(state, -1)) {
+        lua_getfield(state, -1, "randomseed");
+        if (lua_isfunction(state, -1)) {
+            lua_pushinteger(state, seed[0]);
+            lua_pushinteger(state, seed[1]);
+            if (lua_pcall(state, 2, 0, 0) != LUA_OK)
+                lua_pop(state, 1);
+        } else {
+            lua_pop(state, 1);
+        }
+    }
+    lua_pop(state, 1);
+}
+
+std::unique_ptr<LuaRuntime> create_lua_runtime() {
+    auto runtime = std::make_unique<LuaRuntime>();
+    runtime->state.reset(lua_newstate(limited_lua_allocator, &runtime->memory, lua_state_seed()));
+    if (!runtime->state)
+        return nullptr;
+    luaL_openlibs(runtime->state.get());
+    reseed_lua_random(runtime->state.get());
+    protect_library_descriptors(runtime->state.get());
+    register_api(runtime->state.get(), &runtime->context);
+    return runtime;
+}
+
+// Fork-server mode: the stage runner builds one runtime up front and every
+// forked callback worker consumes its private copy instead of rebuilding it.
+void prewarm_lua_runtime() {
+    PrewarmedRuntime& prewarmed = prewarmed_runtime();
+    if (!fork_server_enabled || (prewarmed.runtime && prewarmed.owner == getpid()))
+        return;
+    prewarmed.runtime = create_lua_runtime();
+    prewarmed.owner = getpid();
+}
+
+std::unique_ptr<LuaRuntime> acquire_lua_runtime() {
+    PrewarmedRuntime& prewarmed = prewarmed_runtime();
+    // The owner keeps its copy for the next fork; only a forked worker may use it.
+    if (prewarmed.runtime && prewarmed.owner != getpid()) {
+        prewarmed.owner = -1;
+        // Every worker forked from the owner inherits the same generator state
+        reseed_lua_random(prewarmed.runtime->state.get());
+        return std::move(prewarmed.runtime);
+    }
+    return create_lua_runtime();
+}
+
+Digest sha256_digest(std::string_view data) {
+    Digest digest{};
+    mbedtls_sha256(reinterpret_cast<const unsigned char*>(data.data()), data.size(),
+                   digest.data(), 0);
+    return digest;
+}
+
+int append_bytecode(lua_State* /*state*/, const void* data, size_t size, void* output) {
+    static_cast<std::string*>(output)->append(static_cast<const char*>(data), size);
+    return 0;
+}
+
+fs::path bytecode_cache_path(const std::string& plugin_id) {
+    return fs::path(PLUGIN_CACHE_DIR) / (plugin_id + ".luac");
+}
+
+std::string entry_chunk_name(const PluginRecord& plugin) {
+    return "@" + (fs::path(plugin.directory) / plugin.manifest.entry).string();
+}
+
+// Mirror luaL_loadfilex: drop a UTF-8 BOM and blank a leading '#' line while
+// keeping line numbers stable.
+void strip_entry_prefix(std::string* source) {
+    if (source->compare(0, 3, "\xEF\xBB\xBF") == 0)
+        source->erase(0, 3);
+    if (!source->empty() && source->front() == '#')
+        source->erase(0, std::min(source->find('\n'), source->size()));
+}
+
+std::optional<std::string> read_cached_bytecode(const std::string& plugin_id,
+                                                const Digest& source_digest) {
+    std::string error;
+    const auto content = read_plugin_file(bytecode_cache_path(plugin_id).string(), &error);
+    if (!content || content->size() < sizeof(BytecodeCacheHeader))
+        return std::nullopt;
+    BytecodeCacheHeader header;
+    std::memcpy(&header, content->data(), sizeof(header));
+    if (header.magic != kBytecodeCacheMagic || header.version != kBytecodeCacheVersion ||
+        header.lua_version != LUA_VERSION_NUM || header.source_digest != source_digest ||
+        header.bytecode_size != content->size() - sizeof(header)) {
+        return std::nullopt;
+    }
+    std::string bytecode = content->substr(sizeof(header));
+    if (sha256_digest(bytecode) != header.bytecode_digest)
+        return std::nullopt;
+    return bytecode;
+}
+
+void store_cached_bytecode(const std::string& plugin_id, const Digest& source_digest,
+                           const std::string& bytecode) {
+    BytecodeCacheHeader header;
+    header.bytecode_size = bytecode.size();
+    header.source_digest = source_digest;
+    header.bytecode_digest = sha256_digest(bytecode);
+    std::string content(reinterpret_cast<const char*>(&header), sizeof(header));
+    content += bytecode;
+
+    std::error_code error;
+    fs::create_directories(PLUGIN_CACHE_DIR, error);
+    if (error)
+        return;
+    (void)chmod(PLUGIN_CACHE_DIR, 0700);
+    const fs::path path = bytecode_cache_path(plugin_id);
+    const fs::path temporary = path.string() + ".tmp." + std::to_string(getpid());
+    if (!write_plugin_file(temporary, content) || rename(temporary.c_str(), path.c_str()) != 0)
+        fs::remove(temporary, error);
+}
+
+// Compile the entry script once per snapshot (or take it from the on-disk
+// cache) so callback workers only have to undump it.
+void prepare_entry_bytecode(const PluginRecord& plugin) {
+    if (!bytecode_cache_enabled || !plugin.code_snapshot ||
+        !plugin.code_snapshot->entry_bytecode().empty()) {
+        return;
+    }
+    std::string error;
+    auto source = read_plugin_file(
+        (fs::path(plugin.code_snapshot->directory()) / plugin.manifest.entry).string(), &error);
+    if (!source)
+        return;
+    strip_entry_prefix(&*source);
+    const Digest source_digest = sha256_digest(*source);
+    if (auto cached = read_cached_bytecode(plugin.id, source_digest)) {
+        plugin.code_snapshot->set_entry_bytecode(std::move(*cached));
+        return;
+    }
+
+    LuaMemoryContext memory;
+    const ScopedLuaState state(
+        lua_newstate(limited_lua_allocator, &memory, luaL_makeseed(nullptr)));
+    if (!state)
+        return;
+    const std::string chunk_name = entry_chunk_name(plugin);
+    if (luaL_loadbufferx(state.get(), source->data(), source->size(), chunk_name.c_str(), "t") !=
+        LUA_OK) {
+        return;
+    }
+    std::string bytecode;
+    if (lua_dump(state.get(), append_bytecode, &bytecode, 0) != 0 || bytecode.empty())
+        return;
+    store_cached_bytecode(plugin.id, source_digest, bytecode);
+    plugin.code_snapshot->set_entry_bytecode(std::move(bytecode));
+}
+
+int load_entry_chunk(lua_State* state, const PluginRecord& plugin,
+                     const std::string& code_directory) {
+    prepare_entry_bytecode(plugin);
+    if (bytecode_cache_enabled && plugin.code_snapshot &&
+        !plugin.code_snapshot->entry_bytecode().empty()) {
+        const std::string& bytecode = plugin.code_snapshot->entry_bytecode();
+        return luaL_loadbufferx(state, bytecode.data(), bytecode.size(),
+                                entry_chunk_name(plugin).c_str(), "b");
+    }
+    const fs::path entry = fs::path(code_directory) / plugin.manifest.entry;
+    return luaL_loadfilex(state, entry.c_str(), "t");
+}
+
 std::shared_ptr<PluginCodeSnapshot> open_plugin_snapshot(const std::string& directory,
                                                          std::string* error) {
     for (int attempt = 0; attempt < 8; ++attempt) {
@@ -1529,19 +1806,15 @@ PluginRunResult call_plugin(const PluginRecord& plugin, const std::string& callb
         *callback_ready = false;
     const std::string& code_directory =
         plugin.code_snapshot ? plugin.code_snapshot->directory() : plugin.directory;
-    PluginApiContext context{plugin.id, plugin.directory};
-    LuaMemoryContext memory;
-    const ScopedLuaState state(
-        lua_newstate(limited_lua_allocator, &memory, luaL_makeseed(nullptr)));
-    if (!state) {
+    const std::unique_ptr<LuaRuntime> runtime = acquire_lua_runtime();
+    if (!runtime) {
         report_daemon_ready(&ready_fd, false);
         plugin_append_log(plugin.directory, "W", "cannot allocate a Lua state");
         return PluginRunResult::Failed;
     }
-    luaL_openlibs(state.get());
-    protect_library_descriptors(state.get());
-
-    register_api(state.get(), &context);
+    PluginApiContext& context = runtime->context;
+    context = PluginApiContext{plugin.id, plugin.directory};
+    const ScopedLuaState& state = runtime->state;
     lua_pushlstring(state.get(), plugin.id.data(), plugin.id.size());
     lua_setglobal(state.get(), "PLUGIN_ID");
     lua_pushlstring(state.get(), plugin.directory.data(), plugin.directory.size());
@@ -1552,8 +1825,7 @@ PluginRunResult call_plugin(const PluginRecord& plugin, const std::string& callb
 
     lua_pushcfunction(state.get(), traceback_handler);
     const int load_handler = lua_gettop(state.get());
-    const fs::path entry = fs::path(code_directory) / plugin.manifest.entry;
-    int status = luaL_loadfilex(state.get(), entry.c_str(), "t");
+    int status = load_entry_chunk(state.get(), plugin, code_directory);
     if (status == LUA_OK)
         status = lua_pcall(state.get(), 0, 1, load_handler);
     if (status != LUA_OK) {
@@ -1646,11 +1918,28 @@ PluginRunResult exit_code_result(int code) {
     return PluginRunResult::Failed;
 }
 
-PluginRunResult run_blocking_worker(const PluginRecord& plugin, const std::string& callback,
-                                    bool optional, bool auto_start_main, int timeout_seconds) {
+struct CallbackWorker {
+    pid_t pid = -1;
+    int pid_fd = -1;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+int open_pidfd(pid_t pid) {
+#if defined(SYS_pidfd_open)
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+bool spawn_callback_worker(const PluginRecord& plugin, const std::string& callback, bool optional,
+                           bool auto_start_main, int timeout_seconds, CallbackWorker* worker) {
     const pid_t child = fork();
     if (child < 0)
-        return PluginRunResult::Failed;
+        return false;
     if (child == 0) {
         (void)setpgid(0, 0);
         switch_cgroups();
@@ -1659,29 +1948,266 @@ PluginRunResult run_blocking_worker(const PluginRecord& plugin, const std::strin
         _exit(result_exit_code(result));
     }
     (void)setpgid(child, child);
+    worker->pid = child;
+    worker->pid_fd = open_pidfd(child);
+    worker->started = std::chrono::steady_clock::now();
+    worker->deadline = worker->started + std::chrono::seconds(timeout_seconds);
+    return true;
+}
+
+long long elapsed_milliseconds(const timeval& value) {
+    return (static_cast<long long>(value.tv_sec) * 1000) + (value.tv_usec / 1000);
+}
+
+// Reap a worker that exited (or kill it first when it overran its deadline) and
+// record its wall and CPU time as a debug line in the plugin log.
+PluginRunResult finish_callback_worker(const PluginRecord& plugin, const std::string& callback,
+                                       CallbackWorker* worker, bool timed_out) {
+    if (timed_out) {
+        (void)kill(-worker->pid, SIGKILL);
+        (void)kill(worker->pid, SIGKILL);
+    }
     int status = 0;
-    pid_t waited = 0;
-    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout_seconds);
-    while (true) {
-        waited = waitpid(child, &status, WNOHANG);
-        if (waited == child)
-            break;
-        if (waited < 0 && errno == EINTR)
+    rusage usage{};
+    pid_t waited;
+    do {
+        waited = wait4(worker->pid, &status, 0, &usage);
+    } while (waited < 0 && errno == EINTR);
+    if (worker->pid_fd >= 0) {
+        close(worker->pid_fd);
+        worker->pid_fd = -1;
+    }
+    if (timed_out) {
+        plugin_append_log(plugin.directory, "W",
+                          "callback '" + callback + "' exceeded its time limit");
+        return PluginRunResult::Failed;
+    }
+    const auto wall = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - worker->started);
+    const long long cpu = elapsed_milliseconds(usage.ru_utime) + elapsed_milliseconds(usage.ru_stime);
+    plugin_append_log(plugin.directory, "D",
+                      "callback '" + callback + "' took " + std::to_string(wall.count()) +
+                          " ms wall, " + std::to_string(cpu) + " ms cpu");
+    if (waited < 0 || !WIFEXITED(status))
+        return PluginRunResult::Failed;
+    return exit_code_result(WEXITSTATUS(status));
+}
+
+// Waits on many callback workers at once: exits arrive through pidfds in an
+// epoll set, and the wait timeout is the nearest worker deadline. Kernels
+// without pidfd fall back to a short waitid() probe.
+class WorkerSupervisor {
+public:
+    struct Finished {
+        size_t key = 0;
+        CallbackWorker worker;
+        bool timed_out = false;
+    };
+
+    WorkerSupervisor() : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)) {}
+    ~WorkerSupervisor() {
+        if (epoll_fd_ >= 0)
+            close(epoll_fd_);
+    }
+
+    WorkerSupervisor(const WorkerSupervisor&) = delete;
+    WorkerSupervisor& operator=(const WorkerSupervisor&) = delete;
+
+    void add(size_t key, CallbackWorker worker) {
+        if (worker.pid_fd >= 0) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = worker.pid_fd;
+            if (epoll_fd_ < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, worker.pid_fd, &event) != 0) {
+                close(worker.pid_fd);
+                worker.pid_fd = -1;
+            }
+        }
+        workers_.push_back({key, worker});
+    }
+
+    [[nodiscard]] bool empty() const { return workers_.empty(); }
+
+    Finished wait_next() {
+        while (true) {
+            const auto now = std::chrono::steady_clock::now();
+            auto nearest = std::chrono::steady_clock::time_point::max();
+            bool polling = epoll_fd_ < 0;
+            for (size_t index = 0; index < workers_.size(); ++index) {
+                const CallbackWorker& worker = workers_[index].worker;
+                if (worker.pid_fd < 0) {
+                    polling = true;
+                    siginfo_t info{};
+                    if (waitid(P_PID, static_cast<id_t>(worker.pid), &info,
+                               WEXITED | WNOHANG | WNOWAIT) == 0 &&
+                        info.si_pid == worker.pid) {
+                        return take(index, false);
+                    }
+                }
+                if (now >= worker.deadline)
+                    return take(index, true);
+                nearest = std::min(nearest, worker.deadline);
+            }
+
+            const auto remaining =
+                std::chrono::ceil<std::chrono::milliseconds>(nearest - now).count();
+            int timeout = static_cast<int>(std::min<long long>(remaining, INT_MAX));
+            if (polling)
+                timeout = std::min(timeout, kWorkerPollFallbackMilliseconds);
+            if (epoll_fd_ < 0) {
+                (void)poll(nullptr, 0, timeout);
+                continue;
+            }
+            std::array<epoll_event, 8> events{};
+            const int count =
+                epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout);
+            if (count <= 0)
+                continue;
+            for (size_t index = 0; index < workers_.size(); ++index) {
+                if (workers_[index].worker.pid_fd == events[0].data.fd)
+                    return take(index, false);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        size_t key;
+        CallbackWorker worker;
+    };
+
+    Finished take(size_t index, bool timed_out) {
+        Finished finished{workers_[index].key, workers_[index].worker, timed_out};
+        if (epoll_fd_ >= 0 && finished.worker.pid_fd >= 0)
+            (void)epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, finished.worker.pid_fd, nullptr);
+        workers_.erase(workers_.begin() + static_cast<std::ptrdiff_t>(index));
+        return finished;
+    }
+
+    int epoll_fd_;
+    std::vector<Entry> workers_;
+};
+
+PluginRunResult run_blocking_worker(const PluginRecord& plugin, const std::string& callback,
+                                    bool optional, bool auto_start_main, int timeout_seconds) {
+    CallbackWorker worker;
+    if (!spawn_callback_worker(plugin, callback, optional, auto_start_main, timeout_seconds,
+                               &worker)) {
+        return PluginRunResult::Failed;
+    }
+    WorkerSupervisor supervisor;
+    supervisor.add(0, worker);
+    WorkerSupervisor::Finished finished = supervisor.wait_next();
+    return finish_callback_worker(plugin, callback, &finished.worker, finished.timed_out);
+}
+
+size_t stage_worker_limit() {
+    const long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return static_cast<size_t>(std::clamp(online, 1L, kMaxConcurrentStageWorkers));
+}
+
+// Run a blocking stage with independent plugins in parallel. A plugin starts
+// once every dependency in this stage has finished (successfully or not), which
+// keeps the order plugin_resolve_enabled() guarantees for dependents.
+bool run_stage_workers(const std::vector<PluginRecord>& plugins, const std::string& callback) {
+    const bool auto_start_main = callback == "service";
+    std::map<std::string, size_t> index_of;
+    for (size_t index = 0; index < plugins.size(); ++index)
+        index_of.emplace(plugins[index].id, index);
+    std::vector<size_t> pending(plugins.size(), 0);
+    std::vector<std::vector<size_t>> dependents(plugins.size());
+    for (size_t index = 0; index < plugins.size(); ++index) {
+        for (const auto& dependency : plugins[index].manifest.depends) {
+            const auto found = index_of.find(dependency);
+            if (found == index_of.end())
+                continue;
+            ++pending[index];
+            dependents[found->second].push_back(index);
+        }
+    }
+    std::deque<size_t> ready;
+    for (size_t index = 0; index < plugins.size(); ++index) {
+        if (pending[index] == 0)
+            ready.push_back(index);
+    }
+
+    std::vector<std::optional<PluginRecord>> loaded(plugins.size());
+    // Workers overlap, so each one is recorded when it is reaped
+    std::vector<uint64_t> started_at(plugins.size(), 0);
+    const auto complete = [&](size_t index) {
+        loaded[index].reset();
+        for (const size_t dependent : dependents[index]) {
+            if (--pending[dependent] == 0)
+                ready.push_back(dependent);
+        }
+    };
+
+    WorkerSupervisor supervisor;
+    const size_t limit = stage_worker_limit();
+    size_t running = 0;
+    bool success = true;
+    while (!ready.empty() || running != 0) {
+        while (!ready.empty() && running < limit) {
+            const size_t index = ready.front();
+            ready.pop_front();
+            std::string load_error;
+            loaded[index] = load_plugin_record(plugins[index].id, true, &load_error);
+            if (!loaded[index]) {
+                LOGW("plugin %s stage %s skipped: %s", plugins[index].id.c_str(), callback.c_str(),
+                     load_error.c_str());
+                success = false;
+                complete(index);
+                continue;
+            }
+            prepare_entry_bytecode(*loaded[index]);
+            started_at[index] = boot_timeline_now();
+            CallbackWorker worker;
+            if (!spawn_callback_worker(*loaded[index], callback, true, auto_start_main,
+                                       kStageCallbackTimeoutSeconds, &worker)) {
+                LOGW("plugin %s stage %s failed", plugins[index].id.c_str(), callback.c_str());
+                success = false;
+                complete(index);
+                continue;
+            }
+            supervisor.add(index, worker);
+            ++running;
+        }
+        if (running == 0)
             continue;
-        if (waited < 0)
-            break;
-        if (std::chrono::steady_clock::now() >= deadline) {
-            (void)kill(-child, SIGKILL);
-            (void)kill(child, SIGKILL);
-            do {
-                waited = waitpid(child, &status, 0);
-            } while (waited < 0 && errno == EINTR);
-            plugin_append_log(plugin.directory, "W",
-                              "callback '" + callback + "' exceeded its time limit");
-            return PluginRunResult::Failed;
+
+        WorkerSupervisor::Finished finished = supervisor.wait_next();
+        --running;
+        const size_t index = finished.key;
+        if (finish_callback_worker(*loaded[index], callback, &finished.worker,
+                                   finished.timed_out) != PluginRunResult::Success) {
+            LOGW("plugin %s stage %s failed", plugins[index].id.c_str(), callback.c_str());
+            success = false;
         }
-        (void)poll(nullptr, 0, 100);
+        boot_timeline_record(BootSpanKind::Plugin, plugins[index].id, callback,
+                             started_at[index], boot_timeline_now());
+        complete(index);
+    }
+    return success;
+}
+
+// Run one callback in a forked worker with its output discarded and no deadline,
+// so repeated benchmark iterations measure only the callback path.
+PluginRunResult run_bench_worker(const PluginRecord& plugin, const std::string& callback) {
+    const pid_t child = fork();
+    if (child < 0)
+        return PluginRunResult::Failed;
+    if (child == 0) {
+        if (!redirect_standard_streams())
+            _exit(1);
+        const PluginRunResult result = call_plugin(plugin, callback, false, false);
+        (void)std::fflush(nullptr);
+        _exit(result_exit_code(result));
     }
+    int status = 0;
+    pid_t waited;
+    do {
+        waited = waitpid(child, &status, 0);
+    } while (waited < 0 && errno == EINTR);
     if (waited < 0 || !WIFEXITED(status))
         return PluginRunResult::Failed;
     return exit_code_result(WEXITSTATUS(status));
@@ -1745,6 +2271,11 @@ bool exec_plugin_stage(const std::string& stage, bool block) {
     for (const auto& error : errors)
         LOGW("plugin discovery: %s", error.c_str());
 
+    if (!plugins.empty())
+        prewarm_lua_runtime();
+    if (block)
+        return run_stage_workers(plugins, callback);
+
     bool success = true;
     for (const auto& discovered_plugin : plugins) {
         std::string load_error;
@@ -1756,15 +2287,11 @@ bool exec_plugin_stage(const std::string& stage, bool block) {
             continue;
         }
         const auto& plugin = *loaded_plugin;
+        prepare_entry_bytecode(plugin);
         const bool auto_start_main = callback == "service";
-        if (block) {
-            const PluginRunResult result = run_blocking_worker(
-                plugin, callback, true, auto_start_main, kStageCallbackTimeoutSeconds);
-            if (result != PluginRunResult::Success) {
-                LOGW("plugin %s stage %s failed", plugin.id.c_str(), callback.c_str());
-                success = false;
-            }
-        } else if (!run_detached_worker(plugin, callback, auto_start_main)) {
+        BootSpan span(BootSpanKind::Plugin, plugin.id, callback);
+        span.set_async();
+        if (!run_detached_worker(plugin, callback, auto_start_main)) {
             LOGW("plugin %s stage %s could not be launched", plugin.id.c_str(), callback.c_str());
             success = false;
         }
@@ -1772,6 +2299,69 @@ bool exec_plugin_stage(const std::string& stage, bool block) {
     return success;
 }
 
+int bench_plugin_callback(const std::string& plugin_id, const std::string& callback,
+                          int iterations) {
+    if (!plugin_callback_is_valid(callback) || iterations < 1) {
+        print_error("Invalid plugin callback or iteration count\n");
+        return 1;
+    }
+    std::string error;
+    const auto plugin = load_plugin_record(plugin_id, true, &error);
+    if (!plugin) {
+        print_error("%s\n", error.c_str());
+        return 1;
+    }
+
+    struct BenchMode {
+        const char* name;
+        bool bytecode_cache;
+        bool fork_server;
+    };
+    constexpr std::array<BenchMode, 3> modes{{
+        {"source", false, false},
+        {"bytecode", true, false},
+        {"fork-server", true, true},
+    }};
+    print_output("plugin %s callback %s, %d iterations\n", plugin_id.c_str(), callback.c_str(),
+                 iterations);
+    int exit_code = 0;
+    for (const auto& mode : modes) {
+        bytecode_cache_enabled = mode.bytecode_cache;
+        fork_server_enabled = mode.fork_server;
+        prewarmed_runtime() = PrewarmedRuntime{};
+        plugin->code_snapshot->set_entry_bytecode({});
+
+        const auto setup_start = std::chrono::steady_clock::now();
+        prewarm_lua_runtime();
+        prepare_entry_bytecode(*plugin);
+        const auto setup = std::chrono::steady_clock::now() - setup_start;
+
+        std::chrono::nanoseconds total{0};
+        std::chrono::nanoseconds fastest = std::chrono::nanoseconds::max();
+        int failures = 0;
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            const auto start = std::chrono::steady_clock::now();
+            if (run_bench_worker(*plugin, callback) != PluginRunResult::Success)
+                ++failures;
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            total += elapsed;
+            fastest = std::min(fastest, std::chrono::nanoseconds(elapsed));
+        }
+        const auto micros = [](std::chrono::nanoseconds value) {
+            return static_cast<long long>(
+                std::chrono::duration_cast<std::chrono::microseconds>(value).count());
+        };
+        print_output("  %-12s setup %7lld us  avg %7lld us  min %7lld us  failed %d\n", mode.name,
+                     micros(setup), micros(total / iterations), micros(fastest), failures);
+        if (failures != 0)
+            exit_code = 1;
+    }
+    bytecode_cache_enabled = true;
+    fork_server_enabled = true;
+    prewarmed_runtime() = PrewarmedRuntime{};
+    return exit_code;
+}
+
 bool stop_plugin_daemons(const std::string& plugin_id, std::string* error) {
     if (!plugin_id_is_valid(plugin_id)) {
         *error = "Invalid plugin id";
@@ -282,24 +282,24 @@ std::string plugin_directory(const std::string& id) {
     return std::string(PLUGIN_DIR) + id;
 }
 
-std::string value_as_string(const plugin_json::Value& value) {
-    if (value.type == plugin_json::Type::String)
+std::string value_as_string(const json::Value& value) {
+    if (value.type == json::Type::String)
         return value.s;
-    if (value.type == plugin_json::Type::Null)
+    if (value.type == json::Type::Null)
         return {};
-    return plugin_json::dump(value);
+    return json::dump(value);
 }
 
-std::optional<plugin_json::Value> parse_json(const std::string& content, std::string* error) {
-    return plugin_json::parse(content, error);
+std::optional<json::Value> parse_json(const std::string& content, std::string* error) {
+    return json::try_parse(content, error);
 }
 
-bool read_optional_string(const plugin_json::Object& object, const char* key, std::string* output,
+bool read_optional_string(const json::Object& object, const char* key, std::string* output,
                           std::string* error) {
     const auto iterator = object.find(key);
     if (iterator == object.end())
         return true;
-    if (iterator->second.type != plugin_json::Type::String) {
+    if (iterator->second.type != json::Type::String) {
         if (error)
             *error = std::string("Manifest field '") + key + "' must be a string";
         return false;
@@ -308,23 +308,23 @@ bool read_optional_string(const plugin_json::Object& object, const char* key, st
     return true;
 }
 
-bool validate_localized_strings(const plugin_json::Value& value, const char* field,
+bool validate_localized_strings(const json::Value& value, const char* field,
                                 std::string* error) {
-    if (value.type != plugin_json::Type::Object) {
+    if (value.type != json::Type::Object) {
         if (error)
             *error = std::string("Manifest field '") + field + "' must be an object";
         return false;
     }
     const bool valid = std::all_of(value.o.begin(), value.o.end(), [](const auto& entry) {
-        return !entry.first.empty() && entry.second.type == plugin_json::Type::String;
+        return !entry.first.empty() && entry.second.type == json::Type::String;
     });
     if (!valid && error)
         *error = std::string("Manifest field '") + field + "' has an invalid entry";
     return valid;
 }
 
-bool validate_config_fields(const plugin_json::Value& config, std::string* error) {
-    if (config.type != plugin_json::Type::Array) {
+bool validate_config_fields(const json::Value& config, std::string* error) {
+    if (config.type != json::Type::Array) {
         if (error)
             *error = "Manifest field 'config' must be an array";
         return false;
@@ -332,13 +332,13 @@ bool validate_config_fields(const plugin_json::Value& config, std::string* error
 
     std::set<std::string> keys;
     for (const auto& field : config.a) {
-        if (field.type != plugin_json::Type::Object) {
+        if (field.type != json::Type::Object) {
             if (error)
                 *error = "Each config field must be an object";
             return false;
         }
         const auto key = field.o.find("key");
-        if (key == field.o.end() || key->second.type != plugin_json::Type::String ||
+        if (key == field.o.end() || key->second.type != json::Type::String ||
             !plugin_config_key_is_valid(key->second.s) || !keys.insert(key->second.s).second) {
             if (error)
                 *error = "Config fields must have unique, valid keys";
@@ -347,7 +347,7 @@ bool validate_config_fields(const plugin_json::Value& config, std::string* error
 
         const auto type = field.o.find("type");
         if (type != field.o.end()) {
-            if (type->second.type != plugin_json::Type::String ||
+            if (type->second.type != json::Type::String ||
                 (type->second.s != "text" && type->second.s != "number" &&
                  type->second.s != "bool" && type->second.s != "select")) {
                 if (error)
@@ -357,7 +357,7 @@ bool validate_config_fields(const plugin_json::Value& config, std::string* error
         }
 
         const auto label = field.o.find("label");
-        if (label != field.o.end() && label->second.type != plugin_json::Type::String) {
+        if (label != field.o.end() && label->second.type != json::Type::String) {
             if (error)
                 *error = "Config field label must be a string";
             return false;
@@ -369,10 +369,10 @@ bool validate_config_fields(const plugin_json::Value& config, std::string* error
         }
         const auto options = field.o.find("options");
         if (options != field.o.end()) {
-            if (options->second.type != plugin_json::Type::Array ||
+            if (options->second.type != json::Type::Array ||
                 !std::all_of(options->second.a.begin(), options->second.a.end(),
-                             [](const plugin_json::Value& option) {
-                                 return option.type == plugin_json::Type::String;
+                             [](const json::Value& option) {
+                                 return option.type == json::Type::String;
                              })) {
                 if (error)
                     *error = "Config field options must be an array of strings";
@@ -616,7 +616,7 @@ bool atomic_write(const fs::path& path, const std::string& content, std::string*
     return true;
 }
 
-std::optional<plugin_json::Object> read_config_object(const fs::path& path, std::string* error) {
+std::optional<json::Object> read_config_object(const fs::path& path, std::string* error) {
     std::error_code size_error;
     const auto size = fs::file_size(path, size_error);
     if (!size_error && size > kMaxConfigSize) {
@@ -626,9 +626,9 @@ std::optional<plugin_json::Object> read_config_object(const fs::path& path, std:
     }
     const auto content = read_file(path);
     if (!content)
-        return plugin_json::Object{};
+        return json::Object{};
     const auto value = parse_json(*content, error);
-    if (!value || value->type != plugin_json::Type::Object) {
+    if (!value || value->type != json::Type::Object) {
         if (error && error->empty())
             *error = "config.json is not a JSON object";
         return std::nullopt;
@@ -636,10 +636,16 @@ std::optional<plugin_json::Object> read_config_object(const fs::path& path, std:
     return value->o;
 }
 
-bool write_config_object(const fs::path& path, const plugin_json::Object& object,
+bool write_config_object(const fs::path& path, const json::Object& object,
                          std::string* error) {
-    const std::string content = plugin_json::dump(plugin_json::Value(object), 2);
-    if (content.size() > kMaxConfigSize) {
+    std::string content;
+    json::Writer writer(&content, 2);
+    writer.set_budget(kMaxConfigSize);
+    writer.begin_object();
+    for (const auto& [key, value] : object)
+        writer.key(key).value(value);
+    writer.end_object();
+    if (!writer.ok()) {
         *error = "config.json exceeds the size limit";
         return false;
     }
@@ -930,14 +936,14 @@ int plugin_install(const std::string& zip_path) {
     }
 
     const auto parsed = parse_json(inspected->manifest, &error);
-    if (!parsed || parsed->type != plugin_json::Type::Object) {
+    if (!parsed || parsed->type != json::Type::Object) {
         print_error("Invalid plugin.json: %s\n", error.c_str());
         return 1;
     }
 
     // Parse through the same validator used at runtime by staging the manifest in memory below.
     const auto id_value = parsed->o.find("id");
-    if (id_value == parsed->o.end() || id_value->second.type != plugin_json::Type::String ||
+    if (id_value == parsed->o.end() || id_value->second.type != json::Type::String ||
         !plugin_id_is_valid(id_value->second.s)) {
         print_error("plugin.json has an invalid id\n");
         return 1;
@@ -1138,6 +1144,8 @@ int plugin_uninstall(const std::string& id) {
         print_error("Cannot uninstall plugin: %s\n", stage_error.message().c_str());
         return 1;
     }
+    std::error_code cache_error;
+    fs::remove(fs::path(PLUGIN_CACHE_DIR) / (id + ".luac"), cache_error);
     std::string sync_error;
     if (!sync_directory(PLUGIN_DIR, &sync_error) ||
         !sync_directory(PLUGIN_STAGE_DIR, &sync_error)) {
@@ -1220,31 +1228,34 @@ int plugin_set_enabled(const std::string& id, bool enabled) {
 }
 
 int plugin_list() {
-    plugin_json::Array output;
+    std::string output;
+    json::Writer writer(&output);
+    writer.begin_array();
     for (const auto& plugin : plugin_discover()) {
-        plugin_json::Object item;
-        item["id"] = plugin_json::Value(plugin.id);
-        item["name"] =
-            plugin_json::Value(plugin.manifest.name.empty() ? plugin.id : plugin.manifest.name);
-        item["author"] = plugin_json::Value(plugin.manifest.author);
-        item["version"] = plugin_json::Value(plugin.manifest.version);
-        item["description"] = plugin_json::Value(plugin.manifest.description);
-        item["descriptions"] = plugin.manifest.descriptions;
-        item["license"] = plugin_json::Value(plugin.manifest.license);
-        item["enabled"] = plugin_json::Value(plugin.enabled);
-        item["has_manifest"] = plugin_json::Value(plugin.manifest_valid);
-        item["has_action"] = plugin_json::Value(plugin.manifest.has_action);
-        item["quick_action"] = plugin.manifest.quick_action;
-        item["config"] = plugin.manifest.config;
-        plugin_json::Array dependencies;
+        // Members in key order, as the listing has always been printed
+        writer.begin_object();
+        writer.member("author", plugin.manifest.author);
+        writer.key("config").value(plugin.manifest.config);
+        writer.key("depends").begin_array();
         for (const auto& dependency : plugin.manifest.depends)
-            dependencies.emplace_back(dependency);
-        item["depends"] = plugin_json::Value(dependencies);
+            writer.string(dependency);
+        writer.end_array();
+        writer.member("description", plugin.manifest.description);
+        writer.key("descriptions").value(plugin.manifest.descriptions);
+        writer.member("enabled", plugin.enabled);
         if (!plugin.error.empty())
-            item["error"] = plugin_json::Value(plugin.error);
-        output.emplace_back(item);
-    }
-    print_output("%s\n", plugin_json::dump(plugin_json::Value(output)).c_str());
+            writer.member("error", plugin.error);
+        writer.member("has_action", plugin.manifest.has_action);
+        writer.member("has_manifest", plugin.manifest_valid);
+        writer.member("id", plugin.id);
+        writer.member("license", plugin.manifest.license);
+        writer.member("name", plugin.manifest.name.empty() ? plugin.id : plugin.manifest.name);
+        writer.key("quick_action").value(plugin.manifest.quick_action);
+        writer.member("version", plugin.manifest.version);
+        writer.end_object();
+    }
+    writer.end_array();
+    print_output("%s\n", output.c_str());
     return 0;
 }
 
@@ -1355,7 +1366,13 @@ int plugin_config_handle(const std::string& id, const std::vector<std::string>&
             print_error("%s\n", error.c_str());
             return 1;
         }
-        print_output("%s\n", plugin_json::dump(plugin_json::Value(*object)).c_str());
+        std::string output;
+        json::Writer writer(&output);
+        writer.begin_object();
+        for (const auto& [key, value] : *object)
+            writer.key(key).value(value);
+        writer.end_object();
+        print_output("%s\n", output.c_str());
         return 0;
     }
 
@@ -1394,6 +1411,7 @@ void print_usage() {
     print_output("  list                         List plugins as JSON\n");
     print_output("  run <ID> <FUNCTION>          Run a plugin callback\n");
     print_output("  action <ID>                  Run the action callback\n");
+    print_output("  bench <ID> <FUNCTION> [N]    Time a callback with and without warm caches\n");
     print_output("  log <ID>                     Show a plugin log\n");
     print_output("  clear-log <ID|all>           Clear plugin logs\n");
     print_output("  config --id <ID> <get|set|delete|list> [KEY] [VALUE]\n");
@@ -1436,7 +1454,7 @@ std::optional<PluginManifest> plugin_read_manifest(const std::string& directory,
         return std::nullopt;
     }
     auto root = parse_json(*content, error);
-    if (!root || root->type != plugin_json::Type::Object) {
+    if (!root || root->type != json::Type::Object) {
         if (error && error->empty())
             *error = "plugin.json must contain an object";
         return std::nullopt;
@@ -1445,7 +1463,7 @@ std::optional<PluginManifest> plugin_read_manifest(const std::string& directory,
     PluginManifest manifest;
     manifest.entry = PLUGIN_ENTRY;
     const auto id = root->o.find("id");
-    if (id == root->o.end() || id->second.type != plugin_json::Type::String ||
+    if (id == root->o.end() || id->second.type != json::Type::String ||
         !plugin_id_is_valid(id->second.s)) {
         if (error)
             *error = "Manifest id is missing or invalid";
@@ -1481,7 +1499,7 @@ std::optional<PluginManifest> plugin_read_manifest(const std::string& directory,
 
     const auto minimum = root->o.find("min_version");
     if (minimum != root->o.end()) {
-        if (minimum->second.type != plugin_json::Type::Integer || minimum->second.i < 0 ||
+        if (minimum->second.type != json::Type::Integer || minimum->second.i < 0 ||
             static_cast<uint64_t>(minimum->second.i) > std::numeric_limits<uint32_t>::max()) {
             if (error)
                 *error = "Manifest min_version must be a non-negative integer";
@@ -1502,14 +1520,14 @@ std::optional<PluginManifest> plugin_read_manifest(const std::string& directory,
 
     const auto dependencies = root->o.find("depends");
     if (dependencies != root->o.end()) {
-        if (dependencies->second.type != plugin_json::Type::Array) {
+        if (dependencies->second.type != json::Type::Array) {
             if (error)
                 *error = "Manifest depends must be an array";
             return std::nullopt;
         }
         std::set<std::string> unique;
         for (const auto& dependency : dependencies->second.a) {
-            if (dependency.type != plugin_json::Type::String || !plugin_id_is_valid(dependency.s) ||
+            if (dependency.type != json::Type::String || !plugin_id_is_valid(dependency.s) ||
                 dependency.s == manifest.id || !unique.insert(dependency.s).second) {
                 if (error)
                     *error = "Manifest contains an invalid dependency";
@@ -1527,23 +1545,23 @@ std::optional<PluginManifest> plugin_read_manifest(const std::string& directory,
     }
 
     const auto quick_action = root->o.find("quick_action");
-    if (quick_action != root->o.end() && quick_action->second.type != plugin_json::Type::Null) {
-        plugin_json::Value normalized;
-        if (quick_action->second.type == plugin_json::Type::String) {
+    if (quick_action != root->o.end() && quick_action->second.type != json::Type::Null) {
+        json::Value normalized;
+        if (quick_action->second.type == json::Type::String) {
             if (!plugin_callback_is_valid(quick_action->second.s)) {
                 if (error)
                     *error = "quick_action has an invalid callback";
                 return std::nullopt;
             }
-            plugin_json::Object action;
+            json::Object action;
             action["function"] = quick_action->second;
             action["label"] = quick_action->second;
-            action["labels"] = plugin_json::Value::object();
-            normalized = plugin_json::Value(action);
-        } else if (quick_action->second.type == plugin_json::Type::Object) {
+            action["labels"] = json::Value::object();
+            normalized = json::Value(action);
+        } else if (quick_action->second.type == json::Type::Object) {
             const auto function = quick_action->second.o.find("function");
             if (function == quick_action->second.o.end() ||
-                function->second.type != plugin_json::Type::String ||
+                function->second.type != json::Type::String ||
                 !plugin_callback_is_valid(function->second.s)) {
                 if (error)
                     *error = "quick_action.function is missing or invalid";
@@ -1551,7 +1569,7 @@ std::optional<PluginManifest> plugin_read_manifest(const std::string& directory,
             }
             const auto label = quick_action->second.o.find("label");
             if (label != quick_action->second.o.end() &&
-                label->second.type != plugin_json::Type::String) {
+                label->second.type != json::Type::String) {
                 if (error)
                     *error = "quick_action.label must be a string";
                 return std::nullopt;
@@ -1574,7 +1592,7 @@ std::optional<PluginManifest> plugin_read_manifest(const std::string& directory,
 
     const auto declared_action = root->o.find("has_action");
     if (declared_action != root->o.end()) {
-        if (declared_action->second.type != plugin_json::Type::Bool) {
+        if (declared_action->second.type != json::Type::Bool) {
             if (error)
                 *error = "has_action must be a boolean";
             return std::nullopt;
@@ -1583,13 +1601,13 @@ std::optional<PluginManifest> plugin_read_manifest(const std::string& directory,
     }
     const auto callbacks = root->o.find("callbacks");
     if (callbacks != root->o.end()) {
-        if (callbacks->second.type != plugin_json::Type::Array) {
+        if (callbacks->second.type != json::Type::Array) {
             if (error)
                 *error = "callbacks must be an array";
             return std::nullopt;
         }
         for (const auto& callback : callbacks->second.a) {
-            if (callback.type != plugin_json::Type::String ||
+            if (callback.type != json::Type::String ||
                 !plugin_callback_is_valid(callback.s)) {
                 if (error)
                     *error = "callbacks contains an invalid name";
@@ -1812,7 +1830,7 @@ bool plugin_set_config_value(const std::string& id, const std::string& key,
         *error = "Config value exceeds the size limit";
         return false;
     }
-    if (!plugin_json::is_valid_utf8(value)) {
+    if (!json::is_valid_utf8(value)) {
         *error = "Config value must be valid UTF-8";
         return false;
     }
@@ -1825,7 +1843,7 @@ bool plugin_set_config_value(const std::string& id, const std::string& key,
     auto object = read_config_object(path, error);
     if (!object)
         return false;
-    (*object)[key] = plugin_json::Value(value);
+    (*object)[key] = json::Value(value);
     return write_config_object(path, *object, error);
 }
 
@@ -1902,6 +1920,14 @@ int plugin_handle(const std::vector<std::string>& args) {
         return plugin_run(args[1], args[2]);
     if (command == "action" && args.size() == 2)
         return plugin_run(args[1], "action");
+    if (command == "bench" && (args.size() == 3 || args.size() == 4)) {
+        int iterations = 20;
+        if (args.size() == 4 && !parse_interval(args[3], &iterations)) {
+            print_error("Invalid iteration count\n");
+            return 1;
+        }
+        return bench_plugin_callback(args[1], args[2], iterations);
+    }
     if (command == "daemon" && args.size() == 6) {
         int interval = 0;
         if (!parse_interval(args[3], &interval)) {
@@ -1,11 +1,12 @@
 #pragma once
 
-#include "json.hpp"
+#include "../core/json.hpp"
 
 #include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace ksud {
@@ -20,9 +21,14 @@ public:
 
     [[nodiscard]] const std::string& directory() const { return directory_; }
 
+    // Verified bytecode of the entry script; forked callback workers inherit it.
+    [[nodiscard]] const std::string& entry_bytecode() const { return entry_bytecode_; }
+    void set_entry_bytecode(std::string bytecode) { entry_bytecode_ = std::move(bytecode); }
+
 private:
     int directory_fd_;
     std::string directory_;
+    std::string entry_bytecode_;
 };
 
 struct PluginManifest {
@@ -34,9 +40,9 @@ struct PluginManifest {
     std::string license;
     std::string entry;
     std::vector<std::string> depends;
-    plugin_json::Value descriptions = plugin_json::Value::object();
-    plugin_json::Value config = plugin_json::Value::array();
-    plugin_json::Value quick_action;
+    json::Value descriptions = json::Value::object();
+    json::Value config = json::Value::array();
+    json::Value quick_action;
     bool has_action = false;
     uint32_t min_version = 0;
 };
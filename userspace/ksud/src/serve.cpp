@@ -0,0 +1,371 @@
+#include "serve.hpp"
+
+#include "cli.hpp"
+#include "core/ksucalls.hpp"
+#include "defs.hpp"
+#include "log.hpp"
+#include "magisk_compat/su_protocol.hpp"
+#include "utils.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace ksud {
+
+namespace {
+
+// `ksud serve` keeps one warm ksud process (driver fd, UAPI check, package
+// index) and runs short CLI commands in it. A client connects to the abstract
+// socket, sends a ServeRequest with its stdout/stderr attached, and the command
+// writes straight to them; the ServeReply carries the exit code.
+constexpr const char* kServeSocketName = "ksud_serve";
+
+constexpr uint32_t kServeMagic = 0x4B535256U;  // "KSRV"
+
+constexpr uint32_t kServeMaxPayload = 64U * 1024U;
+
+constexpr size_t kServeMaxClients = 16;
+
+// Followed by payload_len bytes: version\0cmd\0arg1\0...; argc counts all of them
+struct __attribute__((packed)) ServeRequest {
+    uint32_t magic;
+    uint32_t argc;
+    uint32_t payload_len;
+};
+
+struct __attribute__((packed)) ServeReply {
+    uint32_t magic;
+    int32_t handled;  // 0: declined, the client runs the command itself
+    int32_t exit_code;
+};
+
+bool arg_is(const std::vector<std::string>& args, size_t index,
+            std::initializer_list<const char*> names) {
+    if (index >= args.size())
+        return false;
+    for (const char* name : names) {
+        if (args[index] == name)
+            return true;
+    }
+    return false;
+}
+
+// Commands that are short, never read stdin and leave no per-process state
+// behind, so they can run inside the daemon. Boot stages, installers, shells
+// and anything that forks long-lived children stay out, as does anything that
+// reads the client's environment (module config needs KSU_MODULE).
+bool serve_handles(const std::string& cmd, const std::vector<std::string>& args) {
+    if (cmd == "version")
+        return true;
+    if (cmd == "module")
+        return arg_is(args, 0, {"list", "enable", "disable"});
+    if (cmd == "feature")
+        return arg_is(args, 0, {"get", "set", "list", "check"});
+    if (cmd == "plugin")
+        return arg_is(args, 0, {"list"});
+    if (cmd == "yzctl" || cmd == "yukizygisk")
+        return arg_is(args, 0, {"status"});
+    if (cmd == "umount")
+        return arg_is(args, 0, {"list", "add", "del", "remove"});
+    return false;
+}
+
+socklen_t serve_address(struct sockaddr_un* addr) {
+    *addr = {};
+    addr->sun_family = AF_UNIX;
+    addr->sun_path[0] = '\0';
+    const size_t namelen = strlen(kServeSocketName);
+    memcpy(addr->sun_path + 1, kServeSocketName, namelen);
+    return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + 1 + namelen);
+}
+
+int create_serve_listener() {
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOGE("serve: socket() failed: %s", strerror(errno));
+        return -1;
+    }
+    struct sockaddr_un addr{};
+    const socklen_t addrlen = serve_address(&addr);
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), addrlen) != 0 || listen(fd, 16) != 0) {
+        LOGE("serve: bind/listen failed: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int acquire_serve_lock() {
+    const int fd = open(SERVE_LOCK_PATH, O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOGE("serve: open lock failed: %s", strerror(errno));
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::string build_serve_payload(const std::string& cmd, const std::vector<std::string>& args) {
+    std::string payload = VERSION_CODE;
+    payload.push_back('\0');
+    payload += cmd;
+    payload.push_back('\0');
+    for (const std::string& arg : args) {
+        payload += arg;
+        payload.push_back('\0');
+    }
+    return payload;
+}
+
+bool parse_serve_payload(const std::string& payload, uint32_t argc, std::vector<std::string>* out) {
+    size_t pos = 0;
+    for (uint32_t i = 0; i < argc; ++i) {
+        const size_t end = payload.find('\0', pos);
+        if (end == std::string::npos)
+            return false;
+        out->emplace_back(payload, pos, end - pos);
+        pos = end + 1;
+    }
+    return pos == payload.size() && out->size() >= 2;
+}
+
+// Runs one command with stdout/stderr pointed at the client's fds, then puts
+// the daemon's own /dev/null back
+int run_attached(const int fds[2], const std::string& cmd, const std::vector<std::string>& args,
+                 int null_fd) {
+    (void)fflush(stdout);
+    (void)fflush(stderr);
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    // Logs reach the client's stderr as they would when it runs the command
+    log_set_stderr_enabled(true);
+
+    int exit_code = 1;
+    try {
+        exit_code = cli_dispatch(cmd, args);
+    } catch (const std::exception& e) {
+        (void)fprintf(stderr, "ksud: %s\n", e.what());
+    }
+
+    (void)fflush(stdout);
+    (void)fflush(stderr);
+    clearerr(stdout);
+    clearerr(stderr);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+    return exit_code;
+}
+
+// Serves one request from a connection; false drops the connection
+bool handle_request(int conn, int null_fd) {
+    ServeRequest hdr{};
+    int fds[2] = {-1, -1};
+    int nfds = 0;
+    if (!sucompat::recv_with_fds(conn, &hdr, sizeof(hdr), fds, 2, &nfds) ||
+        hdr.magic != kServeMagic || hdr.payload_len > kServeMaxPayload) {
+        for (int i = 0; i < nfds; ++i)
+            close(fds[i]);
+        return false;
+    }
+
+    std::string payload(hdr.payload_len, '\0');
+    std::vector<std::string> args;
+    const bool ok = sucompat::read_all(conn, payload.data(), payload.size()) &&
+                    parse_serve_payload(payload, hdr.argc, &args);
+
+    ServeReply reply{kServeMagic, 0, 0};
+    // A client from a different ksud build may not agree on the commands
+    if (ok && nfds == 2 && args[0] == VERSION_CODE) {
+        const std::string cmd = args[1];
+        args.erase(args.begin(), args.begin() + 2);
+        if (serve_handles(cmd, args)) {
+            reply.handled = 1;
+            reply.exit_code = run_attached(fds, cmd, args, null_fd);
+        }
+    }
+    for (int i = 0; i < nfds; ++i)
+        close(fds[i]);
+    return ok && sucompat::write_all(conn, &reply, sizeof(reply));
+}
+
+void accept_client(int listen_fd, std::vector<struct pollfd>* pfds) {
+    const int conn = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (conn < 0)
+        return;
+
+    struct ucred cred{};
+    socklen_t clen = sizeof(cred);
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &clen) != 0 || cred.uid != 0 ||
+        pfds->size() > kServeMaxClients) {
+        close(conn);
+        return;
+    }
+    // Do not let a stalled client hold up everyone else mid-frame
+    struct timeval tv{5, 0};
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    pfds->push_back({conn, POLLIN, 0});
+}
+
+int spawn_serve() {
+    const pid_t pid = fork();
+    if (pid < 0) {
+        LOGE("Failed to fork serve launcher: %s", strerror(errno));
+        return -1;
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        switch_cgroups();
+
+        const int devnull = open("/dev/null", O_RDWR | O_CLOEXEC);
+        if (devnull >= 0) {
+            dup2(devnull, STDIN_FILENO);
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDERR_FILENO);
+            if (devnull > STDERR_FILENO) {
+                close(devnull);
+            }
+        }
+
+        const pid_t grandchild = fork();
+        if (grandchild < 0) {
+            _exit(127);
+        }
+        if (grandchild > 0) {
+            _exit(0);
+        }
+
+        char* const argv[] = {const_cast<char*>(DAEMON_PATH), const_cast<char*>("serve"), nullptr};
+        execv(DAEMON_PATH, argv);
+        char* const fallback[] = {const_cast<char*>("ksud"), const_cast<char*>("serve"), nullptr};
+        execv("/proc/self/exe", fallback);
+        _exit(127);
+    }
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0) {
+        LOGW("waitpid for serve launcher failed: %s", strerror(errno));
+    }
+    return 0;
+}
+
+}  // namespace
+
+int run_serve() {
+    const int lock_fd = acquire_serve_lock();
+    if (lock_fd < 0) {
+        LOGI("serve: already running, skipping start");
+        return 0;
+    }
+    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
+        LOGW("serve: failed to ignore SIGPIPE: %s", strerror(errno));
+    }
+
+    const int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    const int listen_fd = create_serve_listener();
+    if (null_fd < 0 || listen_fd < 0) {
+        close(lock_fd);
+        return 1;
+    }
+
+    // Warm the driver fd and the UAPI check once for every command served
+    if (!ensure_uapi_version_matched()) {
+        LOGW("serve: UAPI version mismatch, commands will report it themselves");
+    }
+    LOGI("serve: listening on @%s", kServeSocketName);
+
+    std::vector<struct pollfd> pfds = {{listen_fd, POLLIN, 0}};
+    for (;;) {
+        if (poll(pfds.data(), pfds.size(), -1) < 0) {
+            if (errno != EINTR) {
+                LOGE("serve: poll failed: %s", strerror(errno));
+                return 1;
+            }
+            continue;
+        }
+
+        for (size_t i = pfds.size(); i-- > 1;) {
+            if (pfds[i].revents == 0)
+                continue;
+            if ((pfds[i].revents & POLLIN) == 0 || !handle_request(pfds[i].fd, null_fd)) {
+                close(pfds[i].fd);
+                pfds.erase(pfds.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+        if ((pfds[0].revents & POLLIN) != 0)
+            accept_client(listen_fd, &pfds);
+    }
+}
+
+int ensure_serve_running() {
+    return spawn_serve();
+}
+
+bool serve_forward(const std::string& cmd, const std::vector<std::string>& args, int* exit_code) {
+    if (getenv("KSUD_NO_SERVE") != nullptr || getuid() != 0 || !serve_handles(cmd, args))
+        return false;
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    struct sockaddr_un addr{};
+    const socklen_t addrlen = serve_address(&addr);
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), addrlen) != 0) {
+        close(fd);
+        return false;
+    }
+    // Any process can bind an abstract name first; only hand our stdout and
+    // stderr to a root server.
+    struct ucred cred{};
+    socklen_t clen = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &clen) != 0 || cred.uid != 0) {
+        close(fd);
+        return false;
+    }
+
+    const std::string payload = build_serve_payload(cmd, args);
+    const ServeRequest hdr{kServeMagic, static_cast<uint32_t>(args.size() + 2),
+                           static_cast<uint32_t>(payload.size())};
+    const int fds[2] = {STDOUT_FILENO, STDERR_FILENO};
+    (void)fflush(stdout);
+    (void)fflush(stderr);
+    if (payload.size() > kServeMaxPayload ||
+        !sucompat::send_with_fds(fd, &hdr, sizeof(hdr), fds, 2) ||
+        !sucompat::write_all(fd, payload.data(), payload.size())) {
+        close(fd);
+        return false;
+    }
+
+    // Past this point the command may have run; do not run it a second time
+    ServeReply reply{};
+    if (!sucompat::read_all(fd, &reply, sizeof(reply)) || reply.magic != kServeMagic) {
+        close(fd);
+        LOGE("ksud serve dropped the request for '%s'", cmd.c_str());
+        *exit_code = 1;
+        return true;
+    }
+    close(fd);
+    *exit_code = reply.exit_code;
+    return reply.handled != 0;
+}
+
+}  // namespace ksud
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace ksud {
+
+// Run the `ksud serve` daemon in the foreground
+int run_serve();
+
+int ensure_serve_running();
+
+/**
+ * Run a CLI command through a running `ksud serve`, with this process's
+ * stdout/stderr attached
+ * @param exit_code Exit code of the command when it was served
+ * @return false if nothing served it; the caller runs it locally then
+ */
+bool serve_forward(const std::string& cmd, const std::vector<std::string>& args, int* exit_code);
+
+}  // namespace ksud
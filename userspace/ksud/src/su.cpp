@@ -13,8 +13,11 @@
 #include <sys/wait.h>
 #include <unistd.h>
 #include <array>
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -22,22 +25,35 @@ namespace ksud {
 
 namespace {
 
-void print_su_usage() {
-    printf("YukiSU\n\n");
-    printf("Usage: su [options] [-] [user [argument...]]\n\n");
-    printf("Options:\n");
-    printf("  -c, --command COMMAND    pass COMMAND to the invoked shell\n");
-    printf("  -h, --help               display this help message and exit\n");
-    printf("  -l, --login              pretend the shell to be a login shell\n");
-    printf("  -p, --preserve-environment  preserve the entire environment\n");
-    printf("  -s, --shell SHELL        use SHELL instead of the default\n");
-    printf("  -v, --version            display version number and exit\n");
-    printf("  -V                       display version code and exit\n");
-    printf("  -M, -mm, --mount-master  force run in the global mount namespace\n");
-    printf("  -g, --group GROUP        specify the primary group\n");
-    printf("  -G, --supp-group GROUP   specify a supplementary group\n");
-    printf("  -W, --no-wrapper         don't use ksu fd wrapper\n");
-    printf("      --ksu-no-new-privs   block this process and its children from re-escalating\n");
+constexpr const char* kSuUsage =
+    "YukiSU\n\n"
+    "Usage: su [options] [-] [user [argument...]]\n\n"
+    "Options:\n"
+    "  -c, --command COMMAND    pass COMMAND to the invoked shell\n"
+    "  -h, --help               display this help message and exit\n"
+    "  -l, --login              pretend the shell to be a login shell\n"
+    "  -p, --preserve-environment  preserve the entire environment\n"
+    "  -s, --shell SHELL        use SHELL instead of the default\n"
+    "  -v, --version            display version number and exit\n"
+    "  -V                       display version code and exit\n"
+    "  -M, -mm, --mount-master  force run in the global mount namespace\n"
+    "  -g, --group GROUP        specify the primary group\n"
+    "  -G, --supp-group GROUP   specify a supplementary group\n"
+    "  -W, --no-wrapper         don't use ksu fd wrapper\n"
+    "      --ksu-no-new-privs   block this process and its children from re-escalating\n";
+
+bool parse_gid(const char* text, gid_t* gid) {
+    if (text == nullptr || *text < '0' || *text > '9') {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    const unsigned long value = strtoul(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value > std::numeric_limits<gid_t>::max()) {
+        return false;
+    }
+    *gid = static_cast<gid_t>(value);
+    return true;
 }
 
 void set_identity(uid_t uid, gid_t gid, const std::vector<gid_t>& groups) {
@@ -69,6 +85,50 @@ void wrap_tty(int fd) {
     close(new_fd);
 }
 
+const char* get_env(const std::vector<std::string>& env, const char* name) {
+    const size_t len = strlen(name);
+    for (const auto& e : env) {
+        if (e.size() > len && e.compare(0, len, name) == 0 && e[len] == '=') {
+            return e.c_str() + len + 1;
+        }
+    }
+    return nullptr;
+}
+
+void set_env(std::vector<std::string>* env, const char* name, const std::string& value) {
+    const size_t len = strlen(name);
+    std::string entry = std::string(name) + "=" + value;
+    for (auto& e : *env) {
+        if (e.size() > len && e.compare(0, len, name) == 0 && e[len] == '=') {
+            e = std::move(entry);
+            return;
+        }
+    }
+    env->push_back(std::move(entry));
+}
+
+// execvp() would search the PATH of the calling process; the launch carries its
+// own environment, so list where that PATH would look and let exec_su_launch()
+// try them once it runs in the shell's mount namespace and cwd.
+std::vector<std::string> path_candidates(const std::string& name, const char* path) {
+    if (name.find('/') != std::string::npos || path == nullptr) {
+        return {name};
+    }
+    std::vector<std::string> candidates;
+    const char* dir = path;
+    for (;;) {
+        const char* sep = strchr(dir, ':');
+        const size_t len = sep ? static_cast<size_t>(sep - dir) : strlen(dir);
+        std::string candidate = len == 0 ? std::string(".") : std::string(dir, len);
+        candidate += "/" + name;
+        candidates.push_back(std::move(candidate));
+        if (sep == nullptr) {
+            return candidates;
+        }
+        dir = sep + 1;
+    }
+}
+
 }  // namespace
 
 int su_main(int argc, char** argv) {
@@ -87,7 +147,8 @@ int su_main(int argc, char** argv) {
     return run_su_shell(argc, argv);
 }
 
-int run_su_shell(int argc, char** argv) {
+SuPlanResult plan_su_shell(int argc, char** argv, std::vector<std::string> env, SuLaunch* launch,
+                           std::string* message) {
     // Parse options
     std::string command;
     std::string shell = "/system/bin/sh";  // Use system shell by default (like Rust version)
@@ -155,6 +216,7 @@ int run_su_shell(int argc, char** argv) {
     }};
 
     optind = 1;  // Reset getopt
+    opterr = 0;  // Unknown options are ignored; never print from a broker
     int opt;
     while ((opt = getopt_long(argc, argv, "+c:hlps:vVMg:G:W", long_options.data(), nullptr)) !=
            -1) {
@@ -163,8 +225,8 @@ int run_su_shell(int argc, char** argv) {
             command = optarg;
             break;
         case 'h':
-            print_su_usage();
-            return 0;
+            *message = kSuUsage;
+            return SuPlanResult::Message;
         case 'l':
             is_login = true;
             break;
@@ -175,21 +237,30 @@ int run_su_shell(int argc, char** argv) {
             shell = optarg;
             break;
         case 'v':
-            printf("%s:KernelSU\n", VERSION_NAME);
-            return 0;
+            *message = std::string(VERSION_NAME) + ":KernelSU\n";
+            return SuPlanResult::Message;
         case 'V':
-            printf("%s\n", VERSION_CODE);
-            return 0;
+            *message = std::string(VERSION_CODE) + "\n";
+            return SuPlanResult::Message;
         case 'M':
             mount_master = true;
             break;
         case 'g':
-            target_gid = static_cast<gid_t>(std::stoul(optarg));
+            if (!parse_gid(optarg, &target_gid)) {
+                *message = std::string("su: invalid group: ") + optarg + "\n";
+                return SuPlanResult::Invalid;
+            }
             gid_specified = true;
             break;
-        case 'G':
-            groups.push_back(static_cast<gid_t>(std::stoul(optarg)));
+        case 'G': {
+            gid_t gid = 0;
+            if (!parse_gid(optarg, &gid)) {
+                *message = std::string("su: invalid group: ") + optarg + "\n";
+                return SuPlanResult::Invalid;
+            }
+            groups.push_back(gid);
             break;
+        }
         case 'W':
             use_fd_wrapper = false;
             break;
@@ -244,86 +315,145 @@ int run_su_shell(int argc, char** argv) {
         }
     }
 
-    // Switch to global mount namespace if requested
-    if (mount_master) {
-        if (!switch_mnt_ns(1)) {
-            LOGW("Failed to switch to global mount namespace");
-        }
-    }
-
-    // Wrap tty fds if requested
-    if (use_fd_wrapper) {
-        wrap_tty(0);
-        wrap_tty(1);
-        wrap_tty(2);
-    }
-
-    // Lock this process and its children out of any further escalation.
-    if (ksu_no_new_privs && set_ksu_no_new_privs() != 0) {
-        LOGE("Failed to set KSU_NO_NEW_PRIVS");
-        return 1;
-    }
-
-    // Switch cgroups
-    switch_cgroups();
-
     // Set environment
-    setenv("ASH_STANDALONE", "1", 1);
+    set_env(&env, "ASH_STANDALONE", "1");
 
     // Prepend /data/adb/ksu/bin to PATH
-    const char* old_path = getenv("PATH");
+    const char* old_path = get_env(env, "PATH");
     std::string new_path = "/data/adb/ksu/bin";
     if (old_path && old_path[0] != '\0') {
         new_path = new_path + ":" + old_path;
     }
-    setenv("PATH", new_path.c_str(), 1);
+    set_env(&env, "PATH", new_path);
 
-    // Set ENV to KSURC_PATH if exists (for shell initialization)
-    if (access(KSURC_PATH, F_OK) == 0 && getenv("ENV") == nullptr) {
-        setenv("ENV", KSURC_PATH, 1);
-    }
+    // Set ENV to KSURC_PATH if exists (for shell initialization); checked at exec
+    const bool ksurc = get_env(env, "ENV") == nullptr;
 
     if (!preserve_env) {
         const struct passwd* pw = getpwuid(target_uid);
         if (pw) {
-            setenv("HOME", pw->pw_dir, 1);
-            setenv("USER", pw->pw_name, 1);
-            setenv("LOGNAME", pw->pw_name, 1);
-            setenv("SHELL", shell.c_str(), 1);
+            set_env(&env, "HOME", pw->pw_dir);
+            set_env(&env, "USER", pw->pw_name);
+            set_env(&env, "LOGNAME", pw->pw_name);
+            set_env(&env, "SHELL", shell);
         } else {
-            setenv("HOME", "/data", 1);
-            setenv("USER", "root", 1);
-            setenv("LOGNAME", "root", 1);
-            setenv("SHELL", shell.c_str(), 1);
+            set_env(&env, "HOME", "/data");
+            set_env(&env, "USER", "root");
+            set_env(&env, "LOGNAME", "root");
+            set_env(&env, "SHELL", shell);
         }
     }
 
-    // Set identity
-    umask(022);
-    set_identity(target_uid, target_gid, groups);
-
     const bool has_exec_args = command.empty() && !exec_args.empty();
     const std::string executable = has_exec_args ? exec_args.front() : shell;
-    const std::string arg0 = is_login ? "-" : executable;
 
-    std::vector<const char*> exec_argv;
-    exec_argv.push_back(arg0.c_str());
+    launch->args.clear();
+    launch->args.push_back(is_login ? "-" : executable);
 
     // If command specified, add -c and command
     if (!command.empty()) {
-        exec_argv.push_back("-c");
-        exec_argv.push_back(command.c_str());
+        launch->args.emplace_back("-c");
+        launch->args.push_back(command);
     } else if (has_exec_args) {
-        for (size_t i = 1; i < exec_args.size(); ++i) {
-            exec_argv.push_back(exec_args[i].c_str());
+        launch->args.insert(launch->args.end(), exec_args.begin() + 1, exec_args.end());
+    }
+
+    launch->path = executable;
+    launch->candidates = path_candidates(executable, get_env(env, "PATH"));
+    launch->env = std::move(env);
+    launch->uid = target_uid;
+    launch->gid = target_gid;
+    launch->groups = std::move(groups);
+    launch->mount_master = mount_master;
+    launch->wrap_tty = use_fd_wrapper;
+    launch->no_new_privs = ksu_no_new_privs;
+    launch->ksurc = ksurc;
+    return SuPlanResult::Launch;
+}
+
+void prepare_su_launch(SuLaunch* launch) {
+    launch->argv.clear();
+    for (auto& a : launch->args) {
+        launch->argv.push_back(a.data());
+    }
+    launch->argv.push_back(nullptr);
+    launch->envp.clear();
+    if (launch->ksurc) {
+        launch->ksurc_entry = std::string("ENV=") + KSURC_PATH;
+        launch->envp.push_back(launch->ksurc_entry.data());
+    }
+    for (auto& e : launch->env) {
+        launch->envp.push_back(e.data());
+    }
+    launch->envp.push_back(nullptr);
+}
+
+int exec_su_launch(const SuLaunch& launch) {
+    umask(022);
+    // Still as root: the rc file is not readable by every target uid
+    const bool skip_ksurc = launch.ksurc && access(KSURC_PATH, F_OK) != 0;
+    char* const* envp = launch.envp.data() + (skip_ksurc ? 1 : 0);
+    set_identity(launch.uid, launch.gid, launch.groups);
+
+    // Same rules as execvp(): skip missing entries, remember a denied one
+    int error = ENOENT;
+    for (const auto& candidate : launch.candidates) {
+        execve(candidate.c_str(), launch.argv.data(), envp);
+        if (errno == EACCES) {
+            error = EACCES;
+        } else if (errno != ENOENT && errno != ENOTDIR) {
+            return errno;
+        }
+    }
+    return error;
+}
+
+int run_su_shell(int argc, char** argv) {
+    std::vector<std::string> env;
+    for (char** e = environ; e != nullptr && *e != nullptr; ++e) {
+        env.emplace_back(*e);
+    }
+
+    SuLaunch launch;
+    std::string message;
+    switch (plan_su_shell(argc, argv, std::move(env), &launch, &message)) {
+    case SuPlanResult::Launch:
+        break;
+    case SuPlanResult::Message:
+        fputs(message.c_str(), stdout);
+        return 0;
+    case SuPlanResult::Invalid:
+        fputs(message.c_str(), stderr);
+        return 1;
+    }
+
+    // Switch to global mount namespace if requested
+    if (launch.mount_master) {
+        if (!switch_mnt_ns(1)) {
+            LOGW("Failed to switch to global mount namespace");
         }
     }
 
-    exec_argv.push_back(nullptr);
+    // Wrap tty fds if requested
+    if (launch.wrap_tty) {
+        wrap_tty(0);
+        wrap_tty(1);
+        wrap_tty(2);
+    }
+
+    // Lock this process and its children out of any further escalation.
+    if (launch.no_new_privs && set_ksu_no_new_privs() != 0) {
+        LOGE("Failed to set KSU_NO_NEW_PRIVS");
+        return 1;
+    }
+
+    // Switch cgroups
+    switch_cgroups();
 
-    execvp(executable.c_str(), const_cast<char* const*>(exec_argv.data()));
+    prepare_su_launch(&launch);
+    const int error = exec_su_launch(launch);
 
-    LOGE("Failed to exec %s: %s", executable.c_str(), strerror(errno));
+    LOGE("Failed to exec %s: %s", launch.path.c_str(), strerror(error));
     return 127;
 }
 
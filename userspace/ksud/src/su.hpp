@@ -1,12 +1,69 @@
 #pragma once
 
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
 namespace ksud {
 
+// What run_su_shell() is about to exec, decided up front so a broker can plan
+// in the parent and vfork() a child that only has to issue system calls.
+struct SuLaunch {
+    std::string path;                     // Executable as requested
+    std::vector<std::string> candidates;  // path, or path along the launch PATH
+    std::vector<std::string> args;
+    std::vector<std::string> env;
+    uid_t uid = 0;
+    gid_t gid = 0;
+    std::vector<gid_t> groups;
+    bool mount_master = false;
+    bool wrap_tty = true;
+    bool no_new_privs = false;
+    bool ksurc = false;  // Set ENV to KSURC_PATH if it exists where the shell runs
+
+    // Filled by prepare_su_launch(); point into args/env
+    std::vector<char*> argv;
+    std::vector<char*> envp;  // Led by the ENV entry when ksurc is set
+    std::string ksurc_entry;
+};
+
+enum class SuPlanResult {
+    Launch,   // The plan is ready to exec
+    Message,  // --help/--version: print the message to stdout and exit 0
+    Invalid,  // Bad option value: report the message and exit 1
+};
+
 // Main su entry point - handles all command line arguments
 int su_main(int argc, char** argv);
 
 int run_su_shell(int argc, char** argv);
 
+/**
+ * Parse su arguments into a launch plan without touching the filesystem or
+ * printing, so a broker can plan on behalf of a client
+ * @param env Environment of the caller, as NAME=value entries
+ * @param launch Output plan
+ * @param message Output text for SuPlanResult::Message and ::Invalid
+ */
+SuPlanResult plan_su_shell(int argc, char** argv, std::vector<std::string> env, SuLaunch* launch,
+                           std::string* message);
+
+/**
+ * Build the argv/envp pointer arrays of a plan. Call again after copying or
+ * moving the plan.
+ */
+void prepare_su_launch(SuLaunch* launch);
+
+/**
+ * Switch to the planned identity and exec. Only issues system calls on the
+ * prepared plan, so it is usable from a vfork() child. Mount namespace, cwd,
+ * tty wrapping, no-new-privs and cgroups are left to the caller; the PATH
+ * search and the KSURC_PATH check happen here, in that final context.
+ * @return errno of the failed exec
+ */
+int exec_su_launch(const SuLaunch& launch);
+
 // Legacy functions for backward compatibility
 int root_shell();
 int grant_root_shell(bool global_mnt);
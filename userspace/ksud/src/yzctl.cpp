@@ -388,93 +388,110 @@ size_t injected_target_count(const RuntimeSnapshot& snapshot) {
     return targets.size();
 }
 
-json::Value number(uint32_t value) {
-    return {static_cast<double>(value)};
+// Writes the status document for `status --json`. Members are emitted in key
+// order, which keeps the output identical to the sorted object dump it replaced.
+void write_zygote_entry(json::Writer* writer, const yz_runtime_record& record, const char* state) {
+    const std::string target = bounded_string(record.target);
+    writer->begin_object()
+        .member("abi", abi_name(record.abi))
+        .member("name", target)
+        .member("pid", static_cast<uint32_t>(record.pid))
+        .member("state", state)
+        .member("target", target)
+        .end_object();
 }
 
-json::Value build_status_json(const RuntimeSnapshot& snapshot, const ModuleInventory& inventory) {
+void write_status_json(json::Writer* writer, const RuntimeSnapshot& snapshot,
+                       const ModuleInventory& inventory) {
     const std::vector<NativeInjection> injections = build_native_injections(snapshot, inventory);
     const std::vector<NativeModuleView> native_modules =
         build_native_module_views(inventory, injections);
-    json::Value root = json::Value::object();
-    root["generation"] = number(snapshot.generation);
-    root["enabled"] = json::Value(snapshot.enabled);
-    root["count"] = json::Value(static_cast<double>(injected_target_count(snapshot)));
-    root["safe_mode"] = json::Value(snapshot.safe_mode);
-    root["zygote_crashes"] = number(snapshot.zygote_crashes);
-    root["safe_mode_zygote"] = json::Value(
-        snapshot.safe_mode_zygote.empty() ? std::string("zygote") : snapshot.safe_mode_zygote);
-    root["recent"] = json::Value::array();
-    root["runtime"] = json::Value::array();
-    root["zygotes"] = json::Value::array();
-    root["zygote_monitor"] = json::Value::array();
-    root["modules"] = json::Value::array();
-    root["native_modules"] = json::Value::array();
-    root["native_injections"] = json::Value::array();
 
-    for (const yz_runtime_record& record : snapshot.records) {
-        json::Value raw = json::Value::object();
-        raw["pid"] = number(record.pid);
-        raw["generation"] = number(record.generation);
-        raw["restarts"] = number(record.restarts);
-        raw["kind"] = json::Value(kind_name(record.kind));
-        raw["kind_id"] = number(record.kind);
-        raw["state"] = json::Value(runtime_state_name(record.state));
-        raw["state_id"] = number(record.state);
-        raw["abi"] = json::Value(abi_name(record.abi));
-        raw["abi_id"] = number(record.abi);
-        raw["target_type"] = json::Value(target_type_name(record.target_type));
-        raw["target_type_id"] = number(record.target_type);
-        raw["flags"] = number(record.flags);
-        raw["process"] = json::Value(bounded_string(record.process));
-        raw["target"] = json::Value(bounded_string(record.target));
-        raw["module"] = json::Value(bounded_string(record.module_id));
-        root["runtime"].push_back(raw);
-
-        if (record.kind != YZ_RUNTIME_KIND_ZYGOTE)
-            continue;
-        const char* state = monitor_state_name(record.state);
-        if (state == nullptr)
-            continue;
-
-        const std::string target = bounded_string(record.target);
-        json::Value entry = json::Value::object();
-        entry["pid"] = number(record.pid);
-        entry["name"] = json::Value(target);
-        entry["target"] = json::Value(target);
-        entry["abi"] = json::Value(abi_name(record.abi));
-        entry["state"] = json::Value(state);
-        root["zygote_monitor"].push_back(entry);
-        if (record.state == YZ_RUNTIME_STATE_INJECTED)
-            root["zygotes"].push_back(entry);
-    }
+    writer->begin_object();
+    writer->member("count", static_cast<int64_t>(injected_target_count(snapshot)));
+    writer->member("enabled", snapshot.enabled);
+    writer->member("generation", static_cast<uint32_t>(snapshot.generation));
 
+    writer->key("modules").begin_array();
     for (const std::string& module_id : inventory.zygisk_modules)
-        root["modules"].push_back(json::Value(module_id));
+        writer->string(module_id);
+    writer->end_array();
 
+    writer->key("native_injections").begin_array();
+    for (const NativeInjection& injection : injections) {
+        writer->begin_object()
+            .member("abi", abi_name(injection.abi))
+            .member("companion", injection.has_companion)
+            .member("module", injection.module_id)
+            .member("pid", static_cast<uint32_t>(injection.pid))
+            .member("process", injection.process)
+            .member("state", injection.state)
+            .member("target", injection.target)
+            .member("target_type", target_type_name(injection.target_type))
+            .end_object();
+    }
+    writer->end_array();
+
+    writer->key("native_modules").begin_array();
     for (const NativeModuleView& module : native_modules) {
-        json::Value entry = json::Value::object();
-        entry["id"] = json::Value(module.module_id);
-        entry["target_type"] = json::Value(target_type_name(module.target_type));
-        entry["target"] = json::Value(module.target);
-        entry["companion"] = json::Value(module.has_companion);
-        entry["state"] = json::Value(module.state);
-        root["native_modules"].push_back(entry);
+        writer->begin_object()
+            .member("companion", module.has_companion)
+            .member("id", module.module_id)
+            .member("state", module.state)
+            .member("target", module.target)
+            .member("target_type", target_type_name(module.target_type))
+            .end_object();
     }
+    writer->end_array();
 
-    for (const NativeInjection& injection : injections) {
-        json::Value entry = json::Value::object();
-        entry["pid"] = number(injection.pid);
-        entry["process"] = json::Value(injection.process);
-        entry["module"] = json::Value(injection.module_id);
-        entry["target_type"] = json::Value(target_type_name(injection.target_type));
-        entry["target"] = json::Value(injection.target);
-        entry["abi"] = json::Value(abi_name(injection.abi));
-        entry["companion"] = json::Value(injection.has_companion);
-        entry["state"] = json::Value(injection.state);
-        root["native_injections"].push_back(entry);
+    writer->key("recent").begin_array().end_array();
+
+    writer->key("runtime").begin_array();
+    for (const yz_runtime_record& record : snapshot.records) {
+        writer->begin_object()
+            .member("abi", abi_name(record.abi))
+            .member("abi_id", static_cast<uint32_t>(record.abi))
+            .member("flags", static_cast<uint32_t>(record.flags))
+            .member("generation", static_cast<uint32_t>(record.generation))
+            .member("kind", kind_name(record.kind))
+            .member("kind_id", static_cast<uint32_t>(record.kind))
+            .member("module", bounded_string(record.module_id))
+            .member("pid", static_cast<uint32_t>(record.pid))
+            .member("process", bounded_string(record.process))
+            .member("restarts", static_cast<uint32_t>(record.restarts))
+            .member("state", runtime_state_name(record.state))
+            .member("state_id", static_cast<uint32_t>(record.state))
+            .member("target", bounded_string(record.target))
+            .member("target_type", target_type_name(record.target_type))
+            .member("target_type_id", static_cast<uint32_t>(record.target_type))
+            .end_object();
+    }
+    writer->end_array();
+
+    writer->member("safe_mode", snapshot.safe_mode);
+    writer->member("safe_mode_zygote", snapshot.safe_mode_zygote.empty()
+                                           ? std::string("zygote")
+                                           : snapshot.safe_mode_zygote);
+    writer->member("zygote_crashes", static_cast<uint32_t>(snapshot.zygote_crashes));
+
+    writer->key("zygote_monitor").begin_array();
+    for (const yz_runtime_record& record : snapshot.records) {
+        const char* state = record.kind == YZ_RUNTIME_KIND_ZYGOTE
+                                ? monitor_state_name(record.state)
+                                : nullptr;
+        if (state != nullptr)
+            write_zygote_entry(writer, record, state);
+    }
+    writer->end_array();
+
+    writer->key("zygotes").begin_array();
+    for (const yz_runtime_record& record : snapshot.records) {
+        if (record.kind == YZ_RUNTIME_KIND_ZYGOTE && record.state == YZ_RUNTIME_STATE_INJECTED &&
+            monitor_state_name(record.state) != nullptr)
+            write_zygote_entry(writer, record, monitor_state_name(record.state));
     }
-    return root;
+    writer->end_array();
+    writer->end_object();
 }
 
 void print_usage(FILE* stream) {
@@ -527,7 +544,10 @@ int yzctl_run(const std::vector<std::string>& args) {
         }
         if (json_output) {
             const ModuleInventory inventory = scan_modules();
-            printf("%s\n", json::dump(build_status_json(snapshot, inventory)).c_str());
+            std::string output;
+            json::Writer writer(&output);
+            write_status_json(&writer, snapshot, inventory);
+            printf("%s\n", output.c_str());
         } else {
             print_human_status(snapshot);
         }
@@ -0,0 +1,247 @@
+#include "boot_timeline.hpp"
+#include "boot_timeline_report.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+using ksud::BootSpanKind;
+using ksud::boot_timeline::build_tree;
+using ksud::boot_timeline::Chunk;
+using ksud::boot_timeline::ChunkHeader;
+using ksud::boot_timeline::kFlagAsync;
+using ksud::boot_timeline::kStageId;
+using ksud::boot_timeline::parse_timeline;
+using ksud::boot_timeline::print_critical_path;
+using ksud::boot_timeline::Record;
+using ksud::boot_timeline::SpanTree;
+
+constexpr std::uint64_t kMs = 1000000;
+
+int failures = 0;
+
+void expect(bool condition, const char* message) {
+    if (!condition) {
+        std::cerr << "FAIL: " << message << '\n';
+        ++failures;
+    }
+}
+
+Record span(std::uint32_t id, std::uint32_t parent, const char* name, std::uint64_t start_ms,
+            std::uint64_t end_ms, BootSpanKind kind = BootSpanKind::Step) {
+    Record record{};
+    record.start_ns = start_ms * kMs;
+    record.end_ns = end_ms * kMs;
+    record.id = id;
+    record.parent = parent;
+    record.kind = static_cast<std::uint8_t>(kind);
+    std::strncpy(record.name, name, sizeof(record.name) - 1);
+    return record;
+}
+
+void append_chunk(std::string& file, std::int32_t pid, const std::vector<Record>& records,
+                  std::uint32_t count, std::uint32_t dropped = 0) {
+    ChunkHeader header{};
+    std::memcpy(header.magic, ksud::boot_timeline::kMagic, sizeof(header.magic));
+    header.version = ksud::boot_timeline::kFormatVersion;
+    header.record_size = sizeof(Record);
+    header.pid = pid;
+    header.count = count;
+    header.dropped = dropped;
+    file.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!records.empty())
+        file.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+}
+
+std::string write_temp(const std::string& contents) {
+    char path[] = "/tmp/ksud_boot_timeline_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+        return {};
+    close(fd);
+    std::ofstream stream(path, std::ios::binary);
+    stream.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    return path;
+}
+
+// Everything the call printed to stdout
+template <typename Fn>
+std::string capture_stdout(Fn fn) {
+    char path[] = "/tmp/ksud_boot_timeline_out_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0)
+        return {};
+    (void)std::fflush(stdout);
+    const int saved = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    fn();
+    (void)std::fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(fd);
+
+    std::ifstream stream(path, std::ios::binary);
+    std::string output{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+    unlink(path);
+    return output;
+}
+
+void test_parse_timeline() {
+    Record unterminated = span(2, kStageId, "", 1, 2);
+    std::memset(unterminated.name, 'x', sizeof(unterminated.name));
+    std::memset(unterminated.detail, 'y', sizeof(unterminated.detail));
+
+    std::string file;
+    append_chunk(file, 100, {span(kStageId, 0, "post-fs-data", 0, 10, BootSpanKind::Stage),
+                             unterminated},
+                 2, 3);
+    append_chunk(file, 0, {span(1, 0, "module-init", 0, 0, BootSpanKind::Kernel)}, 1);
+    const std::string path = write_temp(file);
+
+    std::vector<Chunk> chunks;
+    expect(parse_timeline(path, &chunks), "timeline file parses");
+    expect(chunks.size() == 2, "both chunks are read");
+    if (chunks.size() == 2) {
+        expect(chunks[0].pid == 100 && chunks[0].dropped == 3, "chunk header is kept");
+        expect(chunks[0].records.size() == 2, "stage chunk has its records");
+        expect(chunks[1].pid == 0 && chunks[1].records.size() == 1, "kernel chunk is read");
+        if (chunks[0].records.size() == 2) {
+            const Record& record = chunks[0].records[1];
+            expect(std::strlen(record.name) == sizeof(record.name) - 1,
+                   "unterminated name is cut at the field end");
+            expect(std::strlen(record.detail) == sizeof(record.detail) - 1,
+                   "unterminated detail is cut at the field end");
+        }
+    }
+    unlink(path.c_str());
+
+    chunks.clear();
+    expect(!parse_timeline("/nonexistent/boot_timeline.bin", &chunks),
+           "missing file is reported");
+}
+
+void test_parse_stops_at_bad_chunk() {
+    std::string file;
+    append_chunk(file, 100, {span(kStageId, 0, "services", 0, 5, BootSpanKind::Stage)}, 1);
+    std::string bad;
+    append_chunk(bad, 200, {span(kStageId, 0, "late", 0, 5, BootSpanKind::Stage)}, 1);
+    bad[0] = 'X';
+    std::string path = write_temp(file + bad);
+
+    std::vector<Chunk> chunks;
+    expect(parse_timeline(path, &chunks) && chunks.size() == 1,
+           "reading stops at an unknown chunk");
+    unlink(path.c_str());
+
+    std::string truncated = file;
+    append_chunk(truncated, 300, {span(kStageId, 0, "cut", 0, 5, BootSpanKind::Stage)}, 4);
+    path = write_temp(truncated);
+    chunks.clear();
+    expect(parse_timeline(path, &chunks) && chunks.size() == 1,
+           "a chunk claiming more records than the file holds is dropped");
+    unlink(path.c_str());
+}
+
+void test_build_tree() {
+    Chunk chunk;
+    chunk.pid = 100;
+    chunk.records = {
+        span(kStageId, 0, "post-fs-data", 0, 100, BootSpanKind::Stage),
+        span(2, kStageId, "late", 30, 40),
+        span(3, kStageId, "early", 10, 20),
+        span(4, 2, "nested", 31, 35),
+        span(5, 99, "orphan", 50, 60),
+    };
+
+    const SpanTree tree = build_tree(chunk);
+    expect(tree.count(kStageId) != 0, "stage has children");
+    if (tree.count(kStageId) != 0) {
+        const auto& roots = tree.at(kStageId);
+        expect(roots.size() == 3, "top-level spans and the orphan hang off the stage");
+        if (roots.size() == 3) {
+            expect(std::strcmp(roots[0]->name, "early") == 0, "children are in start order");
+            expect(std::strcmp(roots[1]->name, "late") == 0, "later child comes second");
+            expect(std::strcmp(roots[2]->name, "orphan") == 0,
+                   "span with a dropped parent is re-parented to the stage");
+        }
+    }
+    expect(tree.count(2) != 0 && tree.at(2).size() == 1 &&
+               std::strcmp(tree.at(2)[0]->name, "nested") == 0,
+           "nested span sits under its parent");
+    expect(tree.count(3) == 0, "leaf span has no entry");
+}
+
+void test_critical_path() {
+    Chunk chunk;
+    chunk.pid = 100;
+    Record spawned = span(6, kStageId, "spawned", 0, 100);
+    spawned.flags |= kFlagAsync;
+    chunk.records = {
+        span(kStageId, 0, "services", 0, 100, BootSpanKind::Stage),
+        span(2, kStageId, "fast-worker", 0, 60, BootSpanKind::Plugin),
+        span(3, kStageId, "slow-worker", 0, 90, BootSpanKind::Plugin),
+        span(4, kStageId, "finish", 90, 100),
+        span(5, 4, "inner", 92, 99, BootSpanKind::Module),
+        spawned,
+    };
+    const SpanTree tree = build_tree(chunk);
+    const Record& stage = chunk.records[0];
+
+    bool printed = false;
+    const std::string output =
+        capture_stdout([&] { printed = print_critical_path(tree, stage, 1); });
+    expect(printed, "critical path is printed");
+
+    const size_t slow = output.find("slow-worker");
+    const size_t finish = output.find("finish");
+    const size_t inner = output.find("inner");
+    expect(slow != std::string::npos && finish != std::string::npos && slow < finish,
+           "the chain runs through the slower worker and then the last step");
+    expect(output.find("fast-worker") == std::string::npos,
+           "a worker that finished early is off the path");
+    expect(output.find("spawned") == std::string::npos, "async spans are never on the path");
+    expect(inner != std::string::npos && inner > finish, "the path recurses into children");
+    expect(output.find("90.0 ms") != std::string::npos, "durations are printed in ms");
+
+    Chunk empty;
+    empty.records = {span(kStageId, 0, "boot-completed", 0, 10, BootSpanKind::Stage)};
+    const SpanTree empty_tree = build_tree(empty);
+    const std::string none = capture_stdout(
+        [&] { printed = print_critical_path(empty_tree, empty.records[0], 1); });
+    expect(!printed && none.empty(), "a stage without children has no critical path");
+}
+
+}  // namespace
+
+int main() {
+    try {
+        test_parse_timeline();
+        test_parse_stops_at_bad_chunk();
+        test_build_tree();
+        test_critical_path();
+        if (failures != 0) {
+            std::cerr << failures << " test assertion(s) failed\n";
+            return 1;
+        }
+        std::cout << "boot_timeline_test: all tests passed\n";
+        return 0;
+    } catch (const std::exception& error) {
+        std::cerr << "unexpected exception: " << error.what() << '\n';
+        return 1;
+    } catch (...) {
+        std::cerr << "unexpected non-standard exception\n";
+        return 1;
+    }
+}
@@ -6,6 +6,7 @@
 
 #include "loader.hpp"
 #include "log.hpp"
+#include "module_image.hpp"
 #include "vermagic.hpp"
 
 #include <algorithm>
@@ -17,7 +18,8 @@
 #include <fstream>
 #include <sstream>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include <elf.h>
@@ -173,72 +175,249 @@ private:
 };
 
 /**
- * Parse /proc/kallsyms to get kernel symbol addresses
+ * The undefined symbols of the module, looked up through an open-addressed
+ * hash table.
+ *
+ * A module imports a few hundred names while kallsyms lists 150k+, so rather
+ * than keeping every kernel symbol we index only the wanted names and drop
+ * everything else while streaming. The table is kept at most half full, so a
+ * miss ends after a short probe in practice.
  */
-std::unordered_map<std::string, uint64_t> parse_kallsyms() {
-    const KptrGuard guard;
+class WantedSymbols {
+public:
+    explicit WantedSymbols(std::vector<std::string> names) : names_(std::move(names)) {
+        std::sort(names_.begin(), names_.end());
+        names_.erase(std::unique(names_.begin(), names_.end()), names_.end());
+        addresses_.assign(names_.size(), 0);
+        found_.assign(names_.size(), false);
+
+        size_t size = 16;
+        while (size < names_.size() * 2) {
+            size <<= 1;
+        }
+        slots_.assign(size, -1);
+        mask_ = static_cast<uint32_t>(size - 1);
+        for (size_t i = 0; i < names_.size(); ++i) {
+            uint32_t slot = hash(names_[i].data(), names_[i].size()) & mask_;
+            while (slots_[slot] >= 0) {
+                slot = (slot + 1) & mask_;
+            }
+            slots_[slot] = static_cast<int32_t>(i);
+        }
+    }
 
-    std::unordered_map<std::string, uint64_t> symbols;
+    [[nodiscard]] bool empty() const { return names_.empty(); }
 
-    std::ifstream ifs("/proc/kallsyms");
-    if (!ifs.is_open()) {
-        KLOGE("Cannot open /proc/kallsyms");
-        return symbols;
+    [[nodiscard]] size_t size() const { return names_.size(); }
+
+    /**
+     * Index of a wanted name, or -1
+     */
+    [[nodiscard]] int find(const char* name, size_t length) const {
+        for (uint32_t slot = hash(name, length) & mask_;; slot = (slot + 1) & mask_) {
+            const int32_t index = slots_[slot];
+            if (index < 0) {
+                return -1;
+            }
+            const std::string& candidate = names_[static_cast<size_t>(index)];
+            if (candidate.size() == length && memcmp(candidate.data(), name, length) == 0) {
+                return index;
+            }
+        }
     }
 
-    std::string line;
-    while (std::getline(ifs, line)) {
-        std::istringstream iss(line);
-        std::string addr_str;
-        std::string type;
-        std::string name;
+    [[nodiscard]] const std::string& name(size_t index) const { return names_[index]; }
 
-        if (!(iss >> addr_str >> type >> name)) {
-            continue;
-        }
+    [[nodiscard]] bool found(size_t index) const { return found_[index]; }
 
-        uint64_t addr = 0;
-        try {
-            addr = std::stoull(addr_str, nullptr, 16);
-        } catch (...) {
-            continue;
-        }
+    [[nodiscard]] uint64_t address(size_t index) const { return addresses_[index]; }
+
+    void set_address(size_t index, uint64_t address) {
+        addresses_[index] = address;
+        found_[index] = true;
+    }
 
-        // Strip version suffixes like "$..." or ".llvm...."
-        auto pos = name.find('$');
-        if (pos == std::string::npos) {
-            pos = name.find(".llvm.");
+private:
+    static uint32_t hash(const char* data, size_t length) {
+        // FNV-1a with a final avalanche
+        uint32_t h = 2166136261U;
+        for (size_t i = 0; i < length; ++i) {
+            h ^= static_cast<uint8_t>(data[i]);
+            h *= 16777619U;
         }
-        if (pos != std::string::npos) {
-            name = name.substr(0, pos);
+        h ^= h >> 16;
+        h *= 0x85ebca6bU;
+        h ^= h >> 13;
+        return h;
+    }
+
+    std::vector<std::string> names_;
+    std::vector<uint64_t> addresses_;
+    std::vector<bool> found_;
+    std::vector<int32_t> slots_;  // Index into names_, or -1 for an empty slot
+    uint32_t mask_ = 0;
+};
+
+/**
+ * Handle one "<address> <type> <name>[\t[module]]" line of /proc/kallsyms
+ */
+void match_kallsyms_line(const char* line, const char* end, WantedSymbols& wanted,
+                         size_t& matched) {
+    const char* p = line;
+    uint64_t addr = 0;
+    const char* const addr_start = p;
+    for (; p < end; ++p) {
+        const char c = *p;
+        unsigned digit = 0;
+        if (c >= '0' && c <= '9') {
+            digit = static_cast<unsigned>(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            digit = static_cast<unsigned>(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            digit = static_cast<unsigned>(c - 'A' + 10);
+        } else {
+            break;
         }
+        addr = (addr << 4) | digit;
+    }
+    if (p == addr_start || p >= end || *p != ' ') {
+        return;
+    }
+
+    // Single-letter type, then the name
+    p += 1;
+    while (p < end && *p != ' ') {
+        ++p;
+    }
+    while (p < end && *p == ' ') {
+        ++p;
+    }
+    const char* const name = p;
+    while (p < end && *p != '\t' && *p != ' ') {
+        ++p;
+    }
+    size_t length = static_cast<size_t>(p - name);
+    if (length == 0) {
+        return;
+    }
 
-        symbols[name] = addr;
+    // Strip version suffixes like "$..." or ".llvm...."
+    const void* dollar = memchr(name, '$', length);
+    if (dollar != nullptr) {
+        length = static_cast<size_t>(static_cast<const char*>(dollar) - name);
+    } else {
+        constexpr std::string_view kLlvmSuffix = ".llvm.";
+        const std::string_view view(name, length);
+        const size_t pos = view.find(kLlvmSuffix);
+        if (pos != std::string_view::npos) {
+            length = pos;
+        }
     }
 
-    return symbols;
+    const int index = wanted.find(name, length);
+    if (index < 0) {
+        return;
+    }
+    // Later entries win, as they did when every symbol went into a map
+    if (!wanted.found(static_cast<size_t>(index))) {
+        ++matched;
+    }
+    wanted.set_address(static_cast<size_t>(index), addr);
 }
 
 /**
- * Read entire file into a vector
+ * Resolve the wanted symbols from /proc/kallsyms
+ *
+ * Streams the file in large blocks and tokenizes lines in place; nothing is
+ * allocated per line and only the wanted addresses are kept.
+ *
+ * @return false if kallsyms could not be read
  */
-bool read_file(const char* path, std::vector<uint8_t>& buffer) {
-    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
-    if (!ifs.is_open()) {
-        KLOGE("Cannot open file: %s", path);
+bool parse_kallsyms(WantedSymbols& wanted) {
+    const KptrGuard guard;
+
+    const int fd = open("/proc/kallsyms", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        KLOGE("Cannot open /proc/kallsyms");
         return false;
     }
 
-    auto size = ifs.tellg();
-    ifs.seekg(0, std::ios::beg);
+    constexpr size_t kBlockSize = size_t{64} * 1024;
+    std::vector<char> block(kBlockSize);
+    size_t pending = 0;     // Bytes of an unfinished line kept at the block start
+    bool skipping = false;  // Inside an over-long line, dropping up to its end
+    size_t lines = 0;
+    size_t matched = 0;
+    bool ok = true;
+
+    while (true) {
+        const ssize_t length = read(fd, block.data() + pending, block.size() - pending);
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            KLOGE("Cannot read /proc/kallsyms: %s", strerror(errno));
+            ok = false;
+            break;
+        }
 
-    buffer.resize(static_cast<size_t>(size));
-    if (!ifs.read(reinterpret_cast<char*>(buffer.data()), size)) {
-        KLOGE("Cannot read file: %s", path);
-        return false;
+        const char* const data = block.data();
+        const char* const end = data + pending + static_cast<size_t>(length);
+        const char* line = data;
+        if (skipping) {
+            const auto* newline =
+                static_cast<const char*>(memchr(line, '\n', static_cast<size_t>(end - line)));
+            if (newline == nullptr) {
+                pending = 0;
+                if (length == 0) {
+                    break;
+                }
+                continue;
+            }
+            line = newline + 1;
+            skipping = false;
+        }
+        while (true) {
+            const auto* newline =
+                static_cast<const char*>(memchr(line, '\n', static_cast<size_t>(end - line)));
+            if (newline == nullptr) {
+                break;
+            }
+            match_kallsyms_line(line, newline, wanted, matched);
+            ++lines;
+            line = newline + 1;
+        }
+
+        pending = static_cast<size_t>(end - line);
+        if (length == 0) {
+            // Last line without a trailing newline
+            if (pending > 0) {
+                match_kallsyms_line(line, end, wanted, matched);
+                ++lines;
+            }
+            break;
+        }
+        if (pending == block.size()) {
+            // No line is this long; drop the rest of it rather than stall
+            // or parse its tail as a line of its own
+            KLOGW("Skipping an over-long kallsyms line");
+            pending = 0;
+            skipping = true;
+            continue;
+        }
+        memmove(block.data(), line, pending);
     }
 
-    return true;
+    close(fd);
+    if (ok && lines == 0) {
+        KLOGE("Cannot parse kallsyms");
+        ok = false;
+    }
+    if (ok) {
+        KLOGI("Resolved %zu of %zu symbols from %zu kallsyms entries", matched, wanted.size(),
+              lines);
+    }
+    return ok;
 }
 
 /**
@@ -248,100 +427,87 @@ int init_module_syscall(void* module_image, unsigned long len, const char* param
     return syscall(__NR_init_module, module_image, len, param_values);
 }
 
-}  // anonymous namespace
+/**
+ * Call finit_module syscall
+ */
+int finit_module_syscall(int fd, const char* param_values) {
+    return syscall(__NR_finit_module, fd, param_values, 0);
+}
 
-bool load_module(const char* path) {
-    // Check if we're PID 1 (init process)
-    if (getpid() != 1) {
-        KLOGE("Invalid process (not init)");
-        return false;
+/**
+ * Load the patched image, from its sealed memfd when possible so the module
+ * is never copied into a userspace buffer
+ */
+int load_image(ModuleImage& image, const char* param_values) {
+    const int fd = image.seal();
+    if (fd >= 0) {
+        if (finit_module_syscall(fd, param_values) == 0) {
+            return 0;
+        }
+        // ENOEXEC goes to the vermagic retry and EEXIST is final; any other
+        // error (no syscall, a memfd the kernel or policy refuses) may still
+        // load from a buffer.
+        if (errno == ENOEXEC || errno == EEXIST) {
+            return -1;
+        }
+        KLOGW("finit_module failed: %s, falling back to init_module", strerror(errno));
     }
-
-    // Read the module file
-    std::vector<uint8_t> buffer;
-    if (!read_file(path, buffer)) {
-        return false;
+    if (image.data() != nullptr) {
+        return init_module_syscall(image.data(), image.size(), param_values);
     }
-
-    // Parse ELF header
-    if (buffer.size() < sizeof(Elf64_Ehdr)) {
-        KLOGE("File too small to be an ELF");
-        return false;
+    std::vector<uint8_t> buffer;
+    if (!image.copy(buffer)) {
+        errno = EIO;
+        return -1;
     }
+    return init_module_syscall(buffer.data(), buffer.size(), param_values);
+}
 
-    auto* ehdr = reinterpret_cast<Elf64_Ehdr*>(buffer.data());
+}  // anonymous namespace
 
-    // Verify ELF magic
-    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0) {
-        KLOGE("Invalid ELF magic");
+bool load_module(const char* path) {
+    // Check if we're PID 1 (init process)
+    if (getpid() != 1) {
+        KLOGE("Invalid process (not init)");
         return false;
     }
 
-    // We only support 64-bit ELF
-    if (ehdr->e_ident[EI_CLASS] != ELFCLASS64) {
-        KLOGE("Only 64-bit ELF supported");
+    // Map the module; symbols are patched in place
+    ModuleImage image;
+    std::string error;
+    if (!image.open(path, error)) {
+        KLOGE("%s", error.c_str());
         return false;
     }
 
-    // Parse kallsyms
-    auto kernel_symbols = parse_kallsyms();
-    if (kernel_symbols.empty()) {
-        KLOGE("Cannot parse kallsyms");
+    // Collect undefined symbols
+    std::vector<UndefinedSymbol> undefined;
+    if (!collect_undefined_symbols(image.data(), image.size(), undefined, error)) {
+        KLOGE("Invalid module: %s", error.c_str());
         return false;
     }
 
-    // Find symbol table section
-    auto* shdr_base = reinterpret_cast<Elf64_Shdr*>(buffer.data() + ehdr->e_shoff);
-
-    Elf64_Shdr* symtab = nullptr;
-    Elf64_Shdr* strtab = nullptr;
-
-    for (int i = 0; i < ehdr->e_shnum; i++) {
-        auto* shdr = &shdr_base[i];
-        if (shdr->sh_type == SHT_SYMTAB) {
-            symtab = shdr;
-            // String table is linked in sh_link
-            strtab = &shdr_base[shdr->sh_link];
-            break;
-        }
+    // Resolve them against kallsyms
+    std::vector<std::string> names;
+    names.reserve(undefined.size());
+    for (const UndefinedSymbol& symbol : undefined) {
+        names.emplace_back(symbol.name);
     }
-
-    if (!symtab || !strtab) {
-        KLOGE("Cannot find symbol table");
+    WantedSymbols wanted(std::move(names));
+    if (!parse_kallsyms(wanted)) {
         return false;
     }
 
-    // Get pointers to symbol and string tables
-    auto* sym_base = reinterpret_cast<Elf64_Sym*>(buffer.data() + symtab->sh_offset);
-    auto* str_base = reinterpret_cast<char*>(buffer.data() + strtab->sh_offset);
-
-    const size_t sym_count = symtab->sh_size / sizeof(Elf64_Sym);
-
-    // Resolve undefined symbols
-    for (size_t i = 1; i < sym_count; i++) {
-        auto* sym = &sym_base[i];
-
-        // Only process undefined symbols
-        if (sym->st_shndx != SHN_UNDEF) {
-            continue;
-        }
-
-        // Get symbol name
-        const char* name = &str_base[sym->st_name];
-        if (!name || !*name) {
-            continue;
-        }
-
-        // Look up in kernel symbols
-        auto it = kernel_symbols.find(name);
-        if (it == kernel_symbols.end()) {
-            KLOGW("Cannot find symbol: %s", name);
+    for (const UndefinedSymbol& symbol : undefined) {
+        const int index = wanted.find(symbol.name.data(), symbol.name.size());
+        if (index < 0 || !wanted.found(static_cast<size_t>(index))) {
+            KLOGW("Cannot find symbol: %.*s", static_cast<int>(symbol.name.size()),
+                  symbol.name.data());
             continue;
         }
 
         // Patch the symbol
-        sym->st_shndx = SHN_ABS;
-        sym->st_value = it->second;
+        resolve_undefined_symbol(image.data(), symbol, wanted.address(static_cast<size_t>(index)));
     }
 
     std::string param_values;
@@ -380,7 +546,8 @@ bool load_module(const char* path) {
 
     // Load the module. A version-magic mismatch returns ENOEXEC; in that exact
     // case, use the new kmsg record to safely patch .modinfo and retry once.
-    int module_result = init_module_syscall(buffer.data(), buffer.size(), param_values.c_str());
+    KLOGI("Loading module from %s", image.is_memfd() ? "sealed memfd" : "private mapping");
+    int module_result = load_image(image, param_values.c_str());
     int module_errno = errno;
     if (module_result != 0 && module_errno == ENOEXEC && kmsg_reader.is_open()) {
         int read_error = 0;
@@ -390,9 +557,14 @@ bool load_module(const char* path) {
         } else {
             VermagicMismatch mismatch;
             if (extract_vermagic_mismatch(new_kmsg, mismatch)) {
+                // The rebuilt .modinfo grows the image, so retry from a copy
+                std::vector<uint8_t> buffer;
                 std::string replacement_error;
-                if (replace_module_vermagic(buffer, mismatch.module_vermagic,
-                                            mismatch.required_vermagic, replacement_error)) {
+                if (!image.copy(buffer)) {
+                    KLOGE("Cannot copy module image for vermagic retry");
+                } else if (replace_module_vermagic(buffer, mismatch.module_vermagic,
+                                                   mismatch.required_vermagic,
+                                                   replacement_error)) {
                     KLOGW("Retrying module load with kernel-required vermagic: %s",
                           mismatch.required_vermagic.c_str());
                     module_result =
@@ -402,7 +574,7 @@ bool load_module(const char* path) {
                     KLOGE("Cannot replace module vermagic: %s", replacement_error.c_str());
                 }
             } else {
-                KLOGW("init_module returned ENOEXEC without a matching vermagic record");
+                KLOGW("Module load returned ENOEXEC without a matching vermagic record");
             }
         }
     }
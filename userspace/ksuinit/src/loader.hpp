@@ -6,10 +6,10 @@ namespace ksuinit {
  * Load a kernel module from the given path
  *
  * This function:
- * 1. Reads the ELF module file
- * 2. Parses kallsyms to resolve undefined symbols
- * 3. Patches the ELF symbol table with resolved addresses
- * 4. Calls init_module syscall to load the module
+ * 1. Maps the ELF module file, through a memfd when available
+ * 2. Streams kallsyms to resolve only the module's undefined symbols
+ * 3. Patches the ELF symbol table in place with resolved addresses
+ * 4. Loads the module with finit_module on the sealed memfd, or init_module
  * 5. On an exact vermagic mismatch, patches .modinfo and retries once
  *
  * @param path Path to the kernel module (.ko file)
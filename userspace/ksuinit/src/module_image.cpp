@@ -0,0 +1,242 @@
+/**
+ * ksuinit - Module image
+ *
+ * Maps the LKM for in-place symbol patching and walks its ELF symbol table.
+ */
+
+#include "module_image.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <linux/memfd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ksuinit {
+
+namespace {
+
+bool in_bounds(uint64_t offset, uint64_t length, size_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+/**
+ * Locate the .symtab section header, validated against the image
+ */
+const Elf64_Shdr* find_symtab(const uint8_t* image, size_t size, const Elf64_Shdr** strtab,
+                              std::string& error) {
+    if (size < sizeof(Elf64_Ehdr)) {
+        error = "file too small to be an ELF";
+        return nullptr;
+    }
+    Elf64_Ehdr ehdr;
+    memcpy(&ehdr, image, sizeof(ehdr));
+    if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0) {
+        error = "invalid ELF magic";
+        return nullptr;
+    }
+    if (ehdr.e_ident[EI_CLASS] != ELFCLASS64) {
+        error = "only 64-bit ELF supported";
+        return nullptr;
+    }
+    if (ehdr.e_shentsize != sizeof(Elf64_Shdr) ||
+        !in_bounds(ehdr.e_shoff, uint64_t{ehdr.e_shnum} * sizeof(Elf64_Shdr), size) ||
+        ehdr.e_shoff % alignof(Elf64_Shdr) != 0) {
+        error = "section headers out of bounds";
+        return nullptr;
+    }
+
+    const auto* shdr_base = reinterpret_cast<const Elf64_Shdr*>(image + ehdr.e_shoff);
+    for (size_t i = 0; i < ehdr.e_shnum; i++) {
+        const Elf64_Shdr* shdr = &shdr_base[i];
+        if (shdr->sh_type != SHT_SYMTAB) {
+            continue;
+        }
+        // String table is linked in sh_link
+        if (shdr->sh_link >= ehdr.e_shnum) {
+            error = "symbol table has no string table";
+            return nullptr;
+        }
+        *strtab = &shdr_base[shdr->sh_link];
+        return shdr;
+    }
+
+    error = "cannot find symbol table";
+    return nullptr;
+}
+
+}  // anonymous namespace
+
+bool collect_undefined_symbols(const uint8_t* image, size_t size,
+                               std::vector<UndefinedSymbol>& symbols, std::string& error) {
+    const Elf64_Shdr* strtab = nullptr;
+    const Elf64_Shdr* symtab = find_symtab(image, size, &strtab, error);
+    if (symtab == nullptr) {
+        return false;
+    }
+    if (!in_bounds(symtab->sh_offset, symtab->sh_size, size) ||
+        symtab->sh_offset % alignof(Elf64_Sym) != 0) {
+        error = "symbol table out of bounds";
+        return false;
+    }
+    if (!in_bounds(strtab->sh_offset, strtab->sh_size, size)) {
+        error = "string table out of bounds";
+        return false;
+    }
+
+    const auto* sym_base = reinterpret_cast<const Elf64_Sym*>(image + symtab->sh_offset);
+    const auto* str_base = reinterpret_cast<const char*>(image + strtab->sh_offset);
+    const size_t str_size = strtab->sh_size;
+    const size_t sym_count = symtab->sh_size / sizeof(Elf64_Sym);
+
+    symbols.clear();
+    for (size_t i = 1; i < sym_count; i++) {
+        const Elf64_Sym* sym = &sym_base[i];
+
+        // Only process undefined symbols
+        if (sym->st_shndx != SHN_UNDEF || sym->st_name == 0) {
+            continue;
+        }
+        if (sym->st_name >= str_size) {
+            error = "symbol name out of bounds";
+            return false;
+        }
+
+        const char* name = str_base + sym->st_name;
+        const void* terminator = memchr(name, '\0', str_size - sym->st_name);
+        if (terminator == nullptr) {
+            error = "unterminated symbol name";
+            return false;
+        }
+        const auto length = static_cast<size_t>(static_cast<const char*>(terminator) - name);
+        if (length == 0) {
+            continue;
+        }
+        symbols.push_back(
+            {symtab->sh_offset + i * sizeof(Elf64_Sym), std::string_view(name, length)});
+    }
+    return true;
+}
+
+void resolve_undefined_symbol(uint8_t* image, const UndefinedSymbol& symbol, uint64_t address) {
+    auto* sym = reinterpret_cast<Elf64_Sym*>(image + symbol.offset);
+    sym->st_shndx = SHN_ABS;
+    sym->st_value = address;
+}
+
+ModuleImage::~ModuleImage() {
+    unmap();
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void ModuleImage::unmap() {
+    if (data_ != nullptr) {
+        munmap(data_, size_);
+        data_ = nullptr;
+    }
+}
+
+bool ModuleImage::open(const char* path, std::string& error) {
+    const int file = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        error = std::string("cannot open ") + path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st {};
+    if (fstat(file, &st) != 0 || st.st_size <= 0) {
+        error = std::string("cannot stat ") + path;
+        close(file);
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    // Copy into a sealable memfd without bouncing through userspace. Kernels
+    // without memfd_create (pre-3.17) map the file private instead.
+    const auto memfd = static_cast<int>(
+        syscall(__NR_memfd_create, "kernelsu.ko", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (memfd >= 0) {
+        off_t offset = 0;
+        while (static_cast<size_t>(offset) < size_) {
+            const ssize_t sent =
+                sendfile(memfd, file, &offset, size_ - static_cast<size_t>(offset));
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                break;
+            }
+        }
+        if (static_cast<size_t>(offset) == size_) {
+            void* mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+            if (mapping != MAP_FAILED) {
+                close(file);
+                data_ = static_cast<uint8_t*>(mapping);
+                fd_ = memfd;
+                memfd_ = true;
+                return true;
+            }
+        }
+        close(memfd);
+    }
+
+    void* mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    const int mmap_errno = errno;
+    close(file);
+    if (mapping == MAP_FAILED) {
+        error = std::string("cannot map ") + path + ": " + strerror(mmap_errno);
+        return false;
+    }
+    data_ = static_cast<uint8_t*>(mapping);
+    return true;
+}
+
+int ModuleImage::seal() {
+    if (!memfd_) {
+        return -1;
+    }
+    if (data_ == nullptr) {
+        return fd_;
+    }
+
+    // F_SEAL_WRITE is refused while a writable shared mapping exists
+    unmap();
+    if (fcntl(fd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == 0) {
+        return fd_;
+    }
+    void* mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping != MAP_FAILED) {
+        data_ = static_cast<uint8_t*>(mapping);
+    }
+    return -1;
+}
+
+bool ModuleImage::copy(std::vector<uint8_t>& buffer) const {
+    buffer.resize(size_);
+    if (data_ != nullptr) {
+        memcpy(buffer.data(), data_, size_);
+        return true;
+    }
+    size_t done = 0;
+    while (done < size_) {
+        const ssize_t length =
+            pread(fd_, buffer.data() + done, size_ - done, static_cast<off_t>(done));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(length);
+    }
+    return true;
+}
+
+}  // namespace ksuinit
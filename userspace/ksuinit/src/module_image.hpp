@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ksuinit {
+
+/**
+ * A named undefined symbol of a module's .symtab
+ */
+struct UndefinedSymbol {
+    size_t offset;          // Of the Elf64_Sym within the module image
+    std::string_view name;  // Points into the module image
+};
+
+/**
+ * Collect the named undefined symbols of an ELF64 kernel module
+ *
+ * Section headers, the symbol table and its string table are bounds-checked
+ * against the image before anything is returned.
+ *
+ * @param image Module image
+ * @param size Size of the image in bytes
+ * @param symbols Receives the undefined symbols in .symtab order
+ * @param error Receives a human-readable validation error on failure
+ * @return false if the image is not a well-formed ELF64 object with a .symtab
+ */
+bool collect_undefined_symbols(const uint8_t* image, size_t size,
+                               std::vector<UndefinedSymbol>& symbols, std::string& error);
+
+/**
+ * Turn an undefined symbol into an absolute one in place
+ *
+ * @param image Module image the symbol was collected from
+ * @param symbol Symbol returned by collect_undefined_symbols()
+ * @param address Resolved kernel address
+ */
+void resolve_undefined_symbol(uint8_t* image, const UndefinedSymbol& symbol, uint64_t address);
+
+/**
+ * A module file mapped for in-place patching
+ *
+ * The file is copied into a memfd inside the kernel and mapped shared, so
+ * patches land in the memfd and the module can be loaded with finit_module
+ * once sealed. Without memfd support the file itself is mapped private.
+ */
+class ModuleImage {
+public:
+    ModuleImage() = default;
+    ModuleImage(const ModuleImage&) = delete;
+    ModuleImage& operator=(const ModuleImage&) = delete;
+    ModuleImage(ModuleImage&&) = delete;
+    ModuleImage& operator=(ModuleImage&&) = delete;
+    ~ModuleImage();
+
+    /**
+     * Map the module at path
+     *
+     * @param error Receives a human-readable error on failure
+     */
+    bool open(const char* path, std::string& error);
+
+    [[nodiscard]] uint8_t* data() const { return data_; }
+
+    [[nodiscard]] size_t size() const { return size_; }
+
+    [[nodiscard]] bool is_memfd() const { return memfd_; }
+
+    /**
+     * Drop the writable mapping and seal the memfd against further changes
+     *
+     * @return the sealed memfd for finit_module, or -1 when the image is not
+     *         backed by a memfd or sealing failed; data() stays valid then
+     */
+    int seal();
+
+    /**
+     * Copy the current image contents, mapped or sealed
+     */
+    bool copy(std::vector<uint8_t>& buffer) const;
+
+private:
+    void unmap();
+
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    int fd_ = -1;
+    bool memfd_ = false;
+};
+
+}  // namespace ksuinit
@@ -0,0 +1,221 @@
+#include "../src/module_image.hpp"
+
+#include <elf.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+using ksuinit::collect_undefined_symbols;
+using ksuinit::ModuleImage;
+using ksuinit::resolve_undefined_symbol;
+using ksuinit::UndefinedSymbol;
+
+int failures = 0;
+
+void expect(bool condition, const char* message) {
+    if (!condition) {
+        std::cerr << "FAIL: " << message << '\n';
+        ++failures;
+    }
+}
+
+template <typename T>
+void append(std::vector<std::uint8_t>& output, const T& value) {
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(&value);
+    output.insert(output.end(), bytes, bytes + sizeof(value));
+}
+
+void align(std::vector<std::uint8_t>& output, std::size_t alignment) {
+    while (output.size() % alignment != 0)
+        output.push_back(0);
+}
+
+Elf64_Sym symbol(std::uint32_t name, std::uint16_t shndx, std::uint64_t value) {
+    Elf64_Sym sym{};
+    sym.st_name = name;
+    sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+    sym.st_shndx = shndx;
+    sym.st_value = value;
+    return sym;
+}
+
+// A relocatable object laid out like a module: one text section, a symbol
+// table with two imports, one local definition and a nameless import, and its
+// string table
+std::vector<std::uint8_t> sample_object() {
+    const std::string strtab("\0printk\0init_module\0kallsyms_lookup_name\0", 41);
+
+    std::vector<std::uint8_t> image(sizeof(Elf64_Ehdr));
+    const std::size_t text_offset = image.size();
+    image.insert(image.end(), 16, 0xd5);
+
+    align(image, alignof(Elf64_Sym));
+    const std::size_t symtab_offset = image.size();
+    append(image, Elf64_Sym{});
+    append(image, symbol(1, SHN_UNDEF, 0));     // printk
+    append(image, symbol(8, 1, 0));             // init_module, defined in .text
+    append(image, symbol(20, SHN_UNDEF, 0));    // kallsyms_lookup_name
+    append(image, symbol(0, SHN_UNDEF, 0));     // nameless
+    const std::size_t symtab_size = image.size() - symtab_offset;
+
+    const std::size_t strtab_offset = image.size();
+    image.insert(image.end(), strtab.begin(), strtab.end());
+
+    align(image, alignof(Elf64_Shdr));
+    const std::size_t shdr_offset = image.size();
+    Elf64_Shdr sections[4]{};
+    sections[1].sh_type = SHT_PROGBITS;
+    sections[1].sh_offset = text_offset;
+    sections[1].sh_size = 16;
+    sections[2].sh_type = SHT_SYMTAB;
+    sections[2].sh_offset = symtab_offset;
+    sections[2].sh_size = symtab_size;
+    sections[2].sh_link = 3;
+    sections[2].sh_entsize = sizeof(Elf64_Sym);
+    sections[3].sh_type = SHT_STRTAB;
+    sections[3].sh_offset = strtab_offset;
+    sections[3].sh_size = strtab.size();
+    for (const Elf64_Shdr& section : sections)
+        append(image, section);
+
+    Elf64_Ehdr ehdr{};
+    std::memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_type = ET_REL;
+    ehdr.e_machine = EM_AARCH64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr.e_shoff = shdr_offset;
+    ehdr.e_shentsize = sizeof(Elf64_Shdr);
+    ehdr.e_shnum = 4;
+    std::memcpy(image.data(), &ehdr, sizeof(ehdr));
+    return image;
+}
+
+Elf64_Sym read_symbol(const std::vector<std::uint8_t>& image, std::size_t offset) {
+    Elf64_Sym sym{};
+    std::memcpy(&sym, image.data() + offset, sizeof(sym));
+    return sym;
+}
+
+void test_collect_and_patch() {
+    std::vector<std::uint8_t> image = sample_object();
+    std::vector<UndefinedSymbol> symbols;
+    std::string error;
+    expect(collect_undefined_symbols(image.data(), image.size(), symbols, error),
+           "sample object parses");
+    expect(symbols.size() == 2, "only named undefined symbols are collected");
+    if (symbols.size() != 2)
+        return;
+    expect(symbols[0].name == "printk", "first import is printk");
+    expect(symbols[1].name == "kallsyms_lookup_name", "second import is kallsyms_lookup_name");
+
+    resolve_undefined_symbol(image.data(), symbols[1], 0xffffffc010203040ULL);
+    const Elf64_Sym patched = read_symbol(image, symbols[1].offset);
+    expect(patched.st_shndx == SHN_ABS, "patched symbol is absolute");
+    expect(patched.st_value == 0xffffffc010203040ULL, "patched symbol carries the address");
+    expect(read_symbol(image, symbols[0].offset).st_shndx == SHN_UNDEF,
+           "unresolved symbol is left undefined");
+
+    expect(collect_undefined_symbols(image.data(), image.size(), symbols, error) &&
+               symbols.size() == 1,
+           "patched symbol is no longer collected");
+}
+
+void test_rejects_malformed() {
+    std::vector<UndefinedSymbol> symbols;
+    std::string error;
+
+    std::vector<std::uint8_t> image = sample_object();
+    expect(!collect_undefined_symbols(image.data(), sizeof(Elf64_Ehdr) - 1, symbols, error),
+           "truncated header is rejected");
+
+    expect(!collect_undefined_symbols(image.data(), image.size() - 8, symbols, error),
+           "truncated section headers are rejected");
+
+    image = sample_object();
+    Elf64_Ehdr ehdr{};
+    std::memcpy(&ehdr, image.data(), sizeof(ehdr));
+    Elf64_Shdr strtab{};
+    const std::size_t strtab_header = ehdr.e_shoff + 3 * sizeof(Elf64_Shdr);
+    std::memcpy(&strtab, image.data() + strtab_header, sizeof(strtab));
+    // Drop the final NUL so the last name runs off the table
+    strtab.sh_size -= 1;
+    std::memcpy(image.data() + strtab_header, &strtab, sizeof(strtab));
+    expect(!collect_undefined_symbols(image.data(), image.size(), symbols, error),
+           "unterminated name is rejected");
+
+    image = sample_object();
+    image[EI_CLASS] = ELFCLASS32;
+    expect(!collect_undefined_symbols(image.data(), image.size(), symbols, error),
+           "ELF32 is rejected");
+}
+
+void test_mapped_image() {
+    char path[] = "/tmp/ksuinit_module_image_XXXXXX";
+    const int fd = mkstemp(path);
+    expect(fd >= 0, "temporary module is created");
+    if (fd < 0)
+        return;
+    close(fd);
+    const std::vector<std::uint8_t> original = sample_object();
+    {
+        std::ofstream stream(path, std::ios::binary);
+        stream.write(reinterpret_cast<const char*>(original.data()),
+                     static_cast<std::streamsize>(original.size()));
+    }
+
+    {
+        ModuleImage image;
+        std::string error;
+        expect(image.open(path, error), "module maps");
+        expect(image.size() == original.size(), "mapping covers the module");
+
+        std::vector<UndefinedSymbol> symbols;
+        expect(collect_undefined_symbols(image.data(), image.size(), symbols, error) &&
+                   symbols.size() == 2,
+               "mapped module parses");
+        if (symbols.size() == 2)
+            resolve_undefined_symbol(image.data(), symbols[0], 0x1234);
+
+        const int sealed = image.seal();
+        expect(sealed < 0 || image.is_memfd(), "only a memfd is sealed");
+
+        std::vector<std::uint8_t> loaded;
+        expect(image.copy(loaded), "image reads back");
+        if (symbols.size() == 2 && loaded.size() == original.size()) {
+            const Elf64_Sym patched = read_symbol(loaded, symbols[0].offset);
+            expect(patched.st_shndx == SHN_ABS && patched.st_value == 0x1234,
+                   "patch is visible in the loaded image");
+        }
+    }
+
+    std::ifstream stream(path, std::ios::binary);
+    const std::vector<std::uint8_t> on_disk{std::istreambuf_iterator<char>(stream),
+                                            std::istreambuf_iterator<char>()};
+    expect(on_disk == original, "module file is left untouched");
+    unlink(path);
+}
+
+}  // namespace
+
+int main() {
+    test_collect_and_patch();
+    test_rejects_malformed();
+    test_mapped_image();
+
+    if (failures == 0)
+        std::cout << "module_image_test: all tests passed\n";
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
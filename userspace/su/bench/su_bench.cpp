@@ -0,0 +1,75 @@
+// Round-trip benchmark for the magisk-compat su path: runs `su -c true` through
+// the standalone client (and so through msud) back to back and reports
+// invocations per second. Not embedded into ksud; build with -DSU_BUILD_BENCH=ON
+// and run on device, e.g. `su_bench -n 500 /system/bin/su`.
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+extern char **environ;
+
+namespace {
+
+double now_seconds() {
+  struct timespec ts{};
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<double>(ts.tv_sec) + (static_cast<double>(ts.tv_nsec) / 1e9);
+}
+
+bool run_once(const char *su_path) {
+  char *const argv[] = {const_cast<char *>("su"), const_cast<char *>("-c"),
+                        const_cast<char *>("true"), nullptr};
+  pid_t pid = -1;
+  if (posix_spawn(&pid, su_path, nullptr, nullptr, argv, environ) != 0) {
+    return false;
+  }
+  int status = 0;
+  if (waitpid(pid, &status, 0) != pid) {
+    return false;
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  long iterations = 200;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    if (opt == 'n') {
+      iterations = strtol(optarg, nullptr, 10);
+    } else {
+      (void)fprintf(stderr, "usage: %s [-n iterations] [su path]\n", argv[0]);
+      return 2;
+    }
+  }
+  const char *su_path = optind < argc ? argv[optind] : "/system/bin/su";
+  if (iterations <= 0) {
+    iterations = 1;
+  }
+
+  // Warm up: first call may prompt or fault in the broker.
+  if (!run_once(su_path)) {
+    (void)fprintf(stderr, "su_bench: `%s -c true` failed\n", su_path);
+    return 1;
+  }
+
+  const double start = now_seconds();
+  long failures = 0;
+  for (long i = 0; i < iterations; ++i) {
+    if (!run_once(su_path)) {
+      ++failures;
+    }
+  }
+  const double elapsed = now_seconds() - start;
+
+  (void)printf("%ld round-trips in %.3f s: %.1f/s, %.3f ms each, %ld failed\n",
+               iterations, elapsed, static_cast<double>(iterations) / elapsed,
+               elapsed * 1000.0 / static_cast<double>(iterations), failures);
+  return failures == 0 ? 0 : 1;
+}
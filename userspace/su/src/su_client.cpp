@@ -1,5 +1,6 @@
 #include "magisk_compat/su_protocol.hpp"
 
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -7,6 +8,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <string>
 
@@ -35,6 +37,82 @@ int connect_msud() {
   return sock;
 }
 
+// `su --session`: one connection for many commands. Every line read from
+// stdin runs as `su -c <line>` with stdin at /dev/null and this process's
+// stdout/stderr; commands run one at a time so their output stays ordered.
+// Exits with the status of the last command.
+int run_session(int sock, const char *cwd, char **envp) {
+  SuRequest hello{};
+  hello.magic = kSuSessionMagic;
+  SuResult opened{};
+  if (!write_all(sock, &hello, sizeof(hello)) ||
+      !read_all(sock, &opened, sizeof(opened)) || opened.magic != kSuMagic) {
+    (void)fprintf(stderr, "su: no response from authorization daemon\n");
+    return 1;
+  }
+  if (opened.granted == 0) {
+    (void)fprintf(stderr,
+                  "su: session denied (grant root to this app first)\n");
+    return 1;
+  }
+
+  const int devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  const std::array<int, 3> fds = {devnull, 1, 2};
+  int last = 0;
+  uint32_t seq = 0;
+  char *line = nullptr;
+  size_t cap = 0;
+  ssize_t len;
+  while ((len = getline(&line, &cap, stdin)) >= 0) {
+    if (len > 0 && line[len - 1] == '\n') {
+      line[len - 1] = '\0';
+    }
+    if (line[0] == '\0') {
+      continue;
+    }
+
+    std::array<char *, 4> args = {const_cast<char *>("su"),
+                                  const_cast<char *>("-c"), line, nullptr};
+    uint32_t na = 0;
+    uint32_t ne = 0;
+    const std::string payload =
+        build_payload(cwd, 3, args.data(), envp, &na, &ne);
+    if (payload.size() > kSuMaxPayload) {
+      (void)fprintf(stderr, "su: command too large\n");
+      last = 1;
+      continue;
+    }
+    SuCommand cmd{};
+    cmd.magic = kSuSessionMagic;
+    cmd.seq = ++seq;
+    cmd.argc = na;
+    cmd.envc = ne;
+    cmd.payload_len = static_cast<uint32_t>(payload.size());
+
+    SuCommandResult res{};
+    if (!send_with_fds(sock, &cmd, sizeof(cmd), fds.data(),
+                       static_cast<int>(fds.size())) ||
+        !write_all(sock, payload.data(), payload.size()) ||
+        !read_all(sock, &res, sizeof(res)) || res.magic != kSuSessionMagic ||
+        res.seq != cmd.seq) {
+      (void)fprintf(stderr, "su: session lost\n");
+      last = 1;
+      break;
+    }
+    if (res.granted == 0) {
+      (void)fprintf(stderr, "su: access denied\n");
+      last = 1;
+      break;
+    }
+    last = res.exit_code;
+  }
+  free(line);
+  if (devnull >= 0) {
+    close(devnull);
+  }
+  return last;
+}
+
 } // namespace
 
 int main(int argc, char **argv, char **envp) {
@@ -47,6 +125,10 @@ int main(int argc, char **argv, char **envp) {
   std::array<char, 4096> cwdbuf{};
   const char *cwd = getcwd(cwdbuf.data(), cwdbuf.size());
 
+  if (argc == 2 && strcmp(argv[1], "--session") == 0) {
+    return run_session(sock, cwd ? cwd : "/", envp);
+  }
+
   uint32_t na = 0;
   uint32_t ne = 0;
   const std::string payload =